@@ -16,6 +16,12 @@ std::string get_buffer(read_piece_alert const& rpa)
        : std::string();
 }
 
+std::string get_resume_data_buffer(save_resume_data_alert const& a)
+{
+    return a.resume_data_buffer ? std::string(a.resume_data_buffer->begin()
+        , a.resume_data_buffer->end()) : std::string();
+}
+
 tuple endpoint_to_tuple(tcp::endpoint const& ep)
 {
     return boost::python::make_tuple(ep.address().to_string(), ep.port());
@@ -362,6 +368,7 @@ void bind_alert()
     class_<save_resume_data_alert, bases<torrent_alert>, noncopyable>(
         "save_resume_data_alert", no_init)
         .def_readonly("resume_data", &save_resume_data_alert::resume_data)
+        .add_property("resume_data_buffer", &get_resume_data_buffer)
         ;
 
     class_<file_completed_alert, bases<torrent_alert>, noncopyable>(
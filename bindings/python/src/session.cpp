@@ -287,6 +287,16 @@ namespace
 #endif
     }
 
+    void async_add_torrents(session& s, list params)
+    {
+        std::vector<add_torrent_params> p(len(params));
+        for (int i = 0; i < int(p.size()); ++i)
+            dict_to_add_torrent_params(extract<dict>(params[i]), p[i]);
+
+        allow_threading_guard guard;
+        s.async_add_torrents(p);
+    }
+
     void dict_to_feed_settings(dict params, feed_settings& feed)
     {
         if (params.has_key("auto_download"))
@@ -410,6 +420,8 @@ namespace
         ret["num_connected"] = st.utp_stats.num_connected;
         ret["num_fin_sent"] = st.utp_stats.num_fin_sent;
         ret["num_close_wait"] = st.utp_stats.num_close_wait;
+        ret["packets_in_use"] = st.utp_stats.packets_in_use;
+        ret["packets_high_water"] = st.utp_stats.packets_high_water;
         return ret;
     }
 
@@ -538,6 +550,13 @@ void bind_session()
         .def_readonly("tracker_download_rate", &session_status::tracker_download_rate)
         .def_readonly("total_tracker_download", &session_status::total_tracker_download)
         .def_readonly("total_tracker_upload", &session_status::total_tracker_upload)
+        .def_readonly("num_idle_tracker_connections", &session_status::num_idle_tracker_connections)
+        .def_readonly("total_tracker_connections", &session_status::total_tracker_connections)
+        .def_readonly("total_tracker_connection_reuses", &session_status::total_tracker_connection_reuses)
+        .def_readonly("dns_cache_size", &session_status::dns_cache_size)
+        .def_readonly("total_dns_lookups", &session_status::total_dns_lookups)
+        .def_readonly("total_dns_cache_hits", &session_status::total_dns_cache_hits)
+        .def_readonly("total_dns_shared_lookups", &session_status::total_dns_shared_lookups)
 
         .def_readonly("total_redundant_bytes", &session_status::total_redundant_bytes)
         .def_readonly("total_failed_bytes", &session_status::total_failed_bytes)
@@ -559,9 +578,13 @@ void bind_session()
         .def_readonly("dht_nodes", &session_status::dht_nodes)
         .def_readonly("dht_node_cache", &session_status::dht_node_cache)
         .def_readonly("dht_torrents", &session_status::dht_torrents)
+        .def_readonly("dht_peers", &session_status::dht_peers)
+        .def_readonly("dht_items", &session_status::dht_items)
+        .def_readonly("dht_storage_bytes", &session_status::dht_storage_bytes)
         .def_readonly("dht_global_nodes", &session_status::dht_global_nodes)
         .def_readonly("active_requests", &session_status::active_requests)
         .def_readonly("dht_total_allocations", &session_status::dht_total_allocations)
+        .def_readonly("dht_instances", &session_status::dht_instances)
 #endif
         .add_property("utp_stats", &get_utp_stats)
         ;
@@ -574,6 +597,15 @@ void bind_session()
         .def_readonly("response", &dht_lookup::responses)
         .def_readonly("branch_factor", &dht_lookup::branch_factor)
     ;
+
+    class_<dht_instance_status>("dht_instance_status")
+        .def_readonly("nodes", &dht_instance_status::nodes)
+        .def_readonly("node_cache", &dht_instance_status::node_cache)
+        .def_readonly("torrents", &dht_instance_status::torrents)
+        .def_readonly("peers", &dht_instance_status::peers)
+        .def_readonly("items", &dht_instance_status::items)
+        .def_readonly("storage_bytes", &dht_instance_status::storage_bytes)
+    ;
 #endif
 
     enum_<storage_mode_t>("storage_mode_t")
@@ -665,6 +697,7 @@ void bind_session()
 #endif
         .def("add_torrent", &add_torrent)
         .def("async_add_torrent", &async_add_torrent)
+        .def("async_add_torrents", &async_add_torrents)
 #ifndef BOOST_NO_EXCEPTIONS
 #ifndef TORRENT_NO_DEPRECATE
         .def(
@@ -16,6 +16,10 @@ void bind_session_settings()
         .def_readwrite("tracker_receive_timeout", &session_settings::tracker_receive_timeout)
         .def_readwrite("stop_tracker_timeout", &session_settings::stop_tracker_timeout)
         .def_readwrite("tracker_maximum_response_length", &session_settings::tracker_maximum_response_length)
+        .def_readwrite("tracker_keepalive_connections", &session_settings::tracker_keepalive_connections)
+        .def_readwrite("tracker_keepalive_timeout", &session_settings::tracker_keepalive_timeout)
+        .def_readwrite("resolver_cache_timeout", &session_settings::resolver_cache_timeout)
+        .def_readwrite("resolver_negative_cache_timeout", &session_settings::resolver_negative_cache_timeout)
         .def_readwrite("piece_timeout", &session_settings::piece_timeout)
         .def_readwrite("request_timeout", &session_settings::request_timeout)
         .def_readwrite("request_queue_time", &session_settings::request_queue_time)
@@ -26,6 +30,7 @@ void bind_session_settings()
         .def_readwrite("urlseed_timeout", &session_settings::urlseed_timeout)
         .def_readwrite("urlseed_pipeline_size", &session_settings::urlseed_pipeline_size)
         .def_readwrite("urlseed_wait_retry", &session_settings::urlseed_wait_retry)
+        .def_readwrite("urlseed_max_connections", &session_settings::urlseed_max_connections)
         .def_readwrite("file_pool_size", &session_settings::file_pool_size)
         .def_readwrite("allow_multiple_connections_per_ip", &session_settings::allow_multiple_connections_per_ip)
         .def_readwrite("max_failcount", &session_settings::max_failcount)
@@ -163,6 +168,7 @@ void bind_session_settings()
 #endif
         .def_readwrite("utp_dynamic_sock_buf", &session_settings::utp_dynamic_sock_buf)
         .def_readwrite("utp_loss_multiplier", &session_settings::utp_loss_multiplier)
+        .def_readwrite("utp_pacing", &session_settings::utp_pacing)
         .def_readwrite("mixed_mode_algorithm", &session_settings::mixed_mode_algorithm)
         .def_readwrite("listen_queue_size", &session_settings::listen_queue_size)
         .def_readwrite("announce_double_nat", &session_settings::announce_double_nat)
@@ -191,6 +197,8 @@ void bind_session_settings()
 		  .def_readwrite("report_redundant_bytes", &session_settings::report_redundant_bytes)
 		  .def_readwrite("handshake_client_version", &session_settings::handshake_client_version)
 		  .def_readwrite("use_disk_cache_pool", &session_settings::use_disk_cache_pool)
+		  .def_readwrite("network_threads", &session_settings::network_threads)
+		  .def_readwrite("add_torrent_threads", &session_settings::add_torrent_threads)
     ;
 
     enum_<proxy_settings::proxy_type>("proxy_type")
@@ -257,7 +265,9 @@ void bind_session_settings()
 #endif
         .def_readwrite("max_fail_count", &dht_settings::max_fail_count)
         .def_readwrite("max_torrents", &dht_settings::max_torrents)
+        .def_readwrite("max_peers", &dht_settings::max_peers)
         .def_readwrite("max_dht_items", &dht_settings::max_dht_items)
+        .def_readwrite("num_instances", &dht_settings::num_instances)
         .def_readwrite("restrict_routing_ips", &dht_settings::restrict_routing_ips)
         .def_readwrite("restrict_search_ips", &dht_settings::restrict_search_ips)
     ;
@@ -486,6 +486,8 @@ void bind_torrent_handle()
 
     enum_<torrent_handle::save_resume_flags_t>("save_resume_flags_t")
         .value("flush_disk_cache", torrent_handle::flush_disk_cache)
+        .value("save_info_dict", torrent_handle::save_info_dict)
+        .value("only_bencoded", torrent_handle::only_bencoded)
     ;
 
     enum_<torrent_handle::deadline_flags>("deadline_flags")
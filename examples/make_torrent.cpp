@@ -39,6 +39,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/create_torrent.hpp"
 #include "libtorrent/file.hpp"
 #include "libtorrent/file_pool.hpp"
+#include "libtorrent/time.hpp"
 
 #include <boost/bind.hpp>
 
@@ -152,6 +153,9 @@ void print_usage()
 		"            where the filename defaults to a.torrent\n"
 		"-r file     add root certificate to the torrent, to verify\n"
 		"            the HTTPS tracker\n"
+		"-j threads  the number of threads hashing pieces. Defaults\n"
+		"            to one per CPU core. The time it took and the\n"
+		"            hashing rate are printed when done\n"
 		, stderr);
 }
 
@@ -177,6 +181,7 @@ int main(int argc, char* argv[])
 		int pad_file_limit = -1;
 		int piece_size = 0;
 		int flags = 0;
+		int num_threads = 0;
 		std::string root_cert;
 
 		std::string outfile;
@@ -241,6 +246,10 @@ int main(int argc, char* argv[])
 					++i;
 					root_cert = argv[i];
 					break;
+				case 'j':
+					++i;
+					num_threads = atoi(argv[i]);
+					break;
 				default:
 					print_usage();
 					return 1;
@@ -269,15 +278,18 @@ int main(int argc, char* argv[])
 			t.add_url_seed(*i);
 
 		error_code ec;
+		ptime start = time_now_hires();
 		set_piece_hashes(t, parent_path(full_path)
-			, boost::bind(&print_progress, _1, t.num_pieces()), ec);
+			, boost::bind(&print_progress, _1, t.num_pieces()), ec, num_threads);
 		if (ec)
 		{
 			fprintf(stderr, "%s\n", ec.message().c_str());
 			return 1;
 		}
+		int ms = int(total_milliseconds(time_now_hires() - start));
 
-		fprintf(stderr, "\n");
+		fprintf(stderr, "\nhashed %d pieces in %d ms (%.1f MB/s)\n"
+			, t.num_pieces(), ms, fs.total_size() / 1000.0 / (std::max)(ms, 1));
 		t.set_creator(creator_str.c_str());
 		if (!comment_str.empty())
 			t.set_comment(comment_str.c_str());
@@ -30,51 +30,153 @@ POSSIBILITY OF SUCH DAMAGE.
 
 */
 
-#include "libtorrent/error_code.hpp"
-#include "libtorrent/session.hpp"
-#include "libtorrent/socket_type.hpp"
-#include "libtorrent/utp_socket_manager.hpp"
-#include "libtorrent/utp_stream.hpp"
+#include <cstdio>
+#include <cstdlib>
+#include <boost/bind.hpp>
+
+#include "libtorrent/udp_socket.hpp"
+#include "libtorrent/address.hpp"
+#include "libtorrent/connection_queue.hpp"
+#include "libtorrent/deadline_timer.hpp"
+#include "libtorrent/time.hpp"
 
 using namespace libtorrent;
 
-void on_connect(error_code const& e)
+// loopback benchmark of udp_socket. One socket sends datagrams as fast as
+// it can to another one, bound to 127.0.0.1. The sender queues up
+// <batch> datagrams at a time with cork()/uncork(), which sends them
+// with a single system call where sendmmsg() is available. The receiving
+// end drains its socket with recvmmsg() where it's available.
+
+struct receiver : udp_socket_observer
 {
-}
+	receiver(): packets(0), bytes(0) {}
+
+	virtual bool incoming_packet(error_code const& ec
+		, udp::endpoint const&, char const* buf, int size)
+	{
+		if (ec) return false;
+		++packets;
+		bytes += size;
+		return true;
+	}
 
-void on_udp_receive(error_code const& e, udp::endpoint const& ep
-		, char const* buf, int size)
+	boost::int64_t packets;
+	boost::int64_t bytes;
+};
+
+struct sender : udp_socket_observer
 {
-}
+	sender(udp_socket& s, udp::endpoint const& target, int size, int batch)
+		: sock(s), ep(target), buf(size, 'x'), batch(batch), packets(0)
+		, stalls(0), done(false) {}
+
+	virtual bool incoming_packet(error_code const& ec
+		, udp::endpoint const&, char const* buf, int size)
+	{ return false; }
+
+	// the socket has room for more datagrams again
+	virtual void writable() { send_burst(); }
 
-void on_utp_incoming(void* userdata
-		, boost::shared_ptr<utp_stream> const& utp_sock)
+	void send_burst()
+	{
+		if (done) return;
+		sock.cork();
+		for (int i = 0; i < batch; ++i)
+		{
+			error_code ec;
+			sock.send(ep, &buf[0], buf.size(), ec);
+			if (ec == asio::error::would_block || ec == asio::error::try_again)
+			{
+				// we'll be notified via writable()
+				++stalls;
+				sock.uncork();
+				return;
+			}
+			++packets;
+		}
+		sock.uncork();
+		sock.get_io_service().post(boost::bind(&sender::send_burst, this));
+	}
+
+	udp_socket& sock;
+	udp::endpoint ep;
+	std::vector<char> buf;
+	int batch;
+	boost::int64_t packets;
+	boost::int64_t stalls;
+	bool done;
+};
+
+void on_done(sender* s, udp_socket* a, udp_socket* b)
 {
+	s->done = true;
+	a->close();
+	b->close();
 }
 
 int main(int argc, char* argv[])
 {
-	//int rtt, rtt_var;
-	//int max_window, cur_window;
-	//int delay_factor, window_factor, scaled_gain;
+	if (argc > 4)
+	{
+		fprintf(stderr, "usage: utp_test [packet-size] [batch] [seconds]\n");
+		return 1;
+	}
 
-	/*session s;
-	s.listen_on(std::make_pair(6881, 6889));*/
+	int size = argc > 1 ? atoi(argv[1]) : 1400;
+	int batch = argc > 2 ? atoi(argv[2]) : 32;
+	int duration = argc > 3 ? atoi(argv[3]) : 5;
+	if (size < 1 || size > 65000 || batch < 1 || duration < 1)
+	{
+		fprintf(stderr, "invalid argument\n");
+		return 1;
+	}
 
 	io_service ios;
 	connection_queue cc(ios);
-	udp_socket udp_sock(ios, boost::bind(&on_udp_receive, _1, _2, _3, _4), cc);
-	
-	void* userdata;
-	utp_socket_manager utp_sockets(udp_sock, boost::bind(&on_utp_incoming, _1, _2), userdata);
-	
-	/*error_code ec;
-	utp_stream sock(ios, cc);
-	sock.bind(udp::endpoint(address_v4::any(), 0), ec);
-	
-	tcp::endpoint ep(address_v4::from_string("239.192.152.143", ec), 6771);
-	
-	sock.async_connect(ep, boost::bind(on_connect, _1));*/
+	udp_socket send_sock(ios, cc);
+	udp_socket recv_sock(ios, cc);
+
+	error_code ec;
+	recv_sock.bind(udp::endpoint(address_v4::loopback(), 0), ec);
+	if (!ec) send_sock.bind(udp::endpoint(address_v4::loopback(), 0), ec);
+	if (ec)
+	{
+		fprintf(stderr, "failed to bind: %s\n", ec.message().c_str());
+		return 1;
+	}
+	recv_sock.set_buf_size(size);
+	recv_sock.set_option(udp::socket::receive_buffer_size(4 * 1024 * 1024), ec);
+	send_sock.set_option(udp::socket::send_buffer_size(1024 * 1024), ec);
+
+	receiver r;
+	recv_sock.subscribe(&r);
+	sender s(send_sock, udp::endpoint(address_v4::loopback()
+		, recv_sock.local_port()), size, batch);
+	send_sock.subscribe(&s);
 
+	deadline_timer timer(ios);
+	timer.expires_from_now(seconds(duration), ec);
+	timer.async_wait(boost::bind(&on_done, &s, &send_sock, &recv_sock));
+
+	ptime start = time_now_hires();
+	ios.post(boost::bind(&sender::send_burst, &s));
+	ios.run(ec);
+	double elapsed = total_microseconds(time_now_hires() - start) / 1000000.0;
+
+	recv_sock.unsubscribe(&r);
+	send_sock.unsubscribe(&s);
+
+	fprintf(stderr, "packet size: %d batch: %d\n"
+		"sent:     %10.0f packets/s\n"
+		"received: %10.0f packets/s (%.1f MB/s)\n"
+		"lost:     %10.2f %%\n"
+		"stalls:   %10" PRId64 "\n"
+		, size, batch
+		, s.packets / elapsed
+		, r.packets / elapsed, r.bytes / elapsed / 1000000.0
+		, s.packets == 0 ? 0.0 : (s.packets - r.packets) * 100.0 / s.packets
+		, s.stalls);
 	return 0;
 }
+
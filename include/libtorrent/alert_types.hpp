@@ -35,6 +35,8 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/alert.hpp"
 #include "libtorrent/torrent_handle.hpp"
+#include "libtorrent/status_delta.hpp"
+#include "libtorrent/performance_counters.hpp"
 #include "libtorrent/socket.hpp"
 #include "libtorrent/config.hpp"
 #include "libtorrent/assert.hpp"
@@ -1007,6 +1009,15 @@ namespace libtorrent
 			: torrent_alert(h)
 			, resume_data(rd)
 		{}
+
+		// internal
+		save_resume_data_alert(boost::shared_ptr<entry> const& rd
+			, boost::shared_ptr<std::vector<char> > const& buf
+			, torrent_handle const& h)
+			: torrent_alert(h)
+			, resume_data(rd)
+			, resume_data_buffer(buf)
+		{}
 	
 		TORRENT_DEFINE_ALERT(save_resume_data_alert);
 
@@ -1015,8 +1026,12 @@ namespace libtorrent
 		{ return torrent_alert::message() + " resume data generated"; }
 		virtual bool discardable() const { return false; }
 
-		// points to the resume data.
+		// points to the resume data. This is empty if the resume data was
+		// saved with the torrent_handle::only_bencoded flag.
 		boost::shared_ptr<entry> resume_data;
+
+		// the resume data, bencoded. It can be written to disk as is.
+		boost::shared_ptr<std::vector<char> > resume_data_buffer;
 	};
 
 	// This alert is generated instead of ``save_resume_data_alert`` if there was an error
@@ -1869,6 +1884,55 @@ namespace libtorrent
 		std::vector<torrent_status> status;
 	};
 
+	// This alert is only posted when requested by the user, by calling
+	// session::post_torrent_delta_updates() on the session. It contains a delta
+	// for every torrent whose status changed since the last time this alert was
+	// posted, with only the fields that changed. Its category is
+	// ``status_notification``, but it's not subject to filtering, since it's only
+	// manually posted anyway.
+	struct TORRENT_EXPORT state_delta_alert : alert
+	{
+		TORRENT_DEFINE_ALERT(state_delta_alert);
+
+		const static int static_category = alert::status_notification;
+		virtual std::string message() const;
+		virtual bool discardable() const { return false; }
+
+		// the changes to each torrent. Call torrent_status_delta::apply() to
+		// update the torrent_status object referring to the same ``handle``.
+		std::vector<torrent_status_delta> deltas;
+	};
+
+	// The session_stats_alert is posted when the user requests session
+	// statistics by calling post_session_stats() on the session object. Its
+	// category is ``stats_notification``, but it is not subject to filtering,
+	// since it's only manually posted anyway.
+	struct TORRENT_EXPORT session_stats_alert : alert
+	{
+		// internal
+		session_stats_alert(counters const& cnt);
+
+		TORRENT_DEFINE_ALERT(session_stats_alert);
+
+		const static int static_category = alert::stats_notification;
+		virtual std::string message() const;
+		virtual bool discardable() const { return false; }
+
+		// An array of all the counters and gauges of the session, sampled at
+		// the time of timestamp(). The indices into this array are the
+		// ``value_index`` of the stats_metric objects returned by
+		// session_stats_metrics(). The values are laid out as a flat array to
+		// make it cheap to sample and store periodically.
+		boost::uint64_t values[counters::num_counters];
+
+		// the bucket counts of all latency histograms of the session,
+		// indexed by the ``value_index`` of stats_metric objects of type
+		// ``type_histogram``. The bucket boundaries are defined by
+		// latency_histogram::bucket_lower_bound(), and the counts are
+		// cumulative since the session started.
+		boost::uint64_t histograms[counters::num_histograms][latency_histogram::num_buckets];
+	};
+
 	// When a torrent changes its info-hash, this alert is posted. This only happens in very
 	// specific cases. For instance, when a torrent is downloaded from a URL, the true info
 	// hash is not known immediately. First the .torrent file must be downloaded and parsed.
@@ -85,9 +85,12 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/socket_io.hpp" // for print_address
 #include "libtorrent/address.hpp"
 #include "libtorrent/utp_socket_manager.hpp"
+#include "libtorrent/resolver.hpp"
 #include "libtorrent/bloom_filter.hpp"
 #include "libtorrent/rss.hpp"
 #include "libtorrent/alert_dispatcher.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/network_thread_pool.hpp"
 #include "libtorrent/kademlia/dht_observer.hpp"
 
 #if TORRENT_COMPLETE_TYPES_REQUIRED
@@ -123,6 +126,7 @@ namespace libtorrent
 	}
 
 	struct bencode_map_entry;
+	struct bencode_writer;
 
 	struct listen_socket_t
 	{
@@ -151,6 +155,7 @@ namespace libtorrent
 	namespace aux
 	{
 		struct session_impl;
+		struct add_torrent_batch;
 
 #if defined TORRENT_STATS && !defined __MACH__
 		struct vm_statistics_data_t
@@ -335,7 +340,7 @@ namespace libtorrent
 #endif
 			void on_dht_announce(error_code const& e);
 			void on_dht_router_name_lookup(error_code const& e
-				, tcp::resolver::iterator host);
+				, std::vector<address> const& addresses, int port);
 #endif
 
 			void maybe_update_udp_mapping(int nat, int local_port, int external_port);
@@ -373,8 +378,12 @@ namespace libtorrent
 			bool is_listening() const;
 
 			torrent_handle add_torrent(add_torrent_params const&, error_code& ec);
-			torrent_handle add_torrent_impl(add_torrent_params const&, error_code& ec);
+			torrent_handle add_torrent_impl(add_torrent_params const&, error_code& ec
+				, int* queue_pos = 0);
 			void async_add_torrent(add_torrent_params* params);
+			void async_add_torrents(std::vector<add_torrent_params>* params);
+			void add_torrent_batch_thread(boost::shared_ptr<add_torrent_batch> b);
+			void on_add_torrent_batch(boost::shared_ptr<add_torrent_batch> b);
 
 			void remove_torrent(torrent_handle const& h, int options);
 			void remove_torrent_impl(boost::shared_ptr<torrent> tptr, int options);
@@ -385,6 +394,7 @@ namespace libtorrent
 			void refresh_torrent_status(std::vector<torrent_status>* ret
 				, boost::uint32_t flags) const;
 			void post_torrent_updates();
+			void post_torrent_delta_updates();
 
 			std::vector<torrent_handle> get_torrents() const;
 			
@@ -428,6 +438,16 @@ namespace libtorrent
 			void choke_peer(peer_connection& c);
 
 			session_status status() const;
+
+			// samples all counters and gauges and posts them
+			// in a session_stats_alert
+			void post_session_stats();
+
+			// the session-wide performance counters. See counters
+			void inc_stats_counter(int c, int value = 1)
+			{ m_stats_counters.inc_stats_counter(c, value); }
+			counters& stats_counters() { return m_stats_counters; }
+
 			void set_peer_id(peer_id const& id);
 			void set_key(int key);
 			address listen_address() const;
@@ -441,6 +461,9 @@ namespace libtorrent
 			void announce_lsd(sha1_hash const& ih, int port, bool broadcast = false);
 
 			void save_state(entry* e, boost::uint32_t flags) const;
+			void save_state_buffer(std::vector<char>* buf, boost::uint32_t flags) const;
+			// writes the session state as a bencoded dictionary
+			void write_state(bencode_writer& w, boost::uint32_t flags) const;
 			void load_state(lazy_entry const* e);
 
 			void set_proxy(proxy_settings const& s);
@@ -689,6 +712,12 @@ namespace libtorrent
 			// handles delayed alerts
 			alert_manager m_alerts;
 
+			// all the performance counters and gauges of the session.
+			// These are always maintained, and sampled by
+			// post_session_stats(). The disk thread records its latencies
+			// here, so it must outlive m_disk_thread
+			counters m_stats_counters;
+
 			// handles disk io requests asynchronously
 			// peers have pointers into the disk buffer
 			// pool, and must be destructed before this
@@ -699,6 +728,12 @@ namespace libtorrent
 			// constructed after it.
 			disk_io_thread m_disk_thread;
 
+			// threads that issue socket writes on behalf of the network
+			// thread. See session_settings::network_threads. Jobs refer to
+			// the io_service and to peer connections, so this must be
+			// destructed before m_io_service
+			network_thread_pool m_net_thread_pool;
+
 			// this is a list of half-open tcp connections
 			// (only outgoing connections)
 			// this has to be one of the last
@@ -757,6 +792,10 @@ namespace libtorrent
 			// this has all torrents that wants to be checked in it
 			check_queue_t m_queued_for_checking;
 
+			// batches of torrents added by async_add_torrents() that
+			// are still being parsed or inserted
+			std::vector<boost::shared_ptr<add_torrent_batch> > m_add_torrent_batches;
+
 			// this maps sockets to their peer_connection
 			// object. It is the complete list of all connected
 			// peers.
@@ -1013,7 +1052,9 @@ namespace libtorrent
 			// by Local service discovery
 			deadline_timer m_lsd_announce_timer;
 
-			tcp::resolver m_host_resolver;
+			// resolves host names for trackers, web seeds, peers and DHT
+			// routers, and caches the results
+			resolver m_host_resolver;
 
 			// the index of the torrent that will be offered to
 			// connect to a peer next time on_tick is called.
@@ -1052,6 +1093,7 @@ namespace libtorrent
 
 #ifdef TORRENT_STATS
 			void rotate_stats_log();
+			void write_latency_log();
 			void print_log_line(int tick_interval_ms, ptime now);
 			void reset_stat_counters();
 			void enable_stats_logging(bool s);
@@ -1067,84 +1109,24 @@ namespace libtorrent
 			// rotated every hour and the sequence number is
 			// incremented by one
 			int m_log_seq;
-			// the number of peers that were disconnected this
-			// tick due to protocol error
-			int m_error_peers;
-			int m_disconnected_peers;
-			int m_eof_peers;
-			int m_connreset_peers;
-			int m_connrefused_peers;
-			int m_connaborted_peers;
-			int m_perm_peers;
-			int m_buffer_peers;
-			int m_unreachable_peers;
-			int m_broken_pipe_peers;
-			int m_addrinuse_peers;
-			int m_no_access_peers;
-			int m_invalid_arg_peers;
-			int m_aborted_peers;
-
-			int m_piece_requests;
-			int m_max_piece_requests;
-			int m_invalid_piece_requests;
-			int m_choked_piece_requests;
-			int m_cancelled_piece_requests;
-			int m_piece_rejects;
-
-			int m_error_incoming_peers;
-			int m_error_outgoing_peers;
-			int m_error_rc4_peers;
-			int m_error_encrypted_peers;
-			int m_error_tcp_peers;
-			int m_error_utp_peers;
-			// the number of times the piece picker fell through
-			// to the end-game mode
-			int m_end_game_piece_picker_blocks;
-			int m_piece_picker_blocks;
-			int m_piece_picks;
-			int m_reject_piece_picks;
-			int m_unchoke_piece_picks;
-			int m_incoming_redundant_piece_picks;
-			int m_incoming_piece_picks;
-			int m_end_game_piece_picks;
-			int m_snubbed_piece_picks;
-			int m_connect_timeouts;
-			int m_uninteresting_peers;
-			int m_timeout_peers;
-			int m_no_memory_peers;
-			int m_too_many_peers;
-			int m_transport_timeout_peers;
 			cache_status m_last_cache_status;
 			size_type m_last_failed;
 			size_type m_last_redundant;
 			size_type m_last_uploaded;
 			size_type m_last_downloaded;
-			int m_connection_attempts;
-			int m_num_banned_peers;
-			int m_banned_for_hash_failure;
+
+			// the value of all counters when the last log line was
+			// printed. The log prints the number of events per line
+			boost::int64_t m_last_stats_counters[counters::num_counters];
+
+			// the value of all counters when the log was last rotated.
+			// Some columns are cumulative within one log file
+			boost::int64_t m_rotation_stats_counters[counters::num_counters];
+
 			vm_statistics_data_t m_last_vm_stat;
 			thread_cpu_usage m_network_thread_cpu_usage;
 			sliding_average<20> m_read_ops;
-			sliding_average<20> m_write_ops;;
-			enum
-			{
-				on_read_counter,
-				on_write_counter,
-				on_tick_counter,
-				on_lsd_counter,
-				on_lsd_peer_counter,
-				on_udp_counter,
-				on_accept_counter,
-				on_disk_queue_counter,
-				on_disk_read_counter,
-				on_disk_write_counter,
-				max_messages
-			};
-			int m_num_messages[max_messages];
-			// 8, 16, 32, 64, 128, 256, 512, 1024, 2048, 4096, 8192,
-			// 16384, 32768, 65536, 131072, 262144, 524288, 1048576
-			int m_send_buffer_sizes[18];
-			int m_recv_buffer_sizes[18];
+			sliding_average<20> m_write_ops;
 #endif
 
 			// each second tick the timer takes a little
@@ -0,0 +1,129 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_BENCODE_WRITER_HPP_INCLUDED
+#define TORRENT_BENCODE_WRITER_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/size_type.hpp"
+#include "libtorrent/entry.hpp"
+
+#include <vector>
+#include <string>
+#include <cstring>
+
+namespace libtorrent
+{
+	// writes bencoded data straight into a buffer, without building an
+	// entry tree first. The buffer is appended to, so a buffer that is
+	// cleared and reused for every message stops allocating once it has
+	// grown to the size of the largest message.
+	//
+	// it's the caller's responsibility to balance begin_dict()/begin_list()
+	// with end(), and to write dictionary keys in sorted order.
+	struct TORRENT_EXTRA_EXPORT bencode_writer
+	{
+		bencode_writer(std::vector<char>& buf): m_buf(buf) {}
+
+		void begin_dict() { m_buf.push_back('d'); }
+		void begin_list() { m_buf.push_back('l'); }
+		void end() { m_buf.push_back('e'); }
+
+		void key(char const* k) { string(k); }
+		void key(std::string const& k) { string(k); }
+
+		void string(char const* str, int len);
+		void string(char const* str) { string(str, int(std::strlen(str))); }
+		void string(std::string const& str)
+		{ string(str.c_str(), int(str.size())); }
+
+		// writes the length prefix of a string of len bytes. The string
+		// itself is then expected to be written with raw()
+		void string_prefix(int len);
+
+		// writes the length prefix of a string of len bytes and returns a
+		// pointer to the len bytes following it, for the caller to fill in.
+		// The pointer is invalidated by the next write
+		char* reserve_string(int len);
+
+		void integer(size_type val);
+
+		// append data that is already bencoded
+		void raw(char const* buf, int len)
+		{ m_buf.insert(m_buf.end(), buf, buf + len); }
+
+		// bencodes e. For parts of a message that only exist as an entry,
+		// e.g. ones built by a plugin
+		void value(entry const& e);
+
+	private:
+		void write_decimal(size_type val);
+
+		std::vector<char>& m_buf;
+	};
+
+	// writes the keys of a dictionary from two sources: the ones passed to
+	// key() by the caller, in sorted order, and the ones already in a
+	// dictionary entry, e.g. filled in by a storage or a plugin. The
+	// entry's keys are written in between the caller's where they belong.
+	// If both have the same key, override decides which value is kept.
+	// finish() must be called before ending the dictionary.
+	struct TORRENT_EXTRA_EXPORT bencode_dict_merge
+	{
+		// if override is true, the entry's values replace the caller's,
+		// otherwise the entry's values are dropped. If extra isn't a
+		// dictionary, it's ignored
+		bencode_dict_merge(bencode_writer& w, entry const& extra, bool override);
+
+		// returns false if the caller should not write this key's value,
+		// because the one from the entry was written in its place
+		bool key(char const* k);
+
+		// writes the remaining keys from the entry
+		void finish();
+
+	private:
+		void write_extra(char const* before);
+
+		bencode_writer& m_w;
+		// the entry's dictionary, or 0
+		entry::dictionary_type const* m_extra;
+		entry::dictionary_type::const_iterator m_next;
+		bool m_override;
+#if TORRENT_USE_ASSERTS
+		std::string m_last_key;
+#endif
+	};
+}
+
+#endif // TORRENT_BENCODE_WRITER_HPP_INCLUDED
+
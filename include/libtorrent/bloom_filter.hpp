@@ -60,6 +60,9 @@ namespace libtorrent
 		void from_string(char const* str)
 		{ memcpy(bits, str, N); }
 
+		// the raw N bytes of the filter, as returned by to_string()
+		char const* data() const { return (char const*)&bits[0]; }
+
 		void clear() { memset(bits, 0, N); }
 
 		float size() const
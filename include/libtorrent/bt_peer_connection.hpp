@@ -167,6 +167,8 @@ namespace libtorrent
 			, std::size_t bytes_transferred);
 		void on_receive(error_code const& error
 			, std::size_t bytes_transferred);
+		void on_receive_impl(error_code const& error
+			, std::size_t bytes_transferred);
 		
 		virtual void get_specific_peer_info(peer_info& p) const;
 		virtual bool in_handshake() const;
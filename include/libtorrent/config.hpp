@@ -240,6 +240,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #else
 #define TORRENT_USE_IFADDRS 1
 #define TORRENT_USE_POSIX_MEMALIGN 1
+// receive and send batches of UDP datagrams
+// with a single system call
+#define TORRENT_USE_RECVMMSG 1
+#define TORRENT_USE_SENDMMSG 1
 #endif
 
 #if __amd64__ || __i386__
@@ -403,6 +407,14 @@ int snprintf(char* buf, int len, char const* fmt, ...)
 #define TORRENT_USE_NETLINK 0
 #endif
 
+#ifndef TORRENT_USE_RECVMMSG
+#define TORRENT_USE_RECVMMSG 0
+#endif
+
+#ifndef TORRENT_USE_SENDMMSG
+#define TORRENT_USE_SENDMMSG 0
+#endif
+
 #ifndef TORRENT_USE_EXECINFO
 #define TORRENT_USE_EXECINFO 0
 #endif
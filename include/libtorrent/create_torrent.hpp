@@ -416,8 +416,12 @@ namespace libtorrent
 	// 
 	// The overloads that don't take an ``error_code&`` may throw an exception in case of a
 	// file error, the other overloads sets the error code to reflect the error, if any.
+	// 
+	// The files are read by one thread, ahead of ``num_threads`` threads hashing the
+	// pieces. ``f`` is still called from the calling thread, once per piece, in order.
+	// A ``num_threads`` of 0 means one hashing thread per CPU core.
 	TORRENT_EXPORT void set_piece_hashes(create_torrent& t, std::string const& p
-		, boost::function<void(int)> f, error_code& ec);
+		, boost::function<void(int)> f, error_code& ec, int num_threads = 0);
 	inline void set_piece_hashes(create_torrent& t, std::string const& p, error_code& ec)
 	{
 		set_piece_hashes(t, p, detail::nop, ec);
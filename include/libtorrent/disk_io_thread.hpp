@@ -37,6 +37,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/allocator.hpp"
 #include "libtorrent/io_service.hpp"
 #include "libtorrent/sliding_average.hpp"
+#include "libtorrent/performance_counters.hpp"
 
 #include <boost/function/function0.hpp>
 #include <boost/function/function2.hpp>
@@ -294,6 +295,7 @@ namespace libtorrent
 		disk_io_thread(io_service& ios
 			, boost::function<void()> const& queue_callback
 			, file_pool& fp
+			, counters& cnt
 			, int block_size = 16 * 1024);
 		~disk_io_thread();
 
@@ -516,6 +518,10 @@ namespace libtorrent
 		// the session_impl object
 		file_pool& m_file_pool;
 
+		// the session's performance counters. The latency histograms
+		// of the disk jobs are recorded here
+		counters& m_counters;
+
 		// when completion notifications are queued, they're stuck
 		// in this list
 		std::list<std::pair<disk_io_job, int> > m_queued_completions;
@@ -62,6 +62,7 @@ namespace libtorrent
 {
 
 struct http_connection;
+struct resolver;
 class connection_queue;
 
 const int default_max_bottled_buffer_size = 2*1024*1024;
@@ -117,6 +118,26 @@ struct TORRENT_EXTRA_EXPORT http_connection
 
 	void close(bool force = false);
 
+	// when enabled, requests ask the server to keep the connection open.
+	// Once a complete response has been received, the connection is left
+	// open and idle, and can be used for another request to the same host
+	// by calling get() or start() again
+	void keep_alive(bool b) { m_keep_alive = b; }
+
+	// returns true if the last response was received completely and the
+	// server didn't ask to close the connection
+	bool can_reuse() const;
+
+	// replaces the handlers. This is used to hand an idle connection over
+	// to a new owner
+	void set_handlers(http_handler const& handler
+		, http_connect_handler const& ch = http_connect_handler()
+		, http_filter_handler const& fh = http_filter_handler());
+
+	// look up host names with the session's resolver, and share its cache,
+	// instead of the one owned by this connection
+	void set_resolver(resolver* r) { m_host_resolver = r; }
+
 	socket_type const& socket() const { return m_sock; }
 
 	std::list<tcp::endpoint> const& endpoints() const { return m_endpoints; }
@@ -129,6 +150,9 @@ private:
 #endif
 	void on_resolve(error_code const& e
 		, tcp::resolver::iterator i);
+	void on_host_resolve(error_code const& e
+		, std::vector<address> const& addresses);
+	void connect_endpoints();
 	void queue_connect();
 	void connect(int ticket, tcp::endpoint target_address);
 	void on_connect_timeout();
@@ -138,6 +162,7 @@ private:
 	static void on_timeout(boost::weak_ptr<http_connection> p
 		, error_code const& e);
 	void on_assign_bandwidth(error_code const& e);
+	void reconnect();
 
 	void callback(error_code e, char const* data = 0, int size = 0);
 
@@ -218,6 +243,18 @@ private:
 	int m_priority;
 
 	bool m_abort;
+
+	// true if requests should keep the connection open
+	bool m_keep_alive;
+
+	// true while the current request is sent on a connection that was
+	// used before, and no response has been received yet. If the server
+	// closed the idle connection, the request is sent again on a new one
+	bool m_reused;
+
+	// if set, host names are looked up by this resolver instead of
+	// m_resolver
+	resolver* m_host_resolver;
 };
 
 }
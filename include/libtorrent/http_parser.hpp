@@ -66,22 +66,44 @@ namespace libtorrent
 	{
 	public:
 		enum flags_t { dont_parse_chunks = 1 };
+
+		// the headers that are looked up in constant time. Any other
+		// header is found by scanning the headers of the response
+		enum known_header_t
+		{
+			connection_header,
+			content_encoding_header,
+			content_length_header,
+			content_range_header,
+			content_type_header,
+			location_header,
+			retry_after_header,
+			server_header,
+			transfer_encoding_header,
+			num_known_headers
+		};
+
 		http_parser(int flags = 0);
 		~http_parser();
-		std::string const& header(char const* key) const
-		{
-			static std::string empty;
-			std::multimap<std::string, std::string>::const_iterator i
-				= m_header.find(key);
-			if (i == m_header.end()) return empty;
-			return i->second;
-		}
 
-		std::string const& protocol() const { return m_protocol; }
+		// returns a copy of the value of the header ``key``, which is
+		// expected to be lower case. If the header isn't present, an
+		// empty string is returned
+		std::string header(char const* key) const;
+
+		// returns the value of a header without copying it. The range
+		// points into the parser's own header buffer and is followed by
+		// a null terminator. It stays valid until the parser is fed more
+		// data or is reset. If the header isn't present, an empty range
+		// is returned
+		buffer::const_interval header_value(char const* key) const;
+		buffer::const_interval header_value(known_header_t h) const;
+
+		std::string protocol() const { return span_string(m_protocol); }
 		int status_code() const { return m_status_code; }
-		std::string const& method() const { return m_method; }
-		std::string const& path() const { return m_path; }
-		std::string const& message() const { return m_server_message; }
+		std::string method() const { return span_string(m_method); }
+		std::string path() const { return span_string(m_path); }
+		std::string message() const { return span_string(m_server_message); }
 		buffer::const_interval get_body() const;
 		bool header_finished() const { return m_state == read_body; }
 		bool finished() const { return m_finished; }
@@ -126,16 +148,43 @@ namespace libtorrent
 
 		bool connection_close() const { return m_connection_close; }
 
-		std::multimap<std::string, std::string> const& headers() const { return m_header; }
+		// builds a map of all the headers, with lower case names. This
+		// copies every header, prefer header() or header_value()
+		std::multimap<std::string, std::string> headers() const;
 		std::vector<std::pair<size_type, size_type> > const& chunks() const { return m_chunked_ranges; }
 		
 	private:
+
+		// a range of m_header_buf
+		struct span
+		{
+			int start;
+			int len;
+		};
+
+		struct header_entry
+		{
+			span name;
+			span value;
+		};
+
+		std::string span_string(span s) const
+		{
+			if (s.len == 0) return std::string();
+			return std::string(&m_header_buf[s.start], s.len);
+		}
+
+		span store(char const* begin, char const* end, bool lower_case);
+		bool add_header(char const* line, char const* line_end);
+		int index_header(int i);
+		int find_header(char const* key) const;
+
 		size_type m_recv_pos;
 		int m_status_code;
-		std::string m_method;
-		std::string m_path;
-		std::string m_protocol;
-		std::string m_server_message;
+		span m_method;
+		span m_path;
+		span m_protocol;
+		span m_server_message;
 
 		size_type m_content_length;
 		size_type m_range_start;
@@ -143,7 +192,20 @@ namespace libtorrent
 
 		enum { read_status, read_header, read_body, error_state } m_state;
 
-		std::multimap<std::string, std::string> m_header;
+		// the status line and all header lines are copied into this
+		// buffer as they are parsed. Header names are lower cased and
+		// every name and value is null terminated. The buffer keeps its
+		// capacity across reset(), so a parser that's reused for one
+		// response after another doesn't allocate
+		std::vector<char> m_header_buf;
+
+		// the headers, in the order they were received
+		std::vector<header_entry> m_headers;
+
+		// the index into m_headers of the first occurrence of each
+		// known header, or -1 if it hasn't been received
+		int m_known_headers[num_known_headers];
+
 		buffer::const_interval m_recv_buffer;
 		int m_body_start_pos;
 
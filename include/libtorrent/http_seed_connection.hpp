@@ -86,7 +86,8 @@ namespace libtorrent
 			, boost::weak_ptr<torrent> t
 			, boost::shared_ptr<socket_type> s
 			, tcp::endpoint const& remote
-			, web_seed_entry& web);
+			, web_seed_entry& web
+			, policy::peer* peerinfo);
 
 		virtual int type() const { return peer_connection::http_seed_connection; }
 
@@ -101,6 +101,10 @@ namespace libtorrent
 
 		tracker_manager& m_man;
 		boost::shared_ptr<http_connection> m_tracker_connection;
+
+		// identifies the tracker host in the tracker_manager's pool of
+		// keep-alive connections. Empty if the connection isn't pooled
+		std::string m_pool_key;
 		aux::session_impl const& m_ses;
 		address m_tracker_ip;
 		proxy_settings const& m_ps;
@@ -33,8 +33,9 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef TORRENT_IP_FILTER_HPP
 #define TORRENT_IP_FILTER_HPP
 
-#include <set>
 #include <vector>
+#include <queue>
+#include <algorithm>
 
 #ifdef _MSC_VER
 #pragma warning(push, 1)
@@ -42,6 +43,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <boost/limits.hpp>
 #include <boost/utility.hpp>
+#include <boost/next_prior.hpp>
 #include <boost/tuple/tuple.hpp>
 
 #ifdef _MSC_VER
@@ -137,6 +139,13 @@ namespace detail
 	// this is the generic implementation of
 	// a filter for a specific address type.
 	// it works with IPv4 and IPv6
+	// 
+	// the ranges are kept in an array sorted by their start address, which
+	// access() does a binary search in. add_rule() doesn't insert into the
+	// array right away, since that would be O(n) per rule. The rules are
+	// collected in a list of pending rules that is merged into the array in
+	// batches. Until it's merged, access() checks the pending list too,
+	// most recent rule first.
 	template<class Addr>
 	class filter_impl
 	{
@@ -145,82 +154,137 @@ namespace detail
 		filter_impl()
 		{
 			// make the entire ip-range non-blocked
-			m_access_list.insert(range(zero<Addr>(), 0));
+			m_access_list.push_back(range(zero<Addr>(), 0));
 		}
 
 		void add_rule(Addr first, Addr last, int flags)
 		{
 			TORRENT_ASSERT(!m_access_list.empty());
 			TORRENT_ASSERT(first < last || first == last);
-			
-			typename range_t::iterator i = m_access_list.upper_bound(first);
-			typename range_t::iterator j = m_access_list.upper_bound(last);
 
-			if (i != m_access_list.begin()) --i;
-			
-			TORRENT_ASSERT(j != m_access_list.begin());
-			TORRENT_ASSERT(j != i);
-			
-			int first_access = i->access;
-			int last_access = boost::prior(j)->access;
+			m_pending.push_back(rule(first, last, flags));
 
-			if (i->start != first && first_access != flags)
-			{
-				i = m_access_list.insert(i, range(first, flags));
-			}
-			else if (i != m_access_list.begin() && boost::prior(i)->access == flags)
-			{
-				--i;
-				first_access = i->access;
-			}
-			TORRENT_ASSERT(!m_access_list.empty());
-			TORRENT_ASSERT(i != m_access_list.end());
+			// a merge is linear in the number of ranges. Merging when the
+			// pending list has grown to a fraction of the array keeps the
+			// cost of loading n rules at O(n log n), and the pending list
+			// short relative to the array
+			if (m_pending.size() >= (std::max)(std::size_t(16), m_access_list.size() / 4))
+				commit();
+		}
 
-			if (i != j) m_access_list.erase(boost::next(i), j);
-			if (i->start == first)
+		// merges the pending rules into the array
+		void commit()
+		{
+			if (m_pending.empty()) return;
+
+			// the new ranges can only start at the start of an existing
+			// range, or at the first or one past the last address of a rule.
+			// The existing ones are already sorted, only the rules' need to be
+			std::vector<Addr> rule_points;
+			rule_points.reserve(m_pending.size() * 2);
+			for (typename std::vector<rule>::const_iterator i = m_pending.begin()
+				, end(m_pending.end()); i != end; ++i)
 			{
-				// we can do this const-cast because we know that the new
-				// start address will keep the set correctly ordered
-				const_cast<Addr&>(i->start) = first;
-				const_cast<int&>(i->access) = flags;
+				rule_points.push_back(i->first);
+				if (i->last != max_addr<Addr>()) rule_points.push_back(plus_one(i->last));
 			}
-			else if (first_access != flags)
+			std::sort(rule_points.begin(), rule_points.end());
+
+			std::vector<Addr> points;
+			points.reserve(m_access_list.size() + rule_points.size());
+			typename std::vector<Addr>::const_iterator rp = rule_points.begin();
+			for (typename std::vector<range>::const_iterator i = m_access_list.begin()
+				, end(m_access_list.end()); i != end; ++i)
 			{
-				m_access_list.insert(i, range(first, flags));
+				for (; rp != rule_points.end() && *rp < i->start; ++rp)
+					points.push_back(*rp);
+				points.push_back(i->start);
 			}
-			
-			if ((j != m_access_list.end()
-					&& minus_one(j->start) != last)
-				|| (j == m_access_list.end()
-					&& last != max_addr<Addr>()))
+			points.insert(points.end(), rp, typename std::vector<Addr>::const_iterator(rule_points.end()));
+			points.erase(std::unique(points.begin(), points.end()), points.end());
+
+			// the rules, ordered by their first address
+			std::vector<int> order(m_pending.size());
+			for (int i = 0; i < int(order.size()); ++i) order[i] = i;
+			std::sort(order.begin(), order.end(), compare_first(m_pending));
+
+			// the rules covering the current point. The most recently added
+			// one is on top, and wins. Rules that have ended are only popped
+			// once they make it to the top
+			std::priority_queue<int> active;
+
+			std::vector<range> ret;
+			ret.reserve(points.size());
+			typename std::vector<range>::const_iterator base = m_access_list.begin();
+			std::vector<int>::const_iterator next_rule = order.begin();
+			for (typename std::vector<Addr>::const_iterator p = points.begin()
+				, end(points.end()); p != end; ++p)
 			{
-				TORRENT_ASSERT(j == m_access_list.end() || last < minus_one(j->start));
-				if (last_access != flags)
-					j = m_access_list.insert(j, range(plus_one(last), last_access));
+				while (boost::next(base) != m_access_list.end() && !(*p < boost::next(base)->start))
+					++base;
+				while (next_rule != order.end() && !(*p < m_pending[*next_rule].first))
+					active.push(*next_rule++);
+				while (!active.empty() && m_pending[active.top()].last < *p)
+					active.pop();
+
+				int const access = active.empty() ? base->access
+					: m_pending[active.top()].flags;
+				if (ret.empty() || ret.back().access != access)
+					ret.push_back(range(*p, access));
 			}
-
-			if (j != m_access_list.end() && j->access == flags) m_access_list.erase(j);
+			m_access_list.swap(ret);
+			m_pending.clear();
 			TORRENT_ASSERT(!m_access_list.empty());
 		}
 
 		int access(Addr const& addr) const
+		{
+			int hint = 0;
+			return access(addr, hint);
+		}
+
+		// hint is the index of the range the previous address was found in,
+		// and is updated to the one addr is found in. Looking up addresses
+		// in ascending order, passing the same hint, saves most of the
+		// binary search
+		int access(Addr const& addr, int& hint) const
 		{
 			TORRENT_ASSERT(!m_access_list.empty());
-			typename range_t::const_iterator i = m_access_list.upper_bound(addr);
-			if (i != m_access_list.begin()) --i;
-			TORRENT_ASSERT(i != m_access_list.end());
-			TORRENT_ASSERT(i->start <= addr && (boost::next(i) == m_access_list.end()
-				|| addr < boost::next(i)->start));
-			return i->access;
+			for (typename std::vector<rule>::const_reverse_iterator i = m_pending.rbegin()
+				, end(m_pending.rend()); i != end; ++i)
+			{
+				if (!(addr < i->first) && !(i->last < addr)) return i->flags;
+			}
+
+			int const size = int(m_access_list.size());
+			if (hint < 0 || hint >= size || addr < m_access_list[hint].start)
+				hint = 0;
+			if (hint + 1 < size && !(addr < m_access_list[hint + 1].start))
+			{
+				typename std::vector<range>::const_iterator i = std::upper_bound(
+					m_access_list.begin() + hint + 1, m_access_list.end(), addr
+					, compare_start());
+				hint = int(i - m_access_list.begin()) - 1;
+			}
+			TORRENT_ASSERT(m_access_list[hint].start <= addr && (hint + 1 == size
+				|| addr < m_access_list[hint + 1].start));
+			return m_access_list[hint].access;
 		}
 
 		template <class ExternalAddressType>
 		std::vector<ip_range<ExternalAddressType> > export_filter() const
 		{
+			if (!m_pending.empty())
+			{
+				filter_impl tmp(*this);
+				tmp.commit();
+				return tmp.template export_filter<ExternalAddressType>();
+			}
+
 			std::vector<ip_range<ExternalAddressType> > ret;
 			ret.reserve(m_access_list.size());
 
-			for (typename range_t::const_iterator i = m_access_list.begin()
+			for (typename std::vector<range>::const_iterator i = m_access_list.begin()
 				, end(m_access_list.end()); i != end;)
 			{
 				ip_range<ExternalAddressType> r;
@@ -243,19 +307,40 @@ namespace detail
 		struct range
 		{
 			range(Addr addr, int a = 0): start(addr), access(a) {}
-			bool operator<(range const& r) const
-			{ return start < r.start; }
-			bool operator<(Addr const& a) const
-			{ return start < a; }
 			Addr start;
 			// the end of the range is implicit
-			// and given by the next entry in the set
+			// and given by the next entry in the array
 			int access;
 		};
 
-		typedef std::set<range> range_t;
-		range_t m_access_list;
-	
+		struct rule
+		{
+			rule(Addr f, Addr l, int a): first(f), last(l), flags(a) {}
+			Addr first;
+			Addr last;
+			int flags;
+		};
+
+		struct compare_start
+		{
+			bool operator()(Addr const& a, range const& r) const
+			{ return a < r.start; }
+		};
+
+		struct compare_first
+		{
+			compare_first(std::vector<rule> const& r): m_rules(&r) {}
+			bool operator()(int lhs, int rhs) const
+			{ return (*m_rules)[lhs].first < (*m_rules)[rhs].first; }
+			std::vector<rule> const* m_rules;
+		};
+
+		// non-overlapping ranges, sorted by start address. The first one
+		// always starts at the zero address
+		std::vector<range> m_access_list;
+
+		// rules added since the last commit(), in the order they were added
+		std::vector<rule> m_pending;
 	};
 
 }
@@ -298,6 +383,17 @@ struct TORRENT_EXPORT ip_filter
 	// the current filter.
 	int access(address const& addr) const;
 
+	// Looks up the access permissions of every address in ``addrs`` and stores them in
+	// ``flags``, in the same order. When the addresses are sorted, each lookup picks up
+	// where the previous one left off, which is considerably cheaper than calling
+	// access() for each of them.
+	void access(std::vector<address> const& addrs, std::vector<int>& flags) const;
+
+	// Rules added with add_rule() are merged into the filter's lookup table in batches.
+	// Until they are, access() checks them one at a time. This merges them right away.
+	// session::set_ip_filter() does this to its copy of the filter.
+	void commit();
+
 #if TORRENT_USE_IPV6
 	typedef boost::tuple<std::vector<ip_range<address_v4> >
 		, std::vector<ip_range<address_v6> > > filter_tuple_t;
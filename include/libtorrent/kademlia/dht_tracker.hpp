@@ -41,6 +41,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <boost/bind.hpp>
 #include <boost/ref.hpp>
 #include <boost/intrusive_ptr.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/detail/atomic_count.hpp>
 
 #include "libtorrent/kademlia/node.hpp"
@@ -52,6 +53,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/socket.hpp"
 #include "libtorrent/thread.hpp"
 #include "libtorrent/deadline_timer.hpp"
+#include "libtorrent/lazy_entry.hpp"
 
 namespace libtorrent
 {
@@ -133,12 +135,24 @@ namespace libtorrent { namespace dht
 		// implements udp_socket_interface
 		virtual bool send_packet(libtorrent::entry& e, udp::endpoint const& addr
 			, int send_flags);
+		virtual bool send_packet(char const* buf, int size
+			, udp::endpoint const& addr, int send_flags);
 
 		node_impl m_dht;
+
+		// when running more than one node (dht_settings::num_instances)
+		// these are the additional ones. m_dht is always the one used for
+		// our own lookups
+		std::vector<boost::shared_ptr<node_impl> > m_extra_nodes;
+
 		rate_limited_udp_socket& m_sock;
 
 		std::vector<char> m_send_buf;
 
+		// incoming messages are decoded into this, so that once it has grown
+		// to fit a typical message, decoding doesn't allocate
+		lazy_bdecode_arena m_arena;
+
 		ptime m_last_new_key;
 		deadline_timer m_timer;
 		deadline_timer m_connection_timer;
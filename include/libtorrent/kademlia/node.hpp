@@ -36,6 +36,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <algorithm>
 #include <map>
 #include <set>
+#include <list>
+#include <vector>
 
 #include <libtorrent/config.hpp>
 #include <libtorrent/kademlia/routing_table.hpp>
@@ -52,6 +54,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <libtorrent/bloom_filter.hpp>
 
 #include <boost/cstdint.hpp>
+#include <boost/shared_ptr.hpp>
 #include <boost/ref.hpp>
 
 #include "libtorrent/socket.hpp"
@@ -59,6 +62,7 @@ POSSIBILITY OF SUCH DAMAGE.
 namespace libtorrent {
 	class alert_manager;
 	struct alert_dispatcher;
+	struct bencode_writer;
 }
 
 namespace libtorrent { namespace dht
@@ -113,7 +117,13 @@ struct peer_entry
 struct torrent_entry
 {
 	std::string name;
-	std::set<peer_entry> peers;
+	// sorted by endpoint. A flat vector is a lot more compact than a
+	// std::set, and the number of peers is bounded by
+	// dht_settings::max_peers
+	std::vector<peer_entry> peers;
+	// this torrent's position in the node's LRU list, used to evict
+	// the least recently announced torrent in constant time
+	std::list<sha1_hash>::iterator lru;
 };
 
 struct dht_immutable_item
@@ -131,6 +141,8 @@ struct dht_immutable_item
 	int num_announcers;
 	// size of malloced space pointed to by value
 	int size;
+	// this item's position in the node's LRU list
+	std::list<sha1_hash>::iterator lru;
 };
 
 struct ed25519_public_key { char bytes[item_pk_len]; };
@@ -171,22 +183,19 @@ public:
 	void reply(msg const&) { flags |= flag_done; }
 };
 
-struct count_peers
-{
-	int& count;
-	count_peers(int& c): count(c) {}
-	void operator()(std::pair<libtorrent::dht::node_id
-		, libtorrent::dht::torrent_entry> const& t)
-	{
-		count += t.second.peers.size();
-	}
-};
-
 struct udp_socket_interface
 {
 	virtual bool send_packet(entry& e, udp::endpoint const& addr, int flags) = 0;
+
+	// sends a message that's already bencoded. Unlike the entry overload,
+	// the message is sent as-is, so it must include the "v" field
+	virtual bool send_packet(char const* buf, int size
+		, udp::endpoint const& addr, int flags) = 0;
 };
 
+// the client version put in the "v" field of every message we send
+extern TORRENT_EXTRA_EXPORT char const dht_client_version[4];
+
 class TORRENT_EXTRA_EXPORT node_impl : boost::noncopyable
 {
 typedef std::map<node_id, torrent_entry> table_t;
@@ -210,12 +219,7 @@ public:
 	void incoming(msg const& m);
 
 	int num_torrents() const { return m_map.size(); }
-	int num_peers() const
-	{
-		int ret = 0;
-		std::for_each(m_map.begin(), m_map.end(), count_peers(ret));
-		return ret;
-	}
+	int num_peers() const { return m_num_peers; }
 
 	int bucket_size(int bucket);
 
@@ -279,8 +283,11 @@ public:
 
 protected:
 
-	void lookup_peers(sha1_hash const& info_hash, int prefix, entry& reply
-		, bool noseed, bool scrape) const;
+	torrent_entry const* lookup_torrent(sha1_hash const& info_hash
+		, int prefix) const;
+	void write_scrape(bencode_writer& w, torrent_entry const& v) const;
+	void write_peers(bencode_writer& w, torrent_entry const& v
+		, bool noseed) const;
 	bool lookup_torrents(sha1_hash const& target, entry& reply
 		, char* tags) const;
 
@@ -294,7 +301,9 @@ private:
 	// since it might have references to it
 	std::set<traversal_algorithm*> m_running_requests;
 
-	void incoming_request(msg const& h, entry& e);
+	bool incoming_request(msg const& h, entry& e);
+	void send_reply(msg const& m, char const* query, lazy_entry const* arg_ent);
+	void send_error(msg const& m, char const* err, bool ip, int error_code = 203);
 
 	node_id m_id;
 
@@ -305,9 +314,27 @@ public:
 private:
 	dht_observer* m_observer;
 
+	void erase_torrent(table_t::iterator i);
+	void erase_immutable_item(dht_immutable_table_t::iterator i);
+	void erase_mutable_item(dht_mutable_table_t::iterator i);
+
 	table_t m_map;
 	dht_immutable_table_t m_immutable_table;
 	dht_mutable_table_t m_mutable_table;
+
+	// the keys of m_map, m_immutable_table and m_mutable_table ordered
+	// by when they were last announced or put. The front of each list
+	// is the next entry to be evicted when the table is full
+	std::list<node_id> m_torrent_lru;
+	std::list<node_id> m_immutable_lru;
+	std::list<node_id> m_mutable_lru;
+
+	// the total number of peers stored across all torrents in m_map
+	int m_num_peers;
+
+	// the number of bytes malloced for the values and salts of the
+	// stored items
+	int m_item_bytes;
 	
 	ptime m_last_tracker_tick;
 
@@ -316,8 +343,35 @@ private:
 
 	alert_dispatcher* m_post_alert;
 	udp_socket_interface* m_sock;
+
+	// replies bencoded directly by send_reply() and send_error() are
+	// written here. It's reused across messages to avoid allocations
+	std::vector<char> m_send_buf;
+
+	// scratch space for the nodes returned by routing_table::find_node()
+	nodes_t m_nodes_buf;
 };
 
+// when running more than one node (dht_settings::num_instances), returns
+// the one responsible for the incoming message m. Replies go to the node
+// that sent the request, queries to the node whose ID is closest to the
+// target. primary is the node used for our own lookups
+node_impl& TORRENT_EXTRA_EXPORT node_for(msg const& m, node_impl& primary
+	, std::vector<boost::shared_ptr<node_impl> > const& extra);
+
+// stores the IDs of the extra nodes in the DHT state, under
+// "extra-node-ids"
+void TORRENT_EXTRA_EXPORT save_extra_node_ids(entry& state
+	, std::vector<boost::shared_ptr<node_impl> > const& extra);
+
+// returns the ID of the extra node idx saved in the DHT state, or
+// node_id::min() if there isn't one
+node_id TORRENT_EXTRA_EXPORT extract_extra_node_id(entry const* state, int idx);
+
+// s is expected to hold the status of the primary node. Adds the
+// counters of the extra nodes to it and fills in s.dht_instances
+void TORRENT_EXTRA_EXPORT add_extra_node_status(session_status& s
+	, std::vector<boost::shared_ptr<node_impl> > const& extra);
 
 } } // namespace libtorrent::dht
 
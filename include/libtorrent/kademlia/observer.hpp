@@ -62,10 +62,13 @@ TORRENT_EXTRA_EXPORT void intrusive_ptr_release(observer const*);
 // 39     1     1         <padding>
 // 40
 
+class rpc_manager;
+
 struct observer : boost::noncopyable
 {
 	friend TORRENT_EXTRA_EXPORT void intrusive_ptr_add_ref(observer const*);
 	friend TORRENT_EXTRA_EXPORT void intrusive_ptr_release(observer const*);
+	friend class rpc_manager;
 
 	observer(boost::intrusive_ptr<traversal_algorithm> const& a
 		, udp::endpoint const& ep, node_id const& id)
@@ -75,6 +78,8 @@ struct observer : boost::noncopyable
 		, m_id(id)
 		, m_port(0)
 		, m_transaction_id()
+		, m_next_transaction(0)
+		, m_prev_transaction(0)
 		, flags(0)
 	{
 		TORRENT_ASSERT(a);
@@ -162,6 +167,15 @@ protected:
 
 	// the transaction ID for this call
 	boost::uint16_t m_transaction_id;
+
+private:
+	// while the request is outstanding, the rpc_manager keeps its
+	// observers in a list, in the order they were sent. This is
+	// what lets it find the ones that time out without looking
+	// at all of them
+	observer* m_next_transaction;
+	observer* m_prev_transaction;
+
 public:
 	unsigned char flags;
 
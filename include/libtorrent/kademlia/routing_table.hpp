@@ -39,6 +39,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <boost/utility.hpp>
 #include <boost/tuple/tuple.hpp>
 #include <boost/array.hpp>
+#include <boost/unordered_set.hpp>
 #include <set>
 
 #include <libtorrent/kademlia/logging.hpp>
@@ -176,8 +177,30 @@ public:
 	void check_invariant() const;
 #endif
 
+	// a node and the first 64 bits of its XOR distance to a target.
+	// find_node() uses these to pick the closest nodes out of a bucket
+	struct candidate
+	{
+		boost::uint64_t distance;
+		node_entry const* node;
+	};
+
 private:
 
+	struct ipv4_hash
+	{
+		std::size_t operator()(address_v4::bytes_type const& ip) const
+		{
+			return (std::size_t(ip[0]) << 24) | (std::size_t(ip[1]) << 16)
+				| (std::size_t(ip[2]) << 8) | std::size_t(ip[3]);
+		}
+	};
+
+	typedef boost::unordered_multiset<address_v4::bytes_type, ipv4_hash> ip_set_t;
+
+	void add_closest_nodes(bucket_t const& b, node_id const& target
+		, std::vector<node_entry>& l, int options, int count);
+
 	table_t::iterator find_bucket(node_id const& id);
 
 	void split_bucket();
@@ -229,7 +252,11 @@ private:
 	// table. It's used to only allow a single entry
 	// per IP in the whole table. Currently only for
 	// IPv4
-	std::multiset<address_v4::bytes_type> m_ips;
+	ip_set_t m_ips;
+
+	// scratch space for find_node(), kept around to
+	// not allocate on every lookup
+	std::vector<candidate> m_candidates;
 };
 
 } } // namespace libtorrent::dht
@@ -34,11 +34,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #define RPC_MANAGER_HPP
 
 #include <vector>
-#include <deque>
-#include <map>
 #include <boost/cstdint.hpp>
 #include <boost/pool/pool.hpp>
 #include <boost/function/function3.hpp>
+#include <boost/unordered_map.hpp>
 
 #include <libtorrent/socket.hpp>
 #include <libtorrent/entry.hpp>
@@ -85,6 +84,10 @@ public:
 	bool incoming(msg const&, node_id* id, libtorrent::dht_settings const& settings);
 	time_duration tick();
 
+	// returns true if the reply or error m matches one of our outstanding
+	// requests. Used to route replies when running more than one node
+	bool is_outstanding(msg const& m) const;
+
 	bool invoke(entry& e, udp::endpoint target
 		, observer_ptr o);
 
@@ -102,14 +105,39 @@ public:
 
 	int num_allocated_observers() const { return m_allocated_observers; }
 
+	int num_transactions() const { return m_transactions.size(); }
+
 private:
 
+	struct address_hash
+	{
+		std::size_t operator()(address const& a) const;
+	};
+
+	typedef boost::unordered_multimap<address, observer_ptr, address_hash> transactions_t;
+
 	boost::uint32_t calc_connection_id(udp::endpoint addr);
 
+	// removes the observer from the transaction table and
+	// from the timeout list. Returns the reference the table held
+	observer_ptr remove_transaction(transactions_t::iterator i);
+
 	mutable boost::pool<> m_pool_allocator;
 
-	typedef std::deque<observer_ptr> transactions_t;
+	// the outstanding requests, keyed by the address they were sent to.
+	// A reply is matched against the transaction ID of the requests to
+	// its address, so transaction IDs only need to be unique per node
 	transactions_t m_transactions;
+
+	// all outstanding requests, in the order they were sent. Since all
+	// requests have the same timeout, the ones to time out are always
+	// at the front
+	observer* m_oldest_transaction;
+	observer* m_newest_transaction;
+
+	// the oldest request that hasn't been considered for a short
+	// timeout yet. Every request before it in the list already has
+	observer* m_next_short_timeout;
 	
 	udp_socket_interface* m_sock;
 	routing_table& m_table;
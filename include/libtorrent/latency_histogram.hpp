@@ -0,0 +1,115 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_LATENCY_HISTOGRAM_HPP_INCLUDED
+#define TORRENT_LATENCY_HISTOGRAM_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/thread.hpp"
+#include "libtorrent/time.hpp"
+
+#include <boost/cstdint.hpp>
+#include <boost/version.hpp>
+
+#if BOOST_VERSION >= 105300
+#include <boost/atomic.hpp>
+#endif
+
+// use lock-free atomics for the buckets where they're available. Otherwise
+// fall back to a mutex
+#if BOOST_VERSION >= 105300 && BOOST_ATOMIC_LLONG_LOCK_FREE == 2
+#define TORRENT_ATOMIC_HISTOGRAM 1
+#else
+#define TORRENT_ATOMIC_HISTOGRAM 0
+#endif
+
+namespace libtorrent
+{
+	// a fixed size, log-linear histogram of latency samples, in microseconds.
+	// Every power of two is split into 4 linear sub-buckets, which bounds the
+	// error of any reported value to 25% while keeping the histogram small
+	// enough to sample and copy frequently. Samples above the largest bucket
+	// (about 134 seconds) are clamped into it.
+	// 
+	// adding a sample is a single relaxed atomic increment, and may be done
+	// from any thread.
+	struct TORRENT_EXTRA_EXPORT latency_histogram
+	{
+		enum
+		{
+			sub_bucket_bits = 2,
+			sub_buckets = 1 << sub_bucket_bits,
+			max_exponent = 27,
+			num_buckets = (max_exponent - 1) * sub_buckets
+		};
+
+		latency_histogram();
+		latency_histogram(latency_histogram const&);
+		latency_histogram& operator=(latency_histogram const&);
+
+		void add_sample(boost::int64_t microseconds);
+		void add_sample(time_duration d) { add_sample(total_microseconds(d)); }
+
+		// copies the bucket counts into ``buckets``, which must have room
+		// for num_buckets values
+		void snapshot(boost::uint64_t* buckets) const;
+
+		void clear();
+
+		// returns the bucket a sample of ``microseconds`` falls into
+		static int bucket_for(boost::int64_t microseconds);
+
+		// returns the smallest sample (in microseconds) that falls into
+		// bucket ``b``
+		static boost::int64_t bucket_lower_bound(int b);
+
+		// returns the highest value (in microseconds) of the bucket the
+		// ``p``:th percentile (0-100) falls into, given bucket counts as
+		// returned by snapshot(). Returns 0 if there are no samples
+		static boost::int64_t percentile(boost::uint64_t const* buckets, double p);
+
+		// returns the total number of samples in ``buckets``
+		static boost::uint64_t num_samples(boost::uint64_t const* buckets);
+
+	private:
+
+#if TORRENT_ATOMIC_HISTOGRAM
+		boost::atomic<boost::uint64_t> m_buckets[num_buckets];
+#else
+		mutable mutex m_mutex;
+		boost::uint64_t m_buckets[num_buckets];
+#endif
+	};
+}
+
+#endif // TORRENT_LATENCY_HISTOGRAM_HPP_INCLUDED
+
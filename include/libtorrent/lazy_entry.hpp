@@ -79,10 +79,26 @@ namespace libtorrent
 	// in case the function fails. ``error_pos`` is an optional pointer to an int,
 	// which will be set to the byte offset into the buffer where an error occurred,
 	// in case the function fails.
+	//
+	// The buffer is first split into a flat array of tokens, then the
+	// ``lazy_entry`` tree is built in a single allocation owned by ``ret``.
+	// If decoding fails, ``ret`` is left empty.
 	TORRENT_EXPORT int lazy_bdecode(char const* start, char const* end
 		, lazy_entry& ret, error_code& ec, int* error_pos = 0
 		, int depth_limit = 1000, int item_limit = 1000000);
 
+	struct lazy_bdecode_arena;
+
+	// This overload decodes into memory held by ``arena`` instead of
+	// allocating it for ``ret``. Decoding into the same arena over and over
+	// reuses its memory, so once it has grown to fit the typical message no
+	// more allocations are made. The tree in ``ret`` refers into the arena. It
+	// is invalidated by the next decode into the same arena and by destroying
+	// the arena, and ``ret`` must not outlive the arena.
+	TORRENT_EXPORT int lazy_bdecode(char const* start, char const* end
+		, lazy_entry& ret, lazy_bdecode_arena& arena, error_code& ec
+		, int* error_pos = 0, int depth_limit = 1000, int item_limit = 1000000);
+
 #ifndef TORRENT_NO_DEPRECATE
 	// for backwards compatibility, does not report error code
 	// deprecated in 0.16
@@ -142,7 +158,8 @@ namespace libtorrent
 		};
 
 		// internal
-		lazy_entry() : m_begin(0), m_len(0), m_size(0), m_capacity(0), m_type(none_t)
+		lazy_entry() : m_begin(0), m_len(0), m_size(0), m_capacity(0)
+			, m_storage(heap_storage), m_indexed(false), m_type(none_t)
 		{ m_data.start = 0; }
 
 		// tells you which specific type this lazy entry has.
@@ -217,6 +234,14 @@ namespace libtorrent
 			m_begin = begin;
 		}
 
+		// internal: turns this entry into a dictionary whose ``size``
+		// entries are constructed in place at ``storage``. If ``indexed``
+		// is true, the caller also writes a hash index of the keys right
+		// after the entries, which dict_find() will use. The storage is not
+		// freed by clear() (see own_storage())
+		lazy_dict_entry* construct_dict(char const* begin, int len
+			, void* storage, int size, bool indexed);
+
 		// internal
 		lazy_entry* dict_append(char const* name);
 		// internal
@@ -272,6 +297,22 @@ namespace libtorrent
 			m_begin = begin;
 		}
 
+		// internal: the list counterpart of the construct_dict() overload
+		// taking storage
+		lazy_entry* construct_list(char const* begin, int len
+			, void* storage, int size);
+
+		// internal: makes this entry responsible for freeing the memory its
+		// children were constructed in (by construct_dict() or
+		// construct_list() above). The memory block must have been allocated
+		// with operator new and must start at this entry's children
+		void own_storage()
+		{
+			TORRENT_ASSERT(m_type == dict_t || m_type == list_t);
+			TORRENT_ASSERT(m_storage == external_storage);
+			m_storage = owned_storage;
+		}
+
 		// internal
 		lazy_entry* list_append();
 
@@ -325,6 +366,8 @@ namespace libtorrent
 			m_data.start = 0;
 			m_size = 0;
 			m_capacity = 0;
+			m_storage = heap_storage;
+			m_indexed = false;
 			m_type = none_t;
 		}
 
@@ -346,6 +389,12 @@ namespace libtorrent
 			tmp = e.m_capacity;
 			e.m_capacity = m_capacity;
 			m_capacity = tmp;
+			tmp = e.m_storage;
+			e.m_storage = m_storage;
+			m_storage = tmp;
+			tmp = e.m_indexed;
+			e.m_indexed = m_indexed;
+			m_indexed = tmp;
 			swap(m_data.start, e.m_data.start);
 			swap(m_size, e.m_size);
 			swap(m_begin, e.m_begin);
@@ -370,8 +419,24 @@ namespace libtorrent
 
 		// if list or dictionary, the number of items
 		boost::uint32_t m_size;
+		// where the children of a list or dictionary live
+		enum storage_t
+		{
+			// allocated with new[] by dict_append() or list_append()
+			heap_storage,
+			// constructed in memory that belongs to someone else, e.g. a
+			// lazy_bdecode_arena or the root of the tree
+			external_storage,
+			// like external_storage, but this entry frees the memory block
+			owned_storage
+		};
+
 		// if list or dictionary, allocated number of items
-		boost::uint32_t m_capacity:29;
+		boost::uint32_t m_capacity:26;
+		// one of storage_t
+		boost::uint32_t m_storage:2;
+		// true if this dictionary is followed by a hash index of its keys
+		boost::uint32_t m_indexed:1;
 		// element type (dict, list, int, string)
 		boost::uint32_t m_type:3;
 
@@ -386,6 +451,64 @@ namespace libtorrent
 		lazy_entry val;
 	};
 
+	// holds the token array and the ``lazy_entry`` tree built by the
+	// arena overload of lazy_bdecode(). The memory is kept between decodes.
+	struct TORRENT_EXPORT lazy_bdecode_arena
+	{
+		lazy_bdecode_arena();
+		~lazy_bdecode_arena();
+
+		// dictionaries with at least this many keys get a hash index,
+		// making dict_find() on them a lookup instead of a linear scan.
+		// 0 (the default) turns indexing off. Most dictionaries are small
+		// enough for the scan to be faster.
+		int index_threshold;
+
+		// internal: one decoded item (or dictionary key) in the order it
+		// appears in the buffer
+		struct token
+		{
+			// offset of the first byte of the item. For strings and
+			// integers, the first byte of the payload
+			boost::uint32_t offset;
+			// the length of the item (containers include their 'd' or 'l'
+			// and 'e'). For strings and integers, the payload length
+			boost::uint32_t length;
+			// the index of the token following this item and all its
+			// children, i.e. its next sibling
+			boost::uint32_t next_item;
+			// the number of children of a list, or key-value pairs of a
+			// dictionary
+			boost::uint32_t size:29;
+			// lazy_entry::entry_type_t
+			boost::uint32_t type:3;
+		};
+
+		// internal: a list or dictionary whose children are being built
+		struct frame
+		{
+			// the next child to fill in, either a dictionary entry or a
+			// list item
+			lazy_dict_entry* dict;
+			lazy_entry* list;
+			// the token of the next child (for dictionaries, its key)
+			int next_token;
+			// the number of children left to fill in
+			int remaining;
+		};
+
+		// internal
+		std::vector<token> tokens;
+		std::vector<frame> frames;
+		char* storage;
+		int storage_size;
+
+	private:
+		// non-copyable
+		lazy_bdecode_arena(lazy_bdecode_arena const&);
+		lazy_bdecode_arena const& operator=(lazy_bdecode_arena const&);
+	};
+
 	TORRENT_EXTRA_EXPORT std::string print_entry(lazy_entry const& e
 		, bool single_line = false, int indent = 0);
 
@@ -0,0 +1,127 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_NETWORK_THREAD_POOL_HPP_INCLUDED
+#define TORRENT_NETWORK_THREAD_POOL_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/thread.hpp"
+#include "libtorrent/io_service_fwd.hpp"
+#include "libtorrent/socket.hpp" // for asio::const_buffer
+
+#include <boost/intrusive_ptr.hpp>
+#include <boost/shared_ptr.hpp>
+#include <boost/noncopyable.hpp>
+#include <deque>
+#include <list>
+#include <vector>
+
+namespace libtorrent
+{
+	class peer_connection;
+
+	struct socket_job
+	{
+		enum job_type_t
+		{
+			// issue an async_write_some() of ``vec`` on the peer's socket
+			write_job,
+			// shut down and close the peer's socket
+			close_job
+		};
+
+		job_type_t type;
+
+		// a copy of the buffer list to send, for write jobs. The buffers
+		// themselves are owned by the peer's send buffer, which keeps them
+		// alive until the write completes
+		std::list<asio::const_buffer> vec;
+
+		boost::intrusive_ptr<peer_connection> peer;
+	};
+
+	// a set of threads that initiate socket operations on behalf of the
+	// network thread. Initiating an async write on a TCP socket performs the
+	// first (speculative) non-blocking send() on the calling thread, which is
+	// where most of the cost of sending is. Spreading it over several threads
+	// lets a seeding session use more than one core for peer I/O, while all
+	// completion handlers still run on the network thread.
+	// 
+	// every peer is owned by exactly one thread (by hashing its address),
+	// which means all jobs for a peer are executed in the order they were
+	// posted. This is what makes it safe to post a close_job right after a
+	// write_job. The network thread keeps reading from the socket, so the
+	// jobs hold the peer's socket mutex while they initiate the operation,
+	// the same way its reads do. It serves as a strand for the socket.
+	// 
+	// with zero threads (the default), jobs are executed immediately by the
+	// calling thread.
+	struct TORRENT_EXTRA_EXPORT network_thread_pool : boost::noncopyable
+	{
+		network_thread_pool(io_service& ios);
+		~network_thread_pool();
+
+		// changes the number of threads. All outstanding jobs are completed
+		// before the old threads are torn down. Must be called from the
+		// network thread.
+		void set_num_threads(int n);
+		int num_threads() const { return int(m_shards.size()); }
+
+		// queues the job on the thread owning the peer, or executes it
+		// immediately if there are no threads
+		void post_job(socket_job const& j);
+
+		// completes all outstanding jobs and stops the threads
+		void stop() { set_num_threads(0); }
+
+	private:
+
+		struct shard
+		{
+			shard(): abort(false) {}
+			mutex queue_mutex;
+			condition_variable cond;
+			std::deque<socket_job> jobs;
+			bool abort;
+			boost::shared_ptr<thread> worker;
+		};
+
+		void thread_fun(shard* s);
+		void process_job(socket_job& j, bool post);
+
+		io_service& m_ios;
+		std::vector<boost::shared_ptr<shard> > m_shards;
+	};
+}
+
+#endif // TORRENT_NETWORK_THREAD_POOL_HPP_INCLUDED
+
@@ -0,0 +1,147 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_PACKET_POOL_HPP_INCLUDED
+#define TORRENT_PACKET_POOL_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/time.hpp" // for ptime
+
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/noncopyable.hpp>
+
+namespace libtorrent
+{
+	// used for out-of-order incoming packets
+	// as well as sent packets that are waiting to be ACKed
+	struct packet
+	{
+		// the last time this packet was sent
+		ptime send_time;
+
+		// the number of bytes actually allocated in 'buf'
+		boost::uint16_t allocated;
+
+		// the size of the buffer 'buf' points to
+		boost::uint16_t size;
+
+		// this is the offset to the payload inside the buffer
+		// this is also used as a cursor to describe where the
+		// next payload that hasn't been consumed yet starts
+		boost::uint16_t header_size;
+		
+		// the number of times this packet has been sent
+		boost::uint8_t num_transmissions:6;
+
+		// true if we need to send this packet again. All
+		// outstanding packets are marked as needing to be
+		// resent on timeouts
+		bool need_resend:1;
+
+		// this is set to true for packets that were
+		// sent with the DF bit set (Don't Fragment)
+		bool mtu_probe:1;
+
+		// the packet_pool free list this packet goes back to
+		boost::uint8_t size_class;
+
+#ifdef TORRENT_DEBUG
+		int num_fast_resend;
+#endif
+
+		// the actual packet buffer
+		boost::uint8_t buf[];
+	};
+
+	// internal: keeps released packets around to be handed out again,
+	// instead of allocating and freeing a buffer for every datagram a uTP
+	// socket sends or receives out of order. There are two size classes,
+	// one for packets that are just a header and one for packets up to the
+	// ethernet MTU. Larger packets are allocated from the heap every time.
+	// The pool is shared by all uTP sockets and is only used from the
+	// network thread.
+	struct TORRENT_EXTRA_EXPORT packet_pool : boost::noncopyable
+	{
+		packet_pool();
+		~packet_pool();
+
+		// returns a packet whose buffer can hold at least ``size`` bytes.
+		// ``allocated`` is set to ``size``, even if the buffer is larger.
+		packet* acquire(int size);
+
+		// returns ``p`` to the pool. ``p`` may be NULL.
+		void release(packet* p);
+
+		// the number of packets handed out from one of the free lists,
+		// and the number of packets that had to be allocated
+		boost::uint64_t hits() const { return m_hits; }
+		boost::uint64_t misses() const { return m_misses; }
+
+		// the number of packets currently handed out, and the largest
+		// that number has ever been
+		int in_use() const { return m_in_use; }
+		int high_water() const { return m_high_water; }
+
+		// the number of packets in the free lists
+		int num_free() const { return m_small.size() + m_mtu.size(); }
+
+		enum
+		{
+			// size classes
+			small_class = 0,
+			mtu_class = 1,
+			heap_class = 2,
+
+			// the buffer size of the two pooled size classes
+			small_size = 128,
+			mtu_size = 1500,
+
+			// the max number of packets kept in each free list
+			max_small_free = 512,
+			max_mtu_free = 1024
+		};
+
+	private:
+
+		std::vector<packet*> m_small;
+		std::vector<packet*> m_mtu;
+
+		boost::uint64_t m_hits;
+		boost::uint64_t m_misses;
+		int m_in_use;
+		int m_high_water;
+	};
+}
+
+#endif
+
@@ -80,6 +80,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/error_code.hpp"
 #include "libtorrent/sliding_average.hpp"
 #include "libtorrent/io_service_fwd.hpp"
+#include "libtorrent/thread.hpp" // for mutex
 
 #ifdef TORRENT_STATS
 #include "libtorrent/aux_/session_impl.hpp"
@@ -359,6 +360,12 @@ namespace libtorrent
 		boost::shared_ptr<socket_type> get_socket() const { return m_socket; }
 		tcp::endpoint const& remote() const { return m_remote; }
 
+		// query the socket itself. Use these rather than calling the socket
+		// directly, since the network thread pool may be initiating an
+		// operation on it
+		tcp::endpoint socket_remote_endpoint(error_code& ec) const;
+		tcp::endpoint socket_local_endpoint(error_code& ec) const;
+
 		bitfield const& get_bitfield() const;
 		std::vector<int> const& allowed_fast();
 		std::vector<int> const& suggested_pieces() const { return m_suggested_pieces; }
@@ -560,6 +567,14 @@ namespace libtorrent
 			, void (*fun)(char*, int, void*) = 0, void* userdata = 0);
 		virtual void setup_send();
 
+		// issues the async write of ``vec`` (from the send buffer) on the
+		// socket. Called by the network_thread_pool thread owning this peer
+		void async_write_send_buffer(std::list<asio::const_buffer> const& vec);
+
+		// shuts down and closes the socket. Called by the network_thread_pool
+		// thread owning this peer
+		void shutdown_socket();
+
 		void cork_socket() { TORRENT_ASSERT(!m_corked); m_corked = true; }
 		void uncork_socket();
 
@@ -937,6 +952,28 @@ namespace libtorrent
 		handler_storage<TORRENT_READ_HANDLER_MAX_SIZE> m_read_handler_storage;
 		handler_storage<TORRENT_WRITE_HANDLER_MAX_SIZE> m_write_handler_storage;
 
+		// when the network thread pool is used, writes and closes are
+		// initiated on the socket by a pool thread, while the network thread
+		// reads from it. Every operation on the socket after it's connected
+		// holds this mutex, but only for sockets handed to the pool. See
+		// pool_managed_socket()
+		mutable mutex m_socket_mutex;
+
+		// locks m_socket_mutex if the socket is handed to the network thread
+		// pool. Used for socket operations on the network thread
+		struct socket_guard
+		{
+			socket_guard(peer_connection const& p);
+			~socket_guard();
+		private:
+			mutex* m_mutex;
+		};
+
+		// true if writes and closes for this peer's socket are issued by
+		// the network thread pool
+		bool pool_managed_socket() const;
+		void issue_write(std::list<asio::const_buffer> const& vec);
+
 #ifndef TORRENT_DISABLE_GEO_IP
 		std::string m_inet_as_name;
 #endif
@@ -0,0 +1,345 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_PERFORMANCE_COUNTERS_HPP_INCLUDED
+#define TORRENT_PERFORMANCE_COUNTERS_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/assert.hpp"
+#include "libtorrent/thread.hpp"
+#include "libtorrent/latency_histogram.hpp"
+
+#include <boost/cstdint.hpp>
+#include <boost/version.hpp>
+
+#if BOOST_VERSION >= 105300
+#include <boost/atomic.hpp>
+#endif
+
+// use lock-free atomics for the counters where they're available. Otherwise
+// fall back to a mutex
+#if BOOST_VERSION >= 105300 && BOOST_ATOMIC_LLONG_LOCK_FREE == 2
+#define TORRENT_ATOMIC_COUNTERS 1
+#else
+#define TORRENT_ATOMIC_COUNTERS 0
+#endif
+
+namespace libtorrent
+{
+	// the session-wide registry of performance counters and gauges. Every
+	// metric has a stable integer ID (from stats_counter_t or stats_gauge_t)
+	// which is used to update it and to look it up in a session_stats_alert.
+	// The name of each metric is available via session_stats_metrics().
+	// 
+	// Counters are monotonically increasing and are updated as the events
+	// happen. Gauges are the current value of some quantity, they are
+	// updated by the session right before the counters are sampled.
+	// Histograms record the distribution of latencies of some operation
+	// (see stats_histogram_t).
+	// 
+	// updating a counter is cheap and thread safe.
+	struct TORRENT_EXTRA_EXPORT counters
+	{
+		enum stats_counter_t
+		{
+			// the reason peers were disconnected
+			disconnected_peers,
+			error_peers,
+			eof_peers,
+			connreset_peers,
+			connrefused_peers,
+			connaborted_peers,
+			perm_peers,
+			buffer_peers,
+			unreachable_peers,
+			broken_pipe_peers,
+			addrinuse_peers,
+			no_access_peers,
+			invalid_arg_peers,
+			aborted_peers,
+			uninteresting_peers,
+			timeout_peers,
+			transport_timeout_peers,
+			no_memory_peers,
+			too_many_peers,
+			connect_timeouts,
+
+			// the kind of peers that were disconnected because
+			// of an error
+			error_incoming_peers,
+			error_outgoing_peers,
+			error_rc4_peers,
+			error_encrypted_peers,
+			error_tcp_peers,
+			error_utp_peers,
+
+			connection_attempts,
+			num_banned_peers,
+			banned_for_hash_failure,
+
+			// incoming requests and how they were handled
+			piece_requests,
+			max_piece_requests,
+			invalid_piece_requests,
+			choked_piece_requests,
+			cancelled_piece_requests,
+			piece_rejects,
+
+			// the reason the piece picker was invoked, and how
+			// it picked blocks
+			end_game_piece_picker_blocks,
+			piece_picker_blocks,
+			reject_piece_picks,
+			unchoke_piece_picks,
+			incoming_redundant_piece_picks,
+			incoming_piece_picks,
+			end_game_piece_picks,
+			snubbed_piece_picks,
+
+			// the number of times each handler in the network
+			// thread was invoked
+			on_read_counter,
+			on_write_counter,
+			on_tick_counter,
+			on_lsd_counter,
+			on_lsd_peer_counter,
+			on_udp_counter,
+			on_accept_counter,
+			on_disk_queue_counter,
+			on_disk_read_counter,
+			on_disk_write_counter,
+
+			// histogram of the number of bytes transferred per socket
+			// operation. socket_send_size3 counts operations of up to
+			// 8 bytes, socket_send_size4 up to 16 bytes and so on. The
+			// last bucket counts everything larger
+			socket_send_size3,
+			socket_send_size4,
+			socket_send_size5,
+			socket_send_size6,
+			socket_send_size7,
+			socket_send_size8,
+			socket_send_size9,
+			socket_send_size10,
+			socket_send_size11,
+			socket_send_size12,
+			socket_send_size13,
+			socket_send_size14,
+			socket_send_size15,
+			socket_send_size16,
+			socket_send_size17,
+			socket_send_size18,
+			socket_send_size19,
+			socket_send_size20,
+			socket_recv_size3,
+			socket_recv_size4,
+			socket_recv_size5,
+			socket_recv_size6,
+			socket_recv_size7,
+			socket_recv_size8,
+			socket_recv_size9,
+			socket_recv_size10,
+			socket_recv_size11,
+			socket_recv_size12,
+			socket_recv_size13,
+			socket_recv_size14,
+			socket_recv_size15,
+			socket_recv_size16,
+			socket_recv_size17,
+			socket_recv_size18,
+			socket_recv_size19,
+			socket_recv_size20,
+
+			// the session's transfer totals. These are copied from the
+			// session's statistics when sampled
+			sent_bytes,
+			sent_payload_bytes,
+			recv_bytes,
+			recv_payload_bytes,
+			recv_failed_bytes,
+			recv_redundant_bytes,
+
+			// disk cache counters, copied from cache_status when sampled
+			disk_blocks_written,
+			disk_blocks_read,
+			disk_blocks_read_hit,
+			disk_writes,
+			disk_reads,
+
+			// uTP counters, copied from the utp_socket_manager when sampled
+			utp_packet_loss,
+			utp_timeout,
+			utp_packets_in,
+			utp_packets_out,
+			utp_fast_retransmit,
+			utp_packet_resend,
+			utp_samples_above_target,
+			utp_samples_below_target,
+			utp_payload_pkts_in,
+			utp_payload_pkts_out,
+			utp_invalid_pkts_in,
+			utp_redundant_pkts_in,
+			utp_paced_packets,
+			utp_packet_pool_hits,
+			utp_packet_pool_misses,
+
+			num_stats_counters
+		};
+
+		enum stats_gauge_t
+		{
+			num_checking_torrents = num_stats_counters,
+			num_stopped_torrents,
+			num_upload_only_torrents,
+			num_downloading_torrents,
+			num_seeding_torrents,
+			num_queued_seeding_torrents,
+			num_queued_download_torrents,
+			num_error_torrents,
+
+			num_peers_connected,
+			num_peers_half_open,
+
+			num_unchoke_slots,
+			num_upload_rate_queue,
+			num_download_rate_queue,
+
+			disk_cache_size,
+			disk_read_cache_size,
+			disk_used_buffers,
+			disk_queued_bytes,
+			disk_job_queue_length,
+
+			utp_num_idle,
+			utp_num_syn_sent,
+			utp_num_connected,
+			utp_num_fin_sent,
+			utp_num_close_wait,
+			utp_packets_in_use,
+			utp_packets_high_water,
+
+			num_counters,
+			num_gauges_counters = num_counters - num_stats_counters
+		};
+
+		enum stats_histogram_t
+		{
+			// the time disk jobs spend in the disk job queue, by job type.
+			// "check" is check_fastresume and check_files, "other" is
+			// every job type not listed
+			disk_queue_time_read,
+			disk_queue_time_write,
+			disk_queue_time_hash,
+			disk_queue_time_check,
+			disk_queue_time_other,
+
+			// the time it takes to execute disk jobs, by job type
+			disk_job_time_read,
+			disk_job_time_write,
+			disk_job_time_hash,
+			disk_job_time_check,
+			disk_job_time_other,
+
+			// the time individual read, write and hash operations take in
+			// the disk thread (not including cache hits)
+			disk_read_time,
+			disk_write_time,
+			disk_hash_time,
+
+			// the time spent in the socket read handler, i.e. handling the
+			// received data and issuing the next read. This is not the time
+			// the handler waited to be called after the read completed
+			socket_read_handler_duration,
+
+			// the time spent handling the bittorrent handshake messages
+			handshake_time,
+
+			// the time spent picking pieces to request from a peer
+			pick_pieces_time,
+
+			// the time spent in each phase of the session's once-per-second
+			// tick, as well as the total time of the tick
+			tick_utp_time,
+			tick_auto_manage_time,
+			tick_torrents_time,
+			tick_connect_peers_time,
+			tick_unchoke_time,
+			tick_disconnect_time,
+			tick_total_time,
+
+			num_histograms
+		};
+
+		counters();
+
+		counters(counters const&);
+		counters& operator=(counters const&);
+
+		// returns the new value
+		boost::int64_t inc_stats_counter(int c, boost::int64_t value = 1);
+
+		boost::int64_t operator[](int i) const;
+
+		void set_value(int c, boost::int64_t value);
+
+		void add_latency_sample(int h, time_duration d)
+		{
+			TORRENT_ASSERT(h >= 0);
+			TORRENT_ASSERT(h < num_histograms);
+			m_histograms[h].add_sample(d);
+		}
+
+		latency_histogram const& histogram(int h) const
+		{
+			TORRENT_ASSERT(h >= 0);
+			TORRENT_ASSERT(h < num_histograms);
+			return m_histograms[h];
+		}
+
+	private:
+
+		// the histograms are thread safe on their own
+		latency_histogram m_histograms[num_histograms];
+
+#if TORRENT_ATOMIC_COUNTERS
+		boost::atomic<boost::int64_t> m_stats_counter[num_counters];
+#else
+		// if the atomic type isn't lock-free, use a single lock instead, for
+		// the whole array
+		mutable mutex m_mutex;
+		boost::int64_t m_stats_counter[num_counters];
+#endif
+	};
+}
+
+#endif // TORRENT_PERFORMANCE_COUNTERS_HPP_INCLUDED
+
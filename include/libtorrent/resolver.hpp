@@ -0,0 +1,154 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#ifndef TORRENT_RESOLVER_HPP_INCLUDED
+#define TORRENT_RESOLVER_HPP_INCLUDED
+
+#include <string>
+#include <vector>
+#include <map>
+
+#ifdef _MSC_VER
+#pragma warning(push, 1)
+#endif
+
+#include <boost/function/function2.hpp>
+#include <boost/noncopyable.hpp>
+
+#ifdef _MSC_VER
+#pragma warning(pop)
+#endif
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/socket.hpp"
+#include "libtorrent/io_service.hpp"
+#include "libtorrent/address.hpp"
+#include "libtorrent/error_code.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/size_type.hpp"
+
+namespace libtorrent
+{
+	struct session_status;
+
+	// resolves host names for the whole session. The addresses a name
+	// resolves to are cached for a while, and so are failed lookups.
+	// Lookups of a name that's already being looked up don't start a new
+	// query, they wait for the outstanding one.
+	struct TORRENT_EXTRA_EXPORT resolver : boost::noncopyable
+	{
+		typedef boost::function<void(error_code const&
+			, std::vector<address> const&)> callback_t;
+
+		resolver(io_service& ios);
+		virtual ~resolver() {}
+
+		// looks up the addresses of ``host`` and calls ``h`` with them. If
+		// the lookup fails, the error is passed and the address list is
+		// empty. ``h`` is never called from within this function, even
+		// when the result is cached or ``host`` is an IP address.
+		void async_resolve(std::string const& host, callback_t const& h);
+
+		// cancels outstanding lookups, their callbacks are called with
+		// asio::error::operation_aborted. The cache is cleared. The session
+		// calls this when it's aborted. Lookups started afterwards work as
+		// usual
+		void abort();
+
+		// the number of seconds to cache the addresses of a name, and the
+		// number of seconds to remember that looking it up failed. 0 means
+		// no caching
+		void set_cache_timeout(int seconds) { m_timeout = seconds; }
+		void set_negative_cache_timeout(int seconds) { m_negative_timeout = seconds; }
+
+		// the most names to keep in the cache
+		enum { max_cache_size = 1000 };
+
+		void get_status(session_status& s) const;
+
+		int cache_size() const { return int(m_cache.size()); }
+		size_type lookups() const { return m_lookups; }
+		size_type cache_hits() const { return m_cache_hits; }
+		size_type shared_lookups() const { return m_shared_lookups; }
+
+	protected:
+
+		// starts looking up ``host``. When done, on_lookup() must be called
+		// with the result. The default implementation uses the system
+		// resolver, tests override it to not depend on DNS
+		virtual void start_lookup(std::string const& host);
+		virtual void cancel_lookups();
+
+		// called with the result of a lookup started by start_lookup()
+		void on_lookup(std::string const& host, error_code const& ec
+			, std::vector<address> const& addresses);
+
+	private:
+
+		void on_system_lookup(error_code const& ec
+			, tcp::resolver::iterator i, std::string host);
+
+		struct cache_entry
+		{
+			std::vector<address> addresses;
+			error_code error;
+			ptime expires;
+		};
+
+		void add_to_cache(std::string const& host, error_code const& ec
+			, std::vector<address> const& addresses);
+
+		typedef std::map<std::string, cache_entry> cache_t;
+		cache_t m_cache;
+
+		// the callbacks waiting for an outstanding lookup, by name
+		typedef std::map<std::string, std::vector<callback_t> > pending_t;
+		pending_t m_pending;
+
+		io_service& m_ios;
+		tcp::resolver m_resolver;
+
+		// cache timeouts, in seconds
+		int m_timeout;
+		int m_negative_timeout;
+
+		// the number of queries sent to the system resolver, the number of
+		// names found in the cache and the number of lookups that waited
+		// for an outstanding query of the same name
+		size_type m_lookups;
+		size_type m_cache_hits;
+		size_type m_shared_lookups;
+	};
+}
+
+#endif // TORRENT_RESOLVER_HPP_INCLUDED
@@ -258,7 +258,11 @@ namespace libtorrent
 		// The ``flags`` arguments passed in to ``save_state`` can be used to
 		// filter which parts of the session state to save. By default, all state
 		// is saved (except for the individual torrents). see save_state_flags_t
+		//
+		// The overload taking a buffer appends the state to it, bencoded,
+		// without building an entry first.
 		void save_state(entry& e, boost::uint32_t flags = 0xffffffff) const;
+		void save_state(std::vector<char>& buf, boost::uint32_t flags = 0xffffffff) const;
 		void load_state(lazy_entry const& e);
 
 		// .. note::
@@ -300,6 +304,29 @@ namespace libtorrent
 		// included. This flag is on by default. See add_torrent_params.
 		void post_torrent_updates();
 
+		// This is a more compact alternative to post_torrent_updates(). It
+		// posts a state_delta_alert, containing a torrent_status_delta for
+		// every torrent whose state changed since the last time this function
+		// was called. Each delta only carries the groups of fields that
+		// actually changed since the last delta for the same torrent.
+		// 
+		// The first delta for a torrent always includes all fields. A client
+		// would typically populate its torrent_status objects with
+		// refresh_torrent_status() once, and then keep them up to date by
+		// applying the deltas.
+		// 
+		// Both functions draw from the same set of updated torrents, so mixing
+		// calls to post_torrent_updates() and this function will not report
+		// every change to both.
+		void post_torrent_delta_updates();
+
+		// This function will post a session_stats_alert object, containing a
+		// snapshot of the performance counters and gauges of the session. The
+		// counters are always maintained, so this is cheap enough to be called
+		// periodically, for instance once per second. To interpret the values,
+		// see session_stats_metrics().
+		void post_session_stats();
+
 		// internal
 		io_service& get_io_service();
 
@@ -342,6 +369,19 @@ namespace libtorrent
 #endif
 		torrent_handle add_torrent(add_torrent_params const& params, error_code& ec);
 		void async_add_torrent(add_torrent_params const& params);
+
+		// ``async_add_torrents()`` adds a large number of torrents at once,
+		// typically when restoring a session at startup. Loading the .torrent
+		// files and parsing metadata and resume data is done by a pool of
+		// threads (see session_settings::add_torrent_threads). The torrents are
+		// then inserted into the session in batches, in the order they appear
+		// in ``params``, and one add_torrent_alert is posted for each of them,
+		// just like async_add_torrent().
+		// 
+		// In addition to the magnet links async_add_torrent() accepts, the
+		// ``url`` field may be a ``file://`` URL of a .torrent file on the local
+		// filesystem. It is loaded by one of the parser threads.
+		void async_add_torrents(std::vector<add_torrent_params> const& params);
 		
 #ifndef BOOST_NO_EXCEPTIONS
 #ifndef TORRENT_NO_DEPRECATE
@@ -176,6 +176,31 @@ namespace libtorrent
 		// 1 megabyte.
 		int tracker_maximum_response_length;
 
+		// the maximum number of idle HTTP tracker connections to keep open.
+		// When a tracker supports HTTP/1.1 keep-alive, its connection is
+		// kept after a request completes, and used for the next announce or
+		// scrape to the same tracker instead of connecting again. When the
+		// limit is reached, the connection idle for the longest time is
+		// closed. Setting this to 0 disables keep-alive for trackers. SSL
+		// torrents and i2p trackers always use a new connection. Default is
+		// 20.
+		int tracker_keepalive_connections;
+
+		// the number of seconds an idle HTTP tracker connection is kept open.
+		// Default is 30 seconds.
+		int tracker_keepalive_timeout;
+
+		// the number of seconds the addresses a host name resolves to are
+		// cached by the session. The cache is shared by trackers, web seeds,
+		// peers added by host name and DHT routers. Setting this to 0
+		// disables caching, but concurrent lookups of the same name are
+		// still shared. Default is 1200 seconds.
+		int resolver_cache_timeout;
+
+		// the number of seconds a host name that failed to resolve is
+		// remembered, before it's looked up again. Default is 60 seconds.
+		int resolver_negative_cache_timeout;
+
 		// controls the number of seconds from a request is sent until it times
 		// out if no piece response is returned.
 		int piece_timeout;
@@ -222,12 +247,24 @@ namespace libtorrent
 		// controls the pipelining with the web server. When using persistent
 		// connections to HTTP 1.1 servers, the client is allowed to send more
 		// requests before the first response is received. This number controls
-		// the number of outstanding requests to use with url-seeds. Default is
-		// 5.
+		// the number of outstanding requests to use with url-seeds and http
+		// seeds. Requests for adjacent ranges of the same file that are
+		// waiting for room in the pipeline are merged into one. If the server
+		// doesn't support keep-alive, only one request is outstanding at a
+		// time. Default is 5.
 		int urlseed_pipeline_size;
 
 		// time to wait until a new retry takes place
 		int urlseed_wait_retry;
+
+		// the maximum number of connections to open to a single url-seed or
+		// http seed. Each connection downloads different pieces. The first
+		// connection is opened right away, and more are added, one at a
+		// time, as long as each one increases the download rate from the
+		// server. When the server responds with 429 (too many requests) or
+		// 503 (service unavailable), the number of connections is halved.
+		// Default is 4.
+		int urlseed_max_connections;
 		
 		// sets the upper limit on the total number of files this session will
 		// keep open. The reason why files are left open at all is that some anti
@@ -1210,6 +1247,12 @@ namespace libtorrent
 		// unless you know what you're doing. Never set it higher than 100.
 		int utp_loss_multiplier;
 
+		// when enabled, uTP sockets pace their packets out evenly over the
+		// round-trip time, at a rate slightly above ``cwnd / rtt``, instead
+		// of sending a full congestion window in a burst whenever it opens
+		// up. This avoids self-inflicted loss on links with small buffers.
+		bool utp_pacing;
+
 		// the options for session_settings::mixed_mode_algorithm.
 		enum bandwidth_mixed_algo_t
 		{
@@ -1383,6 +1426,22 @@ namespace libtorrent
 		// side effect that the disk cache is less likely and slower at returning
 		// memory to the kernel when cache pressure is low.
 		bool use_disk_cache_pool;
+
+		// the number of threads to use to issue writes on peer sockets. By
+		// default (0), all socket operations are performed by the network
+		// thread. When seeding at high rates, the cost of sending becomes the
+		// bottleneck of the network thread. Setting this to 2 or more spreads
+		// the cost of initiating sends over that many threads. Every peer is
+		// owned by one of them. Only plain TCP connections are affected, and
+		// all completion handlers still run on the network thread.
+		int network_threads;
+
+		// the number of threads used by session::async_add_torrents() to load
+		// and parse .torrent files and resume data before the torrents are
+		// inserted into the session. Setting this to 0 makes the network
+		// thread do all the parsing itself. Torrents are still added in
+		// batches.
+		int add_torrent_threads;
 	};
 
 	// structure used to hold configuration options for the DHT
@@ -1402,8 +1461,10 @@ namespace libtorrent
 #endif
 			, max_fail_count(20)
 			, max_torrents(2000)
+			, max_peers(500)
 			, max_dht_items(700)
 			, max_torrent_search_reply(20)
+			, num_instances(1)
 			, restrict_routing_ips(true)
 			, restrict_search_ips(true)
 			, extended_routing_table(true)
@@ -1439,6 +1500,10 @@ namespace libtorrent
 		// an unbounded amount of memory.
 		int max_torrents;
 
+		// the max number of peers to store per torrent. When a torrent is
+		// full, the peer that announced the longest time ago is replaced.
+		int max_peers;
+
 		// max number of items the DHT will store
 		int max_dht_items;
 
@@ -1446,6 +1511,16 @@ namespace libtorrent
 		// DHT
 		int max_torrent_search_reply;
 
+		// the number of DHT nodes to run in this session, each with its own
+		// node ID, routing table and storage. They all share the DHT socket.
+		// The first node is the one used for the session's own lookups and
+		// announces. Incoming queries are answered by the node whose ID is
+		// closest to the target, and replies are handed to the node that sent
+		// the request. Running more than one node only makes sense for
+		// infrastructure nodes (e.g. DHT bootstrap nodes). This only takes
+		// effect when the DHT is started.
+		int num_instances;
+
 		// determines if the routing table entries should restrict entries to one
 		// per IP. This defaults to true, which helps mitigate some attacks on
 		// the DHT. It prevents adding multiple nodes with IPs with a very close
@@ -97,6 +97,23 @@ namespace libtorrent
 		int last_active;
 	};
 
+	// holds counters for one of the DHT nodes, when running more than one.
+	// See dht_settings::num_instances
+	struct TORRENT_EXPORT dht_instance_status
+	{
+		// the number of nodes in this node's routing table and replacement
+		// cache
+		int nodes;
+		int node_cache;
+
+		// the number of torrents, peers and items this node stores, and an
+		// estimate of the memory used by them
+		int torrents;
+		int peers;
+		int items;
+		size_type storage_bytes;
+	};
+
 	// holds counters and gauges for the uTP sockets
 	struct TORRENT_EXPORT utp_status
 	{
@@ -108,6 +125,12 @@ namespace libtorrent
 		int num_fin_sent;
 		int num_close_wait;
 
+		// the number of packet buffers currently held by uTP sockets
+		// (sent packets waiting to be acked and packets received out of
+		// order) and the highest that number has been
+		int packets_in_use;
+		int packets_high_water;
+
 		// counters. These are monotonically increasing
 		// and cumulative counters for their respective event.
 		boost::uint64_t packet_loss;
@@ -122,6 +145,15 @@ namespace libtorrent
 		boost::uint64_t payload_pkts_out;
 		boost::uint64_t invalid_pkts_in;
 		boost::uint64_t redundant_pkts_in;
+
+		// the number of times a socket had to wait before sending a packet,
+		// to not exceed its pacing rate
+		boost::uint64_t paced_packets;
+
+		// the number of packet buffers that were recycled, and the number
+		// that had to be allocated because there were none to recycle
+		boost::uint64_t packet_pool_hits;
+		boost::uint64_t packet_pool_misses;
 	};
 
 	// contains session wide state and counters
@@ -174,6 +206,24 @@ namespace libtorrent
 		size_type total_tracker_download;
 		size_type total_tracker_upload;
 
+		// the number of idle keep-alive connections to HTTP trackers, and
+		// the number of HTTP tracker requests that opened a new connection
+		// and that reused an idle one. The two counters are only updated
+		// when ``tracker_keepalive_connections`` is not 0.
+		int num_idle_tracker_connections;
+		size_type total_tracker_connections;
+		size_type total_tracker_connection_reuses;
+
+		// the number of host names in the session's DNS cache, the number
+		// of lookups sent to the system resolver, the number of lookups
+		// answered from the cache and the number of lookups that waited
+		// for an outstanding lookup of the same name instead of sending a
+		// new one. Trackers, web seeds and DHT routers share the cache.
+		int dns_cache_size;
+		size_type total_dns_lookups;
+		size_type total_dns_cache_hits;
+		size_type total_dns_shared_lookups;
+
 		// the number of bytes that has been received more than once.
 		// This can happen if a request from a peer times out and is requested from a different
 		// peer, and then received again from the first one. To make this lower, increase the
@@ -233,6 +283,15 @@ namespace libtorrent
 		// the number of torrents tracked by the DHT at the moment.
 		int dht_torrents;
 
+		// the number of peers stored for the torrents tracked by the DHT,
+		// and the number of immutable and mutable items stored.
+		int dht_peers;
+		int dht_items;
+
+		// an estimate of the number of bytes of memory used to store the
+		// DHT torrents, peers and items.
+		size_type dht_storage_bytes;
+
 		// an estimation of the total number of nodes in the DHT
 		// network.
 		size_type dht_global_nodes;
@@ -249,6 +308,11 @@ namespace libtorrent
 		// by the DHT.
 		int dht_total_allocations;
 
+		// when running more than one DHT node, the counters for each of them.
+		// The dht_* fields above are the totals across all of them. Empty
+		// when running a single node.
+		std::vector<dht_instance_status> dht_instances;
+
 		// statistics on the uTP sockets.
 		utp_status utp_stats;
 
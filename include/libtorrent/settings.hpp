@@ -40,6 +40,7 @@ namespace libtorrent
 {
 	struct lazy_entry;
 	class entry;
+	struct bencode_writer;
 
 	// internal
 	enum struct_field_type_t
@@ -60,6 +61,9 @@ namespace libtorrent
 
 	void load_struct(lazy_entry const& e, void* s, bencode_map_entry const* m, int num);
 	void save_struct(entry& e, void const* s, bencode_map_entry const* m, int num, void const* def = 0);
+	// writes the struct as a bencoded dictionary, with its keys in sorted
+	// order
+	void save_struct(bencode_writer& w, void const* s, bencode_map_entry const* m, int num, void const* def = 0);
 }
 
 #endif
@@ -0,0 +1,159 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_STATUS_DELTA_HPP_INCLUDED
+#define TORRENT_STATUS_DELTA_HPP_INCLUDED
+
+#include <vector>
+#include <boost/cstdint.hpp>
+#include <boost/intrusive_ptr.hpp>
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/torrent_handle.hpp"
+
+namespace libtorrent
+{
+	class torrent_info;
+
+	// A torrent_status_delta is a compact representation of the fields of a
+	// torrent_status that changed since the last time a delta was generated
+	// for the same torrent. The fields are organized in groups, and only the
+	// groups that changed are included, in a packed binary form. Deltas are
+	// posted in the state_delta_alert, see session::post_torrent_delta_updates().
+	// 
+	// The receiving end is expected to keep a full torrent_status for every
+	// torrent (for instance populated by session::refresh_torrent_status())
+	// and call apply() on it for every delta that refers to its ``handle``.
+	struct TORRENT_EXPORT torrent_status_delta
+	{
+		torrent_status_delta(): fields(0) {}
+
+		// the groups of torrent_status fields. Each flag in ``fields``
+		// indicates that the corresponding group is included in the delta.
+		enum field_group_t
+		{
+			// ``state``, ``storage_mode``, ``queue_position``, ``priority``,
+			// ``seed_rank``, ``need_save_resume`` and all the boolean flags
+			// (``paused``, ``auto_managed``, ``is_seeding`` etc.)
+			state_fields = 0x1,
+
+			// ``progress``, ``progress_ppm``, ``total_done``,
+			// ``total_wanted_done``, ``total_wanted``, ``num_pieces``,
+			// ``block_size`` and ``sparse_regions``
+			progress_fields = 0x2,
+
+			// the current transfer rates and the bandwidth queue sizes
+			rate_fields = 0x4,
+
+			// the ``total_*`` and ``all_time_*`` byte counters
+			transfer_fields = 0x8,
+
+			// peer and connection counts, their limits and the distributed
+			// copies
+			peer_fields = 0x10,
+
+			// ``current_tracker``, ``announce_interval``, ``num_complete``
+			// and ``num_incomplete``
+			tracker_fields = 0x20,
+
+			// the timestamps and the counters that tick every second, like
+			// ``active_time``, ``next_announce`` and ``last_scrape``
+			time_fields = 0x40,
+
+			// ``error``
+			error_fields = 0x80,
+
+			// ``name``, ``save_path``, ``info_hash`` and ``torrent_file``
+			name_fields = 0x100,
+
+			// the ``pieces`` and ``verified_pieces`` bitfields
+			piece_fields = 0x200,
+
+			all_fields = 0x3ff,
+			num_field_groups = 10
+		};
+
+		// updates ``st`` with the fields carried by this delta. Fields in
+		// groups that are not included are left untouched.
+		void apply(torrent_status& st) const;
+
+		// the number of bytes this delta occupies, including the packed field
+		// data.
+		int size() const { return int(sizeof(*this) + data.size()); }
+
+		// the torrent this delta refers to
+		torrent_handle handle;
+
+		// a bitmask of field_group_t, indicating which groups are present in
+		// ``data``
+		boost::uint32_t fields;
+
+		// the packed field groups, in the order of their flags
+		std::vector<char> data;
+
+		// set if ``name_fields`` is included
+		boost::intrusive_ptr<const torrent_info> torrent_file;
+	};
+
+	// this holds the packed form of the last torrent_status a delta was
+	// generated from, for a single torrent. It's used to determine which
+	// field groups changed.
+	struct TORRENT_EXTRA_EXPORT status_snapshot
+	{
+		status_snapshot();
+
+		// encodes ``st`` and fills in ``delta`` with the field groups that
+		// differ from the previous call. The first call includes all groups.
+		// Returns false if nothing changed, in which case ``delta`` is left
+		// with no fields.
+		bool update(torrent_status const& st, torrent_status_delta& delta);
+
+		// forget the last snapshot, the next update will include all fields
+		void clear();
+
+	private:
+
+		// the packed form of all field groups, back to back
+		std::vector<char> m_buf;
+
+		// the offset into m_buf where each field group starts. The last entry
+		// is the end of the buffer
+		int m_offsets[torrent_status_delta::num_field_groups + 1];
+
+		// the torrent_info object that was last sent. This is only compared
+		// against, never dereferenced
+		torrent_info const* m_torrent_file;
+	};
+}
+
+#endif // TORRENT_STATUS_DELTA_HPP_INCLUDED
+
@@ -61,6 +61,10 @@ namespace libtorrent
 	// number of milliseconds
 	TORRENT_EXPORT void sleep(int milliseconds);
 
+	// returns the number of CPU cores available to this process, or 1 if
+	// it can't be determined
+	TORRENT_EXTRA_EXPORT int hardware_concurrency();
+
 	struct TORRENT_EXTRA_EXPORT condition_variable
 	{
 		condition_variable();
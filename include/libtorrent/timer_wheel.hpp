@@ -0,0 +1,110 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_TIMER_WHEEL_HPP_INCLUDED
+#define TORRENT_TIMER_WHEEL_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/time.hpp"
+
+#include <vector>
+#include <boost/cstdint.hpp>
+
+namespace libtorrent
+{
+	// an entry in a timer_wheel. It's meant to be embedded in the object
+	// the timer belongs to, so scheduling and cancelling never allocate
+	struct timer_wheel_entry
+	{
+		timer_wheel_entry(void* ud = 0)
+			: userdata(ud), next(0), prev(0), slot(-1) {}
+
+		bool scheduled() const { return slot >= 0; }
+
+		// the time this entry was scheduled to expire at
+		ptime expires;
+
+		// the object this timer belongs to
+		void* userdata;
+
+	private:
+		friend struct timer_wheel;
+		timer_wheel_entry* next;
+		timer_wheel_entry* prev;
+		int slot;
+	};
+
+	// internal: a hashed timer wheel. Each slot covers ``granularity``
+	// milliseconds and holds an intrusive list of the entries that expire
+	// within it. Scheduling, cancelling and expiring entries are O(1),
+	// regardless of how many timers there are.
+	//
+	// timers further into the future than the wheel spans are put in the
+	// last slot. They expire early, and it's up to the owner to check
+	// the actual deadline and schedule the timer again
+	struct TORRENT_EXTRA_EXPORT timer_wheel
+	{
+		timer_wheel(int granularity_ms, int num_slots);
+		~timer_wheel();
+
+		// schedules ``e`` to expire at ``expires``. If it's already scheduled
+		// it's moved. Timers whose deadline has already passed are put in
+		// the first slot that hasn't expired yet
+		void schedule(timer_wheel_entry* e, ptime expires);
+		void cancel(timer_wheel_entry* e);
+
+		// removes every entry whose slot is due at ``now`` and appends
+		// them to ``out``. Entries expire at the granularity of the wheel,
+		// i.e. up to ``granularity`` ms late
+		void expire(ptime now, std::vector<timer_wheel_entry*>& out);
+
+		int size() const { return m_size; }
+		int granularity() const { return m_granularity; }
+
+	private:
+
+		boost::int64_t to_tick(ptime t) const;
+
+		std::vector<timer_wheel_entry*> m_slots;
+		int m_granularity;
+		int m_size;
+
+		// the tick the first slot to expire next corresponds to
+		boost::int64_t m_cursor;
+
+		// the time tick 0 corresponds to
+		ptime m_base;
+	};
+}
+
+#endif
+
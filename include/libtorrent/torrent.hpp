@@ -55,6 +55,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #endif
 
 #include "libtorrent/torrent_handle.hpp"
+#include "libtorrent/status_delta.hpp"
 #include "libtorrent/entry.hpp"
 #include "libtorrent/torrent_info.hpp"
 #include "libtorrent/socket.hpp"
@@ -97,6 +98,7 @@ namespace libtorrent
 	struct tracker_request;
 	struct add_torrent_params;
 	struct storage_interface;
+	struct bencode_writer;
 	class bt_peer_connection;
 	struct listen_socket_t;
 
@@ -264,6 +266,7 @@ namespace libtorrent
 		// see if we need to connect to web seeds, and if so,
 		// connect to them
 		void maybe_connect_web_seeds();
+		void update_web_seed_limit(web_seed_entry& web, int connections, ptime now);
 
 		std::string name() const;
 
@@ -406,6 +409,10 @@ namespace libtorrent
 
 		void retry_web_seed(peer_connection* p, int retry = 0);
 
+		// called when the web seed responds that it's overloaded. Lowers
+		// the number of connections we open to it
+		void throttle_web_seed(peer_connection* p);
+
 		void remove_web_seed(peer_connection* p);
 
 		std::list<web_seed_entry> web_seeds() const
@@ -659,25 +666,31 @@ namespace libtorrent
 
 		// this is the asio callback that is called when a name
 		// lookup for a PEER is completed.
-		void on_peer_name_lookup(error_code const& e, tcp::resolver::iterator i
-			, peer_id pid);
+		void on_peer_name_lookup(error_code const& e
+			, std::vector<address> const& addresses, int port, peer_id pid);
 
 		// this is the asio callback that is called when a name
 		// lookup for a WEB SEED is completed.
-		void on_name_lookup(error_code const& e, tcp::resolver::iterator i
+		void on_name_lookup(error_code const& e
+			, std::vector<address> const& addresses, int port
 			, std::list<web_seed_entry>::iterator url, tcp::endpoint proxy);
 
 		void connect_web_seed(std::list<web_seed_entry>::iterator web, tcp::endpoint a);
 
 		// this is the asio callback that is called when a name
 		// lookup for a proxy for a web seed is completed.
-		void on_proxy_name_lookup(error_code const& e, tcp::resolver::iterator i
+		void on_proxy_name_lookup(error_code const& e
+			, std::vector<address> const& addresses, int port
 			, std::list<web_seed_entry>::iterator url);
 
 		// remove a web seed, or schedule it for removal in case there
 		// are outstanding operations on it
 		void remove_web_seed(std::list<web_seed_entry>::iterator web);
 
+		// disconnects the connection using the peer entry of a web seed,
+		// if any, and clears the entry out of the piece picker
+		void disconnect_web_seed_peer(policy::ipv4_peer& peerinfo);
+
 		// this is called when the torrent has finished. i.e.
 		// all the pieces we have not filtered have been downloaded.
 		// If no pieces are filtered, this is called first and then
@@ -774,6 +787,9 @@ namespace libtorrent
 		torrent_handle get_handle();
 
 		void write_resume_data(entry& rd) const;
+		// writes the resume data straight into w, without building an
+		// entry. The keys the storage put in storage_data are merged in
+		void write_resume_data(bencode_writer& w, entry const& storage_data) const;
 		void read_resume_data(lazy_entry const& rd);
 
 		void seen_complete() { m_last_seen_complete = time(0); }
@@ -867,6 +883,10 @@ namespace libtorrent
 		void clear_in_state_update()
 		{ m_in_state_updates = false; }
 
+		// the last status that was posted as a delta. Only used by
+		// session_impl::post_torrent_delta_updates()
+		status_snapshot& last_status_snapshot() { return m_status_snapshot; }
+
 		void inc_num_connecting()
 		{ ++m_num_connecting; }
 		void dec_num_connecting()
@@ -894,6 +914,7 @@ namespace libtorrent
 		void on_torrent_paused(int ret, disk_io_job const& j);
 		void on_storage_moved(int ret, disk_io_job const& j);
 		void on_save_resume_data(int ret, disk_io_job const& j);
+		void post_resume_data(entry const& storage_data);
 		void on_file_renamed(int ret, disk_io_job const& j);
 		void on_cache_flushed(int ret, disk_io_job const& j);
 
@@ -903,7 +924,8 @@ namespace libtorrent
 		int prioritize_tracker(int tracker_index);
 		int deprioritize_tracker(int tracker_index);
 
-		void on_country_lookup(error_code const& error, tcp::resolver::iterator i
+		void on_country_lookup(error_code const& error
+			, std::vector<address> const& addresses
 			, boost::intrusive_ptr<peer_connection> p) const;
 		bool request_bandwidth_from_session(int channel) const;
 
@@ -1005,15 +1027,16 @@ namespace libtorrent
 		// it's updated from all its peers once every second.
 		libtorrent::stat m_stat;
 
+		// the packed form of the status last posted in a state_delta_alert.
+		// empty unless the client uses post_torrent_delta_updates()
+		status_snapshot m_status_snapshot;
+
 		// -----------------------------
 
 		// a back reference to the session
 		// this torrent belongs to.
 		aux::session_impl& m_ses;
 
-		// used to resolve hostnames for web seeds
-		mutable tcp::resolver m_host_resolver;
-
 		std::vector<boost::uint8_t> m_file_priority;
 
 		// this vector contains the number of bytes completely
@@ -584,7 +584,14 @@ namespace libtorrent
 			// the resume data will contain the metadata from the torrent file as
 			// well. This is default for any torrent that's added without a
 			// torrent file (such as a magnet link or a URL).
-			save_info_dict = 2
+			save_info_dict = 2,
+
+			// the resume data is only delivered bencoded, in
+			// save_resume_data_alert::resume_data_buffer, and
+			// save_resume_data_alert::resume_data is left empty. This saves
+			// building (and later bencoding) an entry tree, which adds up
+			// when saving resume data for many torrents.
+			only_bencoded = 4
 		};
 
 		// ``save_resume_data()`` generates fast-resume data and returns it as an
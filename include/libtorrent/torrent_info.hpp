@@ -35,6 +35,7 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include <string>
 #include <vector>
+#include <list>
 
 #ifdef _MSC_VER
 #pragma warning(push, 1)
@@ -238,6 +239,24 @@ namespace libtorrent
 			, std::string const& auth_ = std::string()
 			, headers_t const& extra_headers_ = headers_t());
 
+		// returns the peer entry to use for a new connection to this web
+		// seed. It's one that no connection is using, allocated in
+		// extra_peers if they're all taken
+		policy::ipv4_peer& unused_peer();
+
+		// called periodically while connections are open to this web
+		// seed. ``connections`` is the number of them, and ``rate`` their
+		// combined download rate. Raises connection_limit by one if every
+		// allowed connection is open and the rate went up by at least 10%
+		// since the last raise. If it didn't, another connection is tried
+		// a minute later. Returns true if it was raised
+		bool update_connection_limit(int connections, int rate
+			, int max_connections, ptime now);
+
+		// called when the server responds with 429 or 503. Halves
+		// connection_limit, and doesn't raise it again before ``until``
+		void throttle(ptime until);
+
 		// URL and type comparison
 		bool operator==(web_seed_entry const& e) const
 		{ return url == e.url && type == e.type; }
@@ -291,6 +310,26 @@ namespace libtorrent
 		// it's also used to hold the peer_connection
 		// pointer, when the web seed is connected
 		policy::ipv4_peer peer_info;
+
+		// the peer entries of the connections beyond the first one, when
+		// several connections are open to this web seed. They're reused
+		// as connections come and go. This is a list because the piece
+		// picker holds pointers to the entries
+		std::list<policy::ipv4_peer> extra_peers;
+
+		// the number of connections currently allowed to this web seed.
+		// It starts at 1 and grows towards urlseed_max_connections as long
+		// as each added connection raises the download rate. It's halved
+		// when the server responds with 429 or 503
+		int connection_limit;
+
+		// the download rate from this web seed (in bytes per second) when
+		// connection_limit was last raised, or 0 if the next adjustment
+		// should raise it regardless
+		int last_rate;
+
+		// connection_limit isn't adjusted again before this time
+		ptime next_adjustment;
 	};
 
 #ifndef BOOST_NO_EXCEPTIONS
@@ -74,6 +74,9 @@ namespace libtorrent
 	class tracker_manager;
 	struct timeout_handler;
 	struct tracker_connection;
+	struct http_connection;
+	struct resolver;
+	struct session_status;
 	namespace aux { struct session_impl; }
 
 	// returns -1 if gzip header is invalid or the header size in bytes
@@ -260,7 +263,9 @@ namespace libtorrent
 	public:
 
 		tracker_manager(aux::session_impl& ses, proxy_settings const& ps)
-			: m_ses(ses)
+			: m_http_connections(0)
+			, m_http_connection_reuses(0)
+			, m_ses(ses)
 			, m_proxy(ps)
 			, m_abort(false) {}
 		~tracker_manager();
@@ -288,15 +293,50 @@ namespace libtorrent
 		// they may be addressed to hostname
 		virtual bool incoming_packet(error_code const& e, char const* hostname
 			, char const* buf, int size);
+
+		// returns an idle keep-alive connection to the HTTP tracker
+		// identified by ``key``, or an empty pointer if there is none. In
+		// that case, the caller is expected to open a new connection
+		boost::shared_ptr<http_connection> get_http_connection(std::string const& key);
+
+		// hands a connection back to the pool after a completed request, to
+		// be used for the next request with the same key
+		void return_http_connection(std::string const& key
+			, boost::shared_ptr<http_connection> c);
+
+		void get_status(session_status& s) const;
+
+		// the session's caching resolver, used to look up tracker host names
+		resolver& host_resolver();
 		
 	private:
 
+		// closes idle connections that have been in the pool for too long
+		void prune_http_pool(ptime now);
+
 		typedef mutex mutex_t;
 		mutable mutex_t m_mutex;
 
 		typedef std::list<boost::intrusive_ptr<tracker_connection> >
 			tracker_connections_t;
 		tracker_connections_t m_connections;
+
+		struct idle_http_connection
+		{
+			std::string key;
+			boost::shared_ptr<http_connection> connection;
+			ptime idle_since;
+		};
+
+		// idle keep-alive connections to HTTP trackers, the one that has
+		// been idle the longest first
+		std::list<idle_http_connection> m_http_pool;
+
+		// the number of HTTP tracker requests that opened a new connection
+		// and that reused one from the pool
+		size_type m_http_connections;
+		size_type m_http_connection_reuses;
+
 		aux::session_impl& m_ses;
 		proxy_settings const& m_proxy;
 		bool m_abort;
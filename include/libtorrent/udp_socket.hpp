@@ -70,7 +70,11 @@ namespace libtorrent
 		udp_socket(io_service& ios, connection_queue& cc);
 		~udp_socket();
 
-		enum flags_t { dont_drop = 1, peer_connection = 2, dont_queue = 4 };
+		// dont_cork means the datagram is sent right away even if the socket
+		// is corked, for callers that need the error of the send (like an MTU
+		// probe expecting EMSGSIZE). Datagrams queued before it are sent
+		// first, and if they can't be, it fails with would_block
+		enum flags_t { dont_drop = 1, peer_connection = 2, dont_queue = 4, dont_cork = 8 };
 
 		bool is_open() const
 		{
@@ -91,6 +95,18 @@ namespace libtorrent
 
 		void send(udp::endpoint const& ep, char const* p, int len
 			, error_code& ec, int flags = 0);
+
+		// while the socket is corked, datagrams passed to send() are
+		// queued up and sent in a single batch (using sendmmsg() where
+		// available) once the last uncork() is called. Calls may be
+		// nested. Incoming packets are always dispatched with the socket
+		// corked, so responses triggered by them are coalesced.
+		// Since send() can't report the error of a queued datagram, it's
+		// reported to the observers as an incoming_packet() error from its
+		// destination endpoint, the same way ICMP errors are
+		void cork() { ++m_cork; }
+		void uncork();
+
 		void bind(udp::endpoint const& ep, error_code& ec);
 		void close();
 		int local_port() const { return m_bind_port; }
@@ -144,6 +160,23 @@ namespace libtorrent
 			int flags;
 		};
 
+		// a datagram waiting in the send queue. The payload is
+		// stored in m_send_buf, at the specified offset
+		struct pending_datagram
+		{
+			udp::socket* sock;
+			udp::endpoint ep;
+			int offset;
+			int len;
+		};
+
+		// the max number of datagrams received by one system call.
+		// The receive buffer holds this many datagrams
+		enum { read_batch_size = TORRENT_USE_RECVMMSG ? 32 : 1 };
+
+		// the max number of datagrams held in the send queue
+		enum { max_send_queue = 64 };
+
 		// number of outstanding UDP socket operations
 		// using the UDP socket buffer
 		int num_outstanding() const
@@ -177,11 +210,20 @@ namespace libtorrent
 		void call_writable_handler();
 
 		void on_writable(error_code const& ec, udp::socket* s);
+		void subscribe_writable(udp::socket* s);
+
+		void flush_send_queue();
+		void report_send_errors();
+		int send_datagrams(udp::socket* s, pending_datagram const* d
+			, int num, error_code& ec);
 
 		void setup_read(udp::socket* s);
 		void on_read(error_code const& ec, udp::socket* s);
+#if TORRENT_USE_RECVMMSG
+		bool read_batch(udp::socket* s);
+#endif
 		void on_read_impl(udp::socket* sock, udp::endpoint const& ep
-			, error_code const& e, std::size_t bytes_transferred);
+			, error_code const& e, char const* buf, std::size_t bytes_transferred);
 		void on_name_lookup(error_code const& e, tcp::resolver::iterator i);
 		void on_timeout();
 		void on_connect(int ticket);
@@ -226,8 +268,32 @@ namespace libtorrent
 		// the desired size, and it's resized
 		// later
 		int m_new_buf_size;
+
+		// room for read_batch_size datagrams of m_buf_size bytes each
 		char* m_buf;
 
+		// set while dispatching a batch of received datagrams. The
+		// receive buffer may not be resized during that time
+		bool m_reading_batch;
+
+		// datagrams queued while the socket is corked, or while the
+		// socket is waiting to become writable
+		std::vector<pending_datagram> m_send_queue;
+		std::vector<char> m_send_buf;
+
+		// datagrams from the send queue that failed, to be reported to the
+		// observers once they're not being called
+		std::vector<std::pair<udp::endpoint, error_code> > m_send_errors;
+
+		// the number of outstanding calls to cork()
+		int m_cork;
+
+#if TORRENT_USE_SENDMMSG
+		// set to false if the kernel turns out not to support
+		// UDP generic segmentation offload
+		bool m_use_gso;
+#endif
+
 #if TORRENT_USE_IPV6
 		udp::socket m_ipv6_sock;
 #endif
@@ -78,6 +78,17 @@ namespace libtorrent
 		void start();
 		void close();
 
+		// the most info-hashes the tracker will accept in a single scrape
+		// packet. With this many, the response still fits in a single
+		// unfragmented UDP packet
+		enum { max_scrape_hashes = 74 };
+
+		// adds another torrent's scrape to this one, if it hasn't been sent
+		// yet. The scrapes are sent in a single packet. Returns false if
+		// this connection can't take any more info-hashes
+		bool add_scrape(tracker_request const& req
+			, boost::weak_ptr<request_callback> c);
+
 	private:
 
 		enum action_t
@@ -91,7 +102,8 @@ namespace libtorrent
 		boost::intrusive_ptr<udp_tracker_connection> self()
 		{ return boost::intrusive_ptr<udp_tracker_connection>(this); }
 
-		void name_lookup(error_code const& error, tcp::resolver::iterator i);
+		void name_lookup(error_code const& error
+			, std::vector<address> const& addresses, int port);
 		void timeout(error_code const& error);
 		void start_announce();
 
@@ -108,6 +120,9 @@ namespace libtorrent
 			, char const* msg = "", int interval = 0, int min_interval = 0);
 
 		void send_udp_connect();
+		// if we're the connection sending the connect message to our
+		// target, let the ones waiting for it try on their own
+		void release_pending_connect();
 		void send_udp_announce();
 		void send_udp_scrape();
 
@@ -131,8 +146,28 @@ namespace libtorrent
 		};
 
 		static std::map<address, connection_cache_entry> m_connection_cache;
+
+		// when many torrents announce to the same tracker at once, only
+		// one of them sends the connect message. The other ones wait for
+		// its connection ID to end up in the cache
+		struct pending_connect
+		{
+			udp_tracker_connection* connecting;
+			std::vector<boost::intrusive_ptr<udp_tracker_connection> > waiting;
+		};
+
+		static std::map<address, pending_connect> m_pending_connects;
 		static mutex m_cache_mutex;
 
+		// scrapes of other torrents sent in the same packet as ours. Their
+		// info-hashes follow ours, and so do their responses
+		struct extra_scrape
+		{
+			tracker_request req;
+			boost::weak_ptr<request_callback> callback;
+		};
+		std::vector<extra_scrape> m_extra_scrapes;
+
 		action_t m_state;
 
 		proxy_settings m_proxy;
@@ -33,11 +33,16 @@ POSSIBILITY OF SUCH DAMAGE.
 #ifndef TORRENT_UTP_SOCKET_MANAGER_HPP_INCLUDED
 #define TORRENT_UTP_SOCKET_MANAGER_HPP_INCLUDED
 
-#include <map>
+#include <vector>
 
 #include "libtorrent/socket_type.hpp"
 #include "libtorrent/session_status.hpp"
 #include "libtorrent/enum_net.hpp"
+#include "libtorrent/packet_pool.hpp"
+#include "libtorrent/utp_socket_map.hpp"
+#include "libtorrent/timer_wheel.hpp"
+#include "libtorrent/deadline_timer.hpp"
+#include "libtorrent/intrusive_ptr_base.hpp"
 
 namespace libtorrent
 {
@@ -45,8 +50,21 @@ namespace libtorrent
 	class utp_stream;
 	struct utp_socket_impl;
 
+	struct utp_socket_manager;
+
 	typedef boost::function<void(boost::shared_ptr<socket_type> const&)> incoming_utp_callback_t;
 
+	// the timer waking up paced sockets. Its handler holds a reference to
+	// it, and the manager detaches itself from it when it's destructed, so
+	// a handler still in the queue by then doesn't touch the manager
+	struct utp_pacing_timer : intrusive_ptr_base<utp_pacing_timer>
+	{
+		utp_pacing_timer(io_service& ios, utp_socket_manager* m)
+			: timer(ios), manager(m) {}
+		deadline_timer timer;
+		utp_socket_manager* manager;
+	};
+
 	struct utp_socket_manager : udp_socket_observer
 	{
 		utp_socket_manager(session_settings const& sett, udp_socket& s, incoming_utp_callback_t cb);
@@ -74,8 +92,25 @@ namespace libtorrent
 			, error_code& ec, int flags = 0);
 		void subscribe_writable(utp_socket_impl* s);
 
-		// internal, used by utp_stream
-		void remove_socket(boost::uint16_t id);
+		// internal, used by utp_stream when the remote endpoint of a
+		// socket changes. The socket is looked up under ``old_ep``
+		void rekey_socket(utp_socket_impl* s, udp::endpoint const& old_ep);
+
+		// internal, used by utp_stream to allocate the packets
+		// it sends and the ones it receives out of order
+		packet* acquire_packet(int size) { return m_packet_pool.acquire(size); }
+		void release_packet(packet* p) { m_packet_pool.release(p); }
+
+		// internal, used by utp_stream to schedule when its socket
+		// should be ticked next
+		void schedule_timer(timer_wheel_entry* e, ptime expires)
+		{ m_timers.schedule(e, expires); }
+		void cancel_timer(timer_wheel_entry* e) { m_timers.cancel(e); }
+
+		// internal, used by utp_stream. Sockets that are held back by
+		// pacing are woken up (via utp_paced()) once ``when`` has passed
+		void pace(utp_socket_impl* s, ptime when);
+		void cancel_pacing(utp_socket_impl* s);
 
 		utp_socket_impl* new_utp_socket(utp_stream* str);
 		int gain_factor() const { return m_sett.utp_gain_factor; }
@@ -87,6 +122,7 @@ namespace libtorrent
 		int min_timeout() const { return m_sett.utp_min_timeout; }
 		int loss_multiplier() const { return m_sett.utp_loss_multiplier; }
 		bool allow_dynamic_sock_buf() const { return m_sett.utp_dynamic_sock_buf; }
+		bool pacing() const { return m_sett.utp_pacing; }
 
 		void mtu_for_dest(address const& addr, int& link_mtu, int& utp_mtu);
 		void set_sock_buf(int size);
@@ -109,6 +145,7 @@ namespace libtorrent
 			payload_pkts_out,
 			invalid_pkts_in,
 			redundant_pkts_in,
+			paced_packets,
 
 			num_counters,
 		};
@@ -117,12 +154,30 @@ namespace libtorrent
 		void inc_stats_counter(int counter);
 
 	private:
+
+		static void on_pacing_timer(boost::intrusive_ptr<utp_pacing_timer> t
+			, error_code const& ec);
+		void wake_paced_sockets();
+
 		udp_socket& m_sock;
 		incoming_utp_callback_t m_cb;
 
-		// replace with a hash-map
-		typedef std::multimap<boost::uint16_t, utp_socket_impl*> socket_map_t;
-		socket_map_t m_utp_sockets;
+		// all sockets, keyed by remote endpoint and receive connection ID
+		utp_socket_map m_utp_sockets;
+
+		// sockets are only ticked when their timer expires. The
+		// timer is set to the socket's retransmit timeout
+		timer_wheel m_timers;
+
+		// scratch space for tick(), holding the timers that expired
+		std::vector<timer_wheel_entry*> m_expired_timers;
+
+		// sockets waiting for the pacing timer to send more packets.
+		// The timer is set to expire when the first of them is
+		// allowed to send again, or max_time() if it's not armed
+		std::vector<utp_socket_impl*> m_paced_sockets;
+		boost::intrusive_ptr<utp_pacing_timer> m_pacing_timer;
+		ptime m_pacing_deadline;
 
 		// this is a list of sockets that needs to send an ack.
 		// once the UDP socket is drained, all of these will
@@ -167,6 +222,9 @@ namespace libtorrent
 
 		// stats counters
 		boost::uint64_t m_counters[num_counters];
+
+		// recycled packet buffers shared by all uTP sockets
+		packet_pool m_packet_pool;
 	};
 }
 
@@ -0,0 +1,95 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#ifndef TORRENT_UTP_SOCKET_MAP_HPP_INCLUDED
+#define TORRENT_UTP_SOCKET_MAP_HPP_INCLUDED
+
+#include "libtorrent/config.hpp"
+#include "libtorrent/socket.hpp" // for udp::endpoint
+#include "libtorrent/address.hpp"
+
+#include <vector>
+#include <boost/cstdint.hpp>
+
+namespace libtorrent
+{
+	struct utp_socket_impl;
+
+	// internal: maps (remote endpoint, receive connection ID) to uTP sockets.
+	// It's an open addressing hash table with linear probing. The key is
+	// stored in the slot itself, so a lookup doesn't touch the socket
+	// unless it matches. Sockets that don't have a remote endpoint yet are
+	// stored under the default constructed endpoint, and are moved once
+	// they get one.
+	struct TORRENT_EXTRA_EXPORT utp_socket_map
+	{
+		utp_socket_map();
+
+		// returns NULL if there's no socket with this key
+		utp_socket_impl* find(udp::endpoint const& ep, boost::uint16_t id) const;
+
+		// there may be more than one socket with the same key. find() returns
+		// the first one that was inserted
+		void insert(udp::endpoint const& ep, boost::uint16_t id, utp_socket_impl* s);
+
+		// returns false if ``s`` was not found under this key
+		bool erase(udp::endpoint const& ep, boost::uint16_t id, utp_socket_impl* s);
+
+		int size() const { return m_size; }
+		bool empty() const { return m_size == 0; }
+
+		// used to iterate over all sockets. Slots that are not in use
+		// return NULL. The map may not be modified while iterating
+		int capacity() const { return m_slots.size(); }
+		utp_socket_impl* at(int i) const { return m_slots[i].sock; }
+
+	private:
+
+		struct slot
+		{
+			slot(): id(0), sock(0) {}
+			udp::endpoint ep;
+			boost::uint16_t id;
+			utp_socket_impl* sock;
+		};
+
+		static boost::uint32_t hash(udp::endpoint const& ep, boost::uint16_t id);
+		void grow();
+
+		// the number of slots is always a power of two
+		std::vector<slot> m_slots;
+		int m_size;
+	};
+}
+
+#endif
+
@@ -39,6 +39,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/io.hpp"
 #include "libtorrent/packet_buffer.hpp"
 #include "libtorrent/error_code.hpp"
+#include "libtorrent/time.hpp"
 
 #include <boost/bind.hpp>
 #include <boost/function/function1.hpp>
@@ -137,6 +138,37 @@ struct utp_header
 	int get_version() const { return type_ver & 0xf; }
 };
 
+// internal: a token bucket spreading the packets of a uTP socket out
+// over the round-trip time, rather than sending the whole congestion
+// window in one burst
+struct TORRENT_EXTRA_EXPORT utp_pacer
+{
+	utp_pacer(ptime now): m_tokens(0), m_last_update(now) {}
+
+	// returns the pacing rate in bytes per second for a congestion window
+	// of ``cwnd`` bytes and a round-trip time of ``rtt`` milliseconds, or 0
+	// if packets can't be paced
+	static boost::int64_t rate(int cwnd, int rtt, bool slow_start);
+
+	// returns the number of microseconds until a packet of ``bytes`` may
+	// be sent at ``rate``, or 0 if it may be sent now
+	int wait(int bytes, boost::int64_t rate, int mtu, ptime now);
+
+	// takes the tokens for a packet that was sent. A packet that Nagle
+	// held back may have grown since it was checked, so the tokens may
+	// go negative. The difference is paid back before the next one is sent
+	void use(int bytes) { m_tokens -= bytes; }
+
+private:
+
+	// the number of bytes we may send right now without exceeding
+	// the pacing rate
+	boost::int64_t m_tokens;
+
+	// the last time m_tokens was refilled
+	ptime m_last_update;
+};
+
 struct utp_socket_impl;
 
 utp_socket_impl* construct_utp_impl(boost::uint16_t recv_id
@@ -156,6 +188,7 @@ int utp_socket_state(utp_socket_impl const* s);
 void utp_send_ack(utp_socket_impl* s);
 void utp_socket_drained(utp_socket_impl* s);
 void utp_writable(utp_socket_impl* s);
+void utp_paced(utp_socket_impl* s);
 
 #if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING || defined TORRENT_ERROR_LOGGING
 int socket_impl_size();
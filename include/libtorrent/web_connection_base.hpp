@@ -95,7 +95,8 @@ namespace libtorrent
 			, boost::weak_ptr<torrent> t
 			, boost::shared_ptr<socket_type> s
 			, tcp::endpoint const& remote
-			, web_seed_entry& web);
+			, web_seed_entry& web
+			, policy::peer* peerinfo);
 		void start();
 
 		~web_connection_base();
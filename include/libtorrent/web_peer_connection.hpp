@@ -84,7 +84,8 @@ namespace libtorrent
 			, boost::weak_ptr<torrent> t
 			, boost::shared_ptr<socket_type> s
 			, tcp::endpoint const& remote
-			, web_seed_entry& web);
+			, web_seed_entry& web
+			, policy::peer* peerinfo);
 
 		virtual int type() const { return peer_connection::url_seed_connection; }
 
@@ -106,6 +107,15 @@ namespace libtorrent
 
 		bool maybe_harvest_block();
 
+		// queues an HTTP request for the range [start, start + length) of
+		// the file. If the previously queued request hasn't been sent yet
+		// and ends where this one starts, it's extended instead
+		void queue_request(int file_index, size_type start, size_type length);
+
+		// sends queued HTTP requests until urlseed_pipeline_size requests
+		// are outstanding. Returns true if anything was sent
+		bool send_pending_requests();
+
 		// returns the block currently being
 		// downloaded. And the progress of that
 		// block. If the peer isn't downloading
@@ -117,6 +127,20 @@ namespace libtorrent
 		// (might be more than the bt requests)
 		std::deque<int> m_file_requests;
 
+		// an HTTP request that's been queued but not sent yet. When it's
+		// for a single-file torrent, file_index is 0 and the range is the
+		// offset into the torrent
+		struct pending_request
+		{
+			int file_index;
+			size_type start;
+			size_type length;
+		};
+
+		// the HTTP requests waiting for room in the pipeline. Every entry
+		// also has an entry in m_file_requests
+		std::deque<pending_request> m_pending_requests;
+
 		std::string m_url;
 	
 		web_seed_entry& m_web;
@@ -154,6 +178,10 @@ namespace libtorrent
 		// the number of responses we've received so far on
 		// this connection
 		int m_num_responses;
+
+		// the number of HTTP requests we've sent whose response hasn't
+		// been completely received yet
+		int m_outstanding_requests;
 	};
 }
 
@@ -533,6 +533,43 @@ namespace libtorrent {
 		return msg;
 	}
 
+	std::string state_delta_alert::message() const
+	{
+		int size = 0;
+		for (std::vector<torrent_status_delta>::const_iterator i = deltas.begin()
+			, end(deltas.end()); i != end; ++i)
+			size += i->size();
+
+		char msg[200];
+		snprintf(msg, sizeof(msg), "state deltas for %d torrents (%d bytes)"
+			, int(deltas.size()), size);
+		return msg;
+	}
+
+	session_stats_alert::session_stats_alert(counters const& cnt)
+	{
+		for (int i = 0; i < counters::num_counters; ++i)
+			values[i] = cnt[i];
+		for (int i = 0; i < counters::num_histograms; ++i)
+			cnt.histogram(i).snapshot(histograms[i]);
+	}
+
+	std::string session_stats_alert::message() const
+	{
+		std::string ret;
+		char buf[50];
+		snprintf(buf, sizeof(buf), "session stats (%d values): "
+			, int(counters::num_counters));
+		ret = buf;
+		for (int i = 0; i < counters::num_counters; ++i)
+		{
+			snprintf(buf, sizeof(buf), i == 0 ? "%" PRIu64 : ", %" PRIu64
+				, values[i]);
+			ret += buf;
+		}
+		return ret;
+	}
+
 	std::string torrent_update_alert::message() const
 	{
 		char msg[200];
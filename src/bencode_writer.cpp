@@ -0,0 +1,130 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/bencode_writer.hpp"
+#include "libtorrent/bencode.hpp" // for integer_to_str
+#include "libtorrent/entry.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <iterator>
+
+namespace libtorrent
+{
+	void bencode_writer::write_decimal(size_type val)
+	{
+		char buf[21];
+		char const* str = detail::integer_to_str(buf, sizeof(buf), val);
+		m_buf.insert(m_buf.end(), str, (char const*)buf + sizeof(buf) - 1);
+	}
+
+	void bencode_writer::string_prefix(int len)
+	{
+		TORRENT_ASSERT(len >= 0);
+		write_decimal(len);
+		m_buf.push_back(':');
+	}
+
+	char* bencode_writer::reserve_string(int len)
+	{
+		string_prefix(len);
+		std::size_t const offset = m_buf.size();
+		m_buf.resize(offset + len);
+		return len == 0 ? 0 : &m_buf[offset];
+	}
+
+	void bencode_writer::value(entry const& e)
+	{
+		bencode(std::back_inserter(m_buf), e);
+	}
+
+	void bencode_writer::string(char const* str, int len)
+	{
+		string_prefix(len);
+		m_buf.insert(m_buf.end(), str, str + len);
+	}
+
+	void bencode_writer::integer(size_type val)
+	{
+		m_buf.push_back('i');
+		write_decimal(val);
+		m_buf.push_back('e');
+	}
+
+	bencode_dict_merge::bencode_dict_merge(bencode_writer& w
+		, entry const& extra, bool override)
+		: m_w(w)
+		, m_extra(extra.type() == entry::dictionary_t ? &extra.dict() : 0)
+		, m_override(override)
+	{
+		if (m_extra) m_next = m_extra->begin();
+	}
+
+	void bencode_dict_merge::write_extra(char const* before)
+	{
+		if (m_extra == 0) return;
+		for (; m_next != m_extra->end()
+			&& (before == 0 || m_next->first < before); ++m_next)
+		{
+			m_w.key(m_next->first);
+			m_w.value(m_next->second);
+		}
+	}
+
+	bool bencode_dict_merge::key(char const* k)
+	{
+#if TORRENT_USE_ASSERTS
+		// bencoded dictionaries must be sorted
+		TORRENT_ASSERT(m_last_key.empty() || m_last_key < k);
+		m_last_key = k;
+#endif
+		write_extra(k);
+		if (m_extra && m_next != m_extra->end() && m_next->first == k)
+		{
+			if (m_override)
+			{
+				m_w.key(m_next->first);
+				m_w.value(m_next->second);
+				++m_next;
+				return false;
+			}
+			++m_next;
+		}
+		m_w.key(k);
+		return true;
+	}
+
+	void bencode_dict_merge::finish()
+	{
+		write_extra(0);
+	}
+}
+
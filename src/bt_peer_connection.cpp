@@ -308,9 +308,7 @@ namespace libtorrent
 	{
 		INVARIANT_CHECK;
 
-#ifdef TORRENT_STATS
-		++m_ses.m_piece_rejects;
-#endif
+		m_ses.inc_stats_counter(counters::piece_rejects);
 
 		if (!m_supports_fast) return;
 
@@ -2384,6 +2382,23 @@ namespace libtorrent
 
 	void bt_peer_connection::on_receive(error_code const& error
 		, std::size_t bytes_transferred)
+	{
+		if (m_state >= read_packet_size)
+		{
+			on_receive_impl(error, bytes_transferred);
+			return;
+		}
+
+		// we're still in the handshake. Keep track of how long it takes to
+		// process, since the encryption handshake is expensive
+		ptime const start = time_now_hires();
+		on_receive_impl(error, bytes_transferred);
+		m_ses.stats_counters().add_latency_sample(counters::handshake_time
+			, time_now_hires() - start);
+	}
+
+	void bt_peer_connection::on_receive_impl(error_code const& error
+		, std::size_t bytes_transferred)
 	{
 		INVARIANT_CHECK;
 
@@ -35,9 +35,13 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/storage.hpp"
 #include "libtorrent/escape_string.hpp"
 #include "libtorrent/torrent_info.hpp" // for merkle_*()
+#include "libtorrent/thread.hpp"
 
 #include <boost/bind.hpp>
 #include <boost/next_prior.hpp>
+#include <boost/noncopyable.hpp>
+#include <boost/shared_ptr.hpp>
+#include <deque>
 
 #include <sys/types.h>
 #include <sys/stat.h>
@@ -147,51 +151,206 @@ namespace libtorrent
 		}
 	}
 
-	struct piece_holder
+	namespace
 	{
-		piece_holder(int bytes): m_piece(page_aligned_allocator::malloc(bytes)) {}
-		~piece_holder() { page_aligned_allocator::free(m_piece); }
-		char* bytes() { return m_piece; }
-	private:
-		char* m_piece;
-	};
+		// hashes the pieces of a torrent with a pipeline of threads. One
+		// thread reads pieces in order into a ring of buffers, num_threads
+		// threads hash them (in any order), and the calling thread picks up
+		// the hashes in order, calls the progress callback and recycles the
+		// buffers. The file hashes, being hashes of a stream, are calculated
+		// by the calling thread too, as the pieces come back in order.
+		// 
+		// the destructor stops and joins all threads, so the pipeline is
+		// torn down cleanly even if the progress callback throws
+		struct hash_pipeline : boost::noncopyable
+		{
+			hash_pipeline(create_torrent& t, storage_interface& st
+				, int num_threads, int num_slots)
+				: m_t(t)
+				, m_st(st)
+				, m_slots(num_slots)
+				, m_released(0)
+				, m_read_done(false)
+				, m_abort(false)
+			{
+				for (std::vector<slot>::iterator i = m_slots.begin()
+					, end(m_slots.end()); i != end; ++i)
+					i->buffer = page_aligned_allocator::malloc(t.piece_length());
+
+				m_threads.push_back(boost::shared_ptr<thread>(
+					new thread(boost::bind(&hash_pipeline::read_thread, this))));
+				for (int i = 0; i < num_threads; ++i)
+					m_threads.push_back(boost::shared_ptr<thread>(
+						new thread(boost::bind(&hash_pipeline::hash_thread, this))));
+			}
+
+			~hash_pipeline()
+			{
+				{
+					mutex::scoped_lock l(m_mutex);
+					m_abort = true;
+					m_cond.notify_all();
+				}
+				for (std::vector<boost::shared_ptr<thread> >::iterator i = m_threads.begin()
+					, end(m_threads.end()); i != end; ++i)
+					(*i)->join();
+
+				for (std::vector<slot>::iterator i = m_slots.begin()
+					, end(m_slots.end()); i != end; ++i)
+					page_aligned_allocator::free(i->buffer);
+			}
+
+			// blocks until piece has been hashed. Returns the buffer holding
+			// the piece, or 0 if reading failed. Pieces must be waited for in
+			// order, and each one released before waiting for the next one
+			char* wait_for(int piece, sha1_hash& h, error_code& ec)
+			{
+				TORRENT_ASSERT(piece == m_released);
+				slot& s = m_slots[piece % m_slots.size()];
+				mutex::scoped_lock l(m_mutex);
+				while (!(s.piece == piece && s.hashed) && !m_abort)
+					m_cond.wait(l);
+				if (m_abort)
+				{
+					ec = m_error;
+					return 0;
+				}
+				h = s.hash;
+				return s.buffer;
+			}
+
+			// hands the buffer of the oldest piece back to the reader
+			void release()
+			{
+				mutex::scoped_lock l(m_mutex);
+				++m_released;
+				m_cond.notify_all();
+			}
+
+		private:
+
+			struct slot
+			{
+				slot(): buffer(0), piece(-1), hashed(false) {}
+				char* buffer;
+				int piece;
+				bool hashed;
+				sha1_hash hash;
+			};
+
+			void read_thread()
+			{
+				int const num_pieces = m_t.num_pieces();
+				int const num_slots = int(m_slots.size());
+				for (int i = 0; i < num_pieces; ++i)
+				{
+					slot& s = m_slots[i % num_slots];
+					{
+						// wait for the piece that used this slot last to be
+						// released
+						mutex::scoped_lock l(m_mutex);
+						while (i - m_released >= num_slots && !m_abort)
+							m_cond.wait(l);
+						if (m_abort) return;
+					}
+
+					// the slot belongs to this thread until the piece is queued
+					m_st.read(s.buffer, i, 0, m_t.piece_size(i));
+
+					mutex::scoped_lock l(m_mutex);
+					if (m_st.error())
+					{
+						m_error = m_st.error();
+						m_abort = true;
+						m_cond.notify_all();
+						return;
+					}
+					s.piece = i;
+					s.hashed = false;
+					m_queue.push_back(i);
+					m_cond.notify_all();
+				}
+
+				mutex::scoped_lock l(m_mutex);
+				m_read_done = true;
+				m_cond.notify_all();
+			}
+
+			void hash_thread()
+			{
+				int const num_slots = int(m_slots.size());
+				for (;;)
+				{
+					int piece;
+					{
+						mutex::scoped_lock l(m_mutex);
+						while (m_queue.empty() && !m_read_done && !m_abort)
+							m_cond.wait(l);
+						if (m_queue.empty() || m_abort) return;
+						piece = m_queue.front();
+						m_queue.pop_front();
+					}
+
+					slot& s = m_slots[piece % num_slots];
+					sha1_hash h = hasher(s.buffer, m_t.piece_size(piece)).final();
+
+					mutex::scoped_lock l(m_mutex);
+					s.hash = h;
+					s.hashed = true;
+					m_cond.notify_all();
+				}
+			}
+
+			create_torrent& m_t;
+			storage_interface& m_st;
+
+			mutex m_mutex;
+			condition_variable m_cond;
+
+			// piece i is read into m_slots[i % m_slots.size()]
+			std::vector<slot> m_slots;
+
+			// pieces that have been read but not hashed yet
+			std::deque<int> m_queue;
+
+			// the number of pieces the calling thread is done with. The
+			// reader may run at most m_slots.size() pieces ahead of it
+			int m_released;
+
+			bool m_read_done;
+			bool m_abort;
+			error_code m_error;
+
+			std::vector<boost::shared_ptr<thread> > m_threads;
+		};
+
+		// sets the merkle tree nodes [first, last) to the hash of their
+		// two children. The children of node n are 2n+1 and 2n+2
+		void hash_merkle_nodes(std::vector<sha1_hash>* tree, int first, int last)
+		{
+			std::vector<sha1_hash>& t = *tree;
+			for (int n = first; n < last; ++n)
+			{
+				hasher h;
+				h.update((char const*)&t[n * 2 + 1][0], 20);
+				h.update((char const*)&t[n * 2 + 2][0], 20);
+				t[n] = h.final();
+			}
+		}
+	}
 
 #if TORRENT_USE_WSTRING
 	void set_piece_hashes(create_torrent& t, std::wstring const& p
 		, boost::function<void(int)> const& f, error_code& ec)
 	{
-		file_pool fp;
 		std::string utf8;
 		wchar_utf8(p, utf8);
-#if TORRENT_USE_UNC_PATHS
-		utf8 = canonicalize_path(utf8);
-#endif
-		boost::scoped_ptr<storage_interface> st(
-			default_storage_constructor(const_cast<file_storage&>(t.files()), 0, utf8, fp
-			, std::vector<boost::uint8_t>()));
-
-		// calculate the hash for all pieces
-		int num = t.num_pieces();
-		std::vector<char> buf(t.piece_length());
-		for (int i = 0; i < num; ++i)
-		{
-			// read hits the disk and will block. Progress should
-			// be updated in between reads
-			st->read(&buf[0], i, 0, t.piece_size(i));
-			if (st->error())
-			{
-				ec = st->error();
-				return;
-			}
-			hasher h(&buf[0], t.piece_size(i));
-			t.set_hash(i, h.final());
-			f(i);
-		}
+		set_piece_hashes(t, utf8, f, ec);
 	}
 #endif
 
 	void set_piece_hashes(create_torrent& t, std::string const& p
-		, boost::function<void(int)> f, error_code& ec)
+		, boost::function<void(int)> f, error_code& ec, int num_threads)
 	{
 		file_pool fp;
 #if TORRENT_USE_UNC_PATHS
@@ -210,25 +369,29 @@ namespace libtorrent
 			default_storage_constructor(const_cast<file_storage&>(t.files()), 0, path, fp
 			, std::vector<boost::uint8_t>()));
 
+		if (num_threads <= 0) num_threads = hardware_concurrency();
+
+		// two buffers per hashing thread keeps them busy while the
+		// calling thread is waiting for the oldest piece. The read-ahead
+		// is capped at 64 MiB
+		int num_slots = (std::min)(num_threads * 2
+			, (64 * 1024 * 1024) / t.piece_length());
+		num_slots = (std::max)(num_slots, 2);
+
 		// if we're calculating file hashes as well, use this hasher
 		hasher filehash;
 		int file_idx = 0;
 		size_type left_in_file = t.files().at(0).size;
 
-		// calculate the hash for all pieces
+		hash_pipeline pipeline(t, *st, num_threads, num_slots);
+
 		int num = t.num_pieces();
-		piece_holder buf(t.piece_length());
 		for (int i = 0; i < num; ++i)
 		{
-			// read hits the disk and will block. Progress should
-			// be updated in between reads
-			st->read(buf.bytes(), i, 0, t.piece_size(i));
-			if (st->error())
-			{
-				ec = st->error();
-				return;
-			}
-			
+			sha1_hash piece_hash;
+			char* buf = pipeline.wait_for(i, piece_hash, ec);
+			if (buf == 0) return;
+
 			if (t.should_add_file_hashes())
 			{
 				int left_in_piece = t.piece_size(i);
@@ -240,7 +403,7 @@ namespace libtorrent
 					if (to_hash_for_file > 0)
 					{
 						int offset = this_piece_size - left_in_piece;
-						filehash.update(buf.bytes() + offset, to_hash_for_file);
+						filehash.update(buf + offset, to_hash_for_file);
 					}
 					left_in_file -= to_hash_for_file;
 					left_in_piece -= to_hash_for_file;
@@ -256,8 +419,8 @@ namespace libtorrent
 				}
 			}
 
-			hasher h(buf.bytes(), t.piece_size(i));
-			t.set_hash(i, h.final());
+			pipeline.release();
+			t.set_hash(i, piece_hash);
 			f(i);
 		}
 	}
@@ -558,20 +721,29 @@ namespace libtorrent
 				m_merkle_tree[first_leaf + i] = filler;
 
 			// now that we have initialized all leaves, build
-			// each level bottom-up
+			// each level bottom-up. The large levels are split
+			// among threads, each hashing a range of the parents
+			int const num_threads = hardware_concurrency();
 			int level_start = first_leaf;
 			int level_size = num_leafs;
 			while (level_start > 0)
 			{
-				int parent = merkle_get_parent(level_start);
-				for (int i = level_start; i < level_start + level_size; i += 2, ++parent)
+				int const parent = merkle_get_parent(level_start);
+				int const num_parents = level_size / 2;
+				int const chunks = num_parents >= 16 * 1024 ? num_threads : 1;
+				std::vector<boost::shared_ptr<thread> > threads;
+				for (int i = 1; i < chunks; ++i)
 				{
-					hasher h;
-					h.update((char const*)&m_merkle_tree[i][0], 20);
-					h.update((char const*)&m_merkle_tree[i+1][0], 20);
-					m_merkle_tree[parent] = h.final();
+					threads.push_back(boost::shared_ptr<thread>(new thread(boost::bind(
+						&hash_merkle_nodes, &m_merkle_tree
+						, parent + int(size_type(num_parents) * i / chunks)
+						, parent + int(size_type(num_parents) * (i + 1) / chunks)))));
 				}
-				level_start = merkle_get_parent(level_start);
+				hash_merkle_nodes(&m_merkle_tree, parent, parent + num_parents / chunks);
+				for (int i = 0; i < int(threads.size()); ++i)
+					threads[i]->join();
+
+				level_start = parent;
 				level_size /= 2;
 			}
 			TORRENT_ASSERT(level_size == 1);
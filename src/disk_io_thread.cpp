@@ -69,11 +69,34 @@ namespace libtorrent
 	bool is_read_operation(disk_io_job const& j);
 	bool operation_has_buffer(disk_io_job const& j);
 
+	// returns the offset of the histogram (from disk_queue_time_read or
+	// disk_job_time_read) that the job type is accounted for under
+	int job_histogram_offset(disk_io_job const& j)
+	{
+		switch (j.action)
+		{
+			case disk_io_job::read:
+			case disk_io_job::read_and_hash:
+			case disk_io_job::cache_piece:
+				return 0;
+			case disk_io_job::write:
+				return 1;
+			case disk_io_job::hash:
+				return 2;
+			case disk_io_job::check_fastresume:
+			case disk_io_job::check_files:
+				return 3;
+			default:
+				return 4;
+		}
+	}
+
 // ------- disk_io_thread ------
 
 	disk_io_thread::disk_io_thread(io_service& ios
 		, boost::function<void()> const& queue_callback
 		, file_pool& fp
+		, counters& cnt
 		, int block_size)
 		: disk_buffer_pool(block_size)
 		, m_abort(false)
@@ -87,6 +110,7 @@ namespace libtorrent
 		, m_queue_callback(queue_callback)
 		, m_work(io_service::work(m_ios))
 		, m_file_pool(fp)
+		, m_counters(cnt)
 #if TORRENT_USE_ASSERTS
 		, m_magic(0x1337)
 #endif
@@ -694,6 +718,8 @@ namespace libtorrent
 		if (num_write_calls > 0)
 		{
 			m_write_time.add_sample(total_microseconds(done - write_start) / num_write_calls);
+			m_counters.add_latency_sample(counters::disk_write_time
+				, microsec(total_microseconds(done - write_start) / num_write_calls));
 			m_cache_stats.cumulative_write_time += total_milliseconds(done - write_start);
 		}
 		if (ret > 0)
@@ -1763,6 +1789,8 @@ namespace libtorrent
 			}
 
 			m_queue_time.add_sample(total_microseconds(now - j.start_time));
+			m_counters.add_latency_sample(counters::disk_queue_time_read
+				+ job_histogram_offset(j), now - j.start_time);
 
 			// if there's a buffer in this job, it will be freed
 			// when this holder is destructed, unless it has been
@@ -2083,6 +2111,8 @@ namespace libtorrent
 					{
 						ptime now = time_now_hires();
 						m_read_time.add_sample(total_microseconds(now - operation_start));
+						m_counters.add_latency_sample(counters::disk_read_time
+							, now - operation_start);
 						m_cache_stats.cumulative_read_time += total_milliseconds(now - operation_start);
 					}
 					TORRENT_ASSERT(j.buffer == read_holder.get());
@@ -2179,6 +2209,8 @@ namespace libtorrent
 							}
 							ptime done = time_now_hires();
 							m_write_time.add_sample(total_microseconds(done - start));
+							m_counters.add_latency_sample(counters::disk_write_time
+								, done - start);
 							m_cache_stats.cumulative_write_time += total_milliseconds(done - start);
 							// we successfully wrote the block. Ignore previous errors
 							j.storage->clear_error();
@@ -2271,6 +2303,8 @@ namespace libtorrent
 
 					ptime done = time_now_hires();
 					m_hash_time.add_sample(total_microseconds(done - hash_start));
+					m_counters.add_latency_sample(counters::disk_hash_time
+						, done - hash_start);
 					m_cache_stats.cumulative_hash_time += total_milliseconds(done - hash_start);
 					break;
 				}
@@ -2441,6 +2475,8 @@ namespace libtorrent
 
 						ptime done = time_now_hires();
 						m_hash_time.add_sample(total_microseconds(done - hash_start));
+						m_counters.add_latency_sample(counters::disk_hash_time
+							, done - hash_start);
 						m_cache_stats.cumulative_hash_time += total_milliseconds(done - hash_start);
 
 						TORRENT_TRY {
@@ -2514,6 +2550,8 @@ namespace libtorrent
 
 			ptime done = time_now_hires();
 			m_job_time.add_sample(total_microseconds(done - operation_start));
+			m_counters.add_latency_sample(counters::disk_job_time_read
+				+ job_histogram_offset(j), done - operation_start);
 			m_cache_stats.cumulative_job_time += total_milliseconds(done - operation_start);
 
 //			if (!j.callback) std::cerr << "DISK THREAD: no callback specified" << std::endl;
@@ -38,6 +38,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/socket.hpp"
 #include "libtorrent/connection_queue.hpp"
 #include "libtorrent/socket_type.hpp" // for async_shutdown
+#include "libtorrent/resolver.hpp"
 
 #if defined TORRENT_ASIO_DEBUGGING
 #include "libtorrent/debug.hpp"
@@ -88,6 +89,9 @@ http_connection::http_connection(io_service& ios, connection_queue& cc
 	, m_ssl(false)
 	, m_priority(0)
 	, m_abort(false)
+	, m_keep_alive(false)
+	, m_reused(false)
+	, m_host_resolver(0)
 {
 	TORRENT_ASSERT(!m_handler.empty());
 }
@@ -198,7 +202,10 @@ void http_connection::get(std::string const& url, time_duration timeout, int pri
 	if (!auth.empty())
 		APPEND_FMT1("Authorization: Basic %s\r\n", base64encode(auth).c_str());
 
-	APPEND_FMT("Connection: close\r\n\r\n");
+	if (m_keep_alive)
+		APPEND_FMT("Connection: keep-alive\r\n\r\n");
+	else
+		APPEND_FMT("Connection: close\r\n\r\n");
 
 	sendbuffer.assign(request);
 	m_url = url;
@@ -252,6 +259,12 @@ void http_connection::start(std::string const& hostname, std::string const& port
 	if (m_sock.is_open() && m_hostname == hostname && m_port == port
 		&& m_ssl == ssl && m_bind_addr == bind_addr)
 	{
+		// the server may have closed the connection while it was idle.
+		// If so, we'll find out when reading the response
+		m_reused = true;
+		m_last_receive = time_now_hires();
+		m_start_time = m_last_receive;
+		if (m_connect_handler) m_connect_handler(*this);
 #if defined TORRENT_ASIO_DEBUGGING
 		add_outstanding_async("http_connection::on_write");
 #endif
@@ -260,6 +273,7 @@ void http_connection::start(std::string const& hostname, std::string const& port
 	}
 	else
 	{
+		m_reused = false;
 		m_ssl = ssl;
 		m_bind_addr = bind_addr;
 		error_code ec;
@@ -375,9 +389,17 @@ void http_connection::start(std::string const& hostname, std::string const& port
 			add_outstanding_async("http_connection::on_resolve");
 #endif
 			m_endpoints.clear();
-			tcp::resolver::query query(hostname, port);
-			m_resolver.async_resolve(query, boost::bind(&http_connection::on_resolve
-				, me, _1, _2));
+			if (m_host_resolver)
+			{
+				m_host_resolver->async_resolve(hostname
+					, boost::bind(&http_connection::on_host_resolve, me, _1, _2));
+			}
+			else
+			{
+				tcp::resolver::query query(hostname, port);
+				m_resolver.async_resolve(query, boost::bind(&http_connection::on_resolve
+					, me, _1, _2));
+			}
 		}
 		m_hostname = hostname;
 		m_port = port;
@@ -443,6 +465,38 @@ void http_connection::on_timeout(boost::weak_ptr<http_connection> p
 	c->m_timer.async_wait(boost::bind(&http_connection::on_timeout, p, _1));
 }
 
+bool http_connection::can_reuse() const
+{
+	return m_keep_alive && !m_abort && m_sock.is_open()
+		&& m_bottled && m_parser.finished() && !m_parser.connection_close();
+}
+
+void http_connection::set_handlers(http_handler const& handler
+	, http_connect_handler const& ch, http_filter_handler const& fh)
+{
+	m_handler = handler;
+	m_connect_handler = ch;
+	m_filter_handler = fh;
+}
+
+void http_connection::reconnect()
+{
+	// the server closed the idle connection before it responded to our
+	// request. Send it again on a new connection. start() may modify these
+	std::string hostname = m_hostname;
+	std::string port = m_port;
+	proxy_settings ps = m_proxy;
+
+	error_code ec;
+	m_sock.close(ec);
+	start(hostname, port, m_completion_timeout, m_priority, &ps, m_ssl
+		, m_redirects, m_bind_addr
+#if TORRENT_USE_I2P
+		, m_i2p_conn
+#endif
+		);
+}
+
 void http_connection::close(bool force)
 {
 	if (m_abort) return;
@@ -516,6 +570,37 @@ void http_connection::on_resolve(error_code const& e
 	std::transform(i, tcp::resolver::iterator(), std::back_inserter(m_endpoints)
 		, boost::bind(&tcp::resolver::iterator::value_type::endpoint, _1));
 
+	connect_endpoints();
+}
+
+void http_connection::on_host_resolve(error_code const& e
+	, std::vector<address> const& addresses)
+{
+#if defined TORRENT_ASIO_DEBUGGING
+	complete_async("http_connection::on_resolve");
+#endif
+	// the shared resolver can't be cancelled by close()
+	if (m_abort) return;
+
+	if (e || addresses.empty())
+	{
+		boost::shared_ptr<http_connection> me(shared_from_this());
+
+		callback(e ? e : error_code(asio::error::host_not_found));
+		close();
+		return;
+	}
+
+	int port = atoi(m_port.c_str());
+	for (std::vector<address>::const_iterator i = addresses.begin()
+		, end(addresses.end()); i != end; ++i)
+		m_endpoints.push_back(tcp::endpoint(*i, port));
+
+	connect_endpoints();
+}
+
+void http_connection::connect_endpoints()
+{
 	if (m_filter_handler) m_filter_handler(*this, m_endpoints);
 	if (m_endpoints.empty())
 	{
@@ -667,6 +752,11 @@ void http_connection::on_write(error_code const& e)
 	if (e)
 	{
 		boost::shared_ptr<http_connection> me(shared_from_this());
+		if (m_reused && !m_abort)
+		{
+			reconnect();
+			return;
+		}
 		callback(e);
 		close();
 		return;
@@ -674,7 +764,9 @@ void http_connection::on_write(error_code const& e)
 
 	if (m_abort) return;
 
-	std::string().swap(sendbuffer);
+	// on a reused connection, hold on to the request until the response
+	// starts arriving, in case we need to send it again
+	if (!m_reused) std::string().swap(sendbuffer);
 	m_recvbuffer.resize(4096);
 
 	int amount_to_read = m_recvbuffer.size() - m_read_pos;
@@ -723,6 +815,13 @@ void http_connection::on_read(error_code const& e
 	// deletes this object
 	boost::shared_ptr<http_connection> me(shared_from_this());
 
+	// the server closed the idle connection we sent the request on
+	if (e && m_reused && m_read_pos == 0)
+	{
+		reconnect();
+		return;
+	}
+
 	// when using the asio SSL wrapper, it seems like
 	// we get the shut_down error instead of EOF
 	if (e == asio::error::eof || e == asio::error::shut_down)
@@ -752,6 +851,12 @@ void http_connection::on_read(error_code const& e
 	m_read_pos += bytes_transferred;
 	TORRENT_ASSERT(m_read_pos <= int(m_recvbuffer.size()));
 
+	if (m_reused)
+	{
+		m_reused = false;
+		std::string().swap(sendbuffer);
+	}
+
 	if (m_bottled || !m_parser.header_finished())
 	{
 		libtorrent::buffer::const_interval rcv_buf(&m_recvbuffer[0]
@@ -841,6 +946,10 @@ void http_connection::on_read(error_code const& e
 			error_code ec;
 			m_timer.cancel(ec);
 			callback(e, m_parser.get_body().begin, m_parser.get_body().left());
+
+			// leave a keep-alive connection idle, without a read
+			// outstanding. The next request resets the receive buffer
+			if (m_keep_alive && !m_parser.connection_close()) return;
 		}
 	}
 	else
@@ -35,6 +35,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <cctype>
 #include <algorithm>
 #include <stdlib.h>
+#include <string.h>
 
 #include "libtorrent/config.hpp"
 #include "libtorrent/http_parser.hpp"
@@ -60,6 +61,53 @@ namespace libtorrent
 			&& http_status < 400;
 	}
 
+	namespace
+	{
+		// maps a lower case header name to its known_header_t, or -1 if
+		// it isn't one of the known headers. No two known headers have the
+		// same length, so this is a single comparison
+		int known_header_index(char const* name, int len)
+		{
+			char const* known;
+			int ret;
+			switch (len)
+			{
+				case 6: known = "server"; ret = http_parser::server_header; break;
+				case 8: known = "location"; ret = http_parser::location_header; break;
+				case 10: known = "connection"; ret = http_parser::connection_header; break;
+				case 11: known = "retry-after"; ret = http_parser::retry_after_header; break;
+				case 12: known = "content-type"; ret = http_parser::content_type_header; break;
+				case 13: known = "content-range"; ret = http_parser::content_range_header; break;
+				case 14: known = "content-length"; ret = http_parser::content_length_header; break;
+				case 16: known = "content-encoding"; ret = http_parser::content_encoding_header; break;
+				case 17: known = "transfer-encoding"; ret = http_parser::transfer_encoding_header; break;
+				default: return -1;
+			}
+			return memcmp(name, known, len) == 0 ? ret : -1;
+		}
+
+		// like read_until(), but returns the token as a range of the
+		// input instead of copying it
+		buffer::const_interval next_token(char const*& str, char delim, char const* end)
+		{
+			TORRENT_ASSERT(str <= end);
+			char const* start = str;
+			while (str != end && *str != delim) ++str;
+			buffer::const_interval ret(start, str);
+			// skip the delimiter as well
+			while (str != end && *str == delim) ++str;
+			return ret;
+		}
+
+		int parse_status_code(buffer::const_interval s)
+		{
+			int ret = 0;
+			for (char const* i = s.begin; i != s.end && *i >= '0' && *i <= '9'; ++i)
+				ret = ret * 10 + *i - '0';
+			return ret;
+		}
+	}
+
 	http_parser::~http_parser() {}
 
 	http_parser::http_parser(int flags)
@@ -78,7 +126,108 @@ namespace libtorrent
 		, m_chunk_header_size(0)
 		, m_partial_chunk_header(0)
 		, m_flags(flags)
-	{}
+	{
+		span const empty = { 0, 0 };
+		m_method = m_path = m_protocol = m_server_message = empty;
+		std::fill(m_known_headers, m_known_headers + num_known_headers, -1);
+	}
+
+	http_parser::span http_parser::store(char const* begin, char const* end
+		, bool lower_case)
+	{
+		span ret;
+		ret.start = int(m_header_buf.size());
+		ret.len = int(end - begin);
+		m_header_buf.insert(m_header_buf.end(), begin, end);
+		if (lower_case)
+		{
+			std::transform(m_header_buf.begin() + ret.start, m_header_buf.end()
+				, m_header_buf.begin() + ret.start, &to_lower);
+		}
+		m_header_buf.push_back('\0');
+		return ret;
+	}
+
+	// returns false if the line doesn't contain a header, i.e. it's the
+	// blank line terminating the headers
+	bool http_parser::add_header(char const* line, char const* line_end)
+	{
+		char const* separator = std::find(line, line_end, ':');
+		if (separator == line_end) return false;
+
+		header_entry h;
+		h.name = store(line, separator, true);
+		++separator;
+		// skip whitespace
+		while (separator < line_end
+			&& (*separator == ' ' || *separator == '\t'))
+			++separator;
+		h.value = store(separator, line_end, false);
+		m_headers.push_back(h);
+		return true;
+	}
+
+	// makes the header at index i available to constant time lookups,
+	// unless an earlier header has the same name. Returns which known
+	// header it is, or -1
+	int http_parser::index_header(int i)
+	{
+		header_entry const& h = m_headers[i];
+		int const known = known_header_index(&m_header_buf[h.name.start], h.name.len);
+		if (known >= 0 && m_known_headers[known] == -1)
+			m_known_headers[known] = i;
+		return known;
+	}
+
+	int http_parser::find_header(char const* key) const
+	{
+		int const len = int(strlen(key));
+		int const known = known_header_index(key, len);
+		if (known >= 0) return m_known_headers[known];
+
+		for (int i = 0; i < int(m_headers.size()); ++i)
+		{
+			header_entry const& h = m_headers[i];
+			if (h.name.len == len
+				&& memcmp(&m_header_buf[h.name.start], key, len) == 0)
+				return i;
+		}
+		return -1;
+	}
+
+	buffer::const_interval http_parser::header_value(char const* key) const
+	{
+		int const i = find_header(key);
+		if (i == -1) return buffer::const_interval("", "");
+		char const* value = &m_header_buf[m_headers[i].value.start];
+		return buffer::const_interval(value, value + m_headers[i].value.len);
+	}
+
+	buffer::const_interval http_parser::header_value(known_header_t h) const
+	{
+		TORRENT_ASSERT(h >= 0 && h < num_known_headers);
+		int const i = m_known_headers[h];
+		if (i == -1) return buffer::const_interval("", "");
+		char const* value = &m_header_buf[m_headers[i].value.start];
+		return buffer::const_interval(value, value + m_headers[i].value.len);
+	}
+
+	std::string http_parser::header(char const* key) const
+	{
+		buffer::const_interval v = header_value(key);
+		return std::string(v.begin, v.end);
+	}
+
+	std::multimap<std::string, std::string> http_parser::headers() const
+	{
+		std::multimap<std::string, std::string> ret;
+		for (std::vector<header_entry>::const_iterator i = m_headers.begin()
+			, end(m_headers.end()); i != end; ++i)
+		{
+			ret.insert(std::make_pair(span_string(i->name), span_string(i->value)));
+		}
+		return ret;
+	}
 
 	boost::tuple<int, int> http_parser::incoming(
 		buffer::const_interval recv_buffer, bool& error)
@@ -129,25 +278,28 @@ restart_response:
 			boost::get<1>(ret) += newline - (m_recv_buffer.begin + start_pos);
 			pos = newline;
 
-			m_protocol = read_until(line, ' ', line_end);
-			if (m_protocol.substr(0, 5) == "HTTP/")
+			buffer::const_interval protocol = next_token(line, ' ', line_end);
+			if (protocol.left() >= 5 && memcmp(protocol.begin, "HTTP/", 5) == 0)
 			{
-				m_status_code = atoi(read_until(line, ' ', line_end).c_str());
-				m_server_message = read_until(line, '\r', line_end);
+				m_protocol = store(protocol.begin, protocol.end, false);
+				m_status_code = parse_status_code(next_token(line, ' ', line_end));
+				buffer::const_interval message = next_token(line, '\r', line_end);
+				m_server_message = store(message.begin, message.end, false);
 
 				// HTTP 1.0 always closes the connection after
 				// each request
-				if (m_protocol == "HTTP/1.0") m_connection_close = true;
+				if (protocol.left() == 8 && memcmp(protocol.begin, "HTTP/1.0", 8) == 0)
+					m_connection_close = true;
 			}
 			else
 			{
-				m_method = m_protocol;
-				std::transform(m_method.begin(), m_method.end(), m_method.begin(), &to_lower);
+				m_method = store(protocol.begin, protocol.end, true);
 				// the content length is assumed to be 0 for requests
 				m_content_length = 0;
-				m_protocol.clear();
-				m_path = read_until(line, ' ', line_end);
-				m_protocol = read_until(line, ' ', line_end);
+				buffer::const_interval path = next_token(line, ' ', line_end);
+				m_path = store(path.begin, path.end, false);
+				protocol = next_token(line, ' ', line_end);
+				m_protocol = store(protocol.begin, protocol.end, false);
 				m_status_code = 0;
 			}
 			m_state = read_header;
@@ -158,21 +310,19 @@ restart_response:
 		{
 			TORRENT_ASSERT(!m_finished);
 			char const* newline = std::find(pos, recv_buffer.end, '\n');
-			std::string line;
 
 			while (newline != recv_buffer.end && m_state == read_header)
 			{
 				// if the LF character is preceeded by a CR
-				// charachter, don't copy it into the line string.
+				// charachter, don't include it in the line
 				char const* line_end = newline;
 				if (pos != line_end && *(line_end - 1) == '\r') --line_end;
-				line.assign(pos, line_end);
+				char const* line = pos;
 				++newline;
 				m_recv_pos += newline - pos;
 				pos = newline;
 
-				std::string::size_type separator = line.find(':');
-				if (separator == std::string::npos)
+				if (!add_header(line, line_end))
 				{
 					if (m_status_code == 100)
 					{
@@ -194,57 +344,53 @@ restart_response:
 					break;
 				}
 
-				std::string name = line.substr(0, separator);
-				std::transform(name.begin(), name.end(), name.begin(), &to_lower);
-				++separator;
-				// skip whitespace
-				while (separator < line.size()
-					&& (line[separator] == ' ' || line[separator] == '\t'))
-					++separator;
-				std::string value = line.substr(separator, std::string::npos);
-				m_header.insert(std::make_pair(name, value));
-
-				if (name == "content-length")
-				{
-					m_content_length = strtoll(value.c_str(), 0, 10);
-				}
-				else if (name == "connection")
-				{
-					m_connection_close = string_begins_no_case("close", value.c_str());
-				}
-				else if (name == "content-range")
+				// the value is null terminated in m_header_buf
+				char const* value = &m_header_buf[m_headers.back().value.start];
+
+				switch (index_header(int(m_headers.size()) - 1))
 				{
-					bool success = true;
-					char const* ptr = value.c_str();
-
-					// apparently some web servers do not send the "bytes"
-					// in their content-range. Don't treat it as an error
-					// if we can't find it, just assume the byte counters
-					// start immediately
-					if (string_begins_no_case("bytes ", ptr)) ptr += 6;
-					char* end;
-					m_range_start = strtoll(ptr, &end, 10);
-					if (end == ptr) success = false;
-					else if (*end != '-') success = false;
-					else
+					case content_length_header:
+						m_content_length = strtoll(value, 0, 10);
+						break;
+					case connection_header:
+						m_connection_close = string_begins_no_case("close", value);
+						break;
+					case content_range_header:
 					{
-						ptr = end + 1;
-						m_range_end = strtoll(ptr, &end, 10);
+						bool success = true;
+						char const* ptr = value;
+
+						// apparently some web servers do not send the "bytes"
+						// in their content-range. Don't treat it as an error
+						// if we can't find it, just assume the byte counters
+						// start immediately
+						if (string_begins_no_case("bytes ", ptr)) ptr += 6;
+						char* end;
+						m_range_start = strtoll(ptr, &end, 10);
 						if (end == ptr) success = false;
-					}
+						else if (*end != '-') success = false;
+						else
+						{
+							ptr = end + 1;
+							m_range_end = strtoll(ptr, &end, 10);
+							if (end == ptr) success = false;
+						}
 
-					if (!success || m_range_end < m_range_start)
-					{
-						m_state = error_state;
-						error = true;
-						return ret;
+						if (!success || m_range_end < m_range_start)
+						{
+							m_state = error_state;
+							error = true;
+							return ret;
+						}
+						// the http range is inclusive
+						m_content_length = m_range_end - m_range_start + 1;
+						break;
 					}
-					// the http range is inclusive
-					m_content_length = m_range_end - m_range_start + 1;
-				}
-				else if (name == "transfer-encoding")
-				{
-					m_chunked_encoding = string_begins_no_case("chunked", value.c_str());
+					case transfer_encoding_header:
+						m_chunked_encoding = string_begins_no_case("chunked", value);
+						break;
+					default:
+						break;
 				}
 
 				TORRENT_ASSERT(m_recv_pos <= recv_buffer.left());
@@ -380,23 +526,22 @@ restart_response:
 		}
 
 		// this is the terminator of the stream. Also read headers
-		std::map<std::string, std::string> tail_headers;
+		int const num_headers = int(m_headers.size());
+		int const header_buf_size = int(m_header_buf.size());
 		pos = newline;
 		newline = std::find(pos, buf.end, '\n');
 
-		std::string line;
 		while (newline != buf.end)
 		{
 			// if the LF character is preceeded by a CR
-			// charachter, don't copy it into the line string.
+			// charachter, don't include it in the line
 			char const* line_end = newline;
 			if (pos != line_end && *(line_end - 1) == '\r') --line_end;
-			line.assign(pos, line_end);
+			char const* line = pos;
 			++newline;
 			pos = newline;
 
-			std::string::size_type separator = line.find(':');
-			if (separator == std::string::npos)
+			if (!add_header(line, line_end))
 			{
 				// this means we got a blank line,
 				// the header is finished and the body
@@ -407,27 +552,20 @@ restart_response:
 				TORRENT_ASSERT(newline - buf.begin > 2);
 
 				// we were successfull in parsing the headers.
-				// add them to the headers in the parser
-				for (std::map<std::string, std::string>::const_iterator i = tail_headers.begin();
-					i != tail_headers.end(); ++i)
-					m_header.insert(std::make_pair(i->first, i->second));
+				// make them available to lookups
+				for (int i = num_headers; i < int(m_headers.size()); ++i)
+					index_header(i);
 
 				return true;
 			}
 
-			std::string name = line.substr(0, separator);
-			std::transform(name.begin(), name.end(), name.begin(), &to_lower);
-			++separator;
-			// skip whitespace
-			while (separator < line.size()
-				&& (line[separator] == ' ' || line[separator] == '\t'))
-				++separator;
-			std::string value = line.substr(separator, std::string::npos);
-			tail_headers.insert(std::make_pair(name, value));
-//			fprintf(stderr, "tail_header: %s: %s\n", name.c_str(), value.c_str());
-
 			newline = std::find(pos, buf.end, '\n');
 		}
+
+		// the tail headers are incomplete. Drop the ones we stored, they
+		// are parsed again once the rest of them has been received
+		m_headers.resize(num_headers);
+		m_header_buf.resize(header_buf_size);
 		return false;
 	}
 
@@ -446,7 +584,8 @@ restart_response:
 	
 	void http_parser::reset()
 	{
-		m_method.clear();
+		span const empty = { 0, 0 };
+		m_method = m_path = m_protocol = m_server_message = empty;
 		m_recv_pos = 0;
 		m_body_start_pos = 0;
 		m_status_code = -1;
@@ -457,7 +596,10 @@ restart_response:
 		m_state = read_status;
 		m_recv_buffer.begin = 0;
 		m_recv_buffer.end = 0;
-		m_header.clear();
+		// clear() keeps the capacity of the buffers, for the next response
+		m_header_buf.clear();
+		m_headers.clear();
+		std::fill(m_known_headers, m_known_headers + num_known_headers, -1);
 		m_chunked_encoding = false;
 		m_chunked_ranges.clear();
 		m_cur_chunk_end = -1;
@@ -59,8 +59,9 @@ namespace libtorrent
 		, boost::weak_ptr<torrent> t
 		, boost::shared_ptr<socket_type> s
 		, tcp::endpoint const& remote
-		, web_seed_entry& web)
-		: web_connection_base(ses, t, s, remote, web)
+		, web_seed_entry& web
+		, policy::peer* peerinfo)
+		: web_connection_base(ses, t, s, remote, web, peerinfo)
 		, m_url(web.url)
 		, m_response_left(0)
 		, m_chunk_pos(0)
@@ -268,10 +269,14 @@ namespace libtorrent
 				// if the status code is not one of the accepted ones, abort
 				if (!is_ok_status(m_parser.status_code()))
 				{
-					int retry_time = atoi(m_parser.header("retry-after").c_str());
+					int retry_time = atoi(m_parser.header_value(http_parser::retry_after_header).begin);
 					if (retry_time <= 0) retry_time = 5 * 60;
 					// temporarily unavailable, retry later
 					t->retry_web_seed(this, retry_time);
+					// the server may be rejecting us for opening too
+					// many connections
+					if (m_parser.status_code() == 429 || m_parser.status_code() == 503)
+						t->throttle_web_seed(this);
 
 					std::string error_msg = to_string(m_parser.status_code()).elems
 						+ (" " + m_parser.message());
@@ -317,17 +322,17 @@ namespace libtorrent
 					return;
 				}
 
-				std::string const& server_version = m_parser.header("server");
-				if (!server_version.empty())
+				buffer::const_interval server_version = m_parser.header_value(http_parser::server_header);
+				if (server_version.left() > 0)
 				{
 					m_server_string = "URL seed @ ";
 					m_server_string += m_host;
 					m_server_string += " (";
-					m_server_string += server_version;
+					m_server_string.append(server_version.begin, server_version.end);
 					m_server_string += ")";
 				}
 
-				m_response_left = atol(m_parser.header("content-length").c_str());
+				m_response_left = atol(m_parser.header_value(http_parser::content_length_header).begin);
 				if (m_response_left == -1)
 				{
 					m_statistics.received_bytes(0, bytes_transferred);
@@ -418,6 +423,7 @@ namespace libtorrent
 				m_statistics.received_bytes(0, bytes_transferred);
 				// temporarily unavailable, retry later
 				t->retry_web_seed(this, retry_time);
+				t->throttle_web_seed(this);
 				disconnect(error_code(m_parser.status_code(), get_http_category()), 1);
 				return;
 			}
@@ -60,6 +60,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/socket.hpp"
 #include "libtorrent/aux_/session_impl.hpp"
 #include "libtorrent/broadcast_socket.hpp" // for is_local
+#include "libtorrent/parse_url.hpp"
+#include "libtorrent/escape_string.hpp" // for to_string
 
 using namespace libtorrent;
 
@@ -208,15 +210,50 @@ namespace libtorrent
 			}
 		}
 
-		m_tracker_connection.reset(new http_connection(m_ios, m_cc
-			, boost::bind(&http_tracker_connection::on_response, self(), _1, _2, _3, _4)
-			, true, settings.max_http_recv_buffer_size
-			, boost::bind(&http_tracker_connection::on_connect, self(), _1)
-			, boost::bind(&http_tracker_connection::on_filter, self(), _1, _2)
+		// SSL torrents verify the tracker with their own certificate, so
+		// their connections can't be shared with other torrents
+		bool pooled = settings.tracker_keepalive_connections > 0 && !i2p;
 #ifdef TORRENT_USE_OPENSSL
-			, tracker_req().ssl_ctx
+		if (tracker_req().ssl_ctx) pooled = false;
 #endif
-			));
+		if (pooled)
+		{
+			std::string protocol;
+			std::string hostname;
+			int port;
+			error_code ec;
+			using boost::tuples::ignore;
+			boost::tie(protocol, ignore, hostname, port, ignore)
+				= parse_url_components(url, ec);
+			if (!ec)
+			{
+				m_pool_key = protocol + "://" + hostname + ":"
+					+ to_string(port).elems + "/" + print_address(bind_interface());
+				m_tracker_connection = m_man.get_http_connection(m_pool_key);
+			}
+		}
+
+		if (m_tracker_connection)
+		{
+			m_tracker_connection->set_handlers(
+				boost::bind(&http_tracker_connection::on_response, self(), _1, _2, _3, _4)
+				, boost::bind(&http_tracker_connection::on_connect, self(), _1)
+				, boost::bind(&http_tracker_connection::on_filter, self(), _1, _2));
+		}
+		else
+		{
+			m_tracker_connection.reset(new http_connection(m_ios, m_cc
+				, boost::bind(&http_tracker_connection::on_response, self(), _1, _2, _3, _4)
+				, true, settings.max_http_recv_buffer_size
+				, boost::bind(&http_tracker_connection::on_connect, self(), _1)
+				, boost::bind(&http_tracker_connection::on_filter, self(), _1, _2)
+#ifdef TORRENT_USE_OPENSSL
+				, tracker_req().ssl_ctx
+#endif
+				));
+			m_tracker_connection->keep_alive(!m_pool_key.empty());
+			m_tracker_connection->set_resolver(&m_man.host_resolver());
+		}
 
 		int timeout = tracker_req().event==tracker_request::stopped
 			?settings.stop_tracker_timeout
@@ -248,7 +285,12 @@ namespace libtorrent
 	{
 		if (m_tracker_connection)
 		{
-			m_tracker_connection->close();
+			// if the tracker kept the connection open, the next request to
+			// it can use it instead of connecting again
+			if (!m_pool_key.empty() && m_tracker_connection->can_reuse())
+				m_man.return_http_connection(m_pool_key, m_tracker_connection);
+			else
+				m_tracker_connection->close();
 			m_tracker_connection.reset();
 		}
 		tracker_connection::close();
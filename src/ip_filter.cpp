@@ -68,6 +68,39 @@ namespace libtorrent
 #endif
 	}
 
+	void ip_filter::access(std::vector<address> const& addrs
+		, std::vector<int>& flags) const
+	{
+		flags.resize(addrs.size());
+		int hint4 = 0;
+#if TORRENT_USE_IPV6
+		int hint6 = 0;
+#endif
+		for (int i = 0; i < int(addrs.size()); ++i)
+		{
+			address const& a = addrs[i];
+			if (a.is_v4())
+			{
+				flags[i] = m_filter4.access(a.to_v4().to_bytes(), hint4);
+				continue;
+			}
+#if TORRENT_USE_IPV6
+			TORRENT_ASSERT(a.is_v6());
+			flags[i] = m_filter6.access(a.to_v6().to_bytes(), hint6);
+#else
+			flags[i] = 0;
+#endif
+		}
+	}
+
+	void ip_filter::commit()
+	{
+		m_filter4.commit();
+#if TORRENT_USE_IPV6
+		m_filter6.commit();
+#endif
+	}
+
 	ip_filter::filter_tuple_t ip_filter::export_filter() const
 	{
 #if TORRENT_USE_IPV6
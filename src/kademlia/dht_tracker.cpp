@@ -46,6 +46,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/kademlia/traversal_algorithm.hpp"
 #include "libtorrent/kademlia/dht_tracker.hpp"
 #include "libtorrent/kademlia/msg.hpp"
+#include "libtorrent/kademlia/item.hpp"
 
 #include "libtorrent/aux_/session_impl.hpp"
 #include "libtorrent/socket.hpp"
@@ -194,6 +195,13 @@ namespace libtorrent { namespace dht
 		, m_received_bytes(0)
 		, m_refs(0)
 	{
+		for (int i = 1; i < m_settings.num_instances; ++i)
+		{
+			m_extra_nodes.push_back(boost::shared_ptr<node_impl>(new node_impl(
+				&ses, this, settings, extract_extra_node_id(state, i - 1)
+				, ses.external_address().external_address(address_v4()), &ses)));
+		}
+
 #ifdef TORRENT_DHT_VERBOSE_LOGGING
 		m_counter = 0;
 		std::fill_n(m_replies_bytes_sent, 5, 0);
@@ -247,6 +255,10 @@ namespace libtorrent { namespace dht
 		m_refresh_timer.expires_from_now(seconds(5), ec);
 		m_refresh_timer.async_wait(boost::bind(&dht_tracker::refresh_timeout, self(), _1));
 		m_dht.bootstrap(initial_nodes, f);
+
+		for (std::vector<boost::shared_ptr<node_impl> >::iterator i = m_extra_nodes.begin()
+			, end(m_extra_nodes.end()); i != end; ++i)
+			(*i)->bootstrap(initial_nodes, boost::bind(&nop));
 	}
 
 	void dht_tracker::stop()
@@ -262,6 +274,7 @@ namespace libtorrent { namespace dht
 	void dht_tracker::dht_status(session_status& s)
 	{
 		m_dht.status(s);
+		add_extra_node_status(s, m_extra_nodes);
 	}
 
 	void dht_tracker::network_stats(int& sent, int& received)
@@ -277,6 +290,9 @@ namespace libtorrent { namespace dht
 		if (e || m_abort) return;
 
 		time_duration d = m_dht.connection_timeout();
+		for (std::vector<boost::shared_ptr<node_impl> >::iterator i = m_extra_nodes.begin()
+			, end(m_extra_nodes.end()); i != end; ++i)
+			d = (std::min)(d, (*i)->connection_timeout());
 		error_code ec;
 		m_connection_timer.expires_from_now(d, ec);
 		m_connection_timer.async_wait(boost::bind(&dht_tracker::connection_timeout, self(), _1));
@@ -287,6 +303,9 @@ namespace libtorrent { namespace dht
 		if (e || m_abort) return;
 
 		m_dht.tick();
+		for (std::vector<boost::shared_ptr<node_impl> >::iterator i = m_extra_nodes.begin()
+			, end(m_extra_nodes.end()); i != end; ++i)
+			(*i)->tick();
 		error_code ec;
 		m_refresh_timer.expires_from_now(seconds(5), ec);
 		m_refresh_timer.async_wait(
@@ -306,6 +325,9 @@ namespace libtorrent { namespace dht
 		{
 			m_last_new_key = now;
 			m_dht.new_write_key();
+			for (std::vector<boost::shared_ptr<node_impl> >::iterator i = m_extra_nodes.begin()
+				, end(m_extra_nodes.end()); i != end; ++i)
+				(*i)->new_write_key();
 #ifdef TORRENT_DHT_VERBOSE_LOGGING
 			TORRENT_LOG(dht_tracker) << " *** new write key";
 #endif
@@ -490,6 +512,9 @@ namespace libtorrent { namespace dht
 				)
 			{
 				m_dht.unreachable(ep);
+				for (std::vector<boost::shared_ptr<node_impl> >::iterator i = m_extra_nodes.begin()
+					, end(m_extra_nodes.end()); i != end; ++i)
+					(*i)->unreachable(ep);
 			}
 			return false;
 		}
@@ -573,7 +598,7 @@ namespace libtorrent { namespace dht
 		lazy_entry e;
 		int pos;
 		error_code err;
-		int ret = lazy_bdecode(buf, buf + size, e, err, &pos, 10, 500);
+		int ret = lazy_bdecode(buf, buf + size, e, m_arena, err, &pos, 10, 500);
 		if (ret != 0)
 		{
 #ifdef TORRENT_DHT_VERBOSE_LOGGING
@@ -619,7 +644,7 @@ namespace libtorrent { namespace dht
 		}
 #endif
 
-		m_dht.incoming(m);
+		node_for(m, m_dht, m_extra_nodes).incoming(m);
 		return true;
 	}
 
@@ -653,12 +678,17 @@ namespace libtorrent { namespace dht
 		}
 
 		ret["node-id"] = m_dht.nid().to_string();
+
+		save_extra_node_ids(ret, m_extra_nodes);
 		return ret;
 	}
 
 	void dht_tracker::add_node(udp::endpoint node)
 	{
 		m_dht.add_node(node);
+		for (std::vector<boost::shared_ptr<node_impl> >::iterator i = m_extra_nodes.begin()
+			, end(m_extra_nodes.end()); i != end; ++i)
+			(*i)->add_node(node);
 	}
 
 	void dht_tracker::add_node(std::pair<std::string, int> const& node)
@@ -680,6 +710,9 @@ namespace libtorrent { namespace dht
 	void dht_tracker::add_router_node(udp::endpoint const& node)
 	{
 		m_dht.add_router_node(node);
+		for (std::vector<boost::shared_ptr<node_impl> >::iterator i = m_extra_nodes.begin()
+			, end(m_extra_nodes.end()); i != end; ++i)
+			(*i)->add_router_node(node);
 	}
 
 	bool dht_tracker::send_packet(libtorrent::entry& e, udp::endpoint const& addr, int send_flags)
@@ -687,23 +720,27 @@ namespace libtorrent { namespace dht
 		using libtorrent::bencode;
 		using libtorrent::entry;
 
-		static char const version_str[] = {'L', 'T'
-			, LIBTORRENT_VERSION_MAJOR, LIBTORRENT_VERSION_MINOR};
-		e["v"] = std::string(version_str, version_str + 4);
+		e["v"] = std::string(dht_client_version, dht_client_version + 4);
 
 		m_send_buf.clear();
 		bencode(std::back_inserter(m_send_buf), e);
+		return send_packet(&m_send_buf[0], int(m_send_buf.size()), addr, send_flags);
+	}
+
+	bool dht_tracker::send_packet(char const* buf, int size
+		, udp::endpoint const& addr, int send_flags)
+	{
 		error_code ec;
 
 #ifdef TORRENT_DHT_VERBOSE_LOGGING
 		std::stringstream log_line;
 		lazy_entry print;
-		int ret = lazy_bdecode(&m_send_buf[0], &m_send_buf[0] + m_send_buf.size(), print, ec);
+		int ret = lazy_bdecode(buf, buf + size, print, ec);
 		TORRENT_ASSERT(ret == 0);
 		log_line << print_entry(print, true);
 #endif
 
-		if (m_sock.send(addr, &m_send_buf[0], (int)m_send_buf.size(), ec, send_flags))
+		if (m_sock.send(addr, buf, size, ec, send_flags))
 		{
 			if (ec)
 			{
@@ -714,32 +751,14 @@ namespace libtorrent { namespace dht
 			}
 
 			// account for IP and UDP overhead
-			m_sent_bytes += m_send_buf.size() + (addr.address().is_v6() ? 48 : 28);
+			m_sent_bytes += size + (addr.address().is_v6() ? 48 : 28);
 
 #ifdef TORRENT_DHT_VERBOSE_LOGGING
-			m_total_out_bytes += m_send_buf.size();
+			m_total_out_bytes += size;
 		
-			if (e["y"].string() == "r")
-			{
-/*
-				// This doesn't work. r is a dictionary with return
-				// values. The query type isn't part of the response
-				std::string cmd = e["r"].string();
-				int cmd_idx = -1;
-				if (cmd == "ping") cmd_idx = 0;
-				else if (cmd == "find_node") cmd_idx = 1;
-				else if (cmd == "get_peers") cmd_idx = 2;
-				else if (cmd == "announce_peeer") cmd_idx = 3;
-				if (cmd_idx >= 0)
-				{
-					++m_replies_sent[cmd_idx];
-					m_replies_bytes_sent[cmd_idx] += int(m_send_buf.size());
-				}
-*/
-			}
-			else if (e["y"].string() == "q")
+			if (print.dict_find_string_value("y") == "q")
 			{
-				m_queries_out_bytes += m_send_buf.size();
+				m_queries_out_bytes += size;
 			}
 			TORRENT_LOG(dht_tracker) << "==> " << addr << " " << log_line.str();
 #endif
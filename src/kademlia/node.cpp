@@ -38,6 +38,8 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/io.hpp"
 #include "libtorrent/bencode.hpp"
+#include "libtorrent/bencode_writer.hpp"
+#include "libtorrent/version.hpp"
 #include "libtorrent/hasher.hpp"
 #include "libtorrent/alert_types.hpp"
 #include "libtorrent/alert.hpp"
@@ -65,6 +67,9 @@ void incoming_error(entry& e, char const* msg, int error_code = 203);
 
 using detail::write_endpoint;
 
+char const dht_client_version[4] = {'L', 'T'
+	, LIBTORRENT_VERSION_MAJOR, LIBTORRENT_VERSION_MINOR};
+
 // TODO: 2 make this configurable in dht_settings
 enum { announce_interval = 30 };
 
@@ -76,23 +81,34 @@ extern int g_announces;
 
 #endif
 
-// remove peers that have timed out
-void purge_peers(std::set<peer_entry>& peers)
+// remove peers that have timed out. Returns the number of
+// peers that were removed
+int purge_peers(std::vector<peer_entry>& peers)
 {
-	for (std::set<peer_entry>::iterator i = peers.begin()
-		  , end(peers.end()); i != end;)
+	ptime cutoff = time_now() - minutes(int(announce_interval * 1.5f));
+	std::vector<peer_entry>::iterator out = peers.begin();
+	for (std::vector<peer_entry>::iterator i = peers.begin()
+		, end(peers.end()); i != end; ++i)
 	{
 		// the peer has timed out
-		if (i->added + minutes(int(announce_interval * 1.5f)) < time_now())
+		if (i->added < cutoff)
 		{
 #ifdef TORRENT_DHT_VERBOSE_LOGGING
 			TORRENT_LOG(node) << "peer timed out at: " << i->addr;
 #endif
-			peers.erase(i++);
+			continue;
 		}
-		else
-			++i;
+		if (out != i) *out = *i;
+		++out;
 	}
+	int removed = peers.end() - out;
+	peers.erase(out, peers.end());
+	return removed;
+}
+
+bool added_before(peer_entry const& lhs, peer_entry const& rhs)
+{
+	return lhs.added < rhs.added;
 }
 
 void nop() {}
@@ -106,6 +122,8 @@ node_impl::node_impl(alert_dispatcher* alert_disp
 	, m_table(m_id, 8, settings)
 	, m_rpc(m_id, m_table, sock)
 	, m_observer(observer)
+	, m_num_peers(0)
+	, m_item_bytes(0)
 	, m_last_tracker_tick(time_now())
 	, m_post_alert(alert_disp)
 	, m_sock(sock)
@@ -271,8 +289,8 @@ void node_impl::incoming(msg const& m)
 		{
 			TORRENT_ASSERT(m.message.dict_find_string_value("y") == "q");
 			entry e;
-			incoming_request(m, e);
-			m_sock->send_packet(e, m.addr, 0);
+			if (incoming_request(m, e))
+				m_sock->send_packet(e, m.addr, 0);
 			break;
 		}
 		case 'e':
@@ -430,32 +448,26 @@ time_duration node_impl::connection_timeout()
 	if (now - m_last_tracker_tick < minutes(2)) return d;
 	m_last_tracker_tick = now;
 
-	for (dht_immutable_table_t::iterator i = m_immutable_table.begin();
-		i != m_immutable_table.end();)
+	// the LRU list is ordered by last_seen, so the expired items
+	// are all at the front
+	while (!m_immutable_lru.empty())
 	{
-		if (i->second.last_seen + minutes(60) > now)
-		{
-			++i;
-			continue;
-		}
-		free(i->second.value);
-		m_immutable_table.erase(i++);
+		dht_immutable_table_t::iterator i = m_immutable_table.find(
+			m_immutable_lru.front());
+		TORRENT_ASSERT(i != m_immutable_table.end());
+		if (i->second.last_seen + minutes(60) > now) break;
+		erase_immutable_item(i);
 	}
 
 	// look through all peers and see if any have timed out
 	for (table_t::iterator i = m_map.begin(), end(m_map.end()); i != end;)
 	{
 		torrent_entry& t = i->second;
-		node_id const& key = i->first;
-		++i;
-		purge_peers(t.peers);
+		m_num_peers -= purge_peers(t.peers);
 
 		// if there are no more peers, remove the entry altogether
-		if (t.peers.empty())
-		{
-			table_t::iterator i = m_map.find(key);
-			if (i != m_map.end()) m_map.erase(i);
-		}
+		if (t.peers.empty()) erase_torrent(i++);
+		else ++i;
 	}
 
 	return d;
@@ -467,6 +479,20 @@ void node_impl::status(session_status& s)
 
 	m_table.status(s);
 	s.dht_torrents = int(m_map.size());
+	s.dht_peers = m_num_peers;
+	s.dht_items = int(m_immutable_table.size() + m_mutable_table.size());
+
+	// this is an estimate. Every map and list node is assumed to carry
+	// three pointers and a color/padding word of overhead
+	int const node_overhead = 4 * sizeof(void*);
+	s.dht_storage_bytes = size_type(m_map.size())
+			* (sizeof(table_t::value_type) + sizeof(node_id) + 2 * node_overhead)
+		+ size_type(m_num_peers) * sizeof(peer_entry)
+		+ size_type(m_immutable_table.size())
+			* (sizeof(dht_immutable_table_t::value_type) + sizeof(node_id) + 2 * node_overhead)
+		+ size_type(m_mutable_table.size())
+			* (sizeof(dht_mutable_table_t::value_type) + sizeof(node_id) + 2 * node_overhead)
+		+ m_item_bytes;
 	s.active_requests.clear();
 	s.dht_total_allocations = m_rpc.num_allocated_observers();
 	for (std::set<traversal_algorithm*>::iterator i = m_running_requests.begin()
@@ -478,8 +504,8 @@ void node_impl::status(session_status& s)
 	}
 }
 
-void node_impl::lookup_peers(sha1_hash const& info_hash, int prefix, entry& reply
-	, bool noseed, bool scrape) const
+torrent_entry const* node_impl::lookup_torrent(sha1_hash const& info_hash
+	, int prefix) const
 {
 	if (m_post_alert)
 	{
@@ -488,57 +514,58 @@ void node_impl::lookup_peers(sha1_hash const& info_hash, int prefix, entry& repl
 	}
 
 	table_t::const_iterator i = m_map.lower_bound(info_hash);
-	if (i == m_map.end()) return;
-	if (i->first != info_hash && prefix == 20) return;
+	if (i == m_map.end()) return 0;
+	if (i->first != info_hash && prefix == 20) return 0;
 	if (prefix != 20)
 	{
 		sha1_hash mask = sha1_hash::max();
 		mask <<= (20 - prefix) * 8;
-		if ((i->first & mask) != (info_hash & mask)) return;
+		if ((i->first & mask) != (info_hash & mask)) return 0;
 	}
 
-	torrent_entry const& v = i->second;
+	return &i->second;
+}
 
-	if (!v.name.empty()) reply["n"] = v.name;
+void node_impl::write_scrape(bencode_writer& w, torrent_entry const& v) const
+{
+	bloom_filter<256> downloaders;
+	bloom_filter<256> seeds;
 
-	if (scrape)
+	for (std::vector<peer_entry>::const_iterator i = v.peers.begin()
+		, end(v.peers.end()); i != end; ++i)
 	{
-		bloom_filter<256> downloaders;
-		bloom_filter<256> seeds;
+		sha1_hash iphash;
+		hash_address(i->addr.address(), iphash);
+		if (i->seed) seeds.set(iphash);
+		else downloaders.set(iphash);
+	}
 
-		for (std::set<peer_entry>::const_iterator i = v.peers.begin()
-			, end(v.peers.end()); i != end; ++i)
-		{
-			sha1_hash iphash;
-			hash_address(i->addr.address(), iphash);
-			if (i->seed) seeds.set(iphash);
-			else downloaders.set(iphash);
-		}
+	w.key("BFpe");
+	w.string(downloaders.data(), 256);
+	w.key("BFse");
+	w.string(seeds.data(), 256);
+}
 
-		reply["BFpe"] = downloaders.to_string();
-		reply["BFse"] = seeds.to_string();
-	}
-	else
+void node_impl::write_peers(bencode_writer& w, torrent_entry const& v
+	, bool noseed) const
+{
+	int num = (std::min)((int)v.peers.size(), m_settings.max_peers_reply);
+	std::vector<peer_entry>::const_iterator iter = v.peers.begin();
+	char endpoint[18];
+
+	w.key("values");
+	w.begin_list();
+	for (int t = 0, m = 0; m < num && iter != v.peers.end(); ++iter, ++t)
 	{
-		int num = (std::min)((int)v.peers.size(), m_settings.max_peers_reply);
-		std::set<peer_entry>::const_iterator iter = v.peers.begin();
-		entry::list_type& pe = reply["values"].list();
-		std::string endpoint;
+		if ((random() / float(UINT_MAX + 1.f)) * (num - t) >= num - m) continue;
+		if (noseed && iter->seed) continue;
+		char* out = endpoint;
+		write_endpoint(iter->addr, out);
+		w.string(endpoint, out - endpoint);
 
-		for (int t = 0, m = 0; m < num && iter != v.peers.end(); ++iter, ++t)
-		{
-			if ((random() / float(UINT_MAX + 1.f)) * (num - t) >= num - m) continue;
-			if (noseed && iter->seed) continue;
-			endpoint.resize(18);
-			std::string::iterator out = endpoint.begin();
-			write_endpoint(iter->addr, out);
-			endpoint.resize(out - endpoint.begin());
-			pe.push_back(entry(endpoint));
-
-			++m;
-		}
+		++m;
 	}
-	return;
+	w.end();
 }
 
 namespace detail
@@ -581,6 +608,67 @@ namespace detail
 }
 using detail::write_nodes_entry;
 
+namespace
+{
+	// the bencode_writer counterpart of write_nodes_entry()
+	void write_nodes(bencode_writer& w, nodes_t const& nodes)
+	{
+		int num_v4 = 0;
+		int num_v6 = 0;
+		for (nodes_t::const_iterator i = nodes.begin()
+			, end(nodes.end()); i != end; ++i)
+		{
+			if (i->addr().is_v4()) ++num_v4;
+			else ++num_v6;
+		}
+
+		char buf[20 + 18];
+		w.key("nodes");
+		w.string_prefix(num_v4 * (20 + 6));
+		for (nodes_t::const_iterator i = nodes.begin()
+			, end(nodes.end()); i != end; ++i)
+		{
+			if (!i->addr().is_v4()) continue;
+			char* out = buf;
+			std::copy(i->id.begin(), i->id.end(), out);
+			out += 20;
+			write_endpoint(udp::endpoint(i->addr(), i->port()), out);
+			w.raw(buf, out - buf);
+		}
+
+		if (num_v6 == 0) return;
+
+		w.key("nodes2");
+		w.begin_list();
+		for (nodes_t::const_iterator i = nodes.begin()
+			, end(nodes.end()); i != end; ++i)
+		{
+			if (!i->addr().is_v6()) continue;
+			char* out = buf;
+			std::copy(i->id.begin(), i->id.end(), out);
+			out += 20;
+			write_endpoint(udp::endpoint(i->addr(), i->port()), out);
+			w.string(buf, out - buf);
+		}
+		w.end();
+	}
+
+	// writes the "t", "v" and "y" fields, which are the last keys of every
+	// message. The transaction ID is mirrored back from the request
+	void write_message_tail(bencode_writer& w, lazy_entry const& request
+		, char const* y)
+	{
+		lazy_entry const* t = request.dict_find_string("t");
+		w.key("t");
+		if (t) w.string(t->string_ptr(), t->string_length());
+		else w.string("", 0);
+		w.key("v");
+		w.string(dht_client_version, sizeof(dht_client_version));
+		w.key("y");
+		w.string(y);
+	}
+}
+
 // verifies that a message has all the required
 // entries and returns them in ret
 bool verify_message(lazy_entry const* msg, key_desc_t const desc[], lazy_entry const* ret[]
@@ -679,37 +767,159 @@ void incoming_error(entry& e, char const* msg, int error_code)
 	l.push_back(entry(msg));
 }
 
-// return true of the first argument is a better canidate for removal, i.e.
-// less important to keep
-struct immutable_item_comparator
+void node_impl::erase_torrent(table_t::iterator i)
 {
-	immutable_item_comparator(node_id const& our_id) : m_our_id(our_id) {}
+	m_num_peers -= int(i->second.peers.size());
+	m_torrent_lru.erase(i->second.lru);
+	m_map.erase(i);
+}
 
-	bool operator() (std::pair<node_id, dht_immutable_item> const& lhs
-		, std::pair<node_id, dht_immutable_item> const& rhs) const
+void node_impl::erase_immutable_item(dht_immutable_table_t::iterator i)
+{
+	m_item_bytes -= i->second.size;
+	free(i->second.value);
+	m_immutable_lru.erase(i->second.lru);
+	m_immutable_table.erase(i);
+}
+
+void node_impl::erase_mutable_item(dht_mutable_table_t::iterator i)
+{
+	m_item_bytes -= i->second.size + i->second.salt_size;
+	free(i->second.value);
+	free(i->second.salt);
+	m_mutable_lru.erase(i->second.lru);
+	m_mutable_table.erase(i);
+}
+
+// ping, find_node and get_peers make up the bulk of the queries a DHT node
+// receives. Their replies have a fixed shape, so instead of building an
+// entry tree they are bencoded straight into m_send_buf. Keys must be
+// written in sorted order.
+void node_impl::send_reply(msg const& m, char const* query
+	, lazy_entry const* arg_ent)
+{
+	char error_string[200];
+	lazy_entry const* msg_keys[4];
+	torrent_entry const* torrent = 0;
+	sha1_hash target;
+	bool get_peers = false;
+	bool noseed = false;
+	bool scrape = false;
+
+	if (strcmp(query, "get_peers") == 0)
 	{
-		int l_distance = distance_exp(lhs.first, m_our_id);
-		int r_distance = distance_exp(rhs.first, m_our_id);
-
-		// this is a score taking the popularity (number of announcers) and the
-		// fit, in terms of distance from ideal storing node, into account.
-		// each additional 5 announcers is worth one extra bit in the distance.
-		// that is, an item with 10 announcers is allowed to be twice as far
-		// from another item with 5 announcers, from our node ID. Twice as far
-		// because it gets one more bit.
-		return lhs.second.num_announcers / 5 - l_distance < rhs.second.num_announcers / 5 - r_distance;
+		key_desc_t msg_desc[] = {
+			{"info_hash", lazy_entry::string_t, 20, 0},
+			{"ifhpfxl", lazy_entry::int_t, 0, key_desc_t::optional},
+			{"noseed", lazy_entry::int_t, 0, key_desc_t::optional},
+			{"scrape", lazy_entry::int_t, 0, key_desc_t::optional},
+		};
+
+		if (!verify_message(arg_ent, msg_desc, msg_keys, 4, error_string, sizeof(error_string)))
+		{
+			send_error(m, error_string, true);
+			return;
+		}
+
+		target = sha1_hash(msg_keys[0]->string_ptr());
+
+		int prefix = msg_keys[1] ? int(msg_keys[1]->int_value()) : 20;
+		if (prefix > 20) prefix = 20;
+		else if (prefix < 4) prefix = 4;
+
+		if (msg_keys[2] && msg_keys[2]->int_value() != 0) noseed = true;
+		if (msg_keys[3] && msg_keys[3]->int_value() != 0) scrape = true;
+		torrent = lookup_torrent(target, prefix);
+		get_peers = true;
 	}
+	else if (strcmp(query, "find_node") == 0)
+	{
+		key_desc_t msg_desc[] = {
+			{"target", lazy_entry::string_t, 20, 0},
+		};
 
-	node_id const& m_our_id;
-};
+		if (!verify_message(arg_ent, msg_desc, msg_keys, 1, error_string, sizeof(error_string)))
+		{
+			send_error(m, error_string, true);
+			return;
+		}
 
-// build response
-void node_impl::incoming_request(msg const& m, entry& e)
+		target = sha1_hash(msg_keys[0]->string_ptr());
+	}
+
+	m_send_buf.clear();
+	bencode_writer w(m_send_buf);
+	w.begin_dict();
+
+	char ip[18];
+	char* out = ip;
+	write_endpoint(m.addr, out);
+	w.key("ip");
+	w.string(ip, out - ip);
+
+	w.key("r");
+	w.begin_dict();
+	if (torrent && scrape) write_scrape(w, *torrent);
+	w.key("id");
+	w.string((char const*)&m_id[0], m_id.size);
+	if (torrent && !torrent->name.empty())
+	{
+		w.key("n");
+		w.string(torrent->name);
+	}
+	if (strcmp(query, "ping") != 0)
+	{
+		// always return nodes as well as peers
+		m_table.find_node(target, m_nodes_buf, 0);
+		write_nodes(w, m_nodes_buf);
+	}
+	// mirror back the other node's external port
+	w.key("p");
+	w.integer(m.addr.port());
+	if (get_peers)
+	{
+		w.key("token");
+		w.string(generate_token(m.addr, msg_keys[0]->string_ptr()));
+	}
+	if (torrent && !scrape) write_peers(w, *torrent, noseed);
+	w.end();
+
+	write_message_tail(w, m.message, "r");
+	w.end();
+
+	m_sock->send_packet(&m_send_buf[0], int(m_send_buf.size()), m.addr, 0);
+}
+
+// if ip is true, the error tells the requesting node what its external
+// address is, like replies do. That's the case for all errors sent once
+// the message is known to be a well-formed query
+void node_impl::send_error(msg const& m, char const* err, bool ip, int error_code)
 {
-	e = entry(entry::dictionary_t);
-	e["y"] = "r";
-	e["t"] = m.message.dict_find_string_value("t");
+	m_send_buf.clear();
+	bencode_writer w(m_send_buf);
+	w.begin_dict();
+	w.key("e");
+	w.begin_list();
+	w.integer(error_code);
+	w.string(err);
+	w.end();
+	if (ip)
+	{
+		char buf[18];
+		char* out = buf;
+		write_endpoint(m.addr, out);
+		w.key("ip");
+		w.string(buf, out - buf);
+	}
+	write_message_tail(w, m.message, "e");
+	w.end();
 
+	m_sock->send_packet(&m_send_buf[0], int(m_send_buf.size()), m.addr, 0);
+}
+
+// build response. Returns false if the response has already been sent
+bool node_impl::incoming_request(msg const& m, entry& e)
+{
 	key_desc_t top_desc[] = {
 		{"q", lazy_entry::string_t, 0, 0},
 		{"a", lazy_entry::dict_t, 0, key_desc_t::parse_children},
@@ -720,12 +930,10 @@ void node_impl::incoming_request(msg const& m, entry& e)
 	char error_string[200];
 	if (!verify_message(&m.message, top_desc, top_level, 3, error_string, sizeof(error_string)))
 	{
-		incoming_error(e, error_string);
-		return;
+		send_error(m, error_string, false);
+		return false;
 	}
 
-	e["ip"] = endpoint_to_bytes(m.addr);
-
 	char const* query = top_level[0]->string_cstr();
 
 	lazy_entry const* arg_ent = top_level[1];
@@ -737,84 +945,32 @@ void node_impl::incoming_request(msg const& m, entry& e)
 	// don't enforce this yet
 	if (m_settings.enforce_node_id && !verify_id(id, m.addr.address()))
 	{
-		incoming_error(e, "invalid node ID");
-		return;
+		send_error(m, "invalid node ID", true);
+		return false;
 	}
 
 	m_table.heard_about(id, m.addr);
 
-	entry& reply = e["r"];
-	m_rpc.add_our_id(reply);
-
-	// mirror back the other node's external port
-	reply["p"] = m.addr.port();
-
-	if (strcmp(query, "ping") == 0)
+	if (strcmp(query, "ping") == 0
+		|| strcmp(query, "get_peers") == 0
+		|| strcmp(query, "find_node") == 0)
 	{
-		// we already have 't' and 'id' in the response
-		// no more left to add
+		send_reply(m, query, arg_ent);
+		return false;
 	}
-	else if (strcmp(query, "get_peers") == 0)
-	{
-		key_desc_t msg_desc[] = {
-			{"info_hash", lazy_entry::string_t, 20, 0},
-			{"ifhpfxl", lazy_entry::int_t, 0, key_desc_t::optional},
-			{"noseed", lazy_entry::int_t, 0, key_desc_t::optional},
-			{"scrape", lazy_entry::int_t, 0, key_desc_t::optional},
-		};
 
-		lazy_entry const* msg_keys[4];
-		if (!verify_message(arg_ent, msg_desc, msg_keys, 4, error_string, sizeof(error_string)))
-		{
-			incoming_error(e, error_string);
-			return;
-		}
-
-		reply["token"] = generate_token(m.addr, msg_keys[0]->string_ptr());
-		
-		sha1_hash info_hash(msg_keys[0]->string_ptr());
-		nodes_t n;
-		// always return nodes as well as peers
-		m_table.find_node(info_hash, n, 0);
-		write_nodes_entry(reply, n);
-
-		int prefix = msg_keys[1] ? int(msg_keys[1]->int_value()) : 20;
-		if (prefix > 20) prefix = 20;
-		else if (prefix < 4) prefix = 4;
-
-		bool noseed = false;
-		bool scrape = false;
-		if (msg_keys[2] && msg_keys[2]->int_value() != 0) noseed = true;
-		if (msg_keys[3] && msg_keys[3]->int_value() != 0) scrape = true;
-		lookup_peers(info_hash, prefix, reply, noseed, scrape);
-#ifdef TORRENT_DHT_VERBOSE_LOGGING
-		if (reply.find_key("values"))
-		{
-			TORRENT_LOG(node) << " values: " << reply["values"].list().size();
-		}
-#endif
-	}
-	else if (strcmp(query, "find_node") == 0)
-	{
-		key_desc_t msg_desc[] = {
-			{"target", lazy_entry::string_t, 20, 0},
-		};
+	e = entry(entry::dictionary_t);
+	e["y"] = "r";
+	e["t"] = m.message.dict_find_string_value("t");
+	e["ip"] = endpoint_to_bytes(m.addr);
 
-		lazy_entry const* msg_keys[1];
-		if (!verify_message(arg_ent, msg_desc, msg_keys, 1, error_string, sizeof(error_string)))
-		{
-			incoming_error(e, error_string);
-			return;
-		}
+	entry& reply = e["r"];
+	m_rpc.add_our_id(reply);
 
-		sha1_hash target(msg_keys[0]->string_ptr());
+	// mirror back the other node's external port
+	reply["p"] = m.addr.port();
 
-		// TODO: 1 find_node should write directly to the response entry
-		nodes_t n;
-		m_table.find_node(target, n, 0);
-		write_nodes_entry(reply, n);
-	}
-	else if (strcmp(query, "announce_peer") == 0)
+	if (strcmp(query, "announce_peer") == 0)
 	{
 		key_desc_t msg_desc[] = {
 			{"info_hash", lazy_entry::string_t, 20, 0},
@@ -832,7 +988,7 @@ void node_impl::incoming_request(msg const& m, entry& e)
 			++g_failed_announces;
 #endif
 			incoming_error(e, error_string);
-			return;
+			return true;
 		}
 
 		int port = int(msg_keys[1]->int_value());
@@ -848,7 +1004,7 @@ void node_impl::incoming_request(msg const& m, entry& e)
 			++g_failed_announces;
 #endif
 			incoming_error(e, "invalid port");
-			return;
+			return true;
 		}
 
 		sha1_hash info_hash(msg_keys[0]->string_ptr());
@@ -865,7 +1021,7 @@ void node_impl::incoming_request(msg const& m, entry& e)
 			++g_failed_announces;
 #endif
 			incoming_error(e, "invalid token");
-			return;
+			return true;
 		}
 
 		// the token was correct. That means this
@@ -873,23 +1029,25 @@ void node_impl::incoming_request(msg const& m, entry& e)
 		// the table get a chance to add it.
 		m_table.node_seen(id, m.addr, 0xffff);
 
-		if (!m_map.empty() && int(m_map.size()) >= m_settings.max_torrents)
+		table_t::iterator ti = m_map.find(info_hash);
+		if (ti == m_map.end())
 		{
-			// we need to remove some. Remove the ones with the
-			// fewest peers
-			int num_peers = m_map.begin()->second.peers.size();
-			table_t::iterator candidate = m_map.begin();
-			for (table_t::iterator i = m_map.begin()
-				, end(m_map.end()); i != end; ++i)
+			// we need to make room. Remove the torrent that
+			// was announced to the longest time ago
+			if (!m_map.empty() && int(m_map.size()) >= m_settings.max_torrents)
 			{
-				if (int(i->second.peers.size()) > num_peers) continue;
-				if (i->first == info_hash) continue;
-				num_peers = i->second.peers.size();
-				candidate = i;
+				table_t::iterator candidate = m_map.find(m_torrent_lru.front());
+				TORRENT_ASSERT(candidate != m_map.end());
+				erase_torrent(candidate);
 			}
-			m_map.erase(candidate);
+			ti = m_map.insert(std::make_pair(info_hash, torrent_entry())).first;
+			ti->second.lru = m_torrent_lru.insert(m_torrent_lru.end(), info_hash);
+		}
+		else
+		{
+			m_torrent_lru.splice(m_torrent_lru.end(), m_torrent_lru, ti->second.lru);
 		}
-		torrent_entry& v = m_map[info_hash];
+		torrent_entry& v = ti->second;
 
 		// the peer announces a torrent name, and we don't have a name
 		// for this torrent. Store it.
@@ -904,9 +1062,31 @@ void node_impl::incoming_request(msg const& m, entry& e)
 		peer.addr = tcp::endpoint(m.addr.address(), port);
 		peer.added = time_now();
 		peer.seed = msg_keys[4] && msg_keys[4]->int_value();
-		std::set<peer_entry>::iterator i = v.peers.find(peer);
-		if (i != v.peers.end()) v.peers.erase(i++);
-		v.peers.insert(i, peer);
+		std::vector<peer_entry>::iterator i = std::lower_bound(
+			v.peers.begin(), v.peers.end(), peer);
+		if (i != v.peers.end() && !(peer < *i))
+		{
+			// we already have this peer, just refresh it
+			*i = peer;
+		}
+		else
+		{
+			if (!v.peers.empty() && int(v.peers.size()) >= m_settings.max_peers)
+			{
+				// the torrent is full. Make room by removing the
+				// peers we heard from the longest ago. This is a loop
+				// in case max_peers was lowered since they were added
+				while (!v.peers.empty() && int(v.peers.size()) >= m_settings.max_peers)
+				{
+					v.peers.erase(std::min_element(v.peers.begin(), v.peers.end()
+						, &added_before));
+					--m_num_peers;
+				}
+				i = std::lower_bound(v.peers.begin(), v.peers.end(), peer);
+			}
+			v.peers.insert(i, peer);
+			++m_num_peers;
+		}
 #ifdef TORRENT_DHT_VERBOSE_LOGGING
 		++g_announces;
 #endif
@@ -931,7 +1111,7 @@ void node_impl::incoming_request(msg const& m, entry& e)
 		if (!verify_message(arg_ent, msg_desc, msg_keys, 7, error_string, sizeof(error_string)))
 		{
 			incoming_error(e, error_string);
-			return;
+			return true;
 		}
 
 		// is this a mutable put?
@@ -950,7 +1130,7 @@ void node_impl::incoming_request(msg const& m, entry& e)
 		if (buf.second > 1000 || buf.second <= 0)
 		{
 			incoming_error(e, "message too big", 205);
-			return;
+			return true;
 		}
 
 		std::pair<char const*, int> salt(static_cast<char const*>(NULL), 0);
@@ -960,7 +1140,7 @@ void node_impl::incoming_request(msg const& m, entry& e)
 		if (salt.second > 64)
 		{
 			incoming_error(e, "salt too big", 207);
-			return;
+			return true;
 		}
 
 		sha1_hash target;
@@ -980,7 +1160,7 @@ void node_impl::incoming_request(msg const& m, entry& e)
 		if (!verify_token(msg_keys[0]->string_value(), (char const*)&target[0], m.addr))
 		{
 			incoming_error(e, "invalid token");
-			return;
+			return true;
 		}
 
 		dht_immutable_item* f = 0;
@@ -991,18 +1171,14 @@ void node_impl::incoming_request(msg const& m, entry& e)
 			if (i == m_immutable_table.end())
 			{
 				// make sure we don't add too many items
-				if (int(m_immutable_table.size()) >= m_settings.max_dht_items)
+				if (!m_immutable_table.empty()
+					&& int(m_immutable_table.size()) >= m_settings.max_dht_items)
 				{
-					// delete the least important one (i.e. the one
-					// the fewest peers are announcing, and farthest
-					// from our node ID)
-					dht_immutable_table_t::iterator j = std::min_element(m_immutable_table.begin()
-						, m_immutable_table.end()
-						, immutable_item_comparator(m_id));
-
+					// delete the one that was put the longest time ago
+					dht_immutable_table_t::iterator j = m_immutable_table.find(
+						m_immutable_lru.front());
 					TORRENT_ASSERT(j != m_immutable_table.end());
-					free(j->second.value);
-					m_immutable_table.erase(j);
+					erase_immutable_item(j);
 				}
 				dht_immutable_item to_add;
 				to_add.value = (char*)malloc(buf.second);
@@ -1011,6 +1187,12 @@ void node_impl::incoming_request(msg const& m, entry& e)
 		
 				boost::tie(i, boost::tuples::ignore) = m_immutable_table.insert(
 					std::make_pair(target, to_add));
+				i->second.lru = m_immutable_lru.insert(m_immutable_lru.end(), target);
+				m_item_bytes += buf.second;
+			}
+			else
+			{
+				m_immutable_lru.splice(m_immutable_lru.end(), m_immutable_lru, i->second.lru);
 			}
 
 //			fprintf(stderr, "added immutable item (%d)\n", int(m_immutable_table.size()));
@@ -1030,7 +1212,7 @@ void node_impl::incoming_request(msg const& m, entry& e)
 				, msg_keys[2]->int_value(), pk, sig))
 			{
 				incoming_error(e, "invalid signature", 206);
-				return;
+				return true;
 			}
 
 			dht_mutable_table_t::iterator i = m_mutable_table.find(target);
@@ -1038,18 +1220,14 @@ void node_impl::incoming_request(msg const& m, entry& e)
 			{
 				// this is the case where we don't have an item in this slot
 				// make sure we don't add too many items
-				if (int(m_mutable_table.size()) >= m_settings.max_dht_items)
+				if (!m_mutable_table.empty()
+					&& int(m_mutable_table.size()) >= m_settings.max_dht_items)
 				{
-					// delete the least important one (i.e. the one
-					// the fewest peers are announcing)
-					dht_mutable_table_t::iterator j = std::min_element(m_mutable_table.begin()
-						, m_mutable_table.end()
-						, boost::bind(&dht_immutable_item::num_announcers
-							, boost::bind(&dht_mutable_table_t::value_type::second, _1)));
+					// delete the one that was put the longest time ago
+					dht_mutable_table_t::iterator j = m_mutable_table.find(
+						m_mutable_lru.front());
 					TORRENT_ASSERT(j != m_mutable_table.end());
-					free(j->second.value);
-					free(j->second.salt);
-					m_mutable_table.erase(j);
+					erase_mutable_item(j);
 				}
 				dht_mutable_item to_add;
 				to_add.value = (char*)malloc(buf.second);
@@ -1070,6 +1248,8 @@ void node_impl::incoming_request(msg const& m, entry& e)
 		
 				boost::tie(i, boost::tuples::ignore) = m_mutable_table.insert(
 					std::make_pair(target, to_add));
+				i->second.lru = m_mutable_lru.insert(m_mutable_lru.end(), target);
+				m_item_bytes += buf.second + salt.second;
 
 //				fprintf(stderr, "added mutable item (%d)\n", int(m_mutable_table.size()));
 			}
@@ -1091,20 +1271,21 @@ void node_impl::incoming_request(msg const& m, entry& e)
 					if (h != sha1_hash(msg_keys[5]->string_ptr()))
 					{
 						incoming_error(e, "CAS hash failed", 301);
-						return;
+						return true;
 					}
 				}
 
 				if (item->seq > msg_keys[2]->int_value())
 				{
 					incoming_error(e, "old sequence number", 302);
-					return;
+					return true;
 				}
 
 				if (item->seq < msg_keys[2]->int_value())
 				{
 					if (item->size != buf.second)
 					{
+						m_item_bytes += buf.second - item->size;
 						free(item->value);
 						item->value = (char*)malloc(buf.second);
 						item->size = buf.second;
@@ -1114,6 +1295,7 @@ void node_impl::incoming_request(msg const& m, entry& e)
 					TORRENT_ASSERT(sizeof(item->sig) == msg_keys[4]->string_length());
 					memcpy(item->value, buf.first, buf.second);
 				}
+				m_mutable_lru.splice(m_mutable_lru.end(), m_mutable_lru, item->lru);
 			}
 
 			f = &i->second;
@@ -1145,7 +1327,7 @@ void node_impl::incoming_request(msg const& m, entry& e)
 		if (!verify_message(arg_ent, msg_desc, msg_keys, 1, error_string, sizeof(error_string)))
 		{
 			incoming_error(e, error_string);
-			return;
+			return true;
 		}
 
 		sha1_hash target(msg_keys[0]->string_ptr());
@@ -1192,7 +1374,7 @@ void node_impl::incoming_request(msg const& m, entry& e)
 			if (target_ent == 0 || target_ent->string_length() != 20)
 			{
 				incoming_error(e, "unknown message");
-				return;
+				return true;
 			}
 		}
 
@@ -1201,7 +1383,136 @@ void node_impl::incoming_request(msg const& m, entry& e)
 		// always return nodes as well as peers
 		m_table.find_node(target, n, 0);
 		write_nodes_entry(reply, n);
-		return;
+		return true;
+	}
+	return true;
+}
+
+
+node_impl& node_for(msg const& m, node_impl& primary
+	, std::vector<boost::shared_ptr<node_impl> > const& extra)
+{
+	if (extra.empty()) return primary;
+
+	lazy_entry const* y = m.message.dict_find_string("y");
+	if (y == 0 || y->string_length() != 1) return primary;
+
+	if (*y->string_ptr() != 'q')
+	{
+		if (primary.m_rpc.is_outstanding(m)) return primary;
+		for (std::vector<boost::shared_ptr<node_impl> >::const_iterator i = extra.begin()
+			, end(extra.end()); i != end; ++i)
+		{
+			if ((*i)->m_rpc.is_outstanding(m)) return **i;
+		}
+		return primary;
+	}
+
+	lazy_entry const* a = m.message.dict_find_dict("a");
+	if (a == 0) return primary;
+
+	sha1_hash target;
+	lazy_entry const* t = a->dict_find_string("info_hash");
+	if (t == 0) t = a->dict_find_string("target");
+	if (t != 0 && t->string_length() == 20)
+	{
+		target = sha1_hash(t->string_ptr());
+	}
+	else if (lazy_entry const* v = a->dict_find("v"))
+	{
+		// this is a put. Use the same target the storing node will
+		// derive from the item, so that subsequent gets for it are
+		// routed to the node that stored it
+		lazy_entry const* k = a->dict_find_string("k");
+		if (k != 0 && k->string_length() == item_pk_len)
+		{
+			std::pair<char const*, int> salt(static_cast<char const*>(0), 0);
+			if (lazy_entry const* s = a->dict_find_string("salt"))
+				salt = std::make_pair(s->string_ptr(), s->string_length());
+			target = item_target_id(salt, k->string_ptr());
+		}
+		else
+		{
+			target = item_target_id(v->data_section());
+		}
+	}
+	else
+	{
+		return primary;
+	}
+
+	node_impl* ret = &primary;
+	for (std::vector<boost::shared_ptr<node_impl> >::const_iterator i = extra.begin()
+		, end(extra.end()); i != end; ++i)
+	{
+		if (compare_ref((*i)->nid(), ret->nid(), target)) ret = i->get();
+	}
+	return *ret;
+}
+
+void save_extra_node_ids(entry& state
+	, std::vector<boost::shared_ptr<node_impl> > const& extra)
+{
+	if (extra.empty()) return;
+
+	entry& ids = state["extra-node-ids"];
+	ids = entry(entry::list_t);
+	for (std::vector<boost::shared_ptr<node_impl> >::const_iterator i = extra.begin()
+		, end(extra.end()); i != end; ++i)
+		ids.list().push_back((*i)->nid().to_string());
+}
+
+node_id extract_extra_node_id(entry const* state, int idx)
+{
+	if (state == 0 || state->type() != entry::dictionary_t) return (node_id::min)();
+	entry const* ids = state->find_key("extra-node-ids");
+	if (ids == 0 || ids->type() != entry::list_t) return (node_id::min)();
+	entry::list_type const& l = ids->list();
+	if (idx >= int(l.size())) return (node_id::min)();
+	entry::list_type::const_iterator i = l.begin();
+	std::advance(i, idx);
+	if (i->type() != entry::string_t || i->string().length() != 20)
+		return (node_id::min)();
+	return node_id(i->string().c_str());
+}
+
+void add_extra_node_status(session_status& s
+	, std::vector<boost::shared_ptr<node_impl> > const& extra)
+{
+	s.dht_instances.clear();
+	if (extra.empty()) return;
+
+	dht_instance_status st;
+	st.nodes = s.dht_nodes;
+	st.node_cache = s.dht_node_cache;
+	st.torrents = s.dht_torrents;
+	st.peers = s.dht_peers;
+	st.items = s.dht_items;
+	st.storage_bytes = s.dht_storage_bytes;
+	s.dht_instances.push_back(st);
+
+	for (std::vector<boost::shared_ptr<node_impl> >::const_iterator i = extra.begin()
+		, end(extra.end()); i != end; ++i)
+	{
+		session_status es;
+		(*i)->status(es);
+		st.nodes = es.dht_nodes;
+		st.node_cache = es.dht_node_cache;
+		st.torrents = es.dht_torrents;
+		st.peers = es.dht_peers;
+		st.items = es.dht_items;
+		st.storage_bytes = es.dht_storage_bytes;
+		s.dht_instances.push_back(st);
+
+		s.dht_nodes += es.dht_nodes;
+		s.dht_node_cache += es.dht_node_cache;
+		s.dht_torrents += es.dht_torrents;
+		s.dht_peers += es.dht_peers;
+		s.dht_items += es.dht_items;
+		s.dht_storage_bytes += es.dht_storage_bytes;
+		s.dht_total_allocations += es.dht_total_allocations;
+		s.active_requests.insert(s.active_requests.end()
+			, es.active_requests.begin(), es.active_requests.end());
 	}
 }
 
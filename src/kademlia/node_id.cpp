@@ -40,6 +40,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/kademlia/node_entry.hpp"
 #include "libtorrent/hasher.hpp"
 #include "libtorrent/assert.hpp"
+#include "libtorrent/io.hpp"
 #include "libtorrent/broadcast_socket.hpp" // for is_local et.al
 #include "libtorrent/socket_io.hpp" // for hash_address
 #include "libtorrent/random.hpp" // for random
@@ -64,13 +65,18 @@ node_id distance(node_id const& n1, node_id const& n2)
 // returns true if: distance(n1, ref) < distance(n2, ref)
 bool compare_ref(node_id const& n1, node_id const& n2, node_id const& ref)
 {
-	for (node_id::const_iterator i = n1.begin(), j = n2.begin()
-		, k = ref.begin(), end(n1.end()); i != end; ++i, ++j, ++k)
+	// compare 32 bits at a time. The words are read big-endian, so
+	// comparing them as integers orders the same way as comparing the
+	// XOR distance byte by byte
+	char const* i = (char const*)&n1[0];
+	char const* j = (char const*)&n2[0];
+	char const* k = (char const*)&ref[0];
+	for (int n = 0; n < node_id::size / 4; ++n)
 	{
-		boost::uint8_t lhs = (*i ^ *k);
-		boost::uint8_t rhs = (*j ^ *k);
-		if (lhs < rhs) return true;
-		if (lhs > rhs) return false;
+		boost::uint32_t r = detail::read_uint32(k);
+		boost::uint32_t lhs = detail::read_uint32(i) ^ r;
+		boost::uint32_t rhs = detail::read_uint32(j) ^ r;
+		if (lhs != rhs) return lhs < rhs;
 	}
 	return false;
 }
@@ -79,20 +85,22 @@ bool compare_ref(node_id const& n1, node_id const& n2, node_id const& ref)
 // useful for finding out which bucket a node belongs to
 int distance_exp(node_id const& n1, node_id const& n2)
 {
-	int byte = node_id::size - 1;
-	for (node_id::const_iterator i = n1.begin(), j = n2.begin()
-		, end(n1.end()); i != end; ++i, ++j, --byte)
+	char const* i = (char const*)&n1[0];
+	char const* j = (char const*)&n2[0];
+	for (int byte = node_id::size - 4; byte >= 0; byte -= 4)
 	{
-		TORRENT_ASSERT(byte >= 0);
-		boost::uint8_t t = *i ^ *j;
+		boost::uint32_t t = detail::read_uint32(i) ^ detail::read_uint32(j);
 		if (t == 0) continue;
-		// we have found the first non-zero byte
+		// we have found the first non-zero word
 		// return the bit-number of the first bit
 		// that differs
-		int bit = byte * 8;
-		for (int b = 7; b >= 0; --b)
-			if (t >= (1 << b)) return bit + b;
-		return bit;
+		int bit = 0;
+		if (t >= 0x10000) { t >>= 16; bit += 16; }
+		if (t >= 0x100) { t >>= 8; bit += 8; }
+		if (t >= 0x10) { t >>= 4; bit += 4; }
+		if (t >= 0x4) { t >>= 2; bit += 2; }
+		if (t >= 0x2) bit += 1;
+		return byte * 8 + bit;
 	}
 
 	return 0;
@@ -45,6 +45,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/session_status.hpp"
 #include "libtorrent/kademlia/node_id.hpp"
 #include "libtorrent/time.hpp"
+#include "libtorrent/io.hpp"
 
 #include "libtorrent/invariant_check.hpp"
 
@@ -990,92 +991,97 @@ bool routing_table::need_bootstrap() const
 	return true;
 }
 
-// fills the vector with the k nodes from our buckets that
-// are nearest to the given id.
-void routing_table::find_node(node_id const& target
-	, std::vector<node_entry>& l, int options, int count)
+namespace
 {
-	l.clear();
-	if (count == 0) count = m_bucket_size;
-
-	table_t::iterator i = find_bucket(target);
-	int bucket_index = std::distance(m_buckets.begin(), i);
-	int bucket_size_limit = bucket_limit(bucket_index);
-
-	l.reserve(bucket_size_limit);
-
-	table_t::iterator j = i;
+	// the first 64 bits of the XOR distance between id and target
+	boost::uint64_t distance_prefix(node_id const& id, node_id const& target)
+	{
+		char const* i = (char const*)&id[0];
+		char const* t = (char const*)&target[0];
+		boost::uint64_t hi = detail::read_uint32(i) ^ detail::read_uint32(t);
+		boost::uint64_t lo = detail::read_uint32(i) ^ detail::read_uint32(t);
+		return (hi << 32) | lo;
+	}
 
-	int unsorted_start_idx = 0;
-	for (; j != m_buckets.end() && int(l.size()) < count; ++j)
+	struct compare_candidate
 	{
-		bucket_t& b = j->live_nodes;
-		if (options & include_failed)
-		{
-			copy(b.begin(), b.end()
-				, std::back_inserter(l));
-		}
-		else
+		compare_candidate(node_id const& t): target(t) {}
+
+		bool operator()(routing_table::candidate const& lhs
+			, routing_table::candidate const& rhs) const
 		{
-			std::remove_copy_if(b.begin(), b.end()
-				, std::back_inserter(l)
-				, !boost::bind(&node_entry::confirmed, _1));
+			// only look at the whole IDs if the first 64 bits
+			// of the distances are the same
+			if (lhs.distance != rhs.distance) return lhs.distance < rhs.distance;
+			return compare_ref(lhs.node->id, rhs.node->id, target);
 		}
 
-		if (int(l.size()) == count) return;
+		node_id const& target;
+	};
+}
 
-		if (int(l.size()) > count)
-		{
-			// sort the nodes by how close they are to the target
-			std::sort(l.begin() + unsorted_start_idx, l.end(), boost::bind(&compare_ref
-				, boost::bind(&node_entry::id, _1)
-				, boost::bind(&node_entry::id, _2), target));
+// appends the nodes in the bucket to l, as long as it has fewer than
+// count nodes. If they don't all fit, the ones closest to the target are
+// picked, and appended sorted by distance
+void routing_table::add_closest_nodes(bucket_t const& b, node_id const& target
+	, std::vector<node_entry>& l, int options, int count)
+{
+	int room = count - int(l.size());
+	TORRENT_ASSERT(room > 0);
 
-			l.resize(count);
-			return;
-		}
-		unsorted_start_idx = int(l.size());
+	bool include_all = (options & include_failed) != 0;
+	int num_eligible = include_all ? int(b.size())
+		: int(std::count_if(b.begin(), b.end()
+			, boost::bind(&node_entry::confirmed, _1)));
+
+	if (num_eligible <= room)
+	{
+		for (bucket_t::const_iterator i = b.begin(), end(b.end()); i != end; ++i)
+			if (include_all || i->confirmed()) l.push_back(*i);
+		return;
 	}
 
-	// if we still don't have enough nodes, copy nodes
-	// further away from us
+	// there are more nodes than we need. Rather than sorting the whole
+	// bucket, only the closest ones are sorted
+	m_candidates.clear();
+	for (bucket_t::const_iterator i = b.begin(), end(b.end()); i != end; ++i)
+	{
+		if (!include_all && !i->confirmed()) continue;
+		candidate c;
+		c.distance = distance_prefix(i->id, target);
+		c.node = &*i;
+		m_candidates.push_back(c);
+	}
 
-	if (i == m_buckets.begin())
-		return;
+	std::partial_sort(m_candidates.begin(), m_candidates.begin() + room
+		, m_candidates.end(), compare_candidate(target));
 
-	j = i;
+	for (std::vector<candidate>::const_iterator i = m_candidates.begin()
+		, end(m_candidates.begin() + room); i != end; ++i)
+		l.push_back(*i->node);
+}
 
-	unsorted_start_idx = int(l.size());
-	do
-	{
-		--j;
-		bucket_t& b = j->live_nodes;
-	
-		if (options & include_failed)
-		{
-			std::copy(b.begin(), b.end(), std::back_inserter(l));
-		}
-		else
-		{
-			std::remove_copy_if(b.begin(), b.end(), std::back_inserter(l)
-				, !boost::bind(&node_entry::confirmed, _1));
-		}
+// fills the vector with the k nodes from our buckets that
+// are nearest to the given id.
+void routing_table::find_node(node_id const& target
+	, std::vector<node_entry>& l, int options, int count)
+{
+	l.clear();
+	if (count == 0) count = m_bucket_size;
+	l.reserve(count);
 
-		if (int(l.size()) == count) return;
+	table_t::iterator i = find_bucket(target);
 
-		if (int(l.size()) > count)
-		{
-			// sort the nodes by how close they are to the target
-			std::sort(l.begin() + unsorted_start_idx, l.end(), boost::bind(&compare_ref
-				, boost::bind(&node_entry::id, _1)
-				, boost::bind(&node_entry::id, _2), target));
+	for (table_t::iterator j = i; j != m_buckets.end() && int(l.size()) < count; ++j)
+		add_closest_nodes(j->live_nodes, target, l, options, count);
 
-			l.resize(count);
-			return;
-		}
-		unsorted_start_idx = int(l.size());
+	// if we still don't have enough nodes, copy nodes
+	// further away from us
+	for (table_t::iterator j = i; j != m_buckets.begin() && int(l.size()) < count;)
+	{
+		--j;
+		add_closest_nodes(j->live_nodes, target, l, options, count);
 	}
-	while (j != m_buckets.begin() && int(l.size()) < count);
 
 	TORRENT_ASSERT(int(l.size()) <= count);
 }
@@ -1083,7 +1089,7 @@ void routing_table::find_node(node_id const& target
 #if TORRENT_USE_INVARIANT_CHECKS
 void routing_table::check_invariant() const
 {
-	std::multiset<address_v4::bytes_type> all_ips;
+	ip_set_t all_ips;
 
 	for (table_t::const_iterator i = m_buckets.begin()
 		, end(m_buckets.end()); i != end; ++i)
@@ -168,6 +168,9 @@ enum { observer_size = max3<
 rpc_manager::rpc_manager(node_id const& our_id
 	, routing_table& table, udp_socket_interface* sock)
 	: m_pool_allocator(observer_size, 10)
+	, m_oldest_transaction(0)
+	, m_newest_transaction(0)
+	, m_next_short_timeout(0)
 	, m_sock(sock)
 	, m_table(table)
 	, m_timer(time_now())
@@ -212,8 +215,50 @@ rpc_manager::~rpc_manager()
 	for (transactions_t::iterator i = m_transactions.begin()
 		, end(m_transactions.end()); i != end; ++i)
 	{
-		(*i)->abort();
+		i->second->abort();
 	}
+
+	// the observers may outlive us, if something else holds
+	// a reference to them
+	for (observer* o = m_oldest_transaction; o;)
+	{
+		observer* next = o->m_next_transaction;
+		o->m_next_transaction = 0;
+		o->m_prev_transaction = 0;
+		o = next;
+	}
+}
+
+std::size_t rpc_manager::address_hash::operator()(address const& a) const
+{
+	std::size_t ret = 0;
+#if TORRENT_USE_IPV6
+	if (a.is_v6())
+	{
+		address_v6::bytes_type b = a.to_v6().to_bytes();
+		for (int i = 0; i < int(b.size()); ++i)
+			ret = ret * 31 + b[i];
+		return ret;
+	}
+#endif
+	ret = a.to_v4().to_ulong();
+	return ret ^ (ret >> 16);
+}
+
+observer_ptr rpc_manager::remove_transaction(transactions_t::iterator i)
+{
+	observer_ptr o = i->second;
+	m_transactions.erase(i);
+
+	observer* p = o.get();
+	if (m_next_short_timeout == p) m_next_short_timeout = p->m_next_transaction;
+	if (p->m_prev_transaction) p->m_prev_transaction->m_next_transaction = p->m_next_transaction;
+	else m_oldest_transaction = p->m_next_transaction;
+	if (p->m_next_transaction) p->m_next_transaction->m_prev_transaction = p->m_prev_transaction;
+	else m_newest_transaction = p->m_prev_transaction;
+	p->m_next_transaction = 0;
+	p->m_prev_transaction = 0;
+	return o;
 }
 
 void* rpc_manager::allocate_observer()
@@ -244,8 +289,22 @@ void rpc_manager::check_invariant() const
 	for (transactions_t::const_iterator i = m_transactions.begin()
 		, end(m_transactions.end()); i != end; ++i)
 	{
-		TORRENT_ASSERT(*i);
+		TORRENT_ASSERT(i->second);
+		TORRENT_ASSERT(i->second->target_addr() == i->first);
+	}
+
+	int count = 0;
+	bool found_short_timeout = m_next_short_timeout == 0;
+	ptime last = min_time();
+	for (observer const* o = m_oldest_transaction; o; o = o->m_next_transaction)
+	{
+		TORRENT_ASSERT(o->sent() >= last);
+		last = o->sent();
+		if (o == m_next_short_timeout) found_short_timeout = true;
+		++count;
 	}
+	TORRENT_ASSERT(count == int(m_transactions.size()));
+	TORRENT_ASSERT(found_short_timeout);
 }
 #endif
 
@@ -255,14 +314,13 @@ void rpc_manager::unreachable(udp::endpoint const& ep)
 	TORRENT_LOG(rpc) << time_now_string() << " PORT_UNREACHABLE [ ip: " << ep << " ]";
 #endif
 
-	for (transactions_t::iterator i = m_transactions.begin();
-		i != m_transactions.end();)
+	std::pair<transactions_t::iterator, transactions_t::iterator> range
+		= m_transactions.equal_range(ep.address());
+	for (transactions_t::iterator i = range.first; i != range.second; ++i)
 	{
-		TORRENT_ASSERT(*i);
-		observer_ptr const& o = *i;
-		if (o->target_ep() != ep) { ++i; continue; }
-		observer_ptr ptr = *i;
-		i = m_transactions.erase(i);
+		TORRENT_ASSERT(i->second);
+		if (i->second->target_ep() != ep) continue;
+		observer_ptr ptr = remove_transaction(i);
 #ifdef TORRENT_DHT_VERBOSE_LOGGING
 		TORRENT_LOG(rpc) << "  found transaction [ tid: " << ptr->transaction_id() << " ]";
 #endif
@@ -274,6 +332,24 @@ void rpc_manager::unreachable(udp::endpoint const& ep)
 // defined in node.cpp
 void incoming_error(entry& e, char const* msg, int error_code = 203);
 
+bool rpc_manager::is_outstanding(msg const& m) const
+{
+	lazy_entry const* t = m.message.dict_find_string("t");
+	if (t == 0 || t->string_length() != 2) return false;
+
+	char const* ptr = t->string_ptr();
+	int tid = io::read_uint16(ptr);
+
+	std::pair<transactions_t::const_iterator, transactions_t::const_iterator> range
+		= m_transactions.equal_range(m.addr.address());
+	for (transactions_t::const_iterator i = range.first; i != range.second; ++i)
+	{
+		TORRENT_ASSERT(i->second);
+		if (i->second->transaction_id() == tid) return true;
+	}
+	return false;
+}
+
 bool rpc_manager::incoming(msg const& m, node_id* id, libtorrent::dht_settings const& settings)
 {
 	INVARIANT_CHECK;
@@ -295,18 +371,13 @@ bool rpc_manager::incoming(msg const& m, node_id* id, libtorrent::dht_settings c
 
 	observer_ptr o;
 
-	for (transactions_t::iterator i = m_transactions.begin()
-		, end(m_transactions.end()); i != end;)
+	std::pair<transactions_t::iterator, transactions_t::iterator> range
+		= m_transactions.equal_range(m.addr.address());
+	for (transactions_t::iterator i = range.first; i != range.second; ++i)
 	{
-		TORRENT_ASSERT(*i);
-		if ((*i)->transaction_id() != tid
-			|| m.addr.address() != (*i)->target_addr())
-		{
-			++i;
-			continue;
-		}
-		o = *i;
-		i = m_transactions.erase(i);
+		TORRENT_ASSERT(i->second);
+		if (i->second->transaction_id() != tid) continue;
+		o = remove_transaction(i);
 		break;
 	}
 
@@ -395,67 +466,58 @@ time_duration rpc_manager::tick()
 
 	if (m_transactions.empty()) return seconds(short_timeout);
 
-	std::list<observer_ptr> timeouts;
+	std::vector<observer_ptr> timeouts;
 
 	time_duration ret = seconds(short_timeout);
 	ptime now = time_now();
 
-#if TORRENT_USE_ASSERTS
-	ptime last = min_time();
-	for (transactions_t::iterator i = m_transactions.begin();
-		i != m_transactions.end(); ++i)
-	{
-		TORRENT_ASSERT((*i)->sent() >= last);
-		last = (*i)->sent();
-	}
-#endif
-
-	for (transactions_t::iterator i = m_transactions.begin();
-		i != m_transactions.end();)
+	// the list is in the order the requests were sent. Once we reach
+	// an observer that hasn't timed out, every observer after it
+	// hasn't either
+	while (m_oldest_transaction)
 	{
-		observer_ptr o = *i;
-
-		// if we reach an observer that hasn't timed out
-		// break, because every observer after this one will
-		// also not have timed out yet
+		observer* o = m_oldest_transaction;
 		time_duration diff = now - o->sent();
 		if (diff < seconds(timeout))
 		{
 			ret = seconds(timeout) - diff;
 			break;
 		}
-		
+
 #ifdef TORRENT_DHT_VERBOSE_LOGGING
 		TORRENT_LOG(rpc) << "[" << o->m_algorithm.get() << "] Timing out transaction id: " 
-			<< (*i)->transaction_id() << " from " << o->target_ep();
+			<< o->transaction_id() << " from " << o->target_ep();
 #endif
-		i = m_transactions.erase(i);
-		timeouts.push_back(o);
+		std::pair<transactions_t::iterator, transactions_t::iterator> range
+			= m_transactions.equal_range(o->target_addr());
+		transactions_t::iterator i = range.first;
+		while (i != range.second && i->second.get() != o) ++i;
+		TORRENT_ASSERT(i != range.second);
+		if (i == range.second) break;
+		timeouts.push_back(remove_transaction(i));
 	}
 	
 	std::for_each(timeouts.begin(), timeouts.end(), boost::bind(&observer::timeout, _1));
 	timeouts.clear();
 
-	for (transactions_t::iterator i = m_transactions.begin();
-		i != m_transactions.end(); ++i)
+	// the observers before m_next_short_timeout have already
+	// been considered for a short timeout
+	while (m_next_short_timeout)
 	{
-		observer_ptr o = *i;
-
-		// if we reach an observer that hasn't timed out
-		// break, because every observer after this one will
-		// also not have timed out yet
+		observer* o = m_next_short_timeout;
 		time_duration diff = now - o->sent();
 		if (diff < seconds(short_timeout))
 		{
-			ret = seconds(short_timeout) - diff;
+			ret = (std::min)(ret, seconds(short_timeout) - diff);
 			break;
 		}
+		m_next_short_timeout = o->m_next_transaction;
 		
 		// don't call short_timeout() again if we've
 		// already called it once
 		if (o->has_short_timeout()) continue;
 
-		timeouts.push_back(o);
+		timeouts.push_back(observer_ptr(o));
 	}
 
 	std::for_each(timeouts.begin(), timeouts.end(), boost::bind(&observer::short_timeout, _1));
@@ -496,7 +558,15 @@ bool rpc_manager::invoke(entry& e, udp::endpoint target_addr
 
 	if (m_sock->send_packet(e, target_addr, 1))
 	{
-		m_transactions.push_back(o);
+		m_transactions.insert(std::make_pair(target_addr.address(), o));
+
+		observer* p = o.get();
+		p->m_prev_transaction = m_newest_transaction;
+		if (m_newest_transaction) m_newest_transaction->m_next_transaction = p;
+		else m_oldest_transaction = p;
+		m_newest_transaction = p;
+		if (m_next_short_timeout == 0) m_next_short_timeout = p;
+
 #if TORRENT_USE_ASSERTS
 		o->m_was_sent = true;
 #endif
@@ -513,6 +583,7 @@ observer::~observer()
 	// reported back
 	TORRENT_ASSERT(m_was_sent == bool(flags & flag_done) || m_was_abandoned);
 	TORRENT_ASSERT(!m_in_constructor);
+	TORRENT_ASSERT(m_next_transaction == 0 && m_prev_transaction == 0);
 #if TORRENT_USE_ASSERTS
 	TORRENT_ASSERT(m_in_use);
 	m_in_use = false;
@@ -0,0 +1,159 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/latency_histogram.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <cstring> // for memset
+
+namespace libtorrent
+{
+	latency_histogram::latency_histogram()
+	{
+		clear();
+	}
+
+	latency_histogram::latency_histogram(latency_histogram const& h)
+	{
+		boost::uint64_t buckets[num_buckets];
+		h.snapshot(buckets);
+#if TORRENT_ATOMIC_HISTOGRAM
+		for (int i = 0; i < num_buckets; ++i)
+			m_buckets[i].store(buckets[i], boost::memory_order_relaxed);
+#else
+		std::memcpy(m_buckets, buckets, sizeof(m_buckets));
+#endif
+	}
+
+	latency_histogram& latency_histogram::operator=(latency_histogram const& h)
+	{
+		if (&h == this) return *this;
+		boost::uint64_t buckets[num_buckets];
+		h.snapshot(buckets);
+#if TORRENT_ATOMIC_HISTOGRAM
+		for (int i = 0; i < num_buckets; ++i)
+			m_buckets[i].store(buckets[i], boost::memory_order_relaxed);
+#else
+		mutex::scoped_lock l(m_mutex);
+		std::memcpy(m_buckets, buckets, sizeof(m_buckets));
+#endif
+		return *this;
+	}
+
+	void latency_histogram::clear()
+	{
+#if TORRENT_ATOMIC_HISTOGRAM
+		for (int i = 0; i < num_buckets; ++i)
+			m_buckets[i].store(0, boost::memory_order_relaxed);
+#else
+		mutex::scoped_lock l(m_mutex);
+		std::memset(m_buckets, 0, sizeof(m_buckets));
+#endif
+	}
+
+	int latency_histogram::bucket_for(boost::int64_t v)
+	{
+		if (v < sub_buckets) return v < 0 ? 0 : int(v);
+		if (v >= (boost::int64_t(1) << max_exponent))
+			return num_buckets - 1;
+
+		// find the highest set bit
+		int e = sub_bucket_bits;
+		while ((v >> (e + 1)) != 0) ++e;
+
+		int const sub = int(v >> (e - sub_bucket_bits)) & (sub_buckets - 1);
+		int const ret = (e - 1) * sub_buckets + sub;
+		TORRENT_ASSERT(ret >= 0);
+		TORRENT_ASSERT(ret < num_buckets);
+		return ret;
+	}
+
+	boost::int64_t latency_histogram::bucket_lower_bound(int b)
+	{
+		TORRENT_ASSERT(b >= 0);
+		if (b < sub_buckets) return b;
+		int const e = b / sub_buckets + 1;
+		int const sub = b % sub_buckets;
+		return boost::int64_t(sub_buckets + sub) << (e - sub_bucket_bits);
+	}
+
+	void latency_histogram::add_sample(boost::int64_t microseconds)
+	{
+		int const b = bucket_for(microseconds);
+#if TORRENT_ATOMIC_HISTOGRAM
+		m_buckets[b].fetch_add(1, boost::memory_order_relaxed);
+#else
+		mutex::scoped_lock l(m_mutex);
+		++m_buckets[b];
+#endif
+	}
+
+	void latency_histogram::snapshot(boost::uint64_t* buckets) const
+	{
+#if TORRENT_ATOMIC_HISTOGRAM
+		for (int i = 0; i < num_buckets; ++i)
+			buckets[i] = m_buckets[i].load(boost::memory_order_relaxed);
+#else
+		mutex::scoped_lock l(m_mutex);
+		std::memcpy(buckets, m_buckets, sizeof(m_buckets));
+#endif
+	}
+
+	boost::uint64_t latency_histogram::num_samples(boost::uint64_t const* buckets)
+	{
+		boost::uint64_t ret = 0;
+		for (int i = 0; i < num_buckets; ++i) ret += buckets[i];
+		return ret;
+	}
+
+	boost::int64_t latency_histogram::percentile(boost::uint64_t const* buckets
+		, double p)
+	{
+		boost::uint64_t const total = num_samples(buckets);
+		if (total == 0) return 0;
+
+		// the number of samples at or below the percentile. Always include
+		// at least one sample, to make the 0th percentile the minimum
+		boost::uint64_t limit = boost::uint64_t(total * p / 100.0 + 0.5);
+		if (limit < 1) limit = 1;
+		if (limit > total) limit = total;
+
+		boost::uint64_t sum = 0;
+		for (int i = 0; i < num_buckets - 1; ++i)
+		{
+			sum += buckets[i];
+			if (sum >= limit) return bucket_lower_bound(i + 1) - 1;
+		}
+		return bucket_lower_bound(num_buckets - 1);
+	}
+}
+
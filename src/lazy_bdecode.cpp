@@ -33,6 +33,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/config.hpp"
 #include "libtorrent/lazy_entry.hpp"
 #include <cstring>
+#include <new>
+#include <algorithm>
 
 namespace
 {
@@ -46,26 +48,48 @@ namespace libtorrent
 
 	namespace
 	{
-		int fail(int* error_pos
-			, std::vector<lazy_entry*>& stack
-			, char const* start
-			, char const* orig_start)
+		typedef lazy_bdecode_arena::token token_t;
+
+		// an entry in the hash index that follows the entries of an indexed
+		// dictionary. Sorted by hash, then by index
+		struct dict_index_entry
 		{
-			while (!stack.empty()) {
-				lazy_entry* top = stack.back();
-				if (top->type() == lazy_entry::dict_t || top->type() == lazy_entry::list_t)
-				{
-					top->pop();
-					break;
-				}
-				stack.pop_back();
+			boost::uint32_t hash;
+			boost::uint32_t index;
+
+			bool operator<(dict_index_entry const& rhs) const
+			{
+				return hash < rhs.hash
+					|| (hash == rhs.hash && index < rhs.index);
+			}
+		};
+
+		bool hash_less(dict_index_entry const& e, boost::uint32_t h)
+		{ return e.hash < h; }
+
+		dict_index_entry* dict_index(lazy_dict_entry* d, int size)
+		{ return reinterpret_cast<dict_index_entry*>(d + size); }
+
+		// FNV-1a
+		boost::uint32_t key_hash(char const* str, int len)
+		{
+			boost::uint32_t ret = 2166136261u;
+			for (int i = 0; i < len; ++i)
+			{
+				ret ^= boost::uint8_t(str[i]);
+				ret *= 16777619u;
 			}
+			return ret;
+		}
+
+		int fail(int* error_pos, char const* start, char const* orig_start)
+		{
 			if (error_pos) *error_pos = start - orig_start;
 			return -1;
 		}
 	}
 
-#define TORRENT_FAIL_BDECODE(code) do { ec = make_error_code(code); return fail(error_pos, stack, start, orig_start); } while (false)
+#define TORRENT_FAIL_BDECODE(code) do { ec = make_error_code(code); return fail(error_pos, start, orig_start); } while (false)
 
 	namespace { bool numeric(char c) { return c >= '0' && c <= '9'; } }
 
@@ -119,126 +143,328 @@ namespace libtorrent
 	}
 #endif
 
-	// return 0 = success
-	int lazy_bdecode(char const* start, char const* end, lazy_entry& ret
-		, error_code& ec, int* error_pos, int depth_limit, int item_limit)
-	{
-		char const* const orig_start = start;
-		ret.clear();
-		if (start == end) return 0;
+	lazy_bdecode_arena::lazy_bdecode_arena()
+		: index_threshold(0)
+		, storage(0)
+		, storage_size(0)
+	{}
 
-		std::vector<lazy_entry*> stack;
+	lazy_bdecode_arena::~lazy_bdecode_arena()
+	{
+		::operator delete(storage);
+	}
 
-		stack.push_back(&ret);
-		while (start <= end)
+	namespace
+	{
+		// splits the buffer into a flat array of tokens in arena.tokens. While
+		// a dict or list is open, its next_item field links to its parent, so
+		// no separate stack is needed. On success, bytes is set to the amount
+		// of memory build_tree() needs for the children of all lists and
+		// dictionaries
+		int tokenize(char const* start, char const* end
+			, lazy_bdecode_arena& arena, error_code& ec, int* error_pos
+			, int depth_limit, int item_limit, std::size_t& bytes)
 		{
-			if (stack.empty()) break; // done!
+			char const* const orig_start = start;
+			std::vector<token_t>& tokens = arena.tokens;
+			tokens.clear();
+			bytes = 0;
 
-			lazy_entry* top = stack.back();
+			// the innermost open list or dictionary, or -1
+			int parent = -1;
+			int depth = 0;
 
-			if (int(stack.size()) > depth_limit) TORRENT_FAIL_BDECODE(bdecode_errors::depth_exceeded);
-			if (start >= end) TORRENT_FAIL_BDECODE(bdecode_errors::unexpected_eof);
-			char t = *start;
-			++start;
-			if (start >= end && t != 'e') TORRENT_FAIL_BDECODE(bdecode_errors::unexpected_eof);
-
-			switch (top->type())
+			for (;;)
 			{
-				case lazy_entry::dict_t:
+				if (depth > depth_limit) TORRENT_FAIL_BDECODE(bdecode_errors::depth_exceeded);
+				if (start >= end) TORRENT_FAIL_BDECODE(bdecode_errors::unexpected_eof);
+				char t = *start;
+				++start;
+				if (start >= end && t != 'e') TORRENT_FAIL_BDECODE(bdecode_errors::unexpected_eof);
+
+				if (parent >= 0)
 				{
+					token_t& p = tokens[parent];
 					if (t == 'e')
 					{
-						top->set_end(start);
-						stack.pop_back();
+						int const up = int(p.next_item);
+						p.length = start - orig_start - p.offset;
+						p.next_item = tokens.size();
+						if (p.type == lazy_entry::dict_t
+							&& arena.index_threshold > 0
+							&& int(p.size) >= arena.index_threshold)
+							bytes += p.size * sizeof(dict_index_entry);
+						parent = up;
+						--depth;
+						if (parent < 0) return 0;
 						continue;
 					}
-					if (!numeric(t)) TORRENT_FAIL_BDECODE(bdecode_errors::expected_string);
-					boost::int64_t len = t - '0';
-					bdecode_errors::error_code_enum e = bdecode_errors::no_error;
-					start = parse_int(start, end, ':', len, e);
-					if (e)
-						TORRENT_FAIL_BDECODE(e);
-
-					if (start + len + 1 > end)
-						TORRENT_FAIL_BDECODE(bdecode_errors::unexpected_eof);
-
-					if (len < 0)
-						TORRENT_FAIL_BDECODE(bdecode_errors::overflow);
-
-					++start;
-					if (start == end) TORRENT_FAIL_BDECODE(bdecode_errors::unexpected_eof);
-					lazy_entry* ent = top->dict_append(start);
-					if (ent == 0) TORRENT_FAIL_BDECODE(boost::system::errc::not_enough_memory);
-					start += len;
-					if (start >= end) TORRENT_FAIL_BDECODE(bdecode_errors::unexpected_eof);
-					stack.push_back(ent);
-					t = *start;
-					++start;
+
+					++p.size;
+					if (p.type == lazy_entry::dict_t)
+					{
+						bytes += sizeof(lazy_dict_entry);
+
+						if (!numeric(t)) TORRENT_FAIL_BDECODE(bdecode_errors::expected_string);
+						boost::int64_t len = t - '0';
+						bdecode_errors::error_code_enum e = bdecode_errors::no_error;
+						start = parse_int(start, end, ':', len, e);
+						if (e)
+							TORRENT_FAIL_BDECODE(e);
+
+						if (start + len + 1 > end)
+							TORRENT_FAIL_BDECODE(bdecode_errors::unexpected_eof);
+
+						if (len < 0)
+							TORRENT_FAIL_BDECODE(bdecode_errors::overflow);
+
+						++start;
+						if (start == end) TORRENT_FAIL_BDECODE(bdecode_errors::unexpected_eof);
+
+						token_t key;
+						key.offset = start - orig_start;
+						key.length = boost::uint32_t(len);
+						key.next_item = tokens.size() + 1;
+						key.size = 0;
+						key.type = lazy_entry::string_t;
+						tokens.push_back(key);
+
+						start += len;
+						if (start >= end) TORRENT_FAIL_BDECODE(bdecode_errors::unexpected_eof);
+						t = *start;
+						++start;
+					}
+					else
+					{
+						bytes += sizeof(lazy_entry);
+					}
+				}
+
+				--item_limit;
+				if (item_limit <= 0) TORRENT_FAIL_BDECODE(bdecode_errors::limit_exceeded);
+
+				token_t tok;
+				tok.size = 0;
+				switch (t)
+				{
+					case 'd':
+					case 'l':
+						tok.type = t == 'd' ? lazy_entry::dict_t : lazy_entry::list_t;
+						tok.offset = start - 1 - orig_start;
+						tok.length = 0;
+						// link to the parent while this one is open
+						tok.next_item = boost::uint32_t(parent);
+						parent = int(tokens.size());
+						tokens.push_back(tok);
+						++depth;
+						continue;
+					case 'i':
+					{
+						char const* int_start = start;
+						start = find_char(start, end, 'e');
+						if (start == end) TORRENT_FAIL_BDECODE(bdecode_errors::unexpected_eof);
+						TORRENT_ASSERT(*start == 'e');
+						tok.type = lazy_entry::int_t;
+						tok.offset = int_start - orig_start;
+						tok.length = start - int_start;
+						tok.next_item = tokens.size() + 1;
+						tokens.push_back(tok);
+						++start;
+						break;
+					}
+					default:
+					{
+						if (!numeric(t))
+							TORRENT_FAIL_BDECODE(bdecode_errors::expected_value);
+
+						boost::int64_t len = t - '0';
+						bdecode_errors::error_code_enum e = bdecode_errors::no_error;
+						start = parse_int(start, end, ':', len, e);
+						if (e)
+							TORRENT_FAIL_BDECODE(e);
+						if (start + len + 1 > end)
+							TORRENT_FAIL_BDECODE(bdecode_errors::unexpected_eof);
+						if (len < 0)
+							TORRENT_FAIL_BDECODE(bdecode_errors::overflow);
+
+						++start;
+						tok.type = lazy_entry::string_t;
+						tok.offset = start - orig_start;
+						tok.length = boost::uint32_t(len);
+						tok.next_item = tokens.size() + 1;
+						tokens.push_back(tok);
+						start += len;
+						break;
+					}
+				}
+
+				// a string or integer at the root is the whole message
+				if (parent < 0) return 0;
+			}
+		}
+
+		// constructs e from token i. The children of a list or dictionary
+		// are constructed at storage, which is advanced past them, and the
+		// list or dictionary is pushed onto frames to have its children
+		// filled in
+		void construct(lazy_entry& e, int i, char const* buf
+			, lazy_bdecode_arena& arena, char*& storage)
+		{
+			token_t const& t = arena.tokens[i];
+			switch (t.type)
+			{
+				case lazy_entry::int_t:
+					e.construct_int(buf + t.offset, t.length);
+					break;
+				case lazy_entry::string_t:
+					e.construct_string(buf + t.offset, t.length);
+					break;
+				case lazy_entry::dict_t:
+				{
+					int const size = t.size;
+					bool const indexed = arena.index_threshold > 0
+						&& size >= arena.index_threshold;
+					lazy_dict_entry* d = e.construct_dict(buf + t.offset, t.length
+						, storage, size, indexed);
+					storage += size * sizeof(lazy_dict_entry);
+					if (indexed)
+					{
+						dict_index_entry* idx = dict_index(d, size);
+						int k = i + 1;
+						for (int j = 0; j < size; ++j)
+						{
+							token_t const& key = arena.tokens[k];
+							idx[j].hash = key_hash(buf + key.offset, key.length);
+							idx[j].index = j;
+							// skip the key and the value
+							k = arena.tokens[k + 1].next_item;
+						}
+						std::sort(idx, idx + size);
+						storage += size * sizeof(dict_index_entry);
+					}
+					if (size > 0)
+					{
+						lazy_bdecode_arena::frame f = { d, 0, i + 1, size };
+						arena.frames.push_back(f);
+					}
 					break;
 				}
 				case lazy_entry::list_t:
 				{
-					if (t == 'e')
+					int const size = t.size;
+					lazy_entry* l = e.construct_list(buf + t.offset, t.length
+						, storage, size);
+					storage += size * sizeof(lazy_entry);
+					if (size > 0)
 					{
-						top->set_end(start);
-						stack.pop_back();
-						continue;
+						lazy_bdecode_arena::frame f = { 0, l, i + 1, size };
+						arena.frames.push_back(f);
 					}
-					lazy_entry* ent = top->list_append();
-					if (ent == 0) TORRENT_FAIL_BDECODE(boost::system::errc::not_enough_memory);
-					stack.push_back(ent);
 					break;
 				}
-				default: break;
+				default: TORRENT_ASSERT(false);
 			}
+		}
 
-			--item_limit;
-			if (item_limit <= 0) TORRENT_FAIL_BDECODE(bdecode_errors::limit_exceeded);
+		// builds the lazy_entry tree from the token array. Every list and
+		// dictionary gets an array of exactly the right size, taken from
+		// storage in the order they appear
+		void build_tree(lazy_entry& ret, char const* buf
+			, lazy_bdecode_arena& arena, char* storage)
+		{
+			std::vector<lazy_bdecode_arena::frame>& frames = arena.frames;
+			frames.clear();
+			construct(ret, 0, buf, arena, storage);
 
-			top = stack.back();
-			switch (t)
+			while (!frames.empty())
 			{
-				case 'd':
-					top->construct_dict(start - 1);
-					continue;
-				case 'l':
-					top->construct_list(start - 1);
-					continue;
-				case 'i':
+				lazy_bdecode_arena::frame& f = frames.back();
+				if (f.remaining == 0)
 				{
-					char const* int_start = start;
-					start = find_char(start, end, 'e');
-					top->construct_int(int_start, start - int_start);
-					if (start == end) TORRENT_FAIL_BDECODE(bdecode_errors::unexpected_eof);
-					TORRENT_ASSERT(*start == 'e');
-					++start;
-					stack.pop_back();
+					frames.pop_back();
 					continue;
 				}
-				default:
+				--f.remaining;
+
+				int tok = f.next_token;
+				lazy_entry* e;
+				if (f.dict)
 				{
-					if (!numeric(t))
-						TORRENT_FAIL_BDECODE(bdecode_errors::expected_value);
-
-					boost::int64_t len = t - '0';
-					bdecode_errors::error_code_enum e = bdecode_errors::no_error;
-					start = parse_int(start, end, ':', len, e);
-					if (e)
-						TORRENT_FAIL_BDECODE(e);
-					if (start + len + 1 > end)
-						TORRENT_FAIL_BDECODE(bdecode_errors::unexpected_eof);
-					if (len < 0)
-						TORRENT_FAIL_BDECODE(bdecode_errors::overflow);
-
-					++start;
-					top->construct_string(start, int(len));
-					stack.pop_back();
-					start += len;
-					continue;
+					f.dict->name = buf + arena.tokens[tok].offset;
+					e = &f.dict->val;
+					++f.dict;
+					++tok;
 				}
+				else
+				{
+					e = f.list;
+					++f.list;
+				}
+				f.next_token = arena.tokens[tok].next_item;
+				// this may push a new frame, invalidating f
+				construct(*e, tok, buf, arena, storage);
 			}
-			return 0;
 		}
+	}
+
+	// return 0 = success
+	int lazy_bdecode(char const* start, char const* end, lazy_entry& ret
+		, error_code& ec, int* error_pos, int depth_limit, int item_limit)
+	{
+		ret.clear();
+		if (start == end) return 0;
+
+		lazy_bdecode_arena arena;
+		// typical bencoded data averages more than 7 bytes per token. Growing
+		// the token array while parsing large files is a significant part of
+		// the decode time, so reserve what most inputs need up front
+		arena.tokens.reserve(int(end - start) / 7 + 1);
+		std::size_t bytes;
+		if (tokenize(start, end, arena, ec, error_pos, depth_limit, item_limit, bytes) != 0)
+			return -1;
+
+		char* storage = 0;
+		if (bytes > 0)
+		{
+			storage = static_cast<char*>(::operator new(bytes, std::nothrow));
+			if (storage == 0)
+			{
+				ec = make_error_code(boost::system::errc::not_enough_memory);
+				if (error_pos) *error_pos = 0;
+				return -1;
+			}
+		}
+		build_tree(ret, start, arena, storage);
+		// the root's children are the first thing in the block
+		if (storage) ret.own_storage();
+		return 0;
+	}
+
+	int lazy_bdecode(char const* start, char const* end, lazy_entry& ret
+		, lazy_bdecode_arena& arena, error_code& ec, int* error_pos
+		, int depth_limit, int item_limit)
+	{
+		ret.clear();
+		if (start == end) return 0;
+
+		std::size_t bytes;
+		if (tokenize(start, end, arena, ec, error_pos, depth_limit, item_limit, bytes) != 0)
+			return -1;
+
+		if (int(bytes) > arena.storage_size)
+		{
+			char* storage = static_cast<char*>(::operator new(bytes, std::nothrow));
+			if (storage == 0)
+			{
+				ec = make_error_code(boost::system::errc::not_enough_memory);
+				if (error_pos) *error_pos = 0;
+				return -1;
+			}
+			::operator delete(arena.storage);
+			arena.storage = storage;
+			arena.storage_size = int(bytes);
+		}
+		build_tree(ret, start, arena, arena.storage);
 		return 0;
 	}
 
@@ -256,9 +482,41 @@ namespace libtorrent
 		return val;
 	}
 
+	lazy_dict_entry* lazy_entry::construct_dict(char const* begin, int len
+		, void* storage, int size, bool indexed)
+	{
+		TORRENT_ASSERT(m_type == none_t);
+		m_type = dict_t;
+		m_storage = external_storage;
+		m_indexed = indexed;
+		m_size = size;
+		m_capacity = 0;
+		m_begin = begin;
+		m_len = len;
+		m_data.dict = static_cast<lazy_dict_entry*>(storage);
+		for (int i = 0; i < size; ++i) new (m_data.dict + i) lazy_dict_entry;
+		return m_data.dict;
+	}
+
+	lazy_entry* lazy_entry::construct_list(char const* begin, int len
+		, void* storage, int size)
+	{
+		TORRENT_ASSERT(m_type == none_t);
+		m_type = list_t;
+		m_storage = external_storage;
+		m_size = size;
+		m_capacity = 0;
+		m_begin = begin;
+		m_len = len;
+		m_data.list = static_cast<lazy_entry*>(storage);
+		for (int i = 0; i < size; ++i) new (m_data.list + i) lazy_entry;
+		return m_data.list;
+	}
+
 	lazy_entry* lazy_entry::dict_append(char const* name)
 	{
 		TORRENT_ASSERT(m_type == dict_t);
+		TORRENT_ASSERT(m_storage == heap_storage);
 		TORRENT_ASSERT(m_size <= m_capacity);
 		if (m_capacity == 0)
 		{
@@ -394,6 +652,21 @@ namespace libtorrent
 	lazy_entry* lazy_entry::dict_find(char const* name)
 	{
 		TORRENT_ASSERT(m_type == dict_t);
+		if (m_indexed)
+		{
+			boost::uint32_t const h = key_hash(name, int(std::strlen(name)));
+			dict_index_entry const* idx = dict_index(m_data.dict, m_size);
+			dict_index_entry const* end = idx + m_size;
+			for (dict_index_entry const* i = std::lower_bound(idx, end, h, &hash_less);
+				i != end && i->hash == h; ++i)
+			{
+				lazy_dict_entry& e = m_data.dict[i->index];
+				if (string_equal(name, e.name, e.val.m_begin - e.name))
+					return &e.val;
+			}
+			return 0;
+		}
+
 		for (int i = 0; i < int(m_size); ++i)
 		{
 			lazy_dict_entry& e = m_data.dict[i];
@@ -406,6 +679,7 @@ namespace libtorrent
 	lazy_entry* lazy_entry::list_append()
 	{
 		TORRENT_ASSERT(m_type == list_t);
+		TORRENT_ASSERT(m_storage == heap_storage);
 		TORRENT_ASSERT(m_size <= m_capacity);
 		if (m_capacity == 0)
 		{
@@ -453,15 +727,26 @@ namespace libtorrent
 
 	void lazy_entry::clear()
 	{
-		switch (m_type)
+		if (m_storage == heap_storage)
+		{
+			switch (m_type)
+			{
+				case list_t: delete[] m_data.list; break;
+				case dict_t: delete[] m_data.dict; break;
+				default: break;
+			}
+		}
+		else if (m_storage == owned_storage)
 		{
-			case list_t: delete[] m_data.list; break;
-			case dict_t: delete[] m_data.dict; break;
-			default: break;
+			// the children don't own any memory, there is no need to run
+			// their destructors
+			::operator delete(m_data.list);
 		}
 		m_data.start = 0;
 		m_size = 0;
 		m_capacity = 0;
+		m_storage = heap_storage;
+		m_indexed = false;
 		m_type = none_t;
 	}
 
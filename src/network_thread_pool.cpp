@@ -0,0 +1,143 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/network_thread_pool.hpp"
+#include "libtorrent/peer_connection.hpp"
+#include "libtorrent/io_service.hpp"
+
+#include <boost/bind.hpp>
+
+namespace libtorrent
+{
+	namespace
+	{
+		// used to drop a reference to a peer on the network thread, rather
+		// than on a pool thread, in case it's the last one
+		void release_peer(boost::intrusive_ptr<peer_connection> const&) {}
+	}
+
+	network_thread_pool::network_thread_pool(io_service& ios)
+		: m_ios(ios)
+	{}
+
+	network_thread_pool::~network_thread_pool()
+	{
+		stop();
+	}
+
+	void network_thread_pool::set_num_threads(int n)
+	{
+		if (n < 0) n = 0;
+		if (n == int(m_shards.size())) return;
+
+		// the peer-to-thread mapping depends on the number of threads, so
+		// all threads are drained and restarted. This makes sure jobs for a
+		// single peer are never executed out of order
+		for (std::vector<boost::shared_ptr<shard> >::iterator i = m_shards.begin()
+			, end(m_shards.end()); i != end; ++i)
+		{
+			shard& s = **i;
+			mutex::scoped_lock l(s.queue_mutex);
+			s.abort = true;
+			s.cond.notify_all();
+		}
+		for (std::vector<boost::shared_ptr<shard> >::iterator i = m_shards.begin()
+			, end(m_shards.end()); i != end; ++i)
+			(*i)->worker->join();
+		m_shards.clear();
+
+		for (int i = 0; i < n; ++i)
+		{
+			boost::shared_ptr<shard> s(new shard);
+			s->worker.reset(new thread(boost::bind(
+				&network_thread_pool::thread_fun, this, s.get())));
+			m_shards.push_back(s);
+		}
+	}
+
+	void network_thread_pool::post_job(socket_job const& j)
+	{
+		if (m_shards.empty())
+		{
+			socket_job tmp(j);
+			process_job(tmp, false);
+			return;
+		}
+
+		// the peer object's address is used to pick its thread. Divide by
+		// the size to make use of the low bits
+		std::size_t const idx = (std::size_t(j.peer.get()) / sizeof(peer_connection))
+			% m_shards.size();
+		shard& s = *m_shards[idx];
+
+		mutex::scoped_lock l(s.queue_mutex);
+		s.jobs.push_back(j);
+		if (s.jobs.size() == 1) s.cond.notify_all();
+	}
+
+	void network_thread_pool::thread_fun(shard* s)
+	{
+		mutex::scoped_lock l(s->queue_mutex);
+		for (;;)
+		{
+			while (s->jobs.empty() && !s->abort) s->cond.wait(l);
+
+			// drain the queue before exiting
+			if (s->jobs.empty()) return;
+
+			socket_job j = s->jobs.front();
+			s->jobs.pop_front();
+			l.unlock();
+			process_job(j, true);
+			l.lock();
+		}
+	}
+
+	void network_thread_pool::process_job(socket_job& j, bool post)
+	{
+		switch (j.type)
+		{
+			case socket_job::write_job:
+				TORRENT_ASSERT(!j.vec.empty());
+				j.peer->async_write_send_buffer(j.vec);
+				break;
+			case socket_job::close_job:
+				j.peer->shutdown_socket();
+				break;
+		}
+
+		// the network thread may have dropped all its references to the
+		// peer by now. Make sure it's destructed on the network thread
+		if (post) m_ios.post(boost::bind(&release_peer, j.peer));
+	}
+}
+
@@ -0,0 +1,116 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/packet_pool.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <stdlib.h> // for malloc and free
+
+namespace libtorrent
+{
+	packet_pool::packet_pool()
+		: m_hits(0)
+		, m_misses(0)
+		, m_in_use(0)
+		, m_high_water(0)
+	{
+		m_small.reserve(max_small_free);
+		m_mtu.reserve(max_mtu_free);
+	}
+
+	packet_pool::~packet_pool()
+	{
+		for (std::vector<packet*>::iterator i = m_small.begin()
+			, end(m_small.end()); i != end; ++i)
+			free(*i);
+		for (std::vector<packet*>::iterator i = m_mtu.begin()
+			, end(m_mtu.end()); i != end; ++i)
+			free(*i);
+	}
+
+	packet* packet_pool::acquire(int size)
+	{
+		TORRENT_ASSERT(size >= 0);
+		TORRENT_ASSERT(size <= 0xffff);
+
+		++m_in_use;
+		if (m_in_use > m_high_water) m_high_water = m_in_use;
+
+		std::vector<packet*>* l = 0;
+		int size_class = heap_class;
+		int alloc_size = size;
+		if (size <= small_size)
+		{
+			l = &m_small;
+			size_class = small_class;
+			alloc_size = small_size;
+		}
+		else if (size <= mtu_size)
+		{
+			l = &m_mtu;
+			size_class = mtu_class;
+			alloc_size = mtu_size;
+		}
+
+		packet* p;
+		if (l && !l->empty())
+		{
+			++m_hits;
+			p = l->back();
+			l->pop_back();
+		}
+		else
+		{
+			++m_misses;
+			p = (packet*)malloc(sizeof(packet) + alloc_size);
+		}
+		p->size_class = size_class;
+		p->allocated = size;
+		return p;
+	}
+
+	void packet_pool::release(packet* p)
+	{
+		if (p == 0) return;
+
+		TORRENT_ASSERT(m_in_use > 0);
+		--m_in_use;
+
+		if (p->size_class == small_class && int(m_small.size()) < max_small_free)
+			m_small.push_back(p);
+		else if (p->size_class == mtu_class && int(m_mtu.size()) < max_mtu_free)
+			m_mtu.push_back(p);
+		else
+			free(p);
+	}
+}
+
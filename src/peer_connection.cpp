@@ -78,6 +78,23 @@ namespace libtorrent
 		return ((v & 7) == 0) ? v : v + (8 - (v & 7));
 	}
 
+	namespace
+	{
+		// adds the time from its construction until it goes out of scope
+		// to one of the latency histograms
+		struct latency_sample
+		{
+			latency_sample(counters& c, int h)
+				: m_counters(c), m_histogram(h), m_start(time_now_hires()) {}
+			~latency_sample()
+			{ m_counters.add_latency_sample(m_histogram, time_now_hires() - m_start); }
+		private:
+			counters& m_counters;
+			int m_histogram;
+			ptime m_start;
+		};
+	}
+
 #if defined TORRENT_REQUEST_LOGGING
 	void write_request_log(FILE* f, sha1_hash const& ih
 		, peer_connection* p, peer_request const& r)
@@ -242,8 +259,8 @@ namespace libtorrent
 #endif
 #if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_ERROR_LOGGING
 		error_code ec;
-		TORRENT_ASSERT(m_socket->remote_endpoint(ec) == m_remote || ec);
-		tcp::endpoint local_ep = m_socket->local_endpoint(ec);
+		TORRENT_ASSERT(socket_remote_endpoint(ec) == m_remote || ec);
+		tcp::endpoint local_ep = socket_local_endpoint(ec);
 		std::string log_name = "[" + local_ep.address().to_string(ec) + "#"
 			+ to_string(local_ep.port()).elems + "]-"
 			"[" + m_remote.address().to_string(ec) + "#"
@@ -1362,9 +1379,7 @@ namespace libtorrent
 
 		if (m_request_queue.empty() && m_download_queue.size() < 2)
 		{
-#ifdef TORRENT_STATS
-			++m_ses.m_reject_piece_picks;
-#endif
+			m_ses.inc_stats_counter(counters::reject_piece_picks);
 			request_a_block(*t, *this);
 			send_block_requests();
 		}
@@ -1456,9 +1471,7 @@ namespace libtorrent
 
 		if (is_interesting())
 		{
-#ifdef TORRENT_STATS
-			++m_ses.m_unchoke_piece_picks;
-#endif
+			m_ses.inc_stats_counter(counters::unchoke_piece_picks);
 			request_a_block(*t, *this);
 			send_block_requests();
 		}
@@ -1948,9 +1961,7 @@ namespace libtorrent
 		boost::shared_ptr<torrent> t = m_torrent.lock();
 		TORRENT_ASSERT(t);
 
-#ifdef TORRENT_STATS
-		++m_ses.m_piece_requests;
-#endif
+		m_ses.inc_stats_counter(counters::piece_requests);
 
 #if defined TORRENT_VERBOSE_LOGGING
 		peer_log("<== REQUEST [ piece: %d s: %d l: %d ]"
@@ -1960,9 +1971,7 @@ namespace libtorrent
 		if (t->super_seeding()
 			&& !super_seeded_piece(r.piece))
 		{
-#ifdef TORRENT_STATS
-			++m_ses.m_invalid_piece_requests;
-#endif
+			m_ses.inc_stats_counter(counters::invalid_piece_requests);
 			++m_num_invalid_requests;
 #if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_ERROR_LOGGING
 			peer_log("*** INVALID_REQUEST [ piece not superseeded "
@@ -2001,9 +2010,7 @@ namespace libtorrent
 
 		if (!t->valid_metadata())
 		{
-#ifdef TORRENT_STATS
-			++m_ses.m_invalid_piece_requests;
-#endif
+			m_ses.inc_stats_counter(counters::invalid_piece_requests);
 			// if we don't have valid metadata yet,
 			// we shouldn't get a request
 #if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_ERROR_LOGGING
@@ -2017,9 +2024,7 @@ namespace libtorrent
 
 		if (int(m_requests.size()) > m_ses.settings().max_allowed_in_request_queue)
 		{
-#ifdef TORRENT_STATS
-			++m_ses.m_max_piece_requests;
-#endif
+			m_ses.inc_stats_counter(counters::max_piece_requests);
 			// don't allow clients to abuse our
 			// memory consumption.
 			// ignore requests if the client
@@ -2074,9 +2079,7 @@ namespace libtorrent
 				peer_log(" ==> REJECT_PIECE [ piece: %d | s: %d | l: %d ]"
 					, r.piece, r.start, r.length);
 #endif
-#ifdef TORRENT_STATS
-				++m_ses.m_choked_piece_requests;
-#endif
+				m_ses.inc_stats_counter(counters::choked_piece_requests);
 				write_reject_request(r);
 
 				time_duration since_choked = time_now() - m_last_choke;
@@ -2107,9 +2110,7 @@ namespace libtorrent
 		}
 		else
 		{
-#ifdef TORRENT_STATS
-			++m_ses.m_invalid_piece_requests;
-#endif
+			m_ses.inc_stats_counter(counters::invalid_piece_requests);
 #if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_ERROR_LOGGING
 			peer_log("*** INVALID_REQUEST [ "
 				"i: %d t: %d n: %d h: %d block_limit: %d ]"
@@ -2465,9 +2466,7 @@ namespace libtorrent
 			if (!m_download_queue.empty())
 				m_requested = now;
 
-#ifdef TORRENT_STATS
-			++m_ses.m_incoming_redundant_piece_picks;
-#endif
+			m_ses.inc_stats_counter(counters::incoming_redundant_piece_picks);
 			request_a_block(*t, *this);
 			send_block_requests();
 			return;
@@ -2562,9 +2561,7 @@ namespace libtorrent
 
 		if (is_disconnecting()) return;
 
-#ifdef TORRENT_STATS
-		++m_ses.m_incoming_piece_picks;
-#endif
+		m_ses.inc_stats_counter(counters::incoming_piece_picks);
 		request_a_block(*t, *this);
 		send_block_requests();
 	}
@@ -2572,9 +2569,7 @@ namespace libtorrent
 	void peer_connection::on_disk_write_complete(int ret, disk_io_job const& j
 		, peer_request p, boost::shared_ptr<torrent> t)
 	{
-#ifdef TORRENT_STATS
-		++m_ses.m_num_messages[aux::session_impl::on_disk_write_counter];
-#endif
+		m_ses.inc_stats_counter(counters::on_disk_write_counter);
 		TORRENT_ASSERT(m_ses.is_network_thread());
 
 		// flush send buffer at the end of this scope
@@ -2654,9 +2649,7 @@ namespace libtorrent
 
 		if (i != m_requests.end())
 		{
-#ifdef TORRENT_STATS
-			++m_ses.m_cancelled_piece_requests;
-#endif
+			m_ses.inc_stats_counter(counters::cancelled_piece_requests);
 			m_requests.erase(i);
 #ifdef TORRENT_VERBOSE_LOGGING
 			peer_log("==> REJECT_PIECE [ piece: %d s: %d l: %d ]"
@@ -3148,9 +3141,7 @@ namespace libtorrent
 				continue;
 			}
 			peer_request const& r = *i;
-#ifdef TORRENT_STATS
-			++m_ses.m_choked_piece_requests;
-#endif
+			m_ses.inc_stats_counter(counters::choked_piece_requests);
 #ifdef TORRENT_VERBOSE_LOGGING
 			peer_log("==> REJECT_PIECE [ piece: %d s: %d l: %d ] choking"
 				, r.piece , r.start , r.length);
@@ -3422,9 +3413,7 @@ namespace libtorrent
 		(*m_ses.m_logger) << time_now_string() << " CONNECTION FAILED: " << print_endpoint(m_remote) << "\n";
 #endif
 
-#ifdef TORRENT_STATS
-		++m_ses.m_connect_timeouts;
-#endif
+		m_ses.inc_stats_counter(counters::connect_timeouts);
 
 		boost::shared_ptr<torrent> t = m_torrent.lock();
 		TORRENT_ASSERT(!m_connecting || t);
@@ -3520,62 +3509,59 @@ namespace libtorrent
 		// for outgoing connections however, why would we get this?
 		TORRENT_ASSERT(ec != error::invalid_argument || !m_outgoing);
 
-#ifdef TORRENT_STATS
-		++m_ses.m_disconnected_peers;
-		if (error == 2) ++m_ses.m_error_peers;
-		if (ec == error::connection_reset) ++m_ses.m_connreset_peers;
-		else if (ec == error::eof) ++m_ses.m_eof_peers;
-		else if (ec == error::connection_refused) ++m_ses.m_connrefused_peers;
-		else if (ec == error::connection_aborted) ++m_ses.m_connaborted_peers;
-		else if (ec == error::no_permission) ++m_ses.m_perm_peers;
-		else if (ec == error::no_buffer_space) ++m_ses.m_buffer_peers;
-		else if (ec == error::host_unreachable) ++m_ses.m_unreachable_peers;
-		else if (ec == error::broken_pipe) ++m_ses.m_broken_pipe_peers;
-		else if (ec == error::address_in_use) ++m_ses.m_addrinuse_peers;
-		else if (ec == error::access_denied) ++m_ses.m_no_access_peers;
-		else if (ec == error::invalid_argument) ++m_ses.m_invalid_arg_peers;
-		else if (ec == error::operation_aborted) ++m_ses.m_aborted_peers;
+		m_ses.inc_stats_counter(counters::disconnected_peers);
+		if (error == 2) m_ses.inc_stats_counter(counters::error_peers);
+		if (ec == error::connection_reset) m_ses.inc_stats_counter(counters::connreset_peers);
+		else if (ec == error::eof) m_ses.inc_stats_counter(counters::eof_peers);
+		else if (ec == error::connection_refused) m_ses.inc_stats_counter(counters::connrefused_peers);
+		else if (ec == error::connection_aborted) m_ses.inc_stats_counter(counters::connaborted_peers);
+		else if (ec == error::no_permission) m_ses.inc_stats_counter(counters::perm_peers);
+		else if (ec == error::no_buffer_space) m_ses.inc_stats_counter(counters::buffer_peers);
+		else if (ec == error::host_unreachable) m_ses.inc_stats_counter(counters::unreachable_peers);
+		else if (ec == error::broken_pipe) m_ses.inc_stats_counter(counters::broken_pipe_peers);
+		else if (ec == error::address_in_use) m_ses.inc_stats_counter(counters::addrinuse_peers);
+		else if (ec == error::access_denied) m_ses.inc_stats_counter(counters::no_access_peers);
+		else if (ec == error::invalid_argument) m_ses.inc_stats_counter(counters::invalid_arg_peers);
+		else if (ec == error::operation_aborted) m_ses.inc_stats_counter(counters::aborted_peers);
 		else if (ec == error_code(errors::upload_upload_connection)
 			|| ec == error_code(errors::uninteresting_upload_peer)
 			|| ec == error_code(errors::torrent_aborted)
 			|| ec == error_code(errors::self_connection)
 			|| ec == error_code(errors::torrent_paused))
-			++m_ses.m_uninteresting_peers;
+			m_ses.inc_stats_counter(counters::uninteresting_peers);
 
 		if (ec == error_code(errors::timed_out)
 			|| ec == error::timed_out)
-			++m_ses.m_transport_timeout_peers;
+			m_ses.inc_stats_counter(counters::transport_timeout_peers);
 		
 		if (ec == error_code(errors::timed_out_inactivity)
 			|| ec == error_code(errors::timed_out_no_request)
 			|| ec == error_code(errors::timed_out_no_interest))
-			++m_ses.m_timeout_peers;
+			m_ses.inc_stats_counter(counters::timeout_peers);
 
 		if (ec == error_code(errors::no_memory))
-			++m_ses.m_no_memory_peers;
+			m_ses.inc_stats_counter(counters::no_memory_peers);
 
 		if (ec == error_code(errors::too_many_connections))
-			++m_ses.m_too_many_peers;
+			m_ses.inc_stats_counter(counters::too_many_peers);
 
 		if (ec == error_code(errors::timed_out_no_handshake))
-			++m_ses.m_connect_timeouts;
-
-		if (is_utp(*m_socket)) ++m_ses.m_error_utp_peers;
-		else ++m_ses.m_error_tcp_peers;
+			m_ses.inc_stats_counter(counters::connect_timeouts);
 
-		if (m_outgoing) ++m_ses.m_error_outgoing_peers;
-		else ++m_ses.m_error_incoming_peers;
+		if (is_utp(*m_socket)) m_ses.inc_stats_counter(counters::error_utp_peers);
+		else m_ses.inc_stats_counter(counters::error_tcp_peers);
 
+		if (m_outgoing) m_ses.inc_stats_counter(counters::error_outgoing_peers);
+		else m_ses.inc_stats_counter(counters::error_incoming_peers);
 
 #ifndef TORRENT_DISABLE_ENCRYPTION
 		if (type() == bittorrent_connection)
 		{
 			bt_peer_connection* bt = static_cast<bt_peer_connection*>(this);
-			if (bt->supports_encryption()) ++m_ses.m_error_encrypted_peers;
-			if (bt->rc4_encrypted() && bt->supports_encryption()) ++m_ses.m_error_rc4_peers;
+			if (bt->supports_encryption()) m_ses.inc_stats_counter(counters::error_encrypted_peers);
+			if (bt->rc4_encrypted() && bt->supports_encryption()) m_ses.inc_stats_counter(counters::error_rc4_peers);
 		}
 #endif // TORRENT_DISABLE_ENCRYPTION
-#endif
 
 		// we cannot do this in a constructor
 		TORRENT_ASSERT(m_in_constructor == false);
@@ -3700,7 +3686,20 @@ namespace libtorrent
 		m_disconnecting = true;
 		error_code e;
 
-		async_shutdown(*m_socket, m_socket);
+		if (pool_managed_socket())
+		{
+			// a write may still be queued up on the thread owning this
+			// peer. Closing the socket through the same thread makes sure
+			// it's not closed under the write's feet
+			socket_job j;
+			j.type = socket_job::close_job;
+			j.peer = self();
+			m_ses.m_net_thread_pool.post_job(j);
+		}
+		else
+		{
+			async_shutdown(*m_socket, m_socket);
+		}
 
 		m_ses.close_connection(this, ec);
 
@@ -3895,7 +3894,7 @@ namespace libtorrent
 		p.estimated_reciprocation_rate = m_est_reciprocation_rate;
 
 		error_code ec;
-		p.local_endpoint = get_socket()->local_endpoint(ec);
+		p.local_endpoint = socket_local_endpoint(ec);
 	}
 
 	// allocates a disk buffer of size 'disk_buffer_size' and replaces the
@@ -4140,9 +4139,7 @@ namespace libtorrent
 			// might not be any unrequested blocks anymore, so
 			// we should try to pick another block to see
 			// if we can pick a busy one
-#ifdef TORRENT_STATS
-			++m_ses.m_end_game_piece_picks;
-#endif
+			m_ses.inc_stats_counter(counters::end_game_piece_picks);
 			m_last_request = now;
 			request_a_block(*t, *this);
 			if (m_disconnecting) return;
@@ -4386,9 +4383,7 @@ namespace libtorrent
 		// picking the same block again, stalling the
 		// same piece indefinitely.
 		m_desired_queue_size = 2;
-#ifdef TORRENT_STATS
-		++m_ses.m_snubbed_piece_picks;
-#endif
+		m_ses.inc_stats_counter(counters::snubbed_piece_picks);
 		request_a_block(*t, *this);
 
 		// the block we just picked (potentially)
@@ -4540,9 +4535,7 @@ namespace libtorrent
 		// all completed disk operations
 		cork _c(*this);
 
-#ifdef TORRENT_STATS
-		++m_ses.m_num_messages[aux::session_impl::on_disk_read_counter];
-#endif
+		m_ses.inc_stats_counter(counters::on_disk_read_counter);
 		TORRENT_ASSERT(m_ses.is_network_thread());
 
 		m_reading_bytes -= r.length;
@@ -4895,11 +4888,70 @@ namespace libtorrent
 #if defined TORRENT_ASIO_DEBUGGING
 		add_outstanding_async("peer_connection::on_send_data");
 #endif
+		m_channel_state[upload_channel] |= peer_info::bw_network;
+
+		if (pool_managed_socket())
+		{
+			socket_job j;
+			j.type = socket_job::write_job;
+			j.vec = vec;
+			j.peer = self();
+			m_ses.m_net_thread_pool.post_job(j);
+			return;
+		}
+
+		issue_write(vec);
+	}
+
+	void peer_connection::async_write_send_buffer(std::list<asio::const_buffer> const& vec)
+	{
+		mutex::scoped_lock l(m_socket_mutex);
+		issue_write(vec);
+	}
+
+	void peer_connection::issue_write(std::list<asio::const_buffer> const& vec)
+	{
 		m_socket->async_write_some(
 			vec, make_write_handler(boost::bind(
 				&peer_connection::on_send_data, self(), _1, _2)));
+	}
 
-		m_channel_state[upload_channel] |= peer_info::bw_network;
+	bool peer_connection::pool_managed_socket() const
+	{
+		// uTP sockets share state with the utp_socket_manager and SSL streams
+		// share their engine with the read side, so only plain TCP writes
+		// are handed to the network thread pool
+		return m_ses.m_net_thread_pool.num_threads() > 0
+			&& m_socket->get<stream_socket>();
+	}
+
+	peer_connection::socket_guard::socket_guard(peer_connection const& p)
+		: m_mutex(p.pool_managed_socket() ? &p.m_socket_mutex : 0)
+	{
+		if (m_mutex) m_mutex->lock();
+	}
+
+	peer_connection::socket_guard::~socket_guard()
+	{
+		if (m_mutex) m_mutex->unlock();
+	}
+
+	tcp::endpoint peer_connection::socket_remote_endpoint(error_code& ec) const
+	{
+		socket_guard l(*this);
+		return m_socket->remote_endpoint(ec);
+	}
+
+	tcp::endpoint peer_connection::socket_local_endpoint(error_code& ec) const
+	{
+		socket_guard l(*this);
+		return m_socket->local_endpoint(ec);
+	}
+
+	void peer_connection::shutdown_socket()
+	{
+		mutex::scoped_lock l(m_socket_mutex);
+		async_shutdown(*m_socket, m_socket);
 	}
 
 	void peer_connection::on_disk()
@@ -5040,6 +5092,10 @@ namespace libtorrent
 			num_bufs = 2;
 		}
 
+		// a write or close may be initiated on the socket by the network
+		// thread pool at the same time
+		socket_guard l(*this);
+
 		if (s == read_async)
 		{
 			TORRENT_ASSERT((m_channel_state[download_channel] & peer_info::bw_network) == 0);
@@ -5209,17 +5265,19 @@ namespace libtorrent
 	void peer_connection::on_receive_data(const error_code& error
 		, std::size_t bytes_transferred)
 	{
-#ifdef TORRENT_STATS
-		++m_ses.m_num_messages[aux::session_impl::on_read_counter];
+		m_ses.inc_stats_counter(counters::on_read_counter);
 		int size = 8;
 		int index = 0;
 		while (bytes_transferred > size + 13) { size <<= 1; ++index; }
-		int num_max = sizeof(m_ses.m_recv_buffer_sizes)/sizeof(m_ses.m_recv_buffer_sizes[0]);
-		if (index >= num_max) index = num_max - 1;
-		++m_ses.m_recv_buffer_sizes[index];
-#endif
+		int const num_max = counters::socket_recv_size20 - counters::socket_recv_size3;
+		if (index > num_max) index = num_max;
+		m_ses.inc_stats_counter(counters::socket_recv_size3 + index);
 		TORRENT_ASSERT(m_ses.is_network_thread());
 
+		// this includes the handlers of all the messages received, and
+		// disconnecting the peer if that's what they led to
+		latency_sample sample(m_ses.stats_counters(), counters::socket_read_handler_duration);
+
 		// keep ourselves alive in until this function exits in
 		// case we disconnect
 		// this needs to be created before the invariant check,
@@ -5605,15 +5663,13 @@ namespace libtorrent
 	void peer_connection::on_send_data(error_code const& error
 		, std::size_t bytes_transferred)
 	{
-#ifdef TORRENT_STATS
-		++m_ses.m_num_messages[aux::session_impl::on_write_counter];
+		m_ses.inc_stats_counter(counters::on_write_counter);
 		int size = 8;
 		int index = 0;
 		while (bytes_transferred > size + 13) { size <<= 1; ++index; }
-		int num_max = sizeof(m_ses.m_send_buffer_sizes)/sizeof(m_ses.m_send_buffer_sizes[0]);
-		if (index >= num_max) index = num_max - 1;
-		++m_ses.m_send_buffer_sizes[index];
-#endif
+		int const num_max = counters::socket_send_size20 - counters::socket_send_size3;
+		if (index > num_max) index = num_max;
+		m_ses.inc_stats_counter(counters::socket_send_size3 + index);
 		TORRENT_ASSERT(m_ses.is_network_thread());
 
 #if defined TORRENT_VERBOSE_LOGGING 
@@ -0,0 +1,127 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <cstring> // for memset
+
+namespace libtorrent
+{
+	counters::counters()
+	{
+#if TORRENT_ATOMIC_COUNTERS
+		for (int i = 0; i < num_counters; ++i)
+			m_stats_counter[i].store(0, boost::memory_order_relaxed);
+#else
+		std::memset(m_stats_counter, 0, sizeof(m_stats_counter));
+#endif
+	}
+
+	counters::counters(counters const& c)
+	{
+#if TORRENT_ATOMIC_COUNTERS
+		for (int i = 0; i < num_counters; ++i)
+			m_stats_counter[i].store(
+				c.m_stats_counter[i].load(boost::memory_order_relaxed)
+					, boost::memory_order_relaxed);
+#else
+		mutex::scoped_lock l(c.m_mutex);
+		std::memcpy(m_stats_counter, c.m_stats_counter, sizeof(m_stats_counter));
+#endif
+		for (int i = 0; i < num_histograms; ++i)
+			m_histograms[i] = c.m_histograms[i];
+	}
+
+	counters& counters::operator=(counters const& c)
+	{
+		if (&c == this) return *this;
+#if TORRENT_ATOMIC_COUNTERS
+		for (int i = 0; i < num_counters; ++i)
+			m_stats_counter[i].store(
+				c.m_stats_counter[i].load(boost::memory_order_relaxed)
+					, boost::memory_order_relaxed);
+#else
+		mutex::scoped_lock l(m_mutex);
+		mutex::scoped_lock l2(c.m_mutex);
+		std::memcpy(m_stats_counter, c.m_stats_counter, sizeof(m_stats_counter));
+#endif
+		for (int i = 0; i < num_histograms; ++i)
+			m_histograms[i] = c.m_histograms[i];
+		return *this;
+	}
+
+	boost::int64_t counters::operator[](int i) const
+	{
+		TORRENT_ASSERT(i >= 0);
+		TORRENT_ASSERT(i < num_counters);
+
+#if TORRENT_ATOMIC_COUNTERS
+		return m_stats_counter[i].load(boost::memory_order_relaxed);
+#else
+		mutex::scoped_lock l(m_mutex);
+		return m_stats_counter[i];
+#endif
+	}
+
+	boost::int64_t counters::inc_stats_counter(int c, boost::int64_t value)
+	{
+		// gauges may be decremented, counters may not
+		TORRENT_ASSERT(c >= 0);
+		TORRENT_ASSERT(c < num_counters);
+		TORRENT_ASSERT(c >= num_stats_counters || value >= 0);
+
+#if TORRENT_ATOMIC_COUNTERS
+		boost::int64_t pv = m_stats_counter[c].fetch_add(value, boost::memory_order_relaxed);
+		TORRENT_ASSERT(pv + value >= 0);
+		return pv + value;
+#else
+		mutex::scoped_lock l(m_mutex);
+		TORRENT_ASSERT(m_stats_counter[c] + value >= 0);
+		return m_stats_counter[c] += value;
+#endif
+	}
+
+	void counters::set_value(int c, boost::int64_t value)
+	{
+		TORRENT_ASSERT(c >= 0);
+		TORRENT_ASSERT(c < num_counters);
+
+#if TORRENT_ATOMIC_COUNTERS
+		m_stats_counter[c].store(value, boost::memory_order_relaxed);
+#else
+		mutex::scoped_lock l(m_mutex);
+		m_stats_counter[c] = value;
+#endif
+	}
+}
+
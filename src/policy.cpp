@@ -285,7 +285,7 @@ namespace libtorrent
 		// than we requested.
 #ifdef TORRENT_DEBUG
 		error_code ec;
-		TORRENT_ASSERT(c.remote() == c.get_socket()->remote_endpoint(ec) || ec);
+		TORRENT_ASSERT(c.remote() == c.socket_remote_endpoint(ec) || ec);
 #endif
 
 		aux::session_impl& ses = t.session();
@@ -326,9 +326,12 @@ namespace libtorrent
 		// the last argument is if we should prefer whole pieces
 		// for this peer. If we're downloading one piece in 20 seconds
 		// then use this mode.
+		ptime const pick_start = time_now_hires();
 		p.pick_pieces(*bits, interesting_pieces
 			, num_requests, prefer_whole_pieces, c.peer_info_struct()
 			, state, c.picker_options(), suggested, t.num_peers());
+		ses.stats_counters().add_latency_sample(counters::pick_pieces_time
+			, time_now_hires() - pick_start);
 
 #ifdef TORRENT_VERBOSE_LOGGING
 		c.peer_log("*** PIECE_PICKER [ prefer_whole: %d picked: %d ]"
@@ -354,9 +357,7 @@ namespace libtorrent
 		for (std::vector<piece_block>::iterator i = interesting_pieces.begin();
 			i != interesting_pieces.end(); ++i)
 		{
-#ifdef TORRENT_STATS
-			++ses.m_piece_picker_blocks;
-#endif
+			ses.inc_stats_counter(counters::piece_picker_blocks);
 
 			if (prefer_whole_pieces == 0 && num_requests <= 0) break;
 
@@ -439,9 +440,7 @@ namespace libtorrent
 			return;
 		}
 
-#ifdef TORRENT_STATS
-		++ses.m_end_game_piece_picker_blocks;
-#endif
+		ses.inc_stats_counter(counters::end_game_piece_picker_blocks);
 
 #ifdef TORRENT_DEBUG
 		piece_picker::downloading_piece st;
@@ -481,9 +480,20 @@ namespace libtorrent
 		aux::session_impl& ses = m_torrent->session();
 		if (!m_torrent->apply_ip_filter()) return;
 
+		// m_peers is sorted by address, which is the order the filter is
+		// quickest to look addresses up in
+		std::vector<address> addrs;
+		addrs.reserve(m_peers.size());
+		for (iterator i = m_peers.begin(); i != m_peers.end(); ++i)
+			addrs.push_back((*i)->address());
+		std::vector<int> flags;
+		ses.m_ip_filter.access(addrs, flags);
+
+		// flags is kept in step with m_peers as peers are erased
 		for (iterator i = m_peers.begin(); i != m_peers.end();)
 		{
-			if ((ses.m_ip_filter.access((*i)->address()) & ip_filter::blocked) == 0)
+			int current = i - m_peers.begin();
+			if ((flags[current] & ip_filter::blocked) == 0)
 			{
 				++i;
 				continue;
@@ -499,7 +509,6 @@ namespace libtorrent
 				ses.m_alerts.post_alert(peer_blocked_alert(m_torrent->get_handle()
 					, (*i)->address(), peer_blocked_alert::ip_filter));
 
-			int current = i - m_peers.begin();
 			TORRENT_ASSERT(current >= 0);
 			TORRENT_ASSERT(m_peers.size() > 0);
 			TORRENT_ASSERT(i != m_peers.end());
@@ -515,6 +524,7 @@ namespace libtorrent
 				// what *i refers to has changed, i.e. cur was deleted
 				if (m_peers.size() < count)
 				{
+					flags.erase(flags.begin() + current);
 					i = m_peers.begin() + current;
 					continue;
 				}
@@ -523,6 +533,7 @@ namespace libtorrent
 			}
 
 			erase_peer(i);
+			flags.erase(flags.begin() + current);
 			i = m_peers.begin() + current;
 		}
 	}
@@ -703,10 +714,7 @@ namespace libtorrent
 		if (is_connect_candidate(*p, m_finished))
 			--m_num_connect_candidates;
 
-#ifdef TORRENT_STATS
-		aux::session_impl& ses = m_torrent->session();
-		++ses.m_num_banned_peers;
-#endif
+		m_torrent->session().inc_stats_counter(counters::num_banned_peers);
 
 		p->banned = true;
 		TORRENT_ASSERT(!is_connect_candidate(*p, m_finished));
@@ -888,7 +896,7 @@ namespace libtorrent
 		// TODO: only allow _one_ connection to use this
 		// override at a time
 		error_code ec;
-		TORRENT_ASSERT(c.remote() == c.get_socket()->remote_endpoint(ec) || ec);
+		TORRENT_ASSERT(c.remote() == c.socket_remote_endpoint(ec) || ec);
 		TORRENT_ASSERT(!m_torrent->is_paused());
 
 #if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING
@@ -1072,7 +1080,7 @@ namespace libtorrent
 			// we don't have any info about this peer.
 			// add a new entry
 			error_code ec;
-			TORRENT_ASSERT(c.remote() == c.get_socket()->remote_endpoint(ec) || ec);
+			TORRENT_ASSERT(c.remote() == c.socket_remote_endpoint(ec) || ec);
 
 			if (int(m_peers.size()) >= m_torrent->settings().max_peerlist_size)
 			{
@@ -1742,11 +1750,11 @@ namespace libtorrent
 
 		TORRENT_ASSERT(c);
 		error_code ec;
-		if (c->remote() != c->get_socket()->remote_endpoint(ec) && !ec)
+		if (c->remote() != c->socket_remote_endpoint(ec) && !ec)
 		{
-			fprintf(stderr, "c->remote: %s\nc->get_socket()->remote_endpoint: %s\n"
+			fprintf(stderr, "c->remote: %s\nc->socket_remote_endpoint: %s\n"
 				, print_endpoint(c->remote()).c_str()
-				, print_endpoint(c->get_socket()->remote_endpoint(ec)).c_str());
+				, print_endpoint(c->socket_remote_endpoint(ec)).c_str());
 			TORRENT_ASSERT(false);
 		}
 
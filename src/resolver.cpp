@@ -0,0 +1,204 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "libtorrent/resolver.hpp"
+#include "libtorrent/session_status.hpp"
+#include "libtorrent/socket_io.hpp"
+
+#include <boost/bind.hpp>
+
+namespace libtorrent
+{
+	resolver::resolver(io_service& ios)
+		: m_ios(ios)
+		, m_resolver(ios)
+		, m_timeout(1200)
+		, m_negative_timeout(60)
+		, m_lookups(0)
+		, m_cache_hits(0)
+		, m_shared_lookups(0)
+	{}
+
+	void resolver::async_resolve(std::string const& host, callback_t const& h)
+	{
+		// IP addresses don't need to be looked up
+		error_code ec;
+		address a = address::from_string(host.c_str(), ec);
+		if (!ec)
+		{
+			std::vector<address> addresses(1, a);
+			m_ios.post(boost::bind(h, ec, addresses));
+			return;
+		}
+
+		cache_t::iterator i = m_cache.find(host);
+		if (i != m_cache.end())
+		{
+			if (i->second.expires > time_now())
+			{
+				++m_cache_hits;
+				m_ios.post(boost::bind(h, i->second.error, i->second.addresses));
+				return;
+			}
+			m_cache.erase(i);
+		}
+
+		pending_t::iterator p = m_pending.find(host);
+		if (p != m_pending.end())
+		{
+			++m_shared_lookups;
+			p->second.push_back(h);
+			return;
+		}
+
+		m_pending[host].push_back(h);
+		++m_lookups;
+		start_lookup(host);
+	}
+
+	void resolver::start_lookup(std::string const& host)
+	{
+		tcp::resolver::query q(host, "0");
+		m_resolver.async_resolve(q, boost::bind(&resolver::on_system_lookup
+			, this, _1, _2, host));
+	}
+
+	void resolver::cancel_lookups()
+	{
+		m_resolver.cancel();
+	}
+
+	void resolver::on_system_lookup(error_code const& ec
+		, tcp::resolver::iterator i, std::string host)
+	{
+		// abort() has already failed the callbacks waiting for this lookup.
+		// New lookups of the same name may have been started since then
+		if (ec == asio::error::operation_aborted) return;
+
+		std::vector<address> addresses;
+		if (!ec)
+		{
+			for (; i != tcp::resolver::iterator(); ++i)
+			{
+				address const& a = i->endpoint().address();
+				if (std::find(addresses.begin(), addresses.end(), a) == addresses.end())
+					addresses.push_back(a);
+			}
+		}
+		on_lookup(host, ec, addresses);
+	}
+
+	void resolver::on_lookup(std::string const& host, error_code const& ec
+		, std::vector<address> const& addresses)
+	{
+		// a lookup that was cancelled says nothing about the name
+		if (ec != asio::error::operation_aborted)
+			add_to_cache(host, ec, addresses);
+
+		pending_t::iterator p = m_pending.find(host);
+		if (p == m_pending.end()) return;
+
+		// the callbacks may start new lookups of this name, so take them out
+		// of the pending map before calling them
+		std::vector<callback_t> callbacks;
+		callbacks.swap(p->second);
+		m_pending.erase(p);
+
+		for (std::vector<callback_t>::iterator i = callbacks.begin()
+			, end(callbacks.end()); i != end; ++i)
+		{
+			(*i)(ec, addresses);
+		}
+	}
+
+	void resolver::add_to_cache(std::string const& host, error_code const& ec
+		, std::vector<address> const& addresses)
+	{
+		int timeout = (ec || addresses.empty()) ? m_negative_timeout : m_timeout;
+		if (timeout <= 0) return;
+
+		ptime now = time_now();
+		if (int(m_cache.size()) >= max_cache_size)
+		{
+			cache_t::iterator oldest = m_cache.end();
+			for (cache_t::iterator i = m_cache.begin(); i != m_cache.end();)
+			{
+				if (i->second.expires <= now)
+				{
+					m_cache.erase(i++);
+					continue;
+				}
+				if (oldest == m_cache.end() || i->second.expires < oldest->second.expires)
+					oldest = i;
+				++i;
+			}
+			if (int(m_cache.size()) >= max_cache_size && oldest != m_cache.end())
+				m_cache.erase(oldest);
+		}
+
+		cache_entry& e = m_cache[host];
+		e.addresses = addresses;
+		e.error = ec;
+		e.expires = now + seconds(timeout);
+	}
+
+	void resolver::abort()
+	{
+		m_cache.clear();
+		cancel_lookups();
+
+		// cancelled lookups don't call on_lookup(), and lookups started by
+		// a derived class may never complete. Fail whatever is still waiting
+		pending_t pending;
+		pending.swap(m_pending);
+		std::vector<address> empty;
+		for (pending_t::iterator i = pending.begin(); i != pending.end(); ++i)
+		{
+			for (std::vector<callback_t>::iterator j = i->second.begin()
+				, end(i->second.end()); j != end; ++j)
+			{
+				m_ios.post(boost::bind(*j, error_code(asio::error::operation_aborted)
+					, empty));
+			}
+		}
+	}
+
+	void resolver::get_status(session_status& s) const
+	{
+		s.dns_cache_size = int(m_cache.size());
+		s.total_dns_lookups = m_lookups;
+		s.total_dns_cache_hits = m_cache_hits;
+		s.total_dns_shared_lookups = m_shared_lookups;
+	}
+}
+
@@ -466,6 +466,11 @@ namespace libtorrent
 		TORRENT_SYNC_CALL2(save_state, &e, flags);
 	}
 
+	void session::save_state(std::vector<char>& buf, boost::uint32_t flags) const
+	{
+		TORRENT_SYNC_CALL2(save_state_buffer, &buf, flags);
+	}
+
 	void session::load_state(lazy_entry const& e)
 	{
 		// this needs to be synchronized since the lifespan
@@ -630,6 +635,16 @@ namespace libtorrent
 		TORRENT_ASYNC_CALL(post_torrent_updates);
 	}
 
+	void session::post_torrent_delta_updates()
+	{
+		TORRENT_ASYNC_CALL(post_torrent_delta_updates);
+	}
+
+	void session::post_session_stats()
+	{
+		TORRENT_ASYNC_CALL(post_session_stats);
+	}
+
 	std::vector<torrent_handle> session::get_torrents() const
 	{
 		TORRENT_SYNC_CALL_RET(std::vector<torrent_handle>, get_torrents);
@@ -672,6 +687,21 @@ namespace libtorrent
 		TORRENT_ASYNC_CALL1(async_add_torrent, p);
 	}
 
+	void session::async_add_torrents(std::vector<add_torrent_params> const& params)
+	{
+		std::vector<add_torrent_params>* p = new std::vector<add_torrent_params>(params);
+#ifndef TORRENT_NO_DEPRECATE
+		for (std::vector<add_torrent_params>::iterator i = p->begin()
+			, end(p->end()); i != end; ++i)
+		{
+			if (!i->tracker_url) continue;
+			i->trackers.push_back(i->tracker_url);
+			i->tracker_url = NULL;
+		}
+#endif
+		TORRENT_ASYNC_CALL1(async_add_torrents, p);
+	}
+
 #ifndef BOOST_NO_EXCEPTIONS
 #ifndef TORRENT_NO_DEPRECATE
 	// if the torrent already exists, this will throw duplicate_torrent
@@ -1239,6 +1269,10 @@ namespace libtorrent
 		, tracker_receive_timeout(40)
 		, stop_tracker_timeout(5)
 		, tracker_maximum_response_length(1024*1024)
+		, tracker_keepalive_connections(20)
+		, tracker_keepalive_timeout(30)
+		, resolver_cache_timeout(1200)
+		, resolver_negative_cache_timeout(60)
 		, piece_timeout(20)
 		, request_timeout(50)
 		, request_queue_time(3)
@@ -1249,6 +1283,7 @@ namespace libtorrent
 		, urlseed_timeout(20)
 		, urlseed_pipeline_size(5)
 		, urlseed_wait_retry(30)
+		, urlseed_max_connections(4)
 		, file_pool_size(40)
 		, allow_multiple_connections_per_ip(false)
 		, max_failcount(3)
@@ -1392,6 +1427,7 @@ namespace libtorrent
 #endif
 		, utp_dynamic_sock_buf(false) // this doesn't seem quite reliable yet
 		, utp_loss_multiplier(50) // specified in percent
+		, utp_pacing(true)
 		, mixed_mode_algorithm(peer_proportional)
 		, rate_limit_utp(true)
 		, listen_queue_size(5)
@@ -1415,6 +1451,8 @@ namespace libtorrent
 		, support_merkle_torrents(false)
 		, report_redundant_bytes(true)
 		, use_disk_cache_pool(false)
+		, network_threads(0)
+		, add_torrent_threads(4)
 	{}
 
 	session_settings::~session_settings() {}
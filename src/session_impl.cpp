@@ -58,12 +58,14 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/torrent_info.hpp"
 #include "libtorrent/tracker_manager.hpp"
 #include "libtorrent/bencode.hpp"
+#include "libtorrent/bencode_writer.hpp"
 #include "libtorrent/hasher.hpp"
 #include "libtorrent/entry.hpp"
 #include "libtorrent/session.hpp"
 #include "libtorrent/fingerprint.hpp"
 #include "libtorrent/entry.hpp"
 #include "libtorrent/alert_types.hpp"
+#include "libtorrent/session_stats.hpp"
 #include "libtorrent/invariant_check.hpp"
 #include "libtorrent/file.hpp"
 #include "libtorrent/bt_peer_connection.hpp"
@@ -292,6 +294,10 @@ namespace aux {
 		TORRENT_SETTING(integer, tracker_receive_timeout)
 		TORRENT_SETTING(integer, stop_tracker_timeout)
 		TORRENT_SETTING(integer, tracker_maximum_response_length)
+		TORRENT_SETTING(integer, tracker_keepalive_connections)
+		TORRENT_SETTING(integer, tracker_keepalive_timeout)
+		TORRENT_SETTING(integer, resolver_cache_timeout)
+		TORRENT_SETTING(integer, resolver_negative_cache_timeout)
 		TORRENT_SETTING(integer, piece_timeout)
 		TORRENT_SETTING(integer, request_timeout)
 		TORRENT_SETTING(integer, request_queue_time)
@@ -302,6 +308,7 @@ namespace aux {
 		TORRENT_SETTING(integer, urlseed_timeout)
 		TORRENT_SETTING(integer, urlseed_pipeline_size)
 		TORRENT_SETTING(integer, urlseed_wait_retry)
+		TORRENT_SETTING(integer, urlseed_max_connections)
 		TORRENT_SETTING(integer, file_pool_size)
 		TORRENT_SETTING(boolean, allow_multiple_connections_per_ip)
 		TORRENT_SETTING(integer, max_failcount)
@@ -439,6 +446,7 @@ namespace aux {
 		TORRENT_SETTING(integer, utp_delayed_ack)
 #endif
 		TORRENT_SETTING(boolean, utp_dynamic_sock_buf)
+		TORRENT_SETTING(boolean, utp_pacing)
 		TORRENT_SETTING(integer, mixed_mode_algorithm)
 		TORRENT_SETTING(boolean, rate_limit_utp)
 		TORRENT_SETTING(integer, listen_queue_size)
@@ -458,6 +466,8 @@ namespace aux {
 		TORRENT_SETTING(integer, tracker_backoff)
 		TORRENT_SETTING(boolean, ban_web_seeds)
 		TORRENT_SETTING(integer, max_http_recv_buffer_size)
+		TORRENT_SETTING(integer, network_threads)
+		TORRENT_SETTING(integer, add_torrent_threads)
 	};
 
 #undef TORRENT_SETTING
@@ -486,8 +496,10 @@ namespace aux {
 #endif
 		TORRENT_SETTING(integer, max_fail_count)
 		TORRENT_SETTING(integer, max_torrents)
+		TORRENT_SETTING(integer, max_peers)
 		TORRENT_SETTING(integer, max_dht_items)
 		TORRENT_SETTING(integer, max_torrent_search_reply)
+		TORRENT_SETTING(integer, num_instances)
 		TORRENT_SETTING(boolean, restrict_routing_ips)
 		TORRENT_SETTING(boolean, restrict_search_ips)
 		TORRENT_SETTING(boolean, extended_routing_table)
@@ -623,7 +635,9 @@ namespace aux {
 		, m_ssl_ctx(m_io_service, asio::ssl::context::sslv23)
 #endif
 		, m_alerts(m_settings.alert_queue_size, alert_mask)
-		, m_disk_thread(m_io_service, boost::bind(&session_impl::on_disk_queue, this), m_files)
+		, m_disk_thread(m_io_service, boost::bind(&session_impl::on_disk_queue, this), m_files
+			, m_stats_counters)
+		, m_net_thread_pool(m_io_service)
 		, m_half_open(m_io_service)
 		, m_download_rate(peer_connection::download_channel)
 #ifdef TORRENT_VERBOSE_BANDWIDTH_LIMIT
@@ -936,43 +950,60 @@ namespace aux {
 	}
 
 #ifdef TORRENT_STATS
+	// writes the (cumulative) latency histograms next to the current stats
+	// log file. The format is parsed by tools/parse_latency_log.py
+	void session_impl::write_latency_log()
+	{
+		char filename[100];
+#ifdef TORRENT_WINDOWS
+		const int pid = GetCurrentProcessId();
+#else
+		const int pid = getpid();
+#endif
+		snprintf(filename, sizeof(filename), "session_stats/%d.%04d.latency.log"
+			, pid, m_log_seq);
+		FILE* f = fopen(filename, "w+");
+		if (f == 0)
+		{
+			fprintf(stderr, "Failed to create latency log file \"%s\": (%d) %s\n"
+				, filename, errno, strerror(errno));
+			return;
+		}
+
+		fprintf(f, "buckets:");
+		for (int i = 0; i < latency_histogram::num_buckets; ++i)
+			fprintf(f, " %" PRId64, latency_histogram::bucket_lower_bound(i));
+		fprintf(f, "\n");
+
+		std::vector<stats_metric> metrics = session_stats_metrics();
+		boost::uint64_t buckets[latency_histogram::num_buckets];
+		for (std::vector<stats_metric>::iterator i = metrics.begin()
+			, end(metrics.end()); i != end; ++i)
+		{
+			if (i->type != stats_metric::type_histogram) continue;
+			m_stats_counters.histogram(i->value_index).snapshot(buckets);
+			fprintf(f, "%s:", i->name);
+			for (int b = 0; b < latency_histogram::num_buckets; ++b)
+				fprintf(f, " %" PRIu64, buckets[b]);
+			fprintf(f, "\n");
+		}
+		fclose(f);
+	}
+
 	void session_impl::rotate_stats_log()
 	{
 		if (m_stats_logger)
 		{
+			write_latency_log();
 			++m_log_seq;
 			fclose(m_stats_logger);
 		}
 
-		// make these cumulative for easier reading of graphs
-		// reset them every time the log is rotated though,
-		// to make them cumulative per one-hour graph
-		m_error_peers = 0;
-		m_disconnected_peers = 0;
-		m_eof_peers = 0;
-		m_connreset_peers = 0;
-		m_connrefused_peers = 0;
-		m_connaborted_peers = 0;
-		m_perm_peers = 0;
-		m_buffer_peers = 0;
-		m_unreachable_peers = 0;
-		m_broken_pipe_peers = 0;
-		m_addrinuse_peers = 0;
-		m_no_access_peers = 0;
-		m_invalid_arg_peers = 0;
-		m_aborted_peers = 0;
-		m_error_incoming_peers = 0;
-		m_error_outgoing_peers = 0;
-		m_error_rc4_peers = 0;
-		m_error_encrypted_peers = 0;
-		m_error_tcp_peers = 0;
-		m_error_utp_peers = 0;
-		m_connect_timeouts = 0;
-		m_uninteresting_peers = 0;
-		m_transport_timeout_peers = 0;
-		m_timeout_peers = 0;
-		m_no_memory_peers = 0;
-		m_too_many_peers = 0;
+		// make the disconnect counters cumulative for easier reading
+		// of graphs. They're reset every time the log is rotated
+		// though, to make them cumulative per one-hour graph
+		for (int i = 0; i < counters::num_counters; ++i)
+			m_rotation_stats_counters[i] = m_stats_counters[i];
 
 		error_code ec;
 		char filename[100];
@@ -1250,71 +1281,137 @@ namespace aux {
 #endif
 	}
 
+	namespace
+	{
+		// writes the settings category called name, unless it's compiled
+		// out or not selected by flags
+		void write_category(bencode_writer& w, bencode_dict_merge& d
+			, char const* name, void const* ses, void const* def
+			, boost::uint32_t flags)
+		{
+			for (int i = 0; i < int(sizeof(all_settings)/sizeof(all_settings[0])); ++i)
+			{
+				session_category const& c = all_settings[i];
+				if (std::strcmp(c.name, name) != 0) continue;
+				if ((flags & c.flag) == 0) return;
+				if (!d.key(c.name)) return;
+				save_struct(w, reinterpret_cast<char const*>(ses) + c.offset
+					, c.map, c.num_entries, reinterpret_cast<char const*>(def) + c.default_offset);
+				return;
+			}
+		}
+	}
+
 	void session_impl::save_state(entry* eptr, boost::uint32_t flags) const
 	{
 		TORRENT_ASSERT(is_network_thread());
 
-		entry& e = *eptr;
+		std::vector<char> buf;
+		bencode_writer w(buf);
+		write_state(w, flags);
 
-		all_default_values def;
+		// the keys are added to the ones already in the entry
+		entry state = bdecode(buf.begin(), buf.end());
+		entry::dictionary_type& ret = eptr->dict();
+		for (entry::dictionary_type::iterator i = state.dict().begin()
+			, end(state.dict().end()); i != end; ++i)
+			ret[i->first].swap(i->second);
+	}
 
-		for (int i = 0; i < int(sizeof(all_settings)/sizeof(all_settings[0])); ++i)
-		{
-			session_category const& c = all_settings[i];
-			if ((flags & c.flag) == 0) continue;
-			save_struct(e[c.name], reinterpret_cast<char const*>(this) + c.offset
-				, c.map, c.num_entries, reinterpret_cast<char const*>(&def) + c.default_offset);
-		}
-#ifndef TORRENT_DISABLE_DHT
-		if (m_dht && (flags & session::save_dht_state))
-		{
-			e["dht state"] = m_dht->state();
-		}
-#endif
+	void session_impl::save_state_buffer(std::vector<char>* buf
+		, boost::uint32_t flags) const
+	{
+		TORRENT_ASSERT(is_network_thread());
 
-#if TORRENT_USE_I2P
-		if (flags & session::save_i2p_proxy)
+		bencode_writer w(*buf);
+		write_state(w, flags);
+	}
+
+	void session_impl::write_state(bencode_writer& w, boost::uint32_t flags) const
+	{
+		// plugins save their state in an entry, which is merged with the
+		// session's keys. Just like when plugins were handed the session's
+		// entry, their values win
+		entry ext(entry::dictionary_t);
+#ifndef TORRENT_DISABLE_EXTENSIONS
+		for (ses_extension_list_t::const_iterator i = m_ses_extensions.begin()
+			, end(m_ses_extensions.end()); i != end; ++i)
 		{
-			save_struct(e["i2p"], &i2p_proxy(), proxy_settings_map
-				, sizeof(proxy_settings_map)/sizeof(proxy_settings_map[0])
-				, &def.m_proxy);
+			TORRENT_TRY {
+				(*i)->save_state(ext);
+			} TORRENT_CATCH(std::exception&) {}
 		}
 #endif
+
+		all_default_values def;
+
+		// the keys have to be written in sorted order
+		w.begin_dict();
+		bencode_dict_merge d(w, ext, true);
+
 #ifndef TORRENT_DISABLE_GEO_IP
-		if (flags & session::save_as_map)
+		if ((flags & session::save_as_map) && d.key("AS map"))
 		{
-			entry::dictionary_type& as_map = e["AS map"].dict();
-			char buf[10];
+			// AS numbers don't necessarily have 5 digits, so the numerical
+			// order of m_as_peak isn't the order of the keys
+			std::vector<std::pair<std::string, int> > as_map;
+			char buf[20];
 			for (std::map<int, int>::const_iterator i = m_as_peak.begin()
 				, end(m_as_peak.end()); i != end; ++i)
 			{
 				if (i->second == 0) continue;
-					sprintf(buf, "%05d", i->first);
-				as_map[buf] = i->second;
+				snprintf(buf, sizeof(buf), "%05d", i->first);
+				as_map.push_back(std::make_pair(std::string(buf), i->second));
 			}
+			std::sort(as_map.begin(), as_map.end());
+
+			w.begin_dict();
+			for (std::vector<std::pair<std::string, int> >::const_iterator i
+				= as_map.begin(), end(as_map.end()); i != end; ++i)
+			{
+				w.key(i->first);
+				w.integer(i->second);
+			}
+			w.end();
 		}
 #endif
 
-		if (flags & session::save_feeds)
+		write_category(w, d, "dht", this, &def, flags);
+
+#ifndef TORRENT_DISABLE_DHT
+		if (m_dht && (flags & session::save_dht_state) && d.key("dht state"))
+			w.value(m_dht->state());
+#endif
+
+		write_category(w, d, "encryption", this, &def, flags);
+
+		if ((flags & session::save_feeds) && d.key("feeds"))
 		{
-			entry::list_type& feeds = e["feeds"].list();
+			w.begin_list();
 			for (std::vector<boost::shared_ptr<feed> >::const_iterator i =
 				m_feeds.begin(), end(m_feeds.end()); i != end; ++i)
 			{
-				feeds.push_back(entry());
-				(*i)->save_state(feeds.back());
+				entry f;
+				(*i)->save_state(f);
+				w.value(f);
 			}
+			w.end();
 		}
 
-#ifndef TORRENT_DISABLE_EXTENSIONS
-		for (ses_extension_list_t::const_iterator i = m_ses_extensions.begin()
-			, end(m_ses_extensions.end()); i != end; ++i)
+#if TORRENT_USE_I2P
+		if ((flags & session::save_i2p_proxy) && d.key("i2p"))
 		{
-			TORRENT_TRY {
-				(*i)->save_state(*eptr);
-			} TORRENT_CATCH(std::exception&) {}
+			save_struct(w, &i2p_proxy(), proxy_settings_map
+				, sizeof(proxy_settings_map)/sizeof(proxy_settings_map[0])
+				, &def.m_proxy);
 		}
 #endif
+
+		write_category(w, d, "proxy", this, &def, flags);
+		write_category(w, d, "settings", this, &def, flags);
+
+		d.finish();
+		w.end();
 	}
 	
 	void session_impl::set_proxy(proxy_settings const& s)
@@ -1632,6 +1729,34 @@ namespace aux {
 		}
 	}
 	
+	// the state of one call to async_add_torrents(). The parser threads
+	// prepare the parameters in any order, the network thread adds them in
+	// the order they were passed in, as soon as they are ready
+	struct add_torrent_batch
+	{
+		add_torrent_batch(): next_job(0), next_add(0)
+			, handler_posted(false), abort(false) {}
+
+		std::vector<add_torrent_params> params;
+		std::vector<error_code> errors;
+		// done[i] is set once params[i] has been prepared
+		std::vector<bool> done;
+		std::vector<boost::shared_ptr<thread> > threads;
+
+		// protects everything below as well as errors and done
+		mutex mtx;
+		// the next entry for a parser thread to pick up
+		int next_job;
+		// the next entry to be added to the session
+		int next_add;
+		// true while there is a call to on_add_torrent_batch()
+		// in the io_service queue
+		bool handler_posted;
+		// set when the session shuts down, to make the parser
+		// threads exit early
+		bool abort;
+	};
+
 	void session_impl::abort()
 	{
 		TORRENT_ASSERT(is_network_thread());
@@ -1647,6 +1772,23 @@ namespace aux {
 		m_i2p_conn.close(ec);
 #endif
 		m_queued_for_checking.clear();
+
+		// stop parsing torrents that will never be added
+		for (std::vector<boost::shared_ptr<add_torrent_batch> >::iterator i
+			= m_add_torrent_batches.begin(), end(m_add_torrent_batches.end());
+			i != end; ++i)
+		{
+			add_torrent_batch& b = **i;
+			{
+				mutex::scoped_lock l(b.mtx);
+				b.abort = true;
+			}
+			for (std::vector<boost::shared_ptr<thread> >::iterator j = b.threads.begin()
+				, end2(b.threads.end()); j != end2; ++j)
+				(*j)->join();
+			b.threads.clear();
+		}
+		m_add_torrent_batches.clear();
 		stop_lsd();
 		stop_upnp();
 		stop_natpmp();
@@ -1704,6 +1846,11 @@ namespace aux {
 #endif
 		m_tracker_manager.abort_all_requests();
 
+		// fail the outstanding host name lookups, so that they don't keep
+		// torrents alive. The stopped announces below look their trackers
+		// up again
+		m_host_resolver.abort();
+
 #if defined(TORRENT_VERBOSE_LOGGING) || defined(TORRENT_LOGGING)
 		session_log(" sending event=stopped to trackers");
 #endif
@@ -1733,6 +1880,9 @@ namespace aux {
 			TORRENT_ASSERT_VAL(conn == int(m_connections.size()) + 1, conn);
 		}
 
+		// this completes any queued up writes and socket closes
+		m_net_thread_pool.stop();
+
 #if defined(TORRENT_VERBOSE_LOGGING) || defined(TORRENT_LOGGING)
 		session_log(" connection queue: %d", m_half_open.size());
 #endif
@@ -1772,6 +1922,7 @@ namespace aux {
 		INVARIANT_CHECK;
 
 		m_ip_filter = f;
+		m_ip_filter.commit();
 
 		// Close connections whose endpoint is filtered
 		// by the new ip-filter
@@ -1984,11 +2135,17 @@ namespace aux {
 		if (m_settings.ssl_listen != s.ssl_listen)
 			reopen_listen_port = true;
 
+		if (m_settings.network_threads != s.network_threads && !m_abort)
+			m_net_thread_pool.set_num_threads(s.network_threads);
+
 		m_settings = s;
 
 		if (m_settings.cache_buffer_chunk_size <= 0)
 			m_settings.cache_buffer_chunk_size = 1;
 
+		m_host_resolver.set_cache_timeout(m_settings.resolver_cache_timeout);
+		m_host_resolver.set_negative_cache_timeout(m_settings.resolver_negative_cache_timeout);
+
 		update_rate_settings();
 
 		if (connections_limit_changed) update_connections_limit();
@@ -2521,9 +2678,7 @@ retry:
 	bool session_impl::incoming_packet(error_code const& ec
 		, udp::endpoint const& ep, char const* buf, int size)
 	{
-#ifdef TORRENT_STATS
-		++m_num_messages[on_udp_counter];
-#endif
+		inc_stats_counter(counters::on_udp_counter);
 
 		if (ec)
 		{
@@ -2576,9 +2731,7 @@ retry:
 #if defined TORRENT_ASIO_DEBUGGING
 		complete_async("session_impl::on_accept_connection");
 #endif
-#ifdef TORRENT_STATS
-		++m_num_messages[on_accept_counter];
-#endif
+		inc_stats_counter(counters::on_accept_counter);
 		TORRENT_ASSERT(is_network_thread());
 		boost::shared_ptr<socket_acceptor> listener = listen_socket.lock();
 		if (!listener) return;
@@ -3000,9 +3153,7 @@ retry:
 	// wake them up
 	void session_impl::on_disk_queue()
 	{
-#ifdef TORRENT_STATS
-		++m_num_messages[on_disk_queue_counter];
-#endif
+		inc_stats_counter(counters::on_disk_queue_counter);
 		TORRENT_ASSERT(is_network_thread());
 
 		// just to play it safe
@@ -3044,9 +3195,7 @@ retry:
 #if defined TORRENT_ASIO_DEBUGGING
 		complete_async("session_impl::on_tick");
 #endif
-#ifdef TORRENT_STATS
-		++m_num_messages[on_tick_counter];
-#endif
+		inc_stats_counter(counters::on_tick_counter);
 
 		TORRENT_ASSERT(is_network_thread());
 
@@ -3088,7 +3237,16 @@ retry:
 
 		m_last_tick = now;
 
+		// the time each phase of the tick takes is recorded in the latency
+		// histograms. The once-per-second phases are sampled every second,
+		// whether they had any work to do or not
+		ptime phase_start = time_now_hires();
+		// uTP packets resent on timeout go out as one batch
+		m_udp_socket.cork();
 		m_utp_socket_manager.tick(now);
+		m_udp_socket.uncork();
+		m_stats_counters.add_latency_sample(counters::tick_utp_time
+			, time_now_hires() - phase_start);
 
 		// only tick the following once per second
 		if (now - m_last_second_tick < seconds(1)) return;
@@ -3214,12 +3372,15 @@ retry:
 		// --------------------------------------------------------------
 		// auto managed torrent
 		// --------------------------------------------------------------
+		phase_start = time_now_hires();
 		if (!m_paused) m_auto_manage_time_scaler--;
 		if (m_auto_manage_time_scaler < 0)
 		{
 			m_auto_manage_time_scaler = settings().auto_manage_interval;
 			recalculate_auto_managed_torrents();
 		}
+		m_stats_counters.add_latency_sample(counters::tick_auto_manage_time
+			, time_now_hires() - phase_start);
 
 		// --------------------------------------------------------------
 		// check for incoming connections that might have timed out
@@ -3258,6 +3419,7 @@ retry:
 
 		int num_checking = 0;
 		int num_queued = 0;
+		phase_start = time_now_hires();
 		for (torrent_map::iterator i = m_torrents.begin();
 			i != m_torrents.end();)
 		{
@@ -3295,6 +3457,8 @@ retry:
 			++i;
 			t.second_tick(m_stat, tick_interval_ms);
 		}
+		m_stats_counters.add_latency_sample(counters::tick_torrents_time
+			, time_now_hires() - phase_start);
 
 		// some people claim that there sometimes can be cases where
 		// there is no torrent being checked, but there are torrents
@@ -3435,11 +3599,15 @@ retry:
 		// connect new peers
 		// --------------------------------------------------------------
 
+		phase_start = time_now_hires();
 		try_connect_more_peers(num_downloads, num_downloads_peers);
+		m_stats_counters.add_latency_sample(counters::tick_connect_peers_time
+			, time_now_hires() - phase_start);
 
 		// --------------------------------------------------------------
 		// unchoke set calculations
 		// --------------------------------------------------------------
+		phase_start = time_now_hires();
 		m_unchoke_time_scaler--;
 		if (m_unchoke_time_scaler <= 0 && !m_connections.empty())
 		{
@@ -3458,10 +3626,13 @@ retry:
 				= settings().optimistic_unchoke_interval;
 			recalculate_optimistic_unchoke_slots();
 		}
+		m_stats_counters.add_latency_sample(counters::tick_unchoke_time
+			, time_now_hires() - phase_start);
 
 		// --------------------------------------------------------------
 		// disconnect peers when we have too many
 		// --------------------------------------------------------------
+		phase_start = time_now_hires();
 		--m_disconnect_time_scaler;
 		if (m_disconnect_time_scaler <= 0)
 		{
@@ -3503,6 +3674,12 @@ retry:
 			}
 		}
 
+		ptime const tick_end = time_now_hires();
+		m_stats_counters.add_latency_sample(counters::tick_disconnect_time
+			, tick_end - phase_start);
+		m_stats_counters.add_latency_sample(counters::tick_total_time
+			, tick_end - now);
+
 		while (m_tick_residual >= 1000) m_tick_residual -= 1000;
 //		m_peer_pool.release_memory();
 	}
@@ -3518,7 +3695,11 @@ retry:
 		reset_stat_counters();
 		if (!s)
 		{
-			if (m_stats_logger) fclose(m_stats_logger);
+			if (m_stats_logger)
+			{
+				write_latency_log();
+				fclose(m_stats_logger);
+			}
 			m_stats_logger = 0;
 		}
 		else
@@ -3530,29 +3711,9 @@ retry:
 
 	void session_impl::reset_stat_counters()
 	{
-		m_end_game_piece_picker_blocks = 0;
-		m_piece_picker_blocks = 0;
-		m_piece_picks = 0;
-		m_reject_piece_picks = 0;
-		m_unchoke_piece_picks = 0;
-		m_incoming_redundant_piece_picks = 0;
-		m_incoming_piece_picks = 0;
-		m_end_game_piece_picks = 0;
-		m_snubbed_piece_picks = 0;
-		m_connection_attempts = 0;
-		m_num_banned_peers = 0;
-		m_banned_for_hash_failure = 0;
-
-		m_piece_requests = 0;
-		m_max_piece_requests = 0;
-		m_invalid_piece_requests = 0;
-		m_choked_piece_requests = 0;
-		m_cancelled_piece_requests = 0;
-		m_piece_rejects = 0;
-
-		memset(m_num_messages, 0, sizeof(m_num_messages));
-		memset(m_send_buffer_sizes, 0, sizeof(m_send_buffer_sizes));
-		memset(m_recv_buffer_sizes, 0, sizeof(m_recv_buffer_sizes));
+		// the log prints the number of events since the last line
+		for (int i = 0; i < counters::num_counters; ++i)
+			m_last_stats_counters[i] = m_stats_counters[i];
 	}
 
 	void session_impl::print_log_line(int tick_interval_ms, ptime now)
@@ -3799,6 +3960,10 @@ retry:
 #define STAT_LOGL(type, val) fprintf(m_stats_logger, "%" #type "\t", val)
 #endif
 #define STAT_LOG(type, val) fprintf(m_stats_logger, "%" #type "\t", val)
+// the number of events since the last log line
+#define STAT_COUNTER(c) STAT_LOG(d, int(m_stats_counters[counters::c] - m_last_stats_counters[counters::c]))
+// the number of events since the log file was rotated
+#define STAT_CUMULATIVE(c) STAT_LOG(d, int(m_stats_counters[counters::c] - m_rotation_stats_counters[counters::c]))
 
 			STAT_LOG(f, total_milliseconds(now - m_last_log_rotation) / 1000.f);
 			size_type uploaded = m_stat.total_upload() - m_last_uploaded;
@@ -3839,31 +4004,33 @@ retry:
 			STAT_LOGL(d, peer_ul_rate_buckets[4]);
 			STAT_LOGL(d, peer_ul_rate_buckets[5]);
 			STAT_LOGL(d, peer_ul_rate_buckets[6]);
-			STAT_LOGL(d, m_error_peers);
+			STAT_CUMULATIVE(error_peers);
 			STAT_LOGL(d, peers_down_interesting);
 			STAT_LOGL(d, peers_down_unchoked);
 			STAT_LOGL(d, peers_down_requests);
 			STAT_LOGL(d, peers_up_interested);
 			STAT_LOGL(d, peers_up_unchoked);
 			STAT_LOGL(d, peers_up_requests);
-			STAT_LOGL(d, m_disconnected_peers);
-			STAT_LOGL(d, m_eof_peers);
-			STAT_LOGL(d, m_connreset_peers);
+			STAT_CUMULATIVE(disconnected_peers);
+			STAT_CUMULATIVE(eof_peers);
+			STAT_CUMULATIVE(connreset_peers);
 			STAT_LOGL(d, outstanding_requests);
 			STAT_LOGL(d, outstanding_end_game_requests);
 			STAT_LOGL(d, outstanding_write_blocks);
-			STAT_LOGL(d, m_end_game_piece_picker_blocks);
-			STAT_LOGL(d, m_piece_picker_blocks);
-			STAT_LOGL(d, m_piece_picks);
-			STAT_LOGL(d, m_reject_piece_picks);
-			STAT_LOGL(d, m_unchoke_piece_picks);
-			STAT_LOGL(d, m_incoming_redundant_piece_picks);
-			STAT_LOGL(d, m_incoming_piece_picks);
-			STAT_LOGL(d, m_end_game_piece_picks);
-			STAT_LOGL(d, m_snubbed_piece_picks);
-			STAT_LOGL(d, m_connect_timeouts);
-			STAT_LOGL(d, m_uninteresting_peers);
-			STAT_LOGL(d, m_timeout_peers);
+			STAT_COUNTER(end_game_piece_picker_blocks);
+			STAT_COUNTER(piece_picker_blocks);
+			// this column used to be the number of piece picks, which
+			// was never counted
+			STAT_LOG(d, 0);
+			STAT_COUNTER(reject_piece_picks);
+			STAT_COUNTER(unchoke_piece_picks);
+			STAT_COUNTER(incoming_redundant_piece_picks);
+			STAT_COUNTER(incoming_piece_picks);
+			STAT_COUNTER(end_game_piece_picks);
+			STAT_COUNTER(snubbed_piece_picks);
+			STAT_CUMULATIVE(connect_timeouts);
+			STAT_CUMULATIVE(uninteresting_peers);
+			STAT_CUMULATIVE(timeout_peers);
 			STAT_LOG(f, (float(m_total_failed_bytes) * 100.f / (m_stat.total_payload_download() == 0 ? 1 : m_stat.total_payload_download())));
 			STAT_LOG(f, (float(m_total_redundant_bytes) * 100.f / (m_stat.total_payload_download() == 0 ? 1 : m_stat.total_payload_download())));
 			STAT_LOG(f, (float(m_stat.total_protocol_download()) * 100.f / (m_stat.total_download() == 0 ? 1 : m_stat.total_download())));
@@ -3884,9 +4051,9 @@ retry:
 			STAT_LOG(f, float(cs.average_hash_time) / 1000000.f);
 			STAT_LOG(f, float(cs.average_job_time) / 1000000.f);
 			STAT_LOG(f, float(cs.average_sort_time) / 1000000.f);
-			STAT_LOGL(d, m_connection_attempts);
-			STAT_LOGL(d, m_num_banned_peers);
-			STAT_LOGL(d, m_banned_for_hash_failure);
+			STAT_COUNTER(connection_attempts);
+			STAT_COUNTER(num_banned_peers);
+			STAT_COUNTER(banned_for_hash_failure);
 			STAT_LOGL(d, m_settings.cache_size);
 			STAT_LOGL(d, m_settings.connections_limit);
 			STAT_LOGL(d, connect_candidates);
@@ -3932,19 +4099,17 @@ retry:
 
 			STAT_LOGL(d, reading_bytes);
 
-			for (int i = 0; i < max_messages; ++i)
+			for (int i = counters::on_read_counter; i <= counters::on_disk_write_counter; ++i)
 			{
-				STAT_LOGL(d, m_num_messages[i]);
+				STAT_LOG(d, int(m_stats_counters[i] - m_last_stats_counters[i]));
 			}
-			int num_max = sizeof(m_send_buffer_sizes)/sizeof(m_send_buffer_sizes[0]);
-			for (int i = 0; i < num_max; ++i)
+			for (int i = counters::socket_send_size3; i <= counters::socket_send_size20; ++i)
 			{
-				STAT_LOGL(d, m_send_buffer_sizes[i]);
+				STAT_LOG(d, int(m_stats_counters[i] - m_last_stats_counters[i]));
 			}
-			num_max = sizeof(m_recv_buffer_sizes)/sizeof(m_recv_buffer_sizes[0]);
-			for (int i = 0; i < num_max; ++i)
+			for (int i = counters::socket_recv_size3; i <= counters::socket_recv_size20; ++i)
 			{
-				STAT_LOGL(d, m_recv_buffer_sizes[i]);
+				STAT_LOG(d, int(m_stats_counters[i] - m_last_stats_counters[i]));
 			}
 
 			STAT_LOG(f, total_microseconds(cur_cpu_usage.user_time
@@ -3960,9 +4125,9 @@ retry:
 				STAT_LOG(f, (m_redundant_bytes[i] * 100.) / double(m_total_redundant_bytes == 0 ? 1 : m_total_redundant_bytes));
 			}
 
-			STAT_LOGL(d, m_no_memory_peers);
-			STAT_LOGL(d, m_too_many_peers);
-			STAT_LOGL(d, m_transport_timeout_peers);
+			STAT_CUMULATIVE(no_memory_peers);
+			STAT_CUMULATIVE(too_many_peers);
+			STAT_CUMULATIVE(transport_timeout_peers);
 
 			STAT_LOGL(d, sst.utp_stats.num_idle);
 			STAT_LOGL(d, sst.utp_stats.num_syn_sent);
@@ -3973,23 +4138,23 @@ retry:
 			STAT_LOGL(d, num_tcp_peers);
 			STAT_LOGL(d, num_utp_peers);
 
-			STAT_LOGL(d, m_connrefused_peers);
-			STAT_LOGL(d, m_connaborted_peers);
-			STAT_LOGL(d, m_perm_peers);
-			STAT_LOGL(d, m_buffer_peers);
-			STAT_LOGL(d, m_unreachable_peers);
-			STAT_LOGL(d, m_broken_pipe_peers);
-			STAT_LOGL(d, m_addrinuse_peers);
-			STAT_LOGL(d, m_no_access_peers);
-			STAT_LOGL(d, m_invalid_arg_peers);
-			STAT_LOGL(d, m_aborted_peers);
-
-			STAT_LOGL(d, m_error_incoming_peers);
-			STAT_LOGL(d, m_error_outgoing_peers);
-			STAT_LOGL(d, m_error_rc4_peers);
-			STAT_LOGL(d, m_error_encrypted_peers);
-			STAT_LOGL(d, m_error_tcp_peers);
-			STAT_LOGL(d, m_error_utp_peers);
+			STAT_CUMULATIVE(connrefused_peers);
+			STAT_CUMULATIVE(connaborted_peers);
+			STAT_CUMULATIVE(perm_peers);
+			STAT_CUMULATIVE(buffer_peers);
+			STAT_CUMULATIVE(unreachable_peers);
+			STAT_CUMULATIVE(broken_pipe_peers);
+			STAT_CUMULATIVE(addrinuse_peers);
+			STAT_CUMULATIVE(no_access_peers);
+			STAT_CUMULATIVE(invalid_arg_peers);
+			STAT_CUMULATIVE(aborted_peers);
+
+			STAT_CUMULATIVE(error_incoming_peers);
+			STAT_CUMULATIVE(error_outgoing_peers);
+			STAT_CUMULATIVE(error_rc4_peers);
+			STAT_CUMULATIVE(error_encrypted_peers);
+			STAT_CUMULATIVE(error_tcp_peers);
+			STAT_CUMULATIVE(error_utp_peers);
 
 			STAT_LOG(d, int(m_connections.size()));
 			STAT_LOGL(d, pending_incoming_reqs);
@@ -3998,12 +4163,12 @@ retry:
 			STAT_LOGL(d, num_want_more_peers);
 			STAT_LOG(f, total_peers_limit == 0 ? 0 : float(num_limited_peers) / total_peers_limit);
 
-			STAT_LOGL(d, m_piece_requests);
-			STAT_LOGL(d, m_max_piece_requests);
-			STAT_LOGL(d, m_invalid_piece_requests);
-			STAT_LOGL(d, m_choked_piece_requests);
-			STAT_LOGL(d, m_cancelled_piece_requests);
-			STAT_LOGL(d, m_piece_rejects);
+			STAT_COUNTER(piece_requests);
+			STAT_COUNTER(max_piece_requests);
+			STAT_COUNTER(invalid_piece_requests);
+			STAT_COUNTER(choked_piece_requests);
+			STAT_COUNTER(cancelled_piece_requests);
+			STAT_COUNTER(piece_rejects);
 
 			STAT_LOGL(d, peers_up_send_buffer);
 
@@ -4024,6 +4189,8 @@ retry:
 
 #undef STAT_LOG
 #undef STAT_LOGL
+#undef STAT_COUNTER
+#undef STAT_CUMULATIVE
 
 			m_last_cache_status = cs;
 			m_last_vm_stat = vm_stat;
@@ -4152,9 +4319,7 @@ retry:
 #if defined TORRENT_ASIO_DEBUGGING
 		complete_async("session_impl::on_lsd_announce");
 #endif
-#ifdef TORRENT_STATS
-		++m_num_messages[on_lsd_counter];
-#endif
+		inc_stats_counter(counters::on_lsd_counter);
 		TORRENT_ASSERT(is_network_thread());
 		if (e) return;
 
@@ -4518,9 +4683,7 @@ retry:
 								--max_connections;
 								--free_slots;
 								steps_since_last_connect = 0;
-#ifdef TORRENT_STATS
-								++m_connection_attempts;
-#endif
+								inc_stats_counter(counters::connection_attempts);
 							}
 						}
 						TORRENT_CATCH(std::bad_alloc&)
@@ -5004,6 +5167,147 @@ retry:
 		m_alerts.post_alert_ptr(alert.release());
 	}
 
+	void session_impl::post_torrent_delta_updates()
+	{
+		INVARIANT_CHECK;
+
+		TORRENT_ASSERT(is_network_thread());
+
+		std::auto_ptr<state_delta_alert> alert(new state_delta_alert());
+		alert->deltas.reserve(m_state_updates.size());
+
+#if TORRENT_USE_ASSERTS
+		m_posting_torrent_updates = true;
+#endif
+
+		for (std::vector<boost::weak_ptr<torrent> >::iterator i = m_state_updates.begin()
+			, end(m_state_updates.end()); i != end; ++i)
+		{
+			boost::shared_ptr<torrent> t = i->lock();
+			if (!t) continue;
+			// torrent::status() leaves some fields untouched depending
+			// on the state of the torrent, so this can't be reused
+			torrent_status st;
+			t->status(&st, 0xffffffff);
+			t->clear_in_state_update();
+
+			alert->deltas.push_back(torrent_status_delta());
+			if (!t->last_status_snapshot().update(st, alert->deltas.back()))
+				alert->deltas.pop_back();
+		}
+		m_state_updates.clear();
+
+#if TORRENT_USE_ASSERTS
+		m_posting_torrent_updates = false;
+#endif
+
+		m_alerts.post_alert_ptr(alert.release());
+	}
+
+	void session_impl::post_session_stats()
+	{
+		TORRENT_ASSERT(is_network_thread());
+
+		// counters are updated as the events happen. The gauges and the
+		// totals kept by other subsystems are sampled here
+		int checking_torrents = 0;
+		int stopped_torrents = 0;
+		int upload_only_torrents = 0;
+		int downloading_torrents = 0;
+		int seeding_torrents = 0;
+		int queued_seed_torrents = 0;
+		int queued_download_torrents = 0;
+		int error_torrents = 0;
+
+		for (torrent_map::iterator i = m_torrents.begin()
+			, end(m_torrents.end()); i != end; ++i)
+		{
+			torrent* t = i->second.get();
+			if (t->has_error())
+				++error_torrents;
+			else if (t->is_paused())
+			{
+				if (!t->is_auto_managed())
+					++stopped_torrents;
+				else if (t->is_seed())
+					++queued_seed_torrents;
+				else
+					++queued_download_torrents;
+			}
+			else if (t->state() == torrent_status::checking_files
+				|| t->state() == torrent_status::queued_for_checking)
+				++checking_torrents;
+			else if (t->is_seed())
+				++seeding_torrents;
+			else if (t->is_upload_only())
+				++upload_only_torrents;
+			else
+				++downloading_torrents;
+		}
+
+		counters& c = m_stats_counters;
+		c.set_value(counters::num_checking_torrents, checking_torrents);
+		c.set_value(counters::num_stopped_torrents, stopped_torrents);
+		c.set_value(counters::num_upload_only_torrents, upload_only_torrents);
+		c.set_value(counters::num_downloading_torrents, downloading_torrents);
+		c.set_value(counters::num_seeding_torrents, seeding_torrents);
+		c.set_value(counters::num_queued_seeding_torrents, queued_seed_torrents);
+		c.set_value(counters::num_queued_download_torrents, queued_download_torrents);
+		c.set_value(counters::num_error_torrents, error_torrents);
+
+		c.set_value(counters::num_peers_connected, int(m_connections.size()));
+		c.set_value(counters::num_peers_half_open, m_half_open.num_connecting());
+		c.set_value(counters::num_unchoke_slots, m_allowed_upload_slots);
+		c.set_value(counters::num_upload_rate_queue, m_upload_rate.queue_size());
+		c.set_value(counters::num_download_rate_queue, m_download_rate.queue_size());
+
+		c.set_value(counters::sent_bytes, m_stat.total_upload());
+		c.set_value(counters::sent_payload_bytes, m_stat.total_payload_upload());
+		c.set_value(counters::recv_bytes, m_stat.total_download());
+		c.set_value(counters::recv_payload_bytes, m_stat.total_payload_download());
+		c.set_value(counters::recv_failed_bytes, m_total_failed_bytes);
+		c.set_value(counters::recv_redundant_bytes, m_total_redundant_bytes);
+
+		cache_status cs = m_disk_thread.status();
+		c.set_value(counters::disk_blocks_written, cs.blocks_written);
+		c.set_value(counters::disk_blocks_read, cs.blocks_read);
+		c.set_value(counters::disk_blocks_read_hit, cs.blocks_read_hit);
+		c.set_value(counters::disk_writes, cs.writes);
+		c.set_value(counters::disk_reads, cs.reads);
+		c.set_value(counters::disk_cache_size, cs.cache_size);
+		c.set_value(counters::disk_read_cache_size, cs.read_cache_size);
+		c.set_value(counters::disk_used_buffers, cs.total_used_buffers);
+		c.set_value(counters::disk_queued_bytes, cs.queued_bytes);
+		c.set_value(counters::disk_job_queue_length, cs.job_queue_length);
+
+		utp_status us;
+		m_utp_socket_manager.get_status(us);
+		c.set_value(counters::utp_packet_loss, us.packet_loss);
+		c.set_value(counters::utp_timeout, us.timeout);
+		c.set_value(counters::utp_packets_in, us.packets_in);
+		c.set_value(counters::utp_packets_out, us.packets_out);
+		c.set_value(counters::utp_fast_retransmit, us.fast_retransmit);
+		c.set_value(counters::utp_packet_resend, us.packet_resend);
+		c.set_value(counters::utp_samples_above_target, us.samples_above_target);
+		c.set_value(counters::utp_samples_below_target, us.samples_below_target);
+		c.set_value(counters::utp_payload_pkts_in, us.payload_pkts_in);
+		c.set_value(counters::utp_payload_pkts_out, us.payload_pkts_out);
+		c.set_value(counters::utp_invalid_pkts_in, us.invalid_pkts_in);
+		c.set_value(counters::utp_redundant_pkts_in, us.redundant_pkts_in);
+		c.set_value(counters::utp_paced_packets, us.paced_packets);
+		c.set_value(counters::utp_packet_pool_hits, us.packet_pool_hits);
+		c.set_value(counters::utp_packet_pool_misses, us.packet_pool_misses);
+		c.set_value(counters::utp_num_idle, us.num_idle);
+		c.set_value(counters::utp_num_syn_sent, us.num_syn_sent);
+		c.set_value(counters::utp_num_connected, us.num_connected);
+		c.set_value(counters::utp_num_fin_sent, us.num_fin_sent);
+		c.set_value(counters::utp_num_close_wait, us.num_close_wait);
+		c.set_value(counters::utp_packets_in_use, us.packets_in_use);
+		c.set_value(counters::utp_packets_high_water, us.packets_high_water);
+
+		m_alerts.post_alert_ptr(new session_stats_alert(m_stats_counters));
+	}
+
 	std::vector<torrent_handle> session_impl::get_torrents() const
 	{
 		std::vector<torrent_handle> ret;
@@ -5023,6 +5327,75 @@ retry:
 		return torrent_handle(find_torrent(info_hash));
 	}
 
+	namespace
+	{
+		// this is the part of adding a torrent that does not depend on the
+		// session state. It may be called from any thread, and calling it
+		// more than once on the same parameters is harmless. It turns magnet
+		// links and file:// URLs into torrent_info objects and picks up the
+		// metadata stored in resume data, if there is any
+		void load_torrent_params(add_torrent_params& params, error_code& ec)
+		{
+			if (string_begins_no_case("magnet:", params.url.c_str()))
+			{
+				parse_magnet_uri(params.url, params, ec);
+				if (ec) return;
+				params.url.clear();
+			}
+
+			if (!params.ti && string_begins_no_case("file://", params.url.c_str()))
+			{
+				boost::intrusive_ptr<torrent_info> ti(
+					new torrent_info(params.url.substr(7), ec));
+				if (ec) return;
+				params.ti = ti;
+				params.url.clear();
+			}
+
+			if (params.ti && params.ti->is_valid() && params.ti->num_files() == 0)
+			{
+				ec = errors::no_files_in_torrent;
+				return;
+			}
+
+			// we don't have a torrent file. If the user provided
+			// resume data, there may be some metadata in there
+			if ((params.ti && params.ti->is_valid())
+				|| params.resume_data.empty())
+				return;
+
+			int pos;
+			error_code err;
+			lazy_entry tmp;
+			lazy_entry const* info = 0;
+			if (lazy_bdecode(&params.resume_data[0], &params.resume_data[0]
+					+ params.resume_data.size(), tmp, err, &pos) != 0
+				|| tmp.type() != lazy_entry::dict_t
+				|| (info = tmp.dict_find_dict("info")) == 0)
+				return;
+
+			// verify the info-hash of the metadata stored in the resume file matches
+			// the torrent we're loading
+			std::pair<char const*, int> buf = info->data_section();
+			sha1_hash resume_ih = hasher(buf.first, buf.second).final();
+
+			// if url is set, the info_hash is not actually the info-hash of the
+			// torrent, but the hash of the URL, until we have the full torrent
+			// only require the info-hash to match if we actually passed in one
+			if (resume_ih != params.info_hash
+				&& params.url.empty()
+				&& !params.info_hash.is_all_zeros())
+				return;
+
+			boost::intrusive_ptr<torrent_info> ti(new torrent_info(resume_ih));
+			if (!ti->parse_info_section(*info, err, 0)) return;
+
+			// make the info-hash be the one in the resume file
+			params.ti = ti;
+			params.info_hash = resume_ih;
+		}
+	}
+
 	void session_impl::async_add_torrent(add_torrent_params* params)
 	{
 		error_code ec;
@@ -5030,6 +5403,128 @@ retry:
 		delete params;
 	}
 
+	void session_impl::async_add_torrents(std::vector<add_torrent_params>* params)
+	{
+		TORRENT_ASSERT(is_network_thread());
+
+		boost::shared_ptr<add_torrent_batch> b(new add_torrent_batch);
+		b->params.swap(*params);
+		delete params;
+
+		int const num_torrents = b->params.size();
+		if (num_torrents == 0) return;
+		b->errors.resize(num_torrents);
+
+		int num_threads = (std::min)(m_settings.add_torrent_threads, num_torrents);
+		if (num_threads <= 0 || m_abort)
+		{
+			// no parser threads. add_torrent_impl() will do
+			// all the work on the network thread
+			b->done.resize(num_torrents, true);
+			b->handler_posted = true;
+			m_io_service.post(boost::bind(&session_impl::on_add_torrent_batch, this, b));
+			return;
+		}
+
+		b->done.resize(num_torrents, false);
+		m_add_torrent_batches.push_back(b);
+		mutex::scoped_lock l(b->mtx);
+		for (int i = 0; i < num_threads; ++i)
+		{
+			b->threads.push_back(boost::shared_ptr<thread>(new thread(boost::bind(
+				&session_impl::add_torrent_batch_thread, this, b))));
+		}
+	}
+
+	// this runs in the parser threads. It must not touch anything in the
+	// session except for posting to the io_service
+	void session_impl::add_torrent_batch_thread(boost::shared_ptr<add_torrent_batch> b)
+	{
+		mutex::scoped_lock l(b->mtx);
+		while (!b->abort && b->next_job < int(b->params.size()))
+		{
+			int i = b->next_job++;
+			l.unlock();
+
+			// nobody else touches params[i] until done[i] is set
+			error_code ec;
+			load_torrent_params(b->params[i], ec);
+
+			l.lock();
+			b->errors[i] = ec;
+			b->done[i] = true;
+			if (i == b->next_add && !b->handler_posted)
+			{
+				b->handler_posted = true;
+				m_io_service.post(boost::bind(&session_impl::on_add_torrent_batch, this, b));
+			}
+		}
+	}
+
+	void session_impl::on_add_torrent_batch(boost::shared_ptr<add_torrent_batch> b)
+	{
+		TORRENT_ASSERT(is_network_thread());
+
+		// the max number of torrents to add in one go, before letting
+		// the network thread handle other events
+		const int max_batch_size = 100;
+
+		int const num_torrents = b->params.size();
+		int first;
+		int last;
+		{
+			mutex::scoped_lock l(b->mtx);
+			TORRENT_ASSERT(b->handler_posted);
+			first = b->next_add;
+			last = first;
+			while (last < num_torrents && last - first < max_batch_size && b->done[last])
+				++last;
+			b->next_add = last;
+
+			// if there are more torrents ready to be added, come back
+			// for them once we're done with this batch
+			if (last < num_torrents && b->done[last])
+				m_io_service.post(boost::bind(&session_impl::on_add_torrent_batch, this, b));
+			else
+				b->handler_posted = false;
+		}
+
+		// find the end of the queue once for the whole batch, rather
+		// than once per torrent
+		int queue_pos = 0;
+		for (torrent_map::const_iterator i = m_torrents.begin()
+			, end(m_torrents.end()); i != end; ++i)
+		{
+			int pos = i->second->queue_position();
+			if (pos >= queue_pos) queue_pos = pos + 1;
+		}
+
+		for (int i = first; i < last; ++i)
+		{
+			error_code ec = b->errors[i];
+			torrent_handle h;
+			if (!ec) h = add_torrent_impl(b->params[i], ec, &queue_pos);
+			m_alerts.post_alert(add_torrent_alert(h, b->params[i], ec));
+
+			// the torrent has its own copy by now. Free the metadata
+			// and resume data as we go
+			b->params[i] = add_torrent_params();
+		}
+
+		if (last < num_torrents) return;
+
+		// all torrents have been added. The parser threads have
+		// run out of work and are about to exit
+		for (std::vector<boost::shared_ptr<thread> >::iterator i = b->threads.begin()
+			, end(b->threads.end()); i != end; ++i)
+			(*i)->join();
+		b->threads.clear();
+
+		std::vector<boost::shared_ptr<add_torrent_batch> >::iterator i
+			= std::find(m_add_torrent_batches.begin(), m_add_torrent_batches.end(), b);
+		if (i != m_add_torrent_batches.end()) m_add_torrent_batches.erase(i);
+	}
+
 	torrent_handle session_impl::add_torrent(add_torrent_params const& p
 		, error_code& ec)
 	{
@@ -5039,7 +5534,7 @@ retry:
 	}
 
 	torrent_handle session_impl::add_torrent_impl(add_torrent_params const& p
-		, error_code& ec)
+		, error_code& ec, int* queue_pos_hint)
 	{
 		TORRENT_ASSERT(!p.save_path.empty());
 
@@ -5048,18 +5543,17 @@ retry:
 #endif
 
 		add_torrent_params params = p;
-		if (string_begins_no_case("magnet:", params.url.c_str()))
-		{
-			parse_magnet_uri(params.url, params, ec);
-			if (ec) return torrent_handle();
-			params.url.clear();
-		}
+#if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING
+		bool const had_metadata = params.ti && params.ti->is_valid();
+#endif
+		load_torrent_params(params, ec);
+		if (ec) return torrent_handle();
 
-		if (params.ti && params.ti->is_valid() && params.ti->num_files() == 0)
-		{
-			ec = errors::no_files_in_torrent;
-			return torrent_handle();
-		}
+#if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING
+		if (!had_metadata && params.ti && params.ti->is_valid()
+			&& !params.resume_data.empty())
+			session_log("successfully loaded metadata from resume file");
+#endif
 
 #ifndef TORRENT_DISABLE_DHT	
 		// add p.dht_nodes to the DHT, if enabled
@@ -5095,76 +5589,6 @@ retry:
 		}
 		else ih = &params.info_hash;
 
-		// we don't have a torrent file. If the user provided
-		// resume data, there may be some metadata in there
-		if ((!params.ti || !params.ti->is_valid())
-			&& !params.resume_data.empty())
-		{
-			int pos;
-			error_code ec;
-			lazy_entry tmp;
-			lazy_entry const* info = 0;
-#if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING
-			session_log("adding magnet link with resume data");
-#endif
-			if (lazy_bdecode(&params.resume_data[0], &params.resume_data[0]
-					+ params.resume_data.size(), tmp, ec, &pos) == 0
-				&& tmp.type() == lazy_entry::dict_t
-				&& (info = tmp.dict_find_dict("info")))
-			{
-#if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING
-				session_log("found metadata in resume data");
-#endif
-				// verify the info-hash of the metadata stored in the resume file matches
-				// the torrent we're loading
-
-				std::pair<char const*, int> buf = info->data_section();
-				sha1_hash resume_ih = hasher(buf.first, buf.second).final();
-
-				// if url is set, the info_hash is not actually the info-hash of the
-				// torrent, but the hash of the URL, until we have the full torrent
-				// only require the info-hash to match if we actually passed in one
-				if (resume_ih == params.info_hash
-					|| !params.url.empty()
-					|| params.info_hash.is_all_zeros())
-				{
-#if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING
-					session_log("info-hash matched");
-#endif
-					params.ti = new torrent_info(resume_ih);
-
-					if (params.ti->parse_info_section(*info, ec, 0))
-					{
-#if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING
-						session_log("successfully loaded metadata from resume file");
-#endif
-						// make the info-hash be the one in the resume file
-						params.info_hash = resume_ih;
-						ih = &params.info_hash;
-					}
-					else
-					{
-#if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING || defined TORRENT_ERROR_LOGGING
-						session_log("failed to load metadata from resume file: %s"
-								, ec.message().c_str());
-#endif
-					}
-				}
-#if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING || defined TORRENT_ERROR_LOGGING
-				else
-				{
-					session_log("metadata info-hash failed");
-				}
-#endif
-			}
-#if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING || defined TORRENT_ERROR_LOGGING
-			else
-			{
-				session_log("no metadata found");
-			}
-#endif
-		}
-
 		// is the torrent already active?
 		boost::shared_ptr<torrent> torrent_ptr = find_torrent(*ih).lock();
 		if (!torrent_ptr && !params.uuid.empty()) torrent_ptr = find_torrent(params.uuid).lock();
@@ -5196,17 +5620,30 @@ retry:
 		}
 
 		int queue_pos = 0;
-		for (torrent_map::const_iterator i = m_torrents.begin()
-			, end(m_torrents.end()); i != end; ++i)
+		if (queue_pos_hint)
 		{
-			int pos = i->second->queue_position();
-			if (pos >= queue_pos) queue_pos = pos + 1;
+			queue_pos = *queue_pos_hint;
+		}
+		else
+		{
+			for (torrent_map::const_iterator i = m_torrents.begin()
+				, end(m_torrents.end()); i != end; ++i)
+			{
+				int pos = i->second->queue_position();
+				if (pos >= queue_pos) queue_pos = pos + 1;
+			}
 		}
 
 		torrent_ptr.reset(new torrent(*this, m_listen_interface
 			, 16 * 1024, queue_pos, params, *ih));
 		torrent_ptr->start();
 
+		// the new torrent is at the end of the queue. If it left the
+		// queue (because it's a seed) nothing moved, and the next
+		// torrent will take the same position
+		if (queue_pos_hint && torrent_ptr->queue_position() >= 0)
+			*queue_pos_hint = torrent_ptr->queue_position() + 1;
+
 #ifndef TORRENT_DISABLE_EXTENSIONS
 		typedef std::vector<boost::function<
 			boost::shared_ptr<torrent_plugin>(torrent*, void*)> >
@@ -5494,9 +5931,7 @@ retry:
 
 	void session_impl::on_lsd_peer(tcp::endpoint peer, sha1_hash const& ih)
 	{
-#ifdef TORRENT_STATS
-		++m_num_messages[on_lsd_peer_counter];
-#endif
+		inc_stats_counter(counters::on_lsd_peer_counter);
 		TORRENT_ASSERT(is_network_thread());
 
 		INVARIANT_CHECK;
@@ -5674,11 +6109,17 @@ retry:
 			s.dht_nodes = 0;
 			s.dht_node_cache = 0;
 			s.dht_torrents = 0;
+			s.dht_peers = 0;
+			s.dht_items = 0;
+			s.dht_storage_bytes = 0;
 			s.dht_global_nodes = 0;
 			s.dht_total_allocations = 0;
+			s.dht_instances.clear();
 		}
 
 		m_utp_socket_manager.get_status(s.utp_stats);
+		m_tracker_manager.get_status(s);
+		m_host_resolver.get_status(s);
 
 		int peerlist_size = 0;
 		for (torrent_map::const_iterator i = m_torrents.begin()
@@ -5752,19 +6193,18 @@ retry:
 #if defined TORRENT_ASIO_DEBUGGING
 		add_outstanding_async("session_impl::on_dht_router_name_lookup");
 #endif
-		char port[7];
-		snprintf(port, sizeof(port), "%d", node.second);
-		tcp::resolver::query q(node.first, port);
-		m_host_resolver.async_resolve(q,
-			boost::bind(&session_impl::on_dht_router_name_lookup, this, _1, _2));
+		m_host_resolver.async_resolve(node.first,
+			boost::bind(&session_impl::on_dht_router_name_lookup, this, _1, _2
+				, node.second));
 	}
 
 	void session_impl::on_dht_router_name_lookup(error_code const& e
-		, tcp::resolver::iterator host)
+		, std::vector<address> const& addresses, int port)
 	{
 #if defined TORRENT_ASIO_DEBUGGING
 		complete_async("session_impl::on_dht_router_name_lookup");
 #endif
+		if (e == asio::error::operation_aborted) return;
 		if (e)
 		{
 			if (m_alerts.should_post<dht_error_alert>())
@@ -5773,13 +6213,13 @@ retry:
 			return;
 		}
 
-		while (host != tcp::resolver::iterator())
+		for (std::vector<address>::const_iterator i = addresses.begin()
+			, end(addresses.end()); i != end; ++i)
 		{
 			// router nodes should be added before the DHT is started (and bootstrapped)
-			udp::endpoint ep(host->endpoint().address(), host->endpoint().port());
+			udp::endpoint ep(*i, port);
 			if (m_dht) m_dht->add_router_node(ep);
 			m_dht_router_nodes.push_back(ep);
-			++host;
 		}
 	}
 
@@ -5948,7 +6388,11 @@ retry:
 #endif
 
 #ifdef TORRENT_STATS
-		if (m_stats_logger) fclose(m_stats_logger);
+		if (m_stats_logger)
+		{
+			write_latency_log();
+			fclose(m_stats_logger);
+		}
 #endif
 	}
 
@@ -0,0 +1,268 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/session_stats.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <cstring> // for strcmp
+
+namespace libtorrent
+{
+	namespace
+	{
+		struct stats_metric_impl
+		{
+			char const* name;
+			int value_index;
+			stats_metric::metric_type_t type;
+		};
+
+#define METRIC(category, name, type) { #category "." #name, counters:: name, stats_metric:: type_ ## type },
+		const static stats_metric_impl metrics[] =
+		{
+		METRIC(peer, disconnected_peers, counter)
+		METRIC(peer, error_peers, counter)
+		METRIC(peer, eof_peers, counter)
+		METRIC(peer, connreset_peers, counter)
+		METRIC(peer, connrefused_peers, counter)
+		METRIC(peer, connaborted_peers, counter)
+		METRIC(peer, perm_peers, counter)
+		METRIC(peer, buffer_peers, counter)
+		METRIC(peer, unreachable_peers, counter)
+		METRIC(peer, broken_pipe_peers, counter)
+		METRIC(peer, addrinuse_peers, counter)
+		METRIC(peer, no_access_peers, counter)
+		METRIC(peer, invalid_arg_peers, counter)
+		METRIC(peer, aborted_peers, counter)
+		METRIC(peer, uninteresting_peers, counter)
+		METRIC(peer, timeout_peers, counter)
+		METRIC(peer, transport_timeout_peers, counter)
+		METRIC(peer, no_memory_peers, counter)
+		METRIC(peer, too_many_peers, counter)
+		METRIC(peer, connect_timeouts, counter)
+		METRIC(peer, error_incoming_peers, counter)
+		METRIC(peer, error_outgoing_peers, counter)
+		METRIC(peer, error_rc4_peers, counter)
+		METRIC(peer, error_encrypted_peers, counter)
+		METRIC(peer, error_tcp_peers, counter)
+		METRIC(peer, error_utp_peers, counter)
+		METRIC(peer, connection_attempts, counter)
+		METRIC(peer, num_banned_peers, counter)
+		METRIC(peer, banned_for_hash_failure, counter)
+		METRIC(peer, piece_requests, counter)
+		METRIC(peer, max_piece_requests, counter)
+		METRIC(peer, invalid_piece_requests, counter)
+		METRIC(peer, choked_piece_requests, counter)
+		METRIC(peer, cancelled_piece_requests, counter)
+		METRIC(peer, piece_rejects, counter)
+		METRIC(picker, end_game_piece_picker_blocks, counter)
+		METRIC(picker, piece_picker_blocks, counter)
+		METRIC(picker, reject_piece_picks, counter)
+		METRIC(picker, unchoke_piece_picks, counter)
+		METRIC(picker, incoming_redundant_piece_picks, counter)
+		METRIC(picker, incoming_piece_picks, counter)
+		METRIC(picker, end_game_piece_picks, counter)
+		METRIC(picker, snubbed_piece_picks, counter)
+		METRIC(net, on_read_counter, counter)
+		METRIC(net, on_write_counter, counter)
+		METRIC(net, on_tick_counter, counter)
+		METRIC(net, on_lsd_counter, counter)
+		METRIC(net, on_lsd_peer_counter, counter)
+		METRIC(net, on_udp_counter, counter)
+		METRIC(net, on_accept_counter, counter)
+		METRIC(net, on_disk_queue_counter, counter)
+		METRIC(net, on_disk_read_counter, counter)
+		METRIC(net, on_disk_write_counter, counter)
+		METRIC(net, socket_send_size3, counter)
+		METRIC(net, socket_send_size4, counter)
+		METRIC(net, socket_send_size5, counter)
+		METRIC(net, socket_send_size6, counter)
+		METRIC(net, socket_send_size7, counter)
+		METRIC(net, socket_send_size8, counter)
+		METRIC(net, socket_send_size9, counter)
+		METRIC(net, socket_send_size10, counter)
+		METRIC(net, socket_send_size11, counter)
+		METRIC(net, socket_send_size12, counter)
+		METRIC(net, socket_send_size13, counter)
+		METRIC(net, socket_send_size14, counter)
+		METRIC(net, socket_send_size15, counter)
+		METRIC(net, socket_send_size16, counter)
+		METRIC(net, socket_send_size17, counter)
+		METRIC(net, socket_send_size18, counter)
+		METRIC(net, socket_send_size19, counter)
+		METRIC(net, socket_send_size20, counter)
+		METRIC(net, socket_recv_size3, counter)
+		METRIC(net, socket_recv_size4, counter)
+		METRIC(net, socket_recv_size5, counter)
+		METRIC(net, socket_recv_size6, counter)
+		METRIC(net, socket_recv_size7, counter)
+		METRIC(net, socket_recv_size8, counter)
+		METRIC(net, socket_recv_size9, counter)
+		METRIC(net, socket_recv_size10, counter)
+		METRIC(net, socket_recv_size11, counter)
+		METRIC(net, socket_recv_size12, counter)
+		METRIC(net, socket_recv_size13, counter)
+		METRIC(net, socket_recv_size14, counter)
+		METRIC(net, socket_recv_size15, counter)
+		METRIC(net, socket_recv_size16, counter)
+		METRIC(net, socket_recv_size17, counter)
+		METRIC(net, socket_recv_size18, counter)
+		METRIC(net, socket_recv_size19, counter)
+		METRIC(net, socket_recv_size20, counter)
+		METRIC(net, sent_bytes, counter)
+		METRIC(net, sent_payload_bytes, counter)
+		METRIC(net, recv_bytes, counter)
+		METRIC(net, recv_payload_bytes, counter)
+		METRIC(net, recv_failed_bytes, counter)
+		METRIC(net, recv_redundant_bytes, counter)
+		METRIC(disk, disk_blocks_written, counter)
+		METRIC(disk, disk_blocks_read, counter)
+		METRIC(disk, disk_blocks_read_hit, counter)
+		METRIC(disk, disk_writes, counter)
+		METRIC(disk, disk_reads, counter)
+		METRIC(utp, utp_packet_loss, counter)
+		METRIC(utp, utp_timeout, counter)
+		METRIC(utp, utp_packets_in, counter)
+		METRIC(utp, utp_packets_out, counter)
+		METRIC(utp, utp_fast_retransmit, counter)
+		METRIC(utp, utp_packet_resend, counter)
+		METRIC(utp, utp_samples_above_target, counter)
+		METRIC(utp, utp_samples_below_target, counter)
+		METRIC(utp, utp_payload_pkts_in, counter)
+		METRIC(utp, utp_payload_pkts_out, counter)
+		METRIC(utp, utp_invalid_pkts_in, counter)
+		METRIC(utp, utp_redundant_pkts_in, counter)
+		METRIC(utp, utp_paced_packets, counter)
+		METRIC(utp, utp_packet_pool_hits, counter)
+		METRIC(utp, utp_packet_pool_misses, counter)
+		METRIC(ses, num_checking_torrents, gauge)
+		METRIC(ses, num_stopped_torrents, gauge)
+		METRIC(ses, num_upload_only_torrents, gauge)
+		METRIC(ses, num_downloading_torrents, gauge)
+		METRIC(ses, num_seeding_torrents, gauge)
+		METRIC(ses, num_queued_seeding_torrents, gauge)
+		METRIC(ses, num_queued_download_torrents, gauge)
+		METRIC(ses, num_error_torrents, gauge)
+		METRIC(peer, num_peers_connected, gauge)
+		METRIC(peer, num_peers_half_open, gauge)
+		METRIC(ses, num_unchoke_slots, gauge)
+		METRIC(ses, num_upload_rate_queue, gauge)
+		METRIC(ses, num_download_rate_queue, gauge)
+		METRIC(disk, disk_cache_size, gauge)
+		METRIC(disk, disk_read_cache_size, gauge)
+		METRIC(disk, disk_used_buffers, gauge)
+		METRIC(disk, disk_queued_bytes, gauge)
+		METRIC(disk, disk_job_queue_length, gauge)
+		METRIC(utp, utp_num_idle, gauge)
+		METRIC(utp, utp_num_syn_sent, gauge)
+		METRIC(utp, utp_num_connected, gauge)
+		METRIC(utp, utp_num_fin_sent, gauge)
+		METRIC(utp, utp_num_close_wait, gauge)
+		METRIC(utp, utp_packets_in_use, gauge)
+		METRIC(utp, utp_packets_high_water, gauge)
+		};
+#undef METRIC
+
+#define HISTOGRAM(category, name) { #category "." #name, counters:: name, stats_metric::type_histogram },
+		const static stats_metric_impl histograms[] =
+		{
+		HISTOGRAM(disk, disk_queue_time_read)
+		HISTOGRAM(disk, disk_queue_time_write)
+		HISTOGRAM(disk, disk_queue_time_hash)
+		HISTOGRAM(disk, disk_queue_time_check)
+		HISTOGRAM(disk, disk_queue_time_other)
+		HISTOGRAM(disk, disk_job_time_read)
+		HISTOGRAM(disk, disk_job_time_write)
+		HISTOGRAM(disk, disk_job_time_hash)
+		HISTOGRAM(disk, disk_job_time_check)
+		HISTOGRAM(disk, disk_job_time_other)
+		HISTOGRAM(disk, disk_read_time)
+		HISTOGRAM(disk, disk_write_time)
+		HISTOGRAM(disk, disk_hash_time)
+		HISTOGRAM(net, socket_read_handler_duration)
+		HISTOGRAM(peer, handshake_time)
+		HISTOGRAM(picker, pick_pieces_time)
+		HISTOGRAM(ses, tick_utp_time)
+		HISTOGRAM(ses, tick_auto_manage_time)
+		HISTOGRAM(ses, tick_torrents_time)
+		HISTOGRAM(ses, tick_connect_peers_time)
+		HISTOGRAM(ses, tick_unchoke_time)
+		HISTOGRAM(ses, tick_disconnect_time)
+		HISTOGRAM(ses, tick_total_time)
+		};
+#undef HISTOGRAM
+	}
+
+	std::vector<stats_metric> session_stats_metrics()
+	{
+		const int num_metrics = sizeof(metrics) / sizeof(metrics[0]);
+		TORRENT_ASSERT(num_metrics == counters::num_counters);
+		const int num_histograms = sizeof(histograms) / sizeof(histograms[0]);
+		TORRENT_ASSERT(num_histograms == counters::num_histograms);
+
+		std::vector<stats_metric> stats;
+		stats.resize(num_metrics + num_histograms);
+		for (int i = 0; i < num_metrics; ++i)
+		{
+			stats[i].name = metrics[i].name;
+			stats[i].value_index = metrics[i].value_index;
+			stats[i].type = metrics[i].type;
+		}
+		for (int i = 0; i < num_histograms; ++i)
+		{
+			stats_metric& m = stats[num_metrics + i];
+			m.name = histograms[i].name;
+			m.value_index = histograms[i].value_index;
+			m.type = histograms[i].type;
+		}
+		return stats;
+	}
+
+	int find_metric_idx(char const* name)
+	{
+		const int num_metrics = sizeof(metrics) / sizeof(metrics[0]);
+		for (int i = 0; i < num_metrics; ++i)
+		{
+			if (std::strcmp(metrics[i].name, name) == 0)
+				return metrics[i].value_index;
+		}
+		const int num_histograms = sizeof(histograms) / sizeof(histograms[0]);
+		for (int i = 0; i < num_histograms; ++i)
+		{
+			if (std::strcmp(histograms[i].name, name) == 0)
+				return histograms[i].value_index;
+		}
+		return -1;
+	}
+}
+
@@ -34,8 +34,12 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/lazy_entry.hpp"
 #include "libtorrent/entry.hpp"
 #include "libtorrent/assert.hpp"
+#include "libtorrent/bencode_writer.hpp"
 
 #include <string>
+#include <vector>
+#include <algorithm>
+#include <cstring>
 
 namespace libtorrent
 {
@@ -81,6 +85,53 @@ namespace libtorrent
 		}
 	}
 
+	namespace
+	{
+		// returns true if the field at src holds the same value as the one
+		// at def
+		bool is_default(void const* src, void const* def, int type)
+		{
+			switch (type)
+			{
+				case std_string: return *((std::string*)src) == *((std::string*)def);
+				case character: return *((char*)src) == *((char*)def);
+				case integer: return *((int*)src) == *((int*)def);
+				case integer16: return *((boost::uint16_t*)src) == *((boost::uint16_t*)def);
+				case size_integer: return *((size_type*)src) == *((size_type*)def);
+				case time_integer: return *((time_t*)src) == *((time_t*)def);
+				case floating_point: return *((float*)src) == *((float*)def);
+				case boolean: return *((bool*)src) == *((bool*)def);
+				default: TORRENT_ASSERT(false);
+			}
+			return false;
+		}
+
+		// the value of a non-string field, the way it's saved
+		size_type int_value(void const* src, int type)
+		{
+			switch (type)
+			{
+				case character: return *((char*)src);
+				case integer: return *((int*)src);
+				case integer16: return *((boost::uint16_t*)src);
+				case size_integer: return *((size_type*)src);
+				case time_integer: return *((time_t*)src);
+				case floating_point: return size_type(*((float*)src) * 1000.f);
+				case boolean: return *((bool*)src);
+				default: TORRENT_ASSERT(false);
+			}
+			return 0;
+		}
+
+		struct compare_name
+		{
+			compare_name(bencode_map_entry const* m): m_map(m) {}
+			bool operator()(int lhs, int rhs) const
+			{ return std::strcmp(m_map[lhs].name, m_map[rhs].name) < 0; }
+			bencode_map_entry const* m_map;
+		};
+	}
+
 	void save_struct(entry& e, void const* s, bencode_map_entry const* m, int num, void const* def)
 	{
 		if (e.type() != entry::dictionary_t) e = entry(entry::dictionary_t);
@@ -88,55 +139,39 @@ namespace libtorrent
 		{
 			char const* key = m[i].name;
 			void const* src = ((char*)s) + m[i].offset;
-			if (def)
-			{
-				// if we have a default value for this field
-				// and it is the default, don't save it
-				void const* default_value = ((char*)def) + m[i].offset;
-				switch (m[i].type)
-				{
-					case std_string:
-						if (*((std::string*)src) == *((std::string*)default_value)) continue;
-						break;
-					case character:
-						if (*((char*)src) == *((char*)default_value)) continue;
-						break;
-					case integer:
-						if (*((int*)src) == *((int*)default_value)) continue;
-						break;
-					case integer16:
-						if (*((boost::uint16_t*)src) == *((boost::uint16_t*)default_value)) continue;
-						break;
-					case size_integer:
-						if (*((size_type*)src) == *((size_type*)default_value)) continue;
-						break;
-					case time_integer:
-						if (*((time_t*)src) == *((time_t*)default_value)) continue;
-						break;
-					case floating_point:
-						if (*((float*)src) == *((float*)default_value)) continue;
-						break;
-					case boolean:
-						if (*((bool*)src) == *((bool*)default_value)) continue;
-						break;
-					default: TORRENT_ASSERT(false);
-				}
-			}
+			// if we have a default value for this field
+			// and it is the default, don't save it
+			if (def && is_default(src, ((char*)def) + m[i].offset, m[i].type))
+				continue;
 			entry& val = e[key];
 			TORRENT_ASSERT_VAL(val.type() == entry::undefined_t, val.type());
-			switch (m[i].type)
-			{
-				case std_string: val = *((std::string*)src); break;
-				case character: val = *((char*)src); break;
-				case integer: val = *((int*)src); break;
-				case integer16: val = *((boost::uint16_t*)src); break;
-				case size_integer: val = *((size_type*)src); break;
-				case time_integer: val = *((time_t*)src); break;
-				case floating_point: val = size_type(*((float*)src) * 1000.f); break;
-				case boolean: val = *((bool*)src); break;
-				default: TORRENT_ASSERT(false);
-			}
+			if (m[i].type == std_string) val = *((std::string*)src);
+			else val = int_value(src, m[i].type);
+		}
+	}
+
+	void save_struct(bencode_writer& w, void const* s, bencode_map_entry const* m, int num, void const* def)
+	{
+		// the maps aren't sorted by name, but the keys of a bencoded
+		// dictionary must be
+		std::vector<int> order;
+		order.reserve(num);
+		for (int i = 0; i < num; ++i) order.push_back(i);
+		std::sort(order.begin(), order.end(), compare_name(m));
+
+		w.begin_dict();
+		for (std::vector<int>::const_iterator i = order.begin()
+			, end(order.end()); i != end; ++i)
+		{
+			bencode_map_entry const& f = m[*i];
+			void const* src = ((char*)s) + f.offset;
+			if (def && is_default(src, ((char*)def) + f.offset, f.type))
+				continue;
+			w.key(f.name);
+			if (f.type == std_string) w.string(*((std::string*)src));
+			else w.integer(int_value(src, f.type));
 		}
+		w.end();
 	}
 
 }
@@ -0,0 +1,379 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/status_delta.hpp"
+#include "libtorrent/torrent_info.hpp"
+#include "libtorrent/io.hpp"
+#include "libtorrent/assert.hpp"
+
+#include <cstring> // for memcmp, memcpy
+
+namespace libtorrent
+{
+	namespace
+	{
+		// packs fields into a buffer, in big endian byte order
+		struct status_writer
+		{
+			status_writer(std::vector<char>& b): buf(b) {}
+
+			// extends the buffer by n bytes and returns a pointer to them
+			char* grow(int n)
+			{
+				std::size_t const pos = buf.size();
+				buf.resize(pos + n);
+				return &buf[pos];
+			}
+
+			void operator()(boost::int64_t v)
+			{
+				char* ptr = grow(8);
+				detail::write_int64(v, ptr);
+			}
+
+			void operator()(boost::int32_t v)
+			{
+				char* ptr = grow(4);
+				detail::write_int32(v, ptr);
+			}
+
+			void operator()(bool v)
+			{
+				char* ptr = grow(1);
+				detail::write_uint8(v, ptr);
+			}
+
+			void operator()(float v)
+			{
+				boost::uint32_t bits;
+				std::memcpy(&bits, &v, sizeof(bits));
+				char* ptr = grow(4);
+				detail::write_uint32(bits, ptr);
+			}
+
+			void operator()(std::string const& v)
+			{
+				operator()(boost::int32_t(v.size()));
+				buf.insert(buf.end(), v.begin(), v.end());
+			}
+
+			void operator()(bitfield const& v)
+			{
+				operator()(boost::int32_t(v.size()));
+				buf.insert(buf.end(), v.bytes(), v.bytes() + (v.size() + 7) / 8);
+			}
+
+			void operator()(sha1_hash const& v)
+			{
+				buf.insert(buf.end(), v.begin(), v.end());
+			}
+
+			void operator()(boost::posix_time::time_duration const& v)
+			{ operator()(boost::int64_t(v.total_milliseconds())); }
+
+			template <class T>
+			void time(T const& v) { operator()(boost::int64_t(v)); }
+
+			template <class E>
+			void enumeration(E const& v) { operator()(boost::int32_t(v)); }
+
+			std::vector<char>& buf;
+		};
+
+		// unpacks fields written by status_writer
+		struct status_reader
+		{
+			status_reader(char const* b, char const* e): ptr(b), end(e) {}
+
+			void operator()(boost::int64_t& v)
+			{
+				TORRENT_ASSERT(end - ptr >= 8);
+				v = detail::read_int64(ptr);
+			}
+
+			void operator()(boost::int32_t& v)
+			{
+				TORRENT_ASSERT(end - ptr >= 4);
+				v = detail::read_int32(ptr);
+			}
+
+			void operator()(bool& v)
+			{
+				TORRENT_ASSERT(end - ptr >= 1);
+				v = detail::read_uint8(ptr) != 0;
+			}
+
+			void operator()(float& v)
+			{
+				TORRENT_ASSERT(end - ptr >= 4);
+				boost::uint32_t bits = detail::read_uint32(ptr);
+				std::memcpy(&v, &bits, sizeof(bits));
+			}
+
+			void operator()(std::string& v)
+			{
+				boost::int32_t len;
+				operator()(len);
+				TORRENT_ASSERT(end - ptr >= len);
+				v.assign(ptr, len);
+				ptr += len;
+			}
+
+			void operator()(bitfield& v)
+			{
+				boost::int32_t bits;
+				operator()(bits);
+				TORRENT_ASSERT(end - ptr >= (bits + 7) / 8);
+				v.assign(ptr, bits);
+				ptr += (bits + 7) / 8;
+			}
+
+			void operator()(sha1_hash& v)
+			{
+				TORRENT_ASSERT(end - ptr >= 20);
+				std::memcpy(v.begin(), ptr, 20);
+				ptr += 20;
+			}
+
+			void operator()(boost::posix_time::time_duration& v)
+			{
+				boost::int64_t ms;
+				operator()(ms);
+				v = boost::posix_time::milliseconds(ms);
+			}
+
+			template <class T>
+			void time(T& v)
+			{
+				boost::int64_t t;
+				operator()(t);
+				v = T(t);
+			}
+
+			template <class E>
+			void enumeration(E& v)
+			{
+				boost::int32_t e;
+				operator()(e);
+				v = E(e);
+			}
+
+			char const* ptr;
+			char const* end;
+		};
+
+		// this is the one place that defines which fields belong to which
+		// group, and in which order they are packed. Status is either
+		// torrent_status or torrent_status const, depending on whether
+		// we're packing or unpacking
+		template <class Status, class Op>
+		void visit_field_group(int group, Status& st, Op& op)
+		{
+			switch (group)
+			{
+				case 0: // state_fields
+					op.enumeration(st.state);
+					op.enumeration(st.storage_mode);
+					op(st.queue_position);
+					op(st.priority);
+					op(st.seed_rank);
+					op(st.need_save_resume);
+					op(st.ip_filter_applies);
+					op(st.upload_mode);
+					op(st.share_mode);
+					op(st.super_seeding);
+					op(st.paused);
+					op(st.auto_managed);
+					op(st.sequential_download);
+					op(st.is_seeding);
+					op(st.is_finished);
+					op(st.has_metadata);
+					op(st.has_incoming);
+					op(st.seed_mode);
+					op(st.moving_storage);
+					break;
+				case 1: // progress_fields
+					op(st.progress);
+					op(st.progress_ppm);
+					op(st.total_done);
+					op(st.total_wanted_done);
+					op(st.total_wanted);
+					op(st.num_pieces);
+					op(st.block_size);
+					op(st.sparse_regions);
+					break;
+				case 2: // rate_fields
+					op(st.download_rate);
+					op(st.upload_rate);
+					op(st.download_payload_rate);
+					op(st.upload_payload_rate);
+					op(st.up_bandwidth_queue);
+					op(st.down_bandwidth_queue);
+					break;
+				case 3: // transfer_fields
+					op(st.total_download);
+					op(st.total_upload);
+					op(st.total_payload_download);
+					op(st.total_payload_upload);
+					op(st.total_failed_bytes);
+					op(st.total_redundant_bytes);
+					op(st.all_time_upload);
+					op(st.all_time_download);
+					break;
+				case 4: // peer_fields
+					op(st.num_seeds);
+					op(st.num_peers);
+					op(st.list_seeds);
+					op(st.list_peers);
+					op(st.connect_candidates);
+					op(st.num_uploads);
+					op(st.num_connections);
+					op(st.uploads_limit);
+					op(st.connections_limit);
+					op(st.distributed_full_copies);
+					op(st.distributed_fraction);
+					op(st.distributed_copies);
+					break;
+				case 5: // tracker_fields
+					op(st.current_tracker);
+					op(st.announce_interval);
+					op(st.num_complete);
+					op(st.num_incomplete);
+					break;
+				case 6: // time_fields
+					op.time(st.added_time);
+					op.time(st.completed_time);
+					op.time(st.last_seen_complete);
+					op(st.next_announce);
+					op(st.time_since_upload);
+					op(st.time_since_download);
+					op(st.active_time);
+					op(st.finished_time);
+					op(st.seeding_time);
+					op(st.last_scrape);
+					break;
+				case 7: // error_fields
+					op(st.error);
+					break;
+				case 8: // name_fields
+					op(st.name);
+					op(st.save_path);
+					op(st.info_hash);
+					break;
+				case 9: // piece_fields
+					op(st.pieces);
+					op(st.verified_pieces);
+					break;
+				default:
+					TORRENT_ASSERT(false);
+			}
+		}
+	}
+
+	void torrent_status_delta::apply(torrent_status& st) const
+	{
+		if (fields == 0) return;
+
+		status_reader r(&data[0], &data[0] + data.size());
+		for (int i = 0; i < num_field_groups; ++i)
+		{
+			if ((fields & (1 << i)) == 0) continue;
+			visit_field_group(i, st, r);
+		}
+		TORRENT_ASSERT(r.ptr == r.end);
+
+		if (fields & name_fields) st.torrent_file = torrent_file;
+	}
+
+	status_snapshot::status_snapshot()
+		: m_torrent_file(0)
+	{
+		clear();
+	}
+
+	void status_snapshot::clear()
+	{
+		m_buf.clear();
+		for (int i = 0; i < torrent_status_delta::num_field_groups + 1; ++i)
+			m_offsets[i] = 0;
+		m_torrent_file = 0;
+	}
+
+	bool status_snapshot::update(torrent_status const& st
+		, torrent_status_delta& delta)
+	{
+		delta.handle = st.handle;
+		delta.fields = 0;
+		delta.data.clear();
+		delta.torrent_file.reset();
+
+		// the first snapshot (or after clear()) has no previous state to
+		// compare against. All groups are sent in that case
+		bool const first = m_buf.empty();
+
+		std::vector<char> buf;
+		buf.reserve(m_buf.size());
+		int offsets[torrent_status_delta::num_field_groups + 1];
+
+		status_writer w(buf);
+		for (int i = 0; i < torrent_status_delta::num_field_groups; ++i)
+		{
+			offsets[i] = int(buf.size());
+			visit_field_group(i, st, w);
+			int const len = int(buf.size()) - offsets[i];
+
+			bool changed = first
+				|| len != m_offsets[i + 1] - m_offsets[i]
+				|| std::memcmp(&buf[offsets[i]], &m_buf[m_offsets[i]], len) != 0;
+
+			if ((1 << i) == torrent_status_delta::name_fields
+				&& st.torrent_file.get() != m_torrent_file)
+				changed = true;
+
+			if (!changed) continue;
+
+			delta.fields |= 1 << i;
+			delta.data.insert(delta.data.end(), buf.begin() + offsets[i], buf.end());
+		}
+		offsets[torrent_status_delta::num_field_groups] = int(buf.size());
+
+		if (delta.fields & torrent_status_delta::name_fields)
+			delta.torrent_file = st.torrent_file;
+
+		m_buf.swap(buf);
+		std::memcpy(m_offsets, offsets, sizeof(m_offsets));
+		m_torrent_file = st.torrent_file.get();
+
+		return delta.fields != 0;
+	}
+}
+
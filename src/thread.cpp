@@ -42,6 +42,10 @@ POSSIBILITY OF SUCH DAMAGE.
 #include <boost/cstdint.hpp>
 #endif
 
+#if !defined TORRENT_WINDOWS && !defined TORRENT_CYGWIN
+#include <unistd.h> // for sysconf()
+#endif
+
 namespace libtorrent
 {
 	void sleep(int milliseconds)
@@ -55,6 +59,24 @@ namespace libtorrent
 #endif
 	}
 
+	int hardware_concurrency()
+	{
+#if defined TORRENT_WINDOWS || defined TORRENT_CYGWIN
+		SYSTEM_INFO si;
+		GetSystemInfo(&si);
+		int ret = int(si.dwNumberOfProcessors);
+#elif defined TORRENT_BEOS
+		system_info si;
+		get_system_info(&si);
+		int ret = int(si.cpu_count);
+#elif defined _SC_NPROCESSORS_ONLN
+		int ret = int(sysconf(_SC_NPROCESSORS_ONLN));
+#else
+		int ret = 1;
+#endif
+		return ret > 0 ? ret : 1;
+	}
+
 #ifdef BOOST_HAS_PTHREADS
 
 	condition_variable::condition_variable()
@@ -0,0 +1,129 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/timer_wheel.hpp"
+#include "libtorrent/assert.hpp"
+
+namespace libtorrent
+{
+	timer_wheel::timer_wheel(int granularity_ms, int num_slots)
+		: m_slots(num_slots, static_cast<timer_wheel_entry*>(0))
+		, m_granularity(granularity_ms)
+		, m_size(0)
+		, m_cursor(0)
+		, m_base(time_now_hires())
+	{
+		TORRENT_ASSERT(granularity_ms > 0);
+		TORRENT_ASSERT(num_slots > 1);
+	}
+
+	timer_wheel::~timer_wheel()
+	{
+		// unlink all entries, so that their owners don't
+		// think they're still scheduled
+		for (int i = 0; i < int(m_slots.size()); ++i)
+		{
+			while (m_slots[i]) cancel(m_slots[i]);
+		}
+	}
+
+	boost::int64_t timer_wheel::to_tick(ptime t) const
+	{
+		if (t < m_base) return 0;
+		return total_milliseconds(t - m_base) / m_granularity;
+	}
+
+	void timer_wheel::schedule(timer_wheel_entry* e, ptime expires)
+	{
+		if (e->scheduled()) cancel(e);
+
+		boost::int64_t tick = to_tick(expires);
+		int const num_slots = m_slots.size();
+		if (tick < m_cursor) tick = m_cursor;
+		else if (tick >= m_cursor + num_slots) tick = m_cursor + num_slots - 1;
+
+		int slot = int(tick % num_slots);
+		e->expires = expires;
+		e->slot = slot;
+		e->prev = 0;
+		e->next = m_slots[slot];
+		if (e->next) e->next->prev = e;
+		m_slots[slot] = e;
+		++m_size;
+	}
+
+	void timer_wheel::cancel(timer_wheel_entry* e)
+	{
+		if (!e->scheduled()) return;
+		TORRENT_ASSERT(e->slot < int(m_slots.size()));
+
+		if (e->prev) e->prev->next = e->next;
+		else
+		{
+			TORRENT_ASSERT(m_slots[e->slot] == e);
+			m_slots[e->slot] = e->next;
+		}
+		if (e->next) e->next->prev = e->prev;
+		e->next = 0;
+		e->prev = 0;
+		e->slot = -1;
+		--m_size;
+		TORRENT_ASSERT(m_size >= 0);
+	}
+
+	void timer_wheel::expire(ptime now, std::vector<timer_wheel_entry*>& out)
+	{
+		boost::int64_t const end = to_tick(now);
+		int const num_slots = m_slots.size();
+
+		// if we're more than a full revolution behind, every
+		// slot is due. There's no need to visit any of them twice
+		int steps = 0;
+		for (; m_cursor <= end && steps < num_slots; ++m_cursor, ++steps)
+		{
+			int const slot = int(m_cursor % num_slots);
+			for (timer_wheel_entry* e = m_slots[slot]; e != 0;)
+			{
+				timer_wheel_entry* next = e->next;
+				e->next = 0;
+				e->prev = 0;
+				e->slot = -1;
+				--m_size;
+				out.push_back(e);
+				e = next;
+			}
+			m_slots[slot] = 0;
+		}
+		if (m_cursor <= end) m_cursor = end + 1;
+	}
+}
+
@@ -55,6 +55,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/tracker_manager.hpp"
 #include "libtorrent/parse_url.hpp"
 #include "libtorrent/bencode.hpp"
+#include "libtorrent/bencode_writer.hpp"
 #include "libtorrent/hasher.hpp"
 #include "libtorrent/entry.hpp"
 #include "libtorrent/peer.hpp"
@@ -169,7 +170,6 @@ namespace libtorrent
 		, m_num_connecting(0)
 		, m_tracker_timer(ses.m_io_service)
 		, m_ses(ses)
-		, m_host_resolver(ses.m_io_service)
 		, m_trackerid(p.trackerid)
 		, m_save_path(complete(p.save_path))
 		, m_url(p.url)
@@ -2501,7 +2501,13 @@ namespace libtorrent
 			ae->verified = true;
 			ae->updating = false;
 			ae->fails = 0;
-			ae->next_announce = now + seconds(interval);
+			// torrents that were started at the same time would otherwise
+			// keep announcing to the tracker in the same second. Spread
+			// them out by announcing up to 10% early, but never earlier
+			// than the tracker's min interval
+			int jitter = (std::max)((std::min)(interval / 10, interval - min_interval), 0);
+			if (jitter > 0) jitter = random() % (jitter + 1);
+			ae->next_announce = now + seconds(interval - jitter);
 			ae->min_announce = now + seconds(min_interval);
 			int tracker_index = ae - &m_trackers[0];
 			m_last_working_tracker = prioritize_tracker(tracker_index);
@@ -2577,9 +2583,9 @@ namespace libtorrent
 #if defined TORRENT_ASIO_DEBUGGING
 					add_outstanding_async("torrent::on_peer_name_lookup");
 #endif
-					tcp::resolver::query q(i->ip, to_string(i->port).elems);
-					m_host_resolver.async_resolve(q,
-						boost::bind(&torrent::on_peer_name_lookup, shared_from_this(), _1, _2, i->pid));
+					m_ses.m_host_resolver.async_resolve(i->ip,
+						boost::bind(&torrent::on_peer_name_lookup, shared_from_this(), _1, _2
+							, i->port, i->pid));
 				}
 			}
 			else
@@ -2720,8 +2726,8 @@ namespace libtorrent
 	}
 #endif
 
-	void torrent::on_peer_name_lookup(error_code const& e, tcp::resolver::iterator host
-		, peer_id pid)
+	void torrent::on_peer_name_lookup(error_code const& e
+		, std::vector<address> const& addresses, int port, peer_id pid)
 	{
 		TORRENT_ASSERT(m_ses.is_network_thread());
 
@@ -2735,23 +2741,24 @@ namespace libtorrent
 		if (e)
 			debug_log("peer name lookup error: %s", e.message().c_str());
 #endif
-		if (e || host == tcp::resolver::iterator() ||
-			m_ses.is_aborted()) return;
+		if (e || addresses.empty() || m_abort
+			|| m_ses.is_aborted()) return;
 
+		tcp::endpoint host(addresses.front(), port);
 		if (m_apply_ip_filter
-			&& m_ses.m_ip_filter.access(host->endpoint().address()) & ip_filter::blocked)
+			&& m_ses.m_ip_filter.access(host.address()) & ip_filter::blocked)
 		{
 #if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING || defined TORRENT_ERROR_LOGGING
 			error_code ec;
-			debug_log("blocked ip from tracker: %s", host->endpoint().address().to_string(ec).c_str());
+			debug_log("blocked ip from tracker: %s", host.address().to_string(ec).c_str());
 #endif
 			if (m_ses.m_alerts.should_post<peer_blocked_alert>())
 				m_ses.m_alerts.post_alert(peer_blocked_alert(get_handle()
-					, host->endpoint().address(), peer_blocked_alert::ip_filter));
+					, host.address(), peer_blocked_alert::ip_filter));
 			return;
 		}
 			
-		m_policy.add_peer(*host, pid, peer_info::tracker, 0);
+		m_policy.add_peer(host, pid, peer_info::tracker, 0);
 	}
 
 	size_type torrent::bytes_left() const
@@ -3414,9 +3421,7 @@ namespace libtorrent
 
 				// mark the peer as banned
 				m_policy.ban_peer(p);
-#ifdef TORRENT_STATS
-				++m_ses.m_banned_for_hash_failure;
-#endif
+				m_ses.inc_stats_counter(counters::banned_for_hash_failure);
 
 				if (p->connection)
 				{
@@ -3534,7 +3539,6 @@ namespace libtorrent
 			set_state(torrent_status::queued_for_checking);
 
 		m_owning_storage = 0;
-		m_host_resolver.cancel();
 	}
 
 	void torrent::super_seeding(bool on)
@@ -3640,13 +3644,27 @@ namespace libtorrent
 		{
 			m_need_save_resume_data = false;
 			m_last_saved_resume = time(0);
-			write_resume_data(*j.resume_data);
-			alerts().post_alert(save_resume_data_alert(j.resume_data
-				, get_handle()));
+			post_resume_data(*j.resume_data);
 			state_updated();
 		}
 	}
 
+	void torrent::post_resume_data(entry const& storage_data)
+	{
+		boost::shared_ptr<std::vector<char> > buf(new std::vector<char>);
+		bencode_writer w(*buf);
+		write_resume_data(w, storage_data);
+
+		boost::shared_ptr<entry> rd;
+		if ((m_save_resume_flags & torrent_handle::only_bencoded) == 0)
+		{
+			rd.reset(new entry);
+			entry e = bdecode(buf->begin(), buf->end());
+			rd->swap(e);
+		}
+		alerts().post_alert(save_resume_data_alert(rd, buf, get_handle()));
+	}
+
 	void torrent::on_file_renamed(int ret, disk_io_job const& j)
 	{
 		TORRENT_ASSERT(m_ses.is_network_thread());
@@ -4457,6 +4475,57 @@ namespace libtorrent
 		m_connections.erase(i);
 	}
 
+	namespace
+	{
+		// returns the peer entry used by the connection p to the web seed,
+		// or 0 if p isn't connected to it
+		policy::ipv4_peer* web_seed_peer(web_seed_entry& web, peer_connection* p)
+		{
+			if (web.peer_info.connection == p) return &web.peer_info;
+			for (std::list<policy::ipv4_peer>::iterator i = web.extra_peers.begin()
+				, end(web.extra_peers.end()); i != end; ++i)
+			{
+				if (i->connection == p) return &*i;
+			}
+			return 0;
+		}
+
+		std::list<web_seed_entry>::iterator find_web_seed(
+			std::list<web_seed_entry>& web_seeds, peer_connection* p)
+		{
+			TORRENT_ASSERT(p);
+			std::list<web_seed_entry>::iterator i = web_seeds.begin();
+			for (; i != web_seeds.end(); ++i)
+			{
+				if (web_seed_peer(*i, p)) break;
+			}
+			return i;
+		}
+
+		int num_web_seed_connections(web_seed_entry const& web)
+		{
+			int ret = web.peer_info.connection ? 1 : 0;
+			for (std::list<policy::ipv4_peer>::const_iterator i = web.extra_peers.begin()
+				, end(web.extra_peers.end()); i != end; ++i)
+			{
+				if (i->connection) ++ret;
+			}
+			return ret;
+		}
+
+		// the web seed is banned if any of its connections were banned
+		bool web_seed_banned(web_seed_entry const& web)
+		{
+			if (web.peer_info.banned) return true;
+			for (std::list<policy::ipv4_peer>::const_iterator i = web.extra_peers.begin()
+				, end(web.extra_peers.end()); i != end; ++i)
+			{
+				if (i->banned) return true;
+			}
+			return false;
+		}
+	}
+
 	void torrent::remove_web_seed(std::list<web_seed_entry>::iterator web)
 	{
 		if (web->resolving)
@@ -4464,17 +4533,32 @@ namespace libtorrent
 			web->removed = true;
 			return;
 		}
-		peer_connection * peer = web->peer_info.connection;
-		if (peer) {
-			TORRENT_ASSERT(peer->m_in_use == 1337);
-			peer->set_peer_info(0);
+		// the connections to this web seed refer to the web_seed_entry
+		// we're about to remove, and to their peer entries in it. They
+		// have to be disconnected, not just detached
+		disconnect_web_seed_peer(web->peer_info);
+		for (std::list<policy::ipv4_peer>::iterator i = web->extra_peers.begin()
+			, end(web->extra_peers.end()); i != end; ++i)
+		{
+			disconnect_web_seed_peer(*i);
 		}
-		if (has_picker()) picker().clear_peer(&web->peer_info);
-					
 
 		m_web_seeds.erase(web);
 	}
 
+	void torrent::disconnect_web_seed_peer(policy::ipv4_peer& peerinfo)
+	{
+		peer_connection* peer = peerinfo.connection;
+		if (peer)
+		{
+			TORRENT_ASSERT(peer->m_in_use == 1337);
+			peer->disconnect(asio::error::operation_aborted);
+			peer->set_peer_info(0);
+			peerinfo.connection = 0;
+		}
+		if (has_picker()) picker().clear_peer(&peerinfo);
+	}
+
 	void torrent::connect_to_url_seed(std::list<web_seed_entry>::iterator web)
 	{
 		TORRENT_ASSERT(m_ses.is_network_thread());
@@ -4515,7 +4599,7 @@ namespace libtorrent
 			return;
 		}
 
-		if (web->peer_info.banned)
+		if (web_seed_banned(*web))
 		{
 #if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING
 			debug_log("banned web seed: %s", web->url.c_str());
@@ -4603,9 +4687,9 @@ namespace libtorrent
 
 			// use proxy
 			web->resolving = true;
-			tcp::resolver::query q(ps.hostname, to_string(ps.port).elems);
-			m_host_resolver.async_resolve(q,
-				boost::bind(&torrent::on_proxy_name_lookup, shared_from_this(), _1, _2, web));
+			m_ses.m_host_resolver.async_resolve(ps.hostname,
+				boost::bind(&torrent::on_proxy_name_lookup, shared_from_this(), _1, _2
+					, int(ps.port), web));
 		}
 		else if (ps.proxy_hostnames
 			&& (ps.type == proxy_settings::socks5
@@ -4620,14 +4704,14 @@ namespace libtorrent
 #endif
 
 			web->resolving = true;
-			tcp::resolver::query q(hostname, to_string(port).elems);
-			m_host_resolver.async_resolve(q,
-				boost::bind(&torrent::on_name_lookup, shared_from_this(), _1, _2, web
-					, tcp::endpoint()));
+			m_ses.m_host_resolver.async_resolve(hostname,
+				boost::bind(&torrent::on_name_lookup, shared_from_this(), _1, _2
+					, port, web, tcp::endpoint()));
 		}
 	}
 
-	void torrent::on_proxy_name_lookup(error_code const& e, tcp::resolver::iterator host
+	void torrent::on_proxy_name_lookup(error_code const& e
+		, std::vector<address> const& addresses, int proxy_port
 		, std::list<web_seed_entry>::iterator web)
 	{
 		TORRENT_ASSERT(m_ses.is_network_thread());
@@ -4655,7 +4739,7 @@ namespace libtorrent
 
 		if (m_abort) return;
 
-		if (e || host == tcp::resolver::iterator())
+		if (e || addresses.empty())
 		{
 			if (m_ses.m_alerts.should_post<url_seed_alert>())
 			{
@@ -4672,7 +4756,7 @@ namespace libtorrent
 		if (m_ses.is_aborted()) return;
 
 #ifndef TORRENT_DISABLE_GEO_IP
-		int as = m_ses.as_for_ip(host->endpoint().address());
+		int as = m_ses.as_for_ip(addresses.front());
 #ifdef TORRENT_DEBUG
 		web->peer_info.inet_as_num = as;
 #endif
@@ -4683,7 +4767,7 @@ namespace libtorrent
 			|| m_ses.num_connections() >= m_ses.settings().connections_limit)
 			return;
 
-		tcp::endpoint a(host->endpoint());
+		tcp::endpoint a(addresses.front(), proxy_port);
 
 		using boost::tuples::ignore;
 		std::string hostname;
@@ -4715,12 +4799,13 @@ namespace libtorrent
 		}
 
 		web->resolving = true;
-		tcp::resolver::query q(hostname, to_string(port).elems);
-		m_host_resolver.async_resolve(q,
-			boost::bind(&torrent::on_name_lookup, shared_from_this(), _1, _2, web, a));
+		m_ses.m_host_resolver.async_resolve(hostname,
+			boost::bind(&torrent::on_name_lookup, shared_from_this(), _1, _2
+				, port, web, a));
 	}
 
-	void torrent::on_name_lookup(error_code const& e, tcp::resolver::iterator host
+	void torrent::on_name_lookup(error_code const& e
+		, std::vector<address> const& addresses, int port
 		, std::list<web_seed_entry>::iterator web, tcp::endpoint proxy)
 	{
 		TORRENT_ASSERT(m_ses.is_network_thread());
@@ -4743,7 +4828,7 @@ namespace libtorrent
 
 		if (m_abort) return;
 
-		if (e || host == tcp::resolver::iterator())
+		if (e || addresses.empty())
 		{
 			if (m_ses.m_alerts.should_post<url_seed_alert>())
 				m_ses.m_alerts.post_alert(url_seed_alert(get_handle(), web->url, e));
@@ -4757,7 +4842,7 @@ namespace libtorrent
 			return;
 		}
 
-		tcp::endpoint a(host->endpoint());
+		tcp::endpoint a(addresses.front(), port);
 
 		// fill in the peer struct's address field
 		web->endpoint = a;
@@ -4782,18 +4867,29 @@ namespace libtorrent
 		}
 		
 		TORRENT_ASSERT(web->resolving == false);
-		TORRENT_ASSERT(web->peer_info.connection == 0);
+
+		if (is_paused()) return;
+		if (m_ses.is_aborted()) return;
+
+		// every connection to the web seed has its own peer entry, so
+		// that the piece picker hands them different pieces
+		policy::ipv4_peer* peerinfo = &web->unused_peer();
+#ifndef TORRENT_DISABLE_GEO_IP
+#ifdef TORRENT_DEBUG
+		peerinfo->inet_as_num = web->peer_info.inet_as_num;
+#endif
+		peerinfo->inet_as = web->peer_info.inet_as;
+#endif
 
 		web->endpoint = a;
 		if (a.address().is_v4())
 		{
-			web->peer_info.addr = a.address().to_v4();
-			web->peer_info.port = a.port();
+			peerinfo->addr = a.address().to_v4();
+			peerinfo->port = a.port();
+			web->peer_info.addr = peerinfo->addr;
+			web->peer_info.port = peerinfo->port;
 		}
 
-		if (is_paused()) return;
-		if (m_ses.is_aborted()) return;
-
 		boost::shared_ptr<socket_type> s(new (std::nothrow) socket_type(m_ses.m_io_service));
 		if (!s) return;
 	
@@ -4858,12 +4954,12 @@ namespace libtorrent
 		if (web->type == web_seed_entry::url_seed)
 		{
 			c = new (std::nothrow) web_peer_connection(
-				m_ses, shared_from_this(), s, a, *web);
+				m_ses, shared_from_this(), s, a, *web, peerinfo);
 		}
 		else if (web->type == web_seed_entry::http_seed)
 		{
 			c = new (std::nothrow) http_seed_connection(
-				m_ses, shared_from_this(), s, a, *web);
+				m_ses, shared_from_this(), s, a, *web, peerinfo);
 		}
 		if (!c) return;
 
@@ -4888,18 +4984,19 @@ namespace libtorrent
 			m_connections.insert(boost::get_pointer(c));
 			m_ses.m_connections.insert(c);
 
-			TORRENT_ASSERT(!web->peer_info.connection);
-			web->peer_info.connection = c.get();
+			TORRENT_ASSERT(!peerinfo->connection);
+			peerinfo->connection = c.get();
 #if TORRENT_USE_ASSERTS
-			web->peer_info.in_use = true;
+			peerinfo->in_use = true;
 #endif
 
-			c->add_stat(size_type(web->peer_info.prev_amount_download) << 10
-				, size_type(web->peer_info.prev_amount_upload) << 10);
-			web->peer_info.prev_amount_download = 0;
-			web->peer_info.prev_amount_upload = 0;
+			c->add_stat(size_type(peerinfo->prev_amount_download) << 10
+				, size_type(peerinfo->prev_amount_upload) << 10);
+			peerinfo->prev_amount_download = 0;
+			peerinfo->prev_amount_upload = 0;
 #if defined TORRENT_VERBOSE_LOGGING 
-			debug_log("web seed connection started: %s", web->url.c_str());
+			debug_log("web seed connection started: %s (%d connections)"
+				, web->url.c_str(), num_web_seed_connections(*web));
 #endif
 
 			c->start();
@@ -4944,14 +5041,14 @@ namespace libtorrent
 
 		asio::ip::address_v4 reversed(swap_bytes(p->remote().address().to_v4().to_ulong()));
 		error_code ec;
-		tcp::resolver::query q(reversed.to_string(ec) + ".zz.countries.nerd.dk", "0");
+		std::string host = reversed.to_string(ec) + ".zz.countries.nerd.dk";
 		if (ec)
 		{
 			p->set_country("!!");
 			return;
 		}
 		m_resolving_country = true;
-		m_host_resolver.async_resolve(q,
+		m_ses.m_host_resolver.async_resolve(host,
 			boost::bind(&torrent::on_country_lookup, shared_from_this(), _1, _2, p));
 	}
 
@@ -4964,7 +5061,8 @@ namespace libtorrent
 		};
 	}
 
-	void torrent::on_country_lookup(error_code const& error, tcp::resolver::iterator i
+	void torrent::on_country_lookup(error_code const& error
+		, std::vector<address> const& addresses
 		, intrusive_ptr<peer_connection> p) const
 	{
 		TORRENT_ASSERT(m_ses.is_network_thread());
@@ -5028,7 +5126,7 @@ namespace libtorrent
 			, {876,  "WF"}, {882,  "WS"}, {887,  "YE"}, {891,  "CS"}, {894,  "ZM"}
 		};
 
-		if (error || i == tcp::resolver::iterator())
+		if (error || addresses.empty())
 		{
 			// this is used to indicate that we shouldn't
 			// try to resolve it again
@@ -5036,12 +5134,12 @@ namespace libtorrent
 			return;
 		}
 
-		while (i != tcp::resolver::iterator()
-			&& !i->endpoint().address().is_v4()) ++i;
-		if (i != tcp::resolver::iterator())
+		std::vector<address>::const_iterator i = std::find_if(addresses.begin()
+			, addresses.end(), boost::bind(&address::is_v4, _1));
+		if (i != addresses.end())
 		{
 			// country is an ISO 3166 country code
-			int country = i->endpoint().address().to_v4().to_ulong() & 0xffff;
+			int country = i->to_v4().to_ulong() & 0xffff;
 			
 			// look up the country code in the map
 			const int size = sizeof(country_map)/sizeof(country_map[0]);
@@ -5259,194 +5357,30 @@ namespace libtorrent
 	
 	void torrent::write_resume_data(entry& ret) const
 	{
-		using namespace libtorrent::detail; // for write_*_endpoint()
-		ret["file-format"] = "libtorrent resume file";
-		ret["file-version"] = 1;
-		ret["libtorrent-version"] = LIBTORRENT_VERSION;
-
-		ret["total_uploaded"] = m_total_uploaded;
-		ret["total_downloaded"] = m_total_downloaded;
-
-		ret["active_time"] = m_active_time;
-		ret["finished_time"] = m_finished_time;
-		ret["seeding_time"] = m_seeding_time;
-		ret["last_seen_complete"] = m_last_seen_complete;
-
-		ret["num_complete"] = m_complete;
-		ret["num_incomplete"] = m_incomplete;
-		ret["num_downloaded"] = m_downloaded;
-
-		ret["sequential_download"] = m_sequential_download;
-
-		ret["seed_mode"] = m_seed_mode;
-		ret["super_seeding"] = m_super_seeding;
-
-		ret["added_time"] = m_added_time;
-		ret["completed_time"] = m_completed_time;
-
-		ret["last_scrape"] = m_last_scrape;
-		ret["last_download"] = m_last_download;
-		ret["last_upload"] = m_last_upload;
-
-		if (!m_url.empty()) ret["url"] = m_url;
-		if (!m_uuid.empty()) ret["uuid"] = m_uuid;
-		if (!m_source_feed_url.empty()) ret["feed"] = m_source_feed_url;
-		
-		const sha1_hash& info_hash = torrent_file().info_hash();
-		ret["info-hash"] = std::string((char*)info_hash.begin(), (char*)info_hash.end());
-
-		if (valid_metadata())
-		{
-			if (m_magnet_link || (m_save_resume_flags & torrent_handle::save_info_dict))
-				ret["info"] = bdecode(&torrent_file().metadata()[0]
-					, &torrent_file().metadata()[0] + torrent_file().metadata_size());
-		}
-
-		// blocks per piece
-		int num_blocks_per_piece =
-			static_cast<int>(torrent_file().piece_length()) / block_size();
-		ret["blocks per piece"] = num_blocks_per_piece;
-
-		if (m_torrent_file->is_merkle_torrent())
-		{
-			// we need to save the whole merkle hash tree
-			// in order to resume
-			std::string& tree_str = ret["merkle tree"].string();
-			std::vector<sha1_hash> const& tree = m_torrent_file->merkle_tree();
-			tree_str.resize(tree.size() * 20);
-			std::memcpy(&tree_str[0], &tree[0], tree.size() * 20);
-		}
-
-		// if this torrent is a seed, we won't have a piece picker
-		// and there will be no half-finished pieces.
-		if (has_picker())
-		{
-			const std::vector<piece_picker::downloading_piece>& q
-				= m_picker->get_download_queue();
-
-			// unfinished pieces
-			ret["unfinished"] = entry::list_type();
-			entry::list_type& up = ret["unfinished"].list();
-
-			// info for each unfinished piece
-			for (std::vector<piece_picker::downloading_piece>::const_iterator i
-				= q.begin(); i != q.end(); ++i)
-			{
-				if (i->finished == 0) continue;
-
-				entry piece_struct(entry::dictionary_t);
-
-				// the unfinished piece's index
-				piece_struct["piece"] = i->index;
-
-				std::string bitmask;
-				const int num_bitmask_bytes
-					= (std::max)(num_blocks_per_piece / 8, 1);
-
-				for (int j = 0; j < num_bitmask_bytes; ++j)
-				{
-					unsigned char v = 0;
-					int bits = (std::min)(num_blocks_per_piece - j*8, 8);
-					for (int k = 0; k < bits; ++k)
-						v |= (i->info[j*8+k].state == piece_picker::block_info::state_finished)
-						? (1 << k) : 0;
-					bitmask.append(1, v);
-					TORRENT_ASSERT(bits == 8 || j == num_bitmask_bytes - 1);
-				}
-				piece_struct["bitmask"] = bitmask;
-				// push the struct onto the unfinished-piece list
-				up.push_back(piece_struct);
-			}
-		}
-
-		// save trackers
-		if (!m_trackers.empty())
-		{
-			entry::list_type& tr_list = ret["trackers"].list();
-			tr_list.push_back(entry::list_type());
-			int tier = 0;
-			for (std::vector<announce_entry>::const_iterator i = m_trackers.begin()
-				, end(m_trackers.end()); i != end; ++i)
-			{
-				// don't save trackers we can't trust
-				// TODO: 1 save the send_stats state instead of throwing them away
-				// it may pose an issue when downgrading though
-				if (i->send_stats == false) continue;
-				if (i->tier == tier)
-				{
-					tr_list.back().list().push_back(i->url);
-				}
-				else
-				{
-					tr_list.push_back(entry::list_t);
-					tr_list.back().list().push_back(i->url);
-					tier = i->tier;
-				}
-			}
-		}
-
-		// save web seeds
-		if (!m_web_seeds.empty())
-		{
-			entry::list_type& url_list = ret["url-list"].list();
-			entry::list_type& httpseed_list = ret["httpseeds"].list();
-			for (std::list<web_seed_entry>::const_iterator i = m_web_seeds.begin()
-				, end(m_web_seeds.end()); i != end; ++i)
-			{
-				if (i->type == web_seed_entry::url_seed)
-					url_list.push_back(i->url);
-				else if (i->type == web_seed_entry::http_seed)
-					httpseed_list.push_back(i->url);
-			}
-		}
-
-		// write have bitmask
-		// the pieces string has one byte per piece. Each
-		// byte is a bitmask representing different properties
-		// for the piece
-		// bit 0: set if we have the piece
-		// bit 1: set if we have verified the piece (in seed mode)
-		entry::string_type& pieces = ret["pieces"].string();
-		pieces.resize(m_torrent_file->num_pieces());
-		if (is_seed())
-		{
-			std::memset(&pieces[0], 1, pieces.size());
-		}
-		else
-		{
-			for (int i = 0, end(pieces.size()); i < end; ++i)
-				pieces[i] = m_picker->have_piece(i) ? 1 : 0;
-		}
-
-		if (m_seed_mode)
-		{
-			TORRENT_ASSERT(m_verified.size() == pieces.size());
-			for (int i = 0, end(pieces.size()); i < end; ++i)
-				pieces[i] |= m_verified[i] ? 2 : 0;
-		}
+		std::vector<char> buf;
+		bencode_writer w(buf);
+		write_resume_data(w, ret);
+		entry e = bdecode(buf.begin(), buf.end());
+		ret.swap(e);
+	}
 
-		// write renamed files
-		// TODO: 0 make this more generic to not just work if files have been
-		// renamed, but also if they have been merged into a single file for instance.
-		// using file_base
-		if (&m_torrent_file->files() != &m_torrent_file->orig_files()
-			&& m_torrent_file->files().num_files() == m_torrent_file->orig_files().num_files())
-		{
-			entry::list_type& fl = ret["mapped_files"].list();
-			file_storage const& fs = m_torrent_file->files();
-			for (int i = 0; i < fs.num_files(); ++i)
-			{
-				fl.push_back(fs.file_path(i));
-			}
-		}
+	// the keys are written in sorted order, as bencoding requires
+	void torrent::write_resume_data(bencode_writer& w, entry const& storage_data) const
+	{
+		using namespace libtorrent::detail; // for write_*_endpoint()
 
-		// write local peers
+		// write local peers. They're collected up front since banned_peers
+		// is written before peers
 
-		std::back_insert_iterator<entry::string_type> peers(ret["peers"].string());
-		std::back_insert_iterator<entry::string_type> banned_peers(ret["banned_peers"].string());
+		std::string peers_str;
+		std::string banned_peers_str;
+		std::back_insert_iterator<std::string> peers(peers_str);
+		std::back_insert_iterator<std::string> banned_peers(banned_peers_str);
 #if TORRENT_USE_IPV6
-		std::back_insert_iterator<entry::string_type> peers6(ret["peers6"].string());
-		std::back_insert_iterator<entry::string_type> banned_peers6(ret["banned_peers6"].string());
+		std::string peers6_str;
+		std::string banned_peers6_str;
+		std::back_insert_iterator<std::string> peers6(peers6_str);
+		std::back_insert_iterator<std::string> banned_peers6(banned_peers6_str);
 #endif
 
 		// failcount is a 5 bit value
@@ -5516,34 +5450,238 @@ namespace libtorrent
 			++num_saved_peers;
 		}
 
-		ret["upload_rate_limit"] = upload_limit();
-		ret["download_rate_limit"] = download_limit();
-		ret["max_connections"] = max_connections();
-		ret["max_uploads"] = max_uploads();
-		ret["paused"] = is_torrent_paused();
-		ret["announce_to_dht"] = m_announce_to_dht;
-		ret["announce_to_trackers"] = m_announce_to_trackers;
-		ret["announce_to_lsd"] = m_announce_to_lsd;
-		ret["auto_managed"] = m_auto_managed;
+		// blocks per piece
+		int num_blocks_per_piece =
+			static_cast<int>(torrent_file().piece_length()) / block_size();
+		int const num_pieces = m_torrent_file->num_pieces();
+
+		w.begin_dict();
+		// the storage's keys (such as "file sizes") go in between ours
+		bencode_dict_merge d(w, storage_data, false);
+
+		d.key("active_time"); w.integer(m_active_time);
+		d.key("added_time"); w.integer(m_added_time);
+		d.key("announce_to_dht"); w.integer(m_announce_to_dht);
+		d.key("announce_to_lsd"); w.integer(m_announce_to_lsd);
+		d.key("announce_to_trackers"); w.integer(m_announce_to_trackers);
+		d.key("auto_managed"); w.integer(m_auto_managed);
+		d.key("banned_peers"); w.string(banned_peers_str);
+#if TORRENT_USE_IPV6
+		d.key("banned_peers6"); w.string(banned_peers6_str);
+#endif
+		d.key("blocks per piece"); w.integer(num_blocks_per_piece);
+		d.key("completed_time"); w.integer(m_completed_time);
+		d.key("download_rate_limit"); w.integer(download_limit());
+		if (!m_source_feed_url.empty()) { d.key("feed"); w.string(m_source_feed_url); }
+		d.key("file-format"); w.string("libtorrent resume file");
+		d.key("file-version"); w.integer(1);
+
+		// write file priorities
+		d.key("file_priority");
+		w.begin_list();
+		for (int i = 0, end(m_file_priority.size()); i < end; ++i)
+			w.integer(m_file_priority[i]);
+		w.end();
+
+		d.key("finished_time"); w.integer(m_finished_time);
+
+		// save web seeds
+		if (!m_web_seeds.empty())
+		{
+			d.key("httpseeds");
+			w.begin_list();
+			for (std::list<web_seed_entry>::const_iterator i = m_web_seeds.begin()
+				, end(m_web_seeds.end()); i != end; ++i)
+			{
+				if (i->type == web_seed_entry::http_seed) w.string(i->url);
+			}
+			w.end();
+		}
+
+		if (valid_metadata()
+			&& (m_magnet_link || (m_save_resume_flags & torrent_handle::save_info_dict)))
+		{
+			// the metadata is the bencoded info dictionary already
+			d.key("info");
+			w.raw(&torrent_file().metadata()[0], torrent_file().metadata_size());
+		}
+
+		const sha1_hash& info_hash = torrent_file().info_hash();
+		d.key("info-hash"); w.string((char const*)info_hash.begin(), info_hash.size);
+
+		d.key("last_download"); w.integer(m_last_download);
+		d.key("last_scrape"); w.integer(m_last_scrape);
+		d.key("last_seen_complete"); w.integer(m_last_seen_complete);
+		d.key("last_upload"); w.integer(m_last_upload);
+		d.key("libtorrent-version"); w.string(LIBTORRENT_VERSION);
+
+		// write renamed files
+		// TODO: 0 make this more generic to not just work if files have been
+		// renamed, but also if they have been merged into a single file for instance.
+		// using file_base
+		if (&m_torrent_file->files() != &m_torrent_file->orig_files()
+			&& m_torrent_file->files().num_files() == m_torrent_file->orig_files().num_files())
+		{
+			d.key("mapped_files");
+			w.begin_list();
+			file_storage const& fs = m_torrent_file->files();
+			for (int i = 0; i < fs.num_files(); ++i)
+				w.string(fs.file_path(i));
+			w.end();
+		}
+
+		d.key("max_connections"); w.integer(max_connections());
+		d.key("max_uploads"); w.integer(max_uploads());
+
+		if (m_torrent_file->is_merkle_torrent())
+		{
+			// we need to save the whole merkle hash tree
+			// in order to resume
+			std::vector<sha1_hash> const& tree = m_torrent_file->merkle_tree();
+			d.key("merkle tree");
+			w.string(tree.empty() ? "" : (char const*)&tree[0], int(tree.size()) * 20);
+		}
+
+		d.key("num_complete"); w.integer(m_complete);
+		d.key("num_downloaded"); w.integer(m_downloaded);
+		d.key("num_incomplete"); w.integer(m_incomplete);
+		d.key("paused"); w.integer(is_torrent_paused());
+		d.key("peers"); w.string(peers_str);
+#if TORRENT_USE_IPV6
+		d.key("peers6"); w.string(peers6_str);
+#endif
 
 		// write piece priorities
-		entry::string_type& piece_priority = ret["piece_priority"].string();
-		piece_priority.resize(m_torrent_file->num_pieces());
+		d.key("piece_priority");
+		char* piece_priority = w.reserve_string(num_pieces);
 		if (is_seed())
 		{
-			std::memset(&piece_priority[0], 1, pieces.size());
+			std::fill_n(piece_priority, num_pieces, 1);
 		}
 		else
 		{
-			for (int i = 0, end(piece_priority.size()); i < end; ++i)
+			for (int i = 0; i < num_pieces; ++i)
 				piece_priority[i] = m_picker->piece_priority(i);
 		}
 
-		// write file priorities
-		entry::list_type& file_priority = ret["file_priority"].list();
-		file_priority.clear();
-		for (int i = 0, end(m_file_priority.size()); i < end; ++i)
-			file_priority.push_back(m_file_priority[i]);
+		// write have bitmask
+		// the pieces string has one byte per piece. Each
+		// byte is a bitmask representing different properties
+		// for the piece
+		// bit 0: set if we have the piece
+		// bit 1: set if we have verified the piece (in seed mode)
+		d.key("pieces");
+		char* pieces = w.reserve_string(num_pieces);
+		if (is_seed())
+		{
+			std::fill_n(pieces, num_pieces, 1);
+		}
+		else
+		{
+			for (int i = 0; i < num_pieces; ++i)
+				pieces[i] = m_picker->have_piece(i) ? 1 : 0;
+		}
+
+		if (m_seed_mode)
+		{
+			TORRENT_ASSERT(int(m_verified.size()) == num_pieces);
+			for (int i = 0; i < num_pieces; ++i)
+				pieces[i] |= m_verified[i] ? 2 : 0;
+		}
+
+		d.key("seed_mode"); w.integer(m_seed_mode);
+		d.key("seeding_time"); w.integer(m_seeding_time);
+		d.key("sequential_download"); w.integer(m_sequential_download);
+		d.key("super_seeding"); w.integer(m_super_seeding);
+		d.key("total_downloaded"); w.integer(m_total_downloaded);
+		d.key("total_uploaded"); w.integer(m_total_uploaded);
+
+		// save trackers
+		if (!m_trackers.empty())
+		{
+			d.key("trackers");
+			w.begin_list();
+			w.begin_list();
+			int tier = 0;
+			for (std::vector<announce_entry>::const_iterator i = m_trackers.begin()
+				, end(m_trackers.end()); i != end; ++i)
+			{
+				// don't save trackers we can't trust
+				// TODO: 1 save the send_stats state instead of throwing them away
+				// it may pose an issue when downgrading though
+				if (i->send_stats == false) continue;
+				if (i->tier != tier)
+				{
+					w.end();
+					w.begin_list();
+					tier = i->tier;
+				}
+				w.string(i->url);
+			}
+			w.end();
+			w.end();
+		}
+
+		// if this torrent is a seed, we won't have a piece picker
+		// and there will be no half-finished pieces.
+		if (has_picker())
+		{
+			const std::vector<piece_picker::downloading_piece>& q
+				= m_picker->get_download_queue();
+
+			// unfinished pieces
+			d.key("unfinished");
+			w.begin_list();
+
+			const int num_bitmask_bytes
+				= (std::max)(num_blocks_per_piece / 8, 1);
+
+			// info for each unfinished piece
+			for (std::vector<piece_picker::downloading_piece>::const_iterator i
+				= q.begin(); i != q.end(); ++i)
+			{
+				if (i->finished == 0) continue;
+
+				w.begin_dict();
+				w.key("bitmask");
+				char* bitmask = w.reserve_string(num_bitmask_bytes);
+				for (int j = 0; j < num_bitmask_bytes; ++j)
+				{
+					unsigned char v = 0;
+					int bits = (std::min)(num_blocks_per_piece - j*8, 8);
+					for (int k = 0; k < bits; ++k)
+						v |= (i->info[j*8+k].state == piece_picker::block_info::state_finished)
+						? (1 << k) : 0;
+					bitmask[j] = v;
+					TORRENT_ASSERT(bits == 8 || j == num_bitmask_bytes - 1);
+				}
+				// the unfinished piece's index
+				w.key("piece");
+				w.integer(i->index);
+				w.end();
+			}
+			w.end();
+		}
+
+		d.key("upload_rate_limit"); w.integer(upload_limit());
+		if (!m_url.empty()) { d.key("url"); w.string(m_url); }
+
+		if (!m_web_seeds.empty())
+		{
+			d.key("url-list");
+			w.begin_list();
+			for (std::list<web_seed_entry>::const_iterator i = m_web_seeds.begin()
+				, end(m_web_seeds.end()); i != end; ++i)
+			{
+				if (i->type == web_seed_entry::url_seed) w.string(i->url);
+			}
+			w.end();
+		}
+
+		if (!m_uuid.empty()) { d.key("uuid"); w.string(m_uuid); }
+
+		d.finish();
+		w.end();
 	}
 
 	void torrent::get_full_peer_list(std::vector<peer_list_entry>& v) const
@@ -6094,7 +6232,7 @@ namespace libtorrent
 		m_connections.insert(p);
 #ifdef TORRENT_DEBUG
 		error_code ec;
-		TORRENT_ASSERT(p->remote() == p->get_socket()->remote_endpoint(ec) || ec);
+		TORRENT_ASSERT(p->remote() == p->socket_remote_endpoint(ec) || ec);
 #endif
 
 		TORRENT_ASSERT(p->peer_info_struct() != NULL);
@@ -7211,10 +7349,7 @@ namespace libtorrent
 			|| m_state == torrent_status::checking_files
 			|| m_state == torrent_status::checking_resume_data)
 		{
-			boost::shared_ptr<entry> rd(new entry);
-			write_resume_data(*rd);
-			alerts().post_alert(save_resume_data_alert(rd
-				, get_handle()));
+			post_resume_data(entry());
 			return;
 		}
 
@@ -7817,19 +7952,46 @@ namespace libtorrent
 		{
 			// keep trying web-seeds if there are any
 			// first find out which web seeds we are connected to
+			ptime now = time_now();
 			for (std::list<web_seed_entry>::iterator i = m_web_seeds.begin();
 				i != m_web_seeds.end();)
 			{
 				std::list<web_seed_entry>::iterator w = i++;
-				if (w->peer_info.connection) continue;
-				if (w->retry > time_now()) continue;
+				if (w->retry > now) continue;
 				if (w->resolving) continue;
 
+				int connections = num_web_seed_connections(*w);
+				if (connections > 0) update_web_seed_limit(*w, connections, now);
+				if (connections >= w->connection_limit) continue;
+
+				// connect_to_url_seed() may remove the web seed
 				connect_to_url_seed(w);
 			}
 		}
 	}
 
+	void torrent::update_web_seed_limit(web_seed_entry& web, int connections
+		, ptime now)
+	{
+		int rate = 0;
+		for (std::list<policy::ipv4_peer>::iterator i = web.extra_peers.begin()
+			, end(web.extra_peers.end()); i != end; ++i)
+		{
+			if (i->connection) rate += i->connection->statistics().download_payload_rate();
+		}
+		if (web.peer_info.connection)
+			rate += web.peer_info.connection->statistics().download_payload_rate();
+
+		if (web.update_connection_limit(connections, rate
+			, settings().urlseed_max_connections, now))
+		{
+#if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING
+			debug_log("web seed %s: %d B/s, allowing %d connections"
+				, web.url.c_str(), rate, web.connection_limit);
+#endif
+		}
+	}
+
 	void torrent::recalc_share_mode()
 	{
 		TORRENT_ASSERT(share_mode());
@@ -8625,7 +8787,7 @@ namespace libtorrent
 		for (std::list<web_seed_entry>::const_iterator i = m_web_seeds.begin()
 			, end(m_web_seeds.end()); i != end; ++i)
 		{
-			if (i->peer_info.banned) continue;
+			if (web_seed_banned(*i)) continue;
 			if (i->type != type) continue;
 			ret.insert(i->url);
 		}
@@ -8642,8 +8804,7 @@ namespace libtorrent
 
 	void torrent::disconnect_web_seed(peer_connection* p)
 	{
-		std::list<web_seed_entry>::iterator i = std::find_if(m_web_seeds.begin(), m_web_seeds.end()
-			, (boost::bind(&policy::peer::connection, boost::bind(&web_seed_entry::peer_info, _1)) == p));
+		std::list<web_seed_entry>::iterator i = find_web_seed(m_web_seeds, p);
 		// this happens if the web server responded with a redirect
 		// or with something incorrect, so that we removed the web seed
 		// immediately, before we disconnected
@@ -8654,33 +8815,49 @@ namespace libtorrent
 #if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_ERROR_LOGGING
 		debug_log("disconnect web seed: \"%s\"", i->url.c_str());
 #endif
-		TORRENT_ASSERT(i->peer_info.connection);
-		i->peer_info.connection = 0;
+		policy::ipv4_peer* peerinfo = web_seed_peer(*i, p);
+		TORRENT_ASSERT(peerinfo);
+		peerinfo->connection = 0;
 	}
 
 	void torrent::remove_web_seed(peer_connection* p)
 	{
-		std::list<web_seed_entry>::iterator i = std::find_if(m_web_seeds.begin(), m_web_seeds.end()
-			, (boost::bind(&policy::peer::connection, boost::bind(&web_seed_entry::peer_info, _1)) == p));
-		TORRENT_ASSERT(i != m_web_seeds.end());
+		std::list<web_seed_entry>::iterator i = find_web_seed(m_web_seeds, p);
+		// the web seed may already have been removed by another connection
+		// to it, which disconnected this one as well
 		if (i == m_web_seeds.end()) return;
+		policy::ipv4_peer* peerinfo = web_seed_peer(*i, p);
 		p->set_peer_info(0);
-		if (has_picker()) picker().clear_peer(&i->peer_info);
-		m_web_seeds.erase(i);
+		if (has_picker()) picker().clear_peer(peerinfo);
+		peerinfo->connection = 0;
+		// this detaches the other connections to the web seed too
+		remove_web_seed(i);
 	}
 
 	void torrent::retry_web_seed(peer_connection* p, int retry)
 	{
 		TORRENT_ASSERT(m_ses.is_network_thread());
-		std::list<web_seed_entry>::iterator i = std::find_if(m_web_seeds.begin(), m_web_seeds.end()
-			, (boost::bind(&policy::peer::connection, boost::bind(&web_seed_entry::peer_info, _1)) == p));
-
-		TORRENT_ASSERT(i != m_web_seeds.end());
+		std::list<web_seed_entry>::iterator i = find_web_seed(m_web_seeds, p);
+		// see remove_web_seed(peer_connection*)
 		if (i == m_web_seeds.end()) return;
 		if (retry == 0) retry = m_ses.settings().urlseed_wait_retry;
 		i->retry = time_now() + seconds(retry);
 	}
 
+	void torrent::throttle_web_seed(peer_connection* p)
+	{
+		TORRENT_ASSERT(m_ses.is_network_thread());
+		std::list<web_seed_entry>::iterator i = find_web_seed(m_web_seeds, p);
+		if (i == m_web_seeds.end()) return;
+
+		// the server is telling us we're using too many connections
+		i->throttle(time_now() + seconds(m_ses.settings().urlseed_wait_retry));
+#if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING
+		debug_log("web seed %s is overloaded, allowing %d connections"
+			, i->url.c_str(), i->connection_limit);
+#endif
+	}
+
 	bool torrent::try_connect_peer()
 	{
 		TORRENT_ASSERT(m_ses.is_network_thread());
@@ -585,10 +585,67 @@ namespace libtorrent
 		, supports_keepalive(true)
 		, resolving(false), removed(false)
 		, peer_info(tcp::endpoint(), true, 0)
+		, connection_limit(1)
+		, last_rate(0)
+		, next_adjustment(time_now())
 	{
 		peer_info.web_seed = true;
 	}
 
+	policy::ipv4_peer& web_seed_entry::unused_peer()
+	{
+		if (peer_info.connection == 0) return peer_info;
+		for (std::list<policy::ipv4_peer>::iterator i = extra_peers.begin()
+			, end(extra_peers.end()); i != end; ++i)
+		{
+			if (i->connection == 0) return *i;
+		}
+		extra_peers.push_back(policy::ipv4_peer(tcp::endpoint(), true, 0));
+		extra_peers.back().web_seed = true;
+		return extra_peers.back();
+	}
+
+	bool web_seed_entry::update_connection_limit(int connections, int rate
+		, int max_connections, ptime now)
+	{
+		max_connections = (std::max)(max_connections, 1);
+		if (connection_limit > max_connections)
+			connection_limit = max_connections;
+
+		// wait until all the connections we allow are open and have had
+		// time to ramp up before judging whether another one would help
+		if (connections < connection_limit) return false;
+		if (next_adjustment > now) return false;
+		next_adjustment = now + seconds(10);
+
+		if (connection_limit >= max_connections) return false;
+
+		// keep adding connections only as long as the last one we added
+		// made the download faster, by at least 10%. This keeps us from
+		// opening connections that just split the same bandwidth. The
+		// server or the network may change, so try again in a minute
+		if (rate <= last_rate + last_rate / 10)
+		{
+			last_rate = 0;
+			next_adjustment = now + seconds(60);
+			return false;
+		}
+
+		last_rate = rate;
+		++connection_limit;
+		return true;
+	}
+
+	void web_seed_entry::throttle(ptime until)
+	{
+		// back off quickly. The rate measured with more connections doesn't
+		// tell anything about the rate with fewer of them, so once the wait
+		// is over, the next adjustment probes with one more connection again
+		connection_limit = (std::max)(connection_limit / 2, 1);
+		last_rate = 0;
+		next_adjustment = until;
+	}
+
 	torrent_info::torrent_info(torrent_info const& t, int flags)
 		: m_merkle_first_leaf(t.m_merkle_first_leaf)
 		, m_files(t.m_files)
@@ -40,6 +40,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/tracker_manager.hpp"
 #include "libtorrent/http_tracker_connection.hpp"
 #include "libtorrent/udp_tracker_connection.hpp"
+#include "libtorrent/http_connection.hpp"
+#include "libtorrent/session_status.hpp"
 #include "libtorrent/aux_/session_impl.hpp"
 
 using boost::tuples::make_tuple;
@@ -261,6 +263,31 @@ namespace libtorrent
 		}
 		else if (protocol == "udp")
 		{
+			// scrapes to the same tracker are sent in a single packet, as
+			// long as the first one hasn't been sent yet. The most recent
+			// connections are at the end of the list
+			if (req.kind == tracker_request::scrape_request)
+			{
+				for (tracker_connections_t::reverse_iterator i = m_connections.rbegin()
+					, end(m_connections.rend()); i != end; ++i)
+				{
+					tracker_request const& r = (*i)->tracker_req();
+					if (r.kind != tracker_request::scrape_request
+						|| r.url != req.url
+						|| r.bind_ip != req.bind_ip
+						|| r.apply_ip_filter != req.apply_ip_filter)
+						continue;
+
+					// the URL is a udp:// URL, so this is a udp_tracker_connection
+					udp_tracker_connection* uc = static_cast<udp_tracker_connection*>(i->get());
+					if (!uc->add_scrape(req, c)) continue;
+
+					if (boost::shared_ptr<request_callback> cb = c.lock())
+						cb->m_manager = this;
+					return;
+				}
+			}
+
 			con = new udp_tracker_connection(
 				ios, cc, *this, req , c, m_ses
 				, m_proxy);
@@ -312,6 +339,83 @@ namespace libtorrent
 		return false;
 	}
 
+	boost::shared_ptr<http_connection> tracker_manager::get_http_connection(
+		std::string const& key)
+	{
+		TORRENT_ASSERT(m_ses.is_network_thread());
+		prune_http_pool(time_now());
+
+		// prefer the connection that was used most recently. It's the least
+		// likely to have been closed by the server
+		for (std::list<idle_http_connection>::reverse_iterator i = m_http_pool.rbegin()
+			, end(m_http_pool.rend()); i != end; ++i)
+		{
+			if (i->key != key) continue;
+			boost::shared_ptr<http_connection> c = i->connection;
+			m_http_pool.erase(--i.base());
+			if (!c->can_reuse())
+			{
+				c->close();
+				break;
+			}
+			++m_http_connection_reuses;
+			return c;
+		}
+		++m_http_connections;
+		return boost::shared_ptr<http_connection>();
+	}
+
+	void tracker_manager::return_http_connection(std::string const& key
+		, boost::shared_ptr<http_connection> c)
+	{
+		TORRENT_ASSERT(m_ses.is_network_thread());
+
+		// the handlers refer to the tracker connection that's done with it
+		c->set_handlers(http_handler());
+
+		int limit = m_ses.settings().tracker_keepalive_connections;
+		if (m_abort || limit <= 0 || !c->can_reuse())
+		{
+			c->close();
+			return;
+		}
+
+		idle_http_connection e;
+		e.key = key;
+		e.connection = c;
+		e.idle_since = time_now();
+		m_http_pool.push_back(e);
+
+		while (int(m_http_pool.size()) > limit)
+		{
+			m_http_pool.front().connection->close();
+			m_http_pool.pop_front();
+		}
+		prune_http_pool(e.idle_since);
+	}
+
+	void tracker_manager::prune_http_pool(ptime now)
+	{
+		ptime limit = now - seconds(m_ses.settings().tracker_keepalive_timeout);
+		while (!m_http_pool.empty() && m_http_pool.front().idle_since <= limit)
+		{
+			m_http_pool.front().connection->close();
+			m_http_pool.pop_front();
+		}
+	}
+
+	void tracker_manager::get_status(session_status& s) const
+	{
+		s.num_idle_tracker_connections = int(m_http_pool.size());
+		s.total_tracker_connections = m_http_connections;
+		s.total_tracker_connection_reuses = m_http_connection_reuses;
+	}
+
+	resolver& tracker_manager::host_resolver()
+	{
+		return m_ses.m_host_resolver;
+	}
+
 	void tracker_manager::abort_all_requests(bool all)
 	{
 		// removes all connections from m_connections
@@ -343,6 +447,13 @@ namespace libtorrent
 		{
 			(*i)->close();
 		}
+
+		for (std::list<idle_http_connection>::iterator i = m_http_pool.begin()
+			, end(m_http_pool.end()); i != end; ++i)
+		{
+			i->connection->close();
+		}
+		m_http_pool.clear();
 	}
 	
 	bool tracker_manager::empty() const
@@ -53,6 +53,13 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/debug.hpp"
 #endif
 
+#if TORRENT_USE_RECVMMSG || TORRENT_USE_SENDMMSG
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <errno.h>
+#endif
+
 using namespace libtorrent;
 
 udp_socket::udp_socket(asio::io_service& ios
@@ -62,6 +69,11 @@ udp_socket::udp_socket(asio::io_service& ios
 	, m_buf_size(0)
 	, m_new_buf_size(0)
 	, m_buf(0)
+	, m_reading_batch(false)
+	, m_cork(0)
+#if TORRENT_USE_SENDMMSG
+	, m_use_gso(true)
+#endif
 #if TORRENT_USE_IPV6
 	, m_ipv6_sock(ios)
 #endif
@@ -100,7 +112,7 @@ udp_socket::udp_socket(asio::io_service& ios
 
 	m_buf_size = 2000;
 	m_new_buf_size = m_buf_size;
-	m_buf = (char*)malloc(m_buf_size);
+	m_buf = (char*)malloc(m_buf_size * read_batch_size);
 }
 
 udp_socket::~udp_socket()
@@ -211,36 +223,229 @@ void udp_socket::send(udp::endpoint const& ep, char const* p, int len
 
 	if (m_force_proxy) return;
 
+	udp::socket* s = &m_ipv4_sock;
 #if TORRENT_USE_IPV6
 	if (ep.address().is_v6() && m_ipv6_sock.is_open())
-		m_ipv6_sock.send_to(asio::buffer(p, len), ep, 0, ec);
-	else
+		s = &m_ipv6_sock;
 #endif
-		m_ipv4_sock.send_to(asio::buffer(p, len), ep, 0, ec);
+
+	// if there are datagrams waiting for the socket to become writable,
+	// this one has to wait too, to preserve the order
+	if ((flags & dont_cork) && m_cork > 0 && !m_send_queue.empty())
+		flush_send_queue();
+
+	if ((m_cork > 0 && (flags & dont_cork) == 0) || !m_send_queue.empty())
+	{
+		if (int(m_send_queue.size()) >= max_send_queue && m_cork > 0)
+			flush_send_queue();
+
+		if (flags & dont_cork)
+		{
+			// the datagrams queued before this one are waiting for the
+			// socket to become writable
+			ec = error::would_block;
+			return;
+		}
+
+		if (int(m_send_queue.size()) >= max_send_queue)
+		{
+			// we're still waiting for the socket to become writable
+			ec = error::would_block;
+			return;
+		}
+
+		pending_datagram d;
+		d.sock = s;
+		d.ep = ep;
+		d.offset = m_send_buf.size();
+		d.len = len;
+		m_send_buf.insert(m_send_buf.end(), p, p + len);
+		m_send_queue.push_back(d);
+		return;
+	}
+
+	s->send_to(asio::buffer(p, len), ep, 0, ec);
 
 	if (ec == error::would_block || ec == error::try_again)
+		subscribe_writable(s);
+}
+
+void udp_socket::uncork()
+{
+	TORRENT_ASSERT(m_cork > 0);
+	if (--m_cork > 0) return;
+	if (!m_send_queue.empty()) flush_send_queue();
+	if (!m_send_errors.empty()) report_send_errors();
+}
+
+void udp_socket::report_send_errors()
+{
+	// an observer may be sending (and flushing the queue) right now
+	if (m_observers_locked) return;
+
+	std::vector<std::pair<udp::endpoint, error_code> > errors;
+	errors.swap(m_send_errors);
+	for (std::vector<std::pair<udp::endpoint, error_code> >::iterator i = errors.begin()
+		, end(errors.end()); i != end; ++i)
+		call_handler(i->second, i->first, 0, 0);
+}
+
+// sends as many queued datagrams as the sockets accept. If a socket would
+// block, the remaining datagrams are sent once it becomes writable
+void udp_socket::flush_send_queue()
+{
+	TORRENT_ASSERT(is_single_thread());
+
+	int const num = m_send_queue.size();
+	int sent = 0;
+	while (sent < num)
 	{
-#if TORRENT_USE_IPV6
-		if (ep.address().is_v6() && m_ipv6_sock.is_open())
+		// send all consecutive datagrams going out through
+		// the same socket in one go
+		udp::socket* s = m_send_queue[sent].sock;
+		int end = sent + 1;
+		while (end < num && m_send_queue[end].sock == s) ++end;
+
+		error_code ec;
+		sent += send_datagrams(s, &m_send_queue[sent], end - sent, ec);
+		if (ec == error::would_block || ec == error::try_again)
 		{
-			if (!m_v6_write_subscribed)
-			{
-				m_ipv6_sock.async_send(asio::null_buffers()
-					, boost::bind(&udp_socket::on_writable, this, _1, &m_ipv6_sock));
-				m_v6_write_subscribed = true;
-			}
+			subscribe_writable(s);
+			break;
+		}
+		// on any other error, drop the datagram that failed, just like
+		// send() would have, and report the error to the observers
+		if (ec)
+		{
+			m_send_errors.push_back(std::make_pair(m_send_queue[sent].ep, ec));
+			++sent;
+		}
+	}
+
+	if (sent == num)
+	{
+		m_send_queue.clear();
+		m_send_buf.clear();
+		return;
+	}
+
+	int const offset = m_send_queue[sent].offset;
+	m_send_queue.erase(m_send_queue.begin(), m_send_queue.begin() + sent);
+	m_send_buf.erase(m_send_buf.begin(), m_send_buf.begin() + offset);
+	for (std::vector<pending_datagram>::iterator i = m_send_queue.begin()
+		, end(m_send_queue.end()); i != end; ++i)
+		i->offset -= offset;
+}
+
+// returns the number of datagrams that were sent. If it's less than num,
+// ec is set to the error of the first datagram that could not be sent
+int udp_socket::send_datagrams(udp::socket* s, pending_datagram const* d
+	, int num, error_code& ec)
+{
+#if TORRENT_USE_SENDMMSG
+	mmsghdr msgs[max_send_queue];
+	iovec iov[max_send_queue];
+	// the number of datagrams covered by each message. When using
+	// generic segmentation offload, a run of equally sized datagrams
+	// to the same endpoint is handed to the kernel as one message
+	int segments[max_send_queue];
+#ifdef UDP_SEGMENT
+	char control[max_send_queue][CMSG_SPACE(sizeof(boost::uint16_t))];
+#endif
+
+	int num_msgs = 0;
+	for (int i = 0; i < num;)
+	{
+		int seg = 1;
+#ifdef UDP_SEGMENT
+		// the last segment is allowed to be shorter than the others
+		int total = d[i].len;
+		while (m_use_gso && i + seg < num
+			&& d[i + seg].ep == d[i].ep
+			&& d[i + seg].len <= d[i].len
+			&& total + d[i + seg].len <= 65000
+			&& d[i + seg - 1].len == d[i].len)
+		{
+			total += d[i + seg].len;
+			++seg;
 		}
-		else
 #endif
+		mmsghdr& m = msgs[num_msgs];
+		memset(&m, 0, sizeof(m));
+		iov[num_msgs].iov_base = &m_send_buf[d[i].offset];
+		iov[num_msgs].iov_len = d[i + seg - 1].offset + d[i + seg - 1].len - d[i].offset;
+		m.msg_hdr.msg_name = const_cast<void*>(static_cast<void const*>(d[i].ep.data()));
+		m.msg_hdr.msg_namelen = d[i].ep.size();
+		m.msg_hdr.msg_iov = &iov[num_msgs];
+		m.msg_hdr.msg_iovlen = 1;
+#ifdef UDP_SEGMENT
+		if (seg > 1)
 		{
-			if (!m_v4_write_subscribed)
-			{
-				m_ipv4_sock.async_send(asio::null_buffers()
-					, boost::bind(&udp_socket::on_writable, this, _1, &m_ipv4_sock));
-				m_v4_write_subscribed = true;
-			}
+			m.msg_hdr.msg_control = control[num_msgs];
+			m.msg_hdr.msg_controllen = sizeof(control[num_msgs]);
+			cmsghdr* cm = CMSG_FIRSTHDR(&m.msg_hdr);
+			cm->cmsg_level = SOL_UDP;
+			cm->cmsg_type = UDP_SEGMENT;
+			cm->cmsg_len = CMSG_LEN(sizeof(boost::uint16_t));
+			boost::uint16_t const seg_size = d[i].len;
+			memcpy(CMSG_DATA(cm), &seg_size, sizeof(seg_size));
 		}
+#endif
+		segments[num_msgs] = seg;
+		++num_msgs;
+		i += seg;
+	}
+
+	int ret = sendmmsg(s->native_handle(), msgs, num_msgs, 0);
+	if (ret < 0)
+	{
+		ec = error_code(errno, get_system_category());
+#ifdef UDP_SEGMENT
+		// EIO or EINVAL means the kernel or the network
+		// card doesn't support segmentation offload. Stop
+		// using it, and try again without it
+		if (segments[0] > 1 && (errno == EIO || errno == EINVAL))
+		{
+			m_use_gso = false;
+			ec.clear();
+			return send_datagrams(s, d, num, ec);
+		}
+#endif
+		return 0;
+	}
+
+	int sent = 0;
+	for (int i = 0; i < ret; ++i) sent += segments[i];
+	// sendmmsg() only reports an error if the first message fails.
+	// Find out what stopped it by sending the next one
+	if (sent < num) return sent + send_datagrams(s, d + sent, 1, ec);
+	return sent;
+#else
+	for (int i = 0; i < num; ++i)
+	{
+		s->send_to(asio::buffer(&m_send_buf[d[i].offset], d[i].len), d[i].ep, 0, ec);
+		if (ec) return i;
+	}
+	return num;
+#endif
+}
+
+void udp_socket::subscribe_writable(udp::socket* s)
+{
+#if TORRENT_USE_IPV6
+	if (s == &m_ipv6_sock)
+	{
+		if (m_v6_write_subscribed) return;
+		m_v6_write_subscribed = true;
+	}
+	else
+#endif
+	{
+		if (m_v4_write_subscribed) return;
+		m_v4_write_subscribed = true;
 	}
+	s->async_send(asio::null_buffers()
+		, boost::bind(&udp_socket::on_writable, this, _1, s));
 }
 
 void udp_socket::on_writable(error_code const& ec, udp::socket* s)
@@ -252,6 +457,14 @@ void udp_socket::on_writable(error_code const& ec, udp::socket* s)
 #endif
 		m_v4_write_subscribed = false;
 
+	// datagrams that were queued up go out first
+	if (!ec && !m_send_queue.empty())
+	{
+		flush_send_queue();
+		if (!m_send_errors.empty()) report_send_errors();
+		if (!m_send_queue.empty()) return;
+	}
+
 	call_writable_handler();
 }
 
@@ -283,18 +496,82 @@ void udp_socket::on_read(error_code const& ec, udp::socket* s)
 
 	CHECK_MAGIC;
 
+	// responses to the packets we receive are sent
+	// in batches, once we're done with all of them
+	cork();
 	for (;;)
 	{
+#if TORRENT_USE_RECVMMSG
+		if (!read_batch(s)) break;
+#else
 		error_code ec;
 		udp::endpoint ep;
 		size_t bytes_transferred = s->receive_from(asio::buffer(m_buf, m_buf_size), ep, 0, ec);
 		if (ec == asio::error::would_block || ec == asio::error::try_again) break;
-		on_read_impl(s, ep, ec, bytes_transferred);
+		on_read_impl(s, ep, ec, m_buf, bytes_transferred);
+#endif
 	}
 	call_drained_handler();
+	uncork();
 	setup_read(s);
 }
 
+#if TORRENT_USE_RECVMMSG
+// receives up to read_batch_size datagrams with a single system call
+// and dispatches them. Returns false once the socket is drained
+bool udp_socket::read_batch(udp::socket* s)
+{
+	mmsghdr msgs[read_batch_size];
+	iovec iov[read_batch_size];
+	sockaddr_storage addr[read_batch_size];
+	memset(msgs, 0, sizeof(msgs));
+	for (int i = 0; i < read_batch_size; ++i)
+	{
+		iov[i].iov_base = m_buf + i * m_buf_size;
+		iov[i].iov_len = m_buf_size;
+		msgs[i].msg_hdr.msg_name = &addr[i];
+		msgs[i].msg_hdr.msg_namelen = sizeof(addr[i]);
+		msgs[i].msg_hdr.msg_iov = &iov[i];
+		msgs[i].msg_hdr.msg_iovlen = 1;
+	}
+
+	int ret = recvmmsg(s->native_handle(), msgs, read_batch_size, MSG_DONTWAIT, 0);
+	if (ret < 0)
+	{
+		error_code ec(errno, get_system_category());
+		if (ec == asio::error::would_block || ec == asio::error::try_again) return false;
+		on_read_impl(s, udp::endpoint(), ec, m_buf, 0);
+		return true;
+	}
+
+	// the observers may not resize the buffer until
+	// we're done with all the datagrams in it
+	m_reading_batch = true;
+	for (int i = 0; i < ret; ++i)
+	{
+		udp::endpoint ep;
+		if (msgs[i].msg_hdr.msg_namelen > ep.capacity()) continue;
+		memcpy(ep.data(), &addr[i], msgs[i].msg_hdr.msg_namelen);
+		ep.resize(msgs[i].msg_hdr.msg_namelen);
+
+		// a datagram that didn't fit in the buffer is dropped, the
+		// same way receive_from() fails with message_size
+		if (msgs[i].msg_hdr.msg_flags & MSG_TRUNC)
+		{
+			on_read_impl(s, ep, asio::error::message_size, 0, 0);
+			continue;
+		}
+		on_read_impl(s, ep, error_code(), m_buf + i * m_buf_size, msgs[i].msg_len);
+	}
+	m_reading_batch = false;
+	if (m_new_buf_size != m_buf_size)
+		set_buf_size(m_new_buf_size);
+
+	// a partial batch means there was nothing more to read
+	return ret == read_batch_size;
+}
+#endif
+
 void udp_socket::call_handler(error_code const& ec, udp::endpoint const& ep, char const* buf, int size)
 {
 	m_observers_locked = true;
@@ -407,7 +684,7 @@ void udp_socket::unsubscribe(udp_socket_observer* o)
 }
 
 void udp_socket::on_read_impl(udp::socket* s, udp::endpoint const& ep
-	, error_code const& e, std::size_t bytes_transferred)
+	, error_code const& e, char const* buf, std::size_t bytes_transferred)
 {
 	TORRENT_ASSERT(m_magic == 0x1337);
 	TORRENT_ASSERT(is_single_thread());
@@ -451,11 +728,11 @@ void udp_socket::on_read_impl(udp::socket* s, udp::endpoint const& ep
 		{
 			// if the source IP doesn't match the proxy's, ignore the packet
 			if (ep == m_udp_proxy_addr)
-				unwrap(e, m_buf, bytes_transferred);
+				unwrap(e, buf, bytes_transferred);
 		}
 		else if (!m_force_proxy) // block incoming packets that aren't coming via the proxy
 		{
-			call_handler(e, ep, m_buf, bytes_transferred);
+			call_handler(e, ep, buf, bytes_transferred);
 		}
 
 	} TORRENT_CATCH (std::exception&) {}
@@ -618,6 +895,8 @@ void udp_socket::close()
 	TORRENT_ASSERT_VAL(!ec || ec == error::bad_descriptor, ec);
 	m_resolver.cancel();
 	m_abort = true;
+	m_send_queue.clear();
+	m_send_buf.clear();
 
 #if TORRENT_USE_ASSERTS
 	m_outstanding_when_aborted = num_outstanding();
@@ -653,7 +932,7 @@ void udp_socket::set_buf_size(int s)
 {
 	TORRENT_ASSERT(is_single_thread());
 
-	if (m_observers_locked)
+	if (m_observers_locked || m_reading_batch)
 	{
 		// we can't actually reallocate the buffer while
 		// it's being used by the observers, we have to
@@ -665,7 +944,7 @@ void udp_socket::set_buf_size(int s)
 	if (s == m_buf_size) return;
 
 	bool no_mem = false;
-	void* tmp = realloc(m_buf, s);
+	void* tmp = realloc(m_buf, s * read_batch_size);
 	if (tmp != 0)
 	{
 		m_buf = (char*)tmp;
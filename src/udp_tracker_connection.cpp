@@ -61,6 +61,9 @@ namespace libtorrent
 	std::map<address, udp_tracker_connection::connection_cache_entry>
 		udp_tracker_connection::m_connection_cache;
 
+	std::map<address, udp_tracker_connection::pending_connect>
+		udp_tracker_connection::m_pending_connects;
+
 	mutex udp_tracker_connection::m_cache_mutex;
 
 	udp_tracker_connection::udp_tracker_connection(
@@ -95,7 +98,7 @@ namespace libtorrent
 
 		if (ec)
 		{
-			tracker_connection::fail(ec);
+			fail(ec);
 			return;
 		}
 		
@@ -114,10 +117,9 @@ namespace libtorrent
 #if defined TORRENT_ASIO_DEBUGGING
 			add_outstanding_async("udp_tracker_connection::name_lookup");
 #endif
-			tcp::resolver::query q(hostname, to_string(port).elems);
-			m_ses.m_host_resolver.async_resolve(q
+			m_ses.m_host_resolver.async_resolve(hostname
 				, boost::bind(
-				&udp_tracker_connection::name_lookup, self(), _1, _2));
+				&udp_tracker_connection::name_lookup, self(), _1, _2, port));
 #if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING
 			boost::shared_ptr<request_callback> cb = requester();
 			if (cb) cb->debug_log("*** UDP_TRACKER [ initiating name lookup: \"%s\" ]"
@@ -134,6 +136,8 @@ namespace libtorrent
 	void udp_tracker_connection::fail(error_code const& ec, int code
 		, char const* msg, int interval, int min_interval)
 	{
+		release_pending_connect();
+
 		// m_target failed. remove it from the endpoint list
 		std::list<tcp::endpoint>::iterator i = std::find(m_endpoints.begin()
 			, m_endpoints.end(), tcp::endpoint(m_target.address(), m_target.port()));
@@ -143,6 +147,21 @@ namespace libtorrent
 		// if that was the last one, fail the whole announce
 		if (m_endpoints.empty())
 		{
+			// don't let any more scrapes join this request
+			m_abort = true;
+
+			for (std::vector<extra_scrape>::iterator i = m_extra_scrapes.begin()
+				, end(m_extra_scrapes.end()); i != end; ++i)
+			{
+				boost::shared_ptr<request_callback> cb = i->callback.lock();
+				if (!cb) continue;
+				// we need to post the error to avoid deadlock
+				get_io_service().post(boost::bind(&request_callback::tracker_request_error
+					, cb, i->req, code, ec, std::string(msg)
+					, interval == 0 ? min_interval : interval));
+			}
+			m_extra_scrapes.clear();
+
 			tracker_connection::fail(ec, code, msg, interval, min_interval);
 			return;
 		}
@@ -165,14 +184,14 @@ namespace libtorrent
 	}
 
 	void udp_tracker_connection::name_lookup(error_code const& error
-		, tcp::resolver::iterator i)
+		, std::vector<address> const& addresses, int port)
 	{
 #if defined TORRENT_ASIO_DEBUGGING
 		complete_async("udp_tracker_connection::name_lookup");
 #endif
 		if (m_abort) return;
 		if (error == asio::error::operation_aborted) return;
-		if (error || i == tcp::resolver::iterator())
+		if (error || addresses.empty())
 		{
 			fail(error);
 			return;
@@ -194,8 +213,9 @@ namespace libtorrent
 		// we're listening on. To make sure the tracker get our
 		// correct listening address.
 
-		std::transform(i, tcp::resolver::iterator(), std::back_inserter(m_endpoints)
-			, boost::bind(&tcp::resolver::iterator::value_type::endpoint, _1));
+		for (std::vector<address>::const_iterator i = addresses.begin()
+			, end(addresses.end()); i != end; ++i)
+			m_endpoints.push_back(tcp::endpoint(*i, port));
 
 		if (tracker_req().apply_ip_filter)
 		{
@@ -270,6 +290,8 @@ namespace libtorrent
 
 	void udp_tracker_connection::start_announce()
 	{
+		if (m_abort || cancelled()) return;
+
 		mutex::scoped_lock l(m_cache_mutex);
 		std::map<address, connection_cache_entry>::iterator cc
 			= m_connection_cache.find(m_target.address());
@@ -279,6 +301,7 @@ namespace libtorrent
 			// use if if it hasn't expired
 			if (time_now() < cc->second.expires)
 			{
+				l.unlock();
 				if (tracker_req().kind == tracker_request::announce_request)
 					send_udp_announce();
 				else if (tracker_req().kind == tracker_request::scrape_request)
@@ -288,11 +311,74 @@ namespace libtorrent
 			// if it expired, remove it from the cache
 			m_connection_cache.erase(cc);
 		}
+
+		// if another connection is already asking this tracker for a
+		// connection ID, wait for it instead of sending a connect message
+		// of our own. When connecting through a proxy by hostname, the
+		// target address isn't known, so we can't tell trackers apart
+		if (m_hostname.empty())
+		{
+			std::map<address, pending_connect>::iterator p
+				= m_pending_connects.find(m_target.address());
+			if (p != m_pending_connects.end() && p->second.connecting != this)
+			{
+				p->second.waiting.push_back(self());
+#if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING
+				boost::shared_ptr<request_callback> cb = requester();
+				if (cb) cb->debug_log("*** UDP_TRACKER [ waiting for connect: %s ]"
+					, print_endpoint(m_target).c_str());
+#endif
+				return;
+			}
+			m_pending_connects[m_target.address()].connecting = this;
+		}
 		l.unlock();
 
 		send_udp_connect();
 	}
 
+	void udp_tracker_connection::release_pending_connect()
+	{
+		mutex::scoped_lock l(m_cache_mutex);
+		std::map<address, pending_connect>::iterator p
+			= m_pending_connects.find(m_target.address());
+		if (p == m_pending_connects.end() || p->second.connecting != this) return;
+
+		std::vector<boost::intrusive_ptr<udp_tracker_connection> > waiting;
+		waiting.swap(p->second.waiting);
+		m_pending_connects.erase(p);
+		l.unlock();
+
+		// if we got a connection ID, it's in the cache by now. If we
+		// didn't, the first of these to start over sends a new connect.
+		// The map is shared by all sessions, so a waiting connection may
+		// belong to another session. Resume it on its own network thread
+		for (std::vector<boost::intrusive_ptr<udp_tracker_connection> >::iterator i
+			= waiting.begin(), end(waiting.end()); i != end; ++i)
+		{
+			(*i)->get_io_service().post(boost::bind(
+				&udp_tracker_connection::start_announce, *i));
+		}
+	}
+
+	bool udp_tracker_connection::add_scrape(tracker_request const& req
+		, boost::weak_ptr<request_callback> c)
+	{
+		TORRENT_ASSERT(tracker_req().kind == tracker_request::scrape_request);
+		TORRENT_ASSERT(req.kind == tracker_request::scrape_request);
+
+		if (m_abort || cancelled()) return false;
+		// once our scrape is sent, it's too late to add to it
+		if (m_state == action_scrape) return false;
+		if (int(m_extra_scrapes.size()) + 1 >= max_scrape_hashes) return false;
+
+		extra_scrape e;
+		e.req = req;
+		e.callback = c;
+		m_extra_scrapes.push_back(e);
+		return true;
+	}
+
 	void udp_tracker_connection::on_timeout(error_code const& ec)
 	{
 		if (ec)
@@ -311,7 +397,8 @@ namespace libtorrent
 
 	void udp_tracker_connection::close()
 	{
-		error_code ec;
+		release_pending_connect();
+		m_extra_scrapes.clear();
 		tracker_connection::close();
 	}
 
@@ -415,6 +502,10 @@ namespace libtorrent
 		connection_cache_entry& cce = m_connection_cache[m_target.address()];
 		cce.connection_id = connection_id;
 		cce.expires = time_now() + seconds(m_ses.m_settings.udp_tracker_token_expiry);
+		l.unlock();
+
+		// let the connections waiting for this connection ID use it
+		release_pending_connect();
 
 		if (tracker_req().kind == tracker_request::announce_request)
 			send_udp_announce();
@@ -474,36 +565,50 @@ namespace libtorrent
 
 		if (m_abort) return;
 
+		mutex::scoped_lock l(m_cache_mutex);
 		std::map<address, connection_cache_entry>::iterator i
 			= m_connection_cache.find(m_target.address());
 		// this isn't really supposed to happen
 		TORRENT_ASSERT(i != m_connection_cache.end());
 		if (i == m_connection_cache.end()) return;
+		boost::int64_t connection_id = i->second.connection_id;
+		l.unlock();
 
-		char buf[8 + 4 + 4 + 20];
+		char buf[8 + 4 + 4 + 20 * max_scrape_hashes];
 		char* out = buf;
 
-		detail::write_int64(i->second.connection_id, out); // connection_id
+		detail::write_int64(connection_id, out); // connection_id
 		detail::write_int32(action_scrape, out); // action (scrape)
 		detail::write_int32(m_transaction_id, out); // transaction_id
 		// info_hash
 		std::copy(tracker_req().info_hash.begin(), tracker_req().info_hash.end(), out);
-#if defined TORRENT_DEBUG || TORRENT_RELEASE_ASSERTS
 		out += 20;
-		TORRENT_ASSERT(out - buf == sizeof(buf));
+		// the info-hashes of the scrapes sharing this packet
+		for (std::vector<extra_scrape>::iterator j = m_extra_scrapes.begin()
+			, end(m_extra_scrapes.end()); j != end; ++j)
+		{
+			std::copy(j->req.info_hash.begin(), j->req.info_hash.end(), out);
+			out += 20;
+		}
+		TORRENT_ASSERT(out - buf <= int(sizeof(buf)));
+
+#if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING
+		boost::shared_ptr<request_callback> cb = requester();
+		if (cb) cb->debug_log("==> UDP_TRACKER_SCRAPE [ info-hashes: %d ]"
+			, int(m_extra_scrapes.size()) + 1);
 #endif
 
 		error_code ec;
 		if (!m_hostname.empty())
 		{
-			m_ses.m_udp_socket.send_hostname(m_hostname.c_str(), m_target.port(), buf, sizeof(buf), ec);
+			m_ses.m_udp_socket.send_hostname(m_hostname.c_str(), m_target.port(), buf, out - buf, ec);
 		}
 		else
 		{
-			m_ses.m_udp_socket.send(m_target, buf, sizeof(buf), ec);
+			m_ses.m_udp_socket.send(m_target, buf, out - buf, ec);
 		}
 		m_state = action_scrape;
-		sent_bytes(sizeof(buf) + 28); // assuming UDP/IP header
+		sent_bytes(out - buf + 28); // assuming UDP/IP header
 		++m_attempts;
 		if (ec)
 		{
@@ -607,19 +712,41 @@ namespace libtorrent
 			return true;
 		}
 
+		// the response has 12 bytes for every info-hash in the request,
+		// in the same order
+		int num_responses = (size - 8) / 12;
+
 		int complete = detail::read_int32(buf);
 		int downloaded = detail::read_int32(buf);
 		int incomplete = detail::read_int32(buf);
 
 		boost::shared_ptr<request_callback> cb = requester();
-		if (!cb)
+		if (cb)
 		{
-			close();
-			return true;
+			cb->tracker_scrape_response(tracker_req()
+				, complete, incomplete, downloaded, -1);
+		}
+
+		for (int i = 0; i < int(m_extra_scrapes.size()); ++i)
+		{
+			extra_scrape const& e = m_extra_scrapes[i];
+			boost::shared_ptr<request_callback> ecb = e.callback.lock();
+			if (!ecb) continue;
+
+			if (i + 1 >= num_responses)
+			{
+				ecb->tracker_request_error(e.req, -1
+					, error_code(errors::invalid_tracker_response_length), "", 0);
+				continue;
+			}
+
+			char const* ptr = buf + i * 12;
+			complete = detail::read_int32(ptr);
+			downloaded = detail::read_int32(ptr);
+			incomplete = detail::read_int32(ptr);
+			ecb->tracker_scrape_response(e.req
+				, complete, incomplete, downloaded, -1);
 		}
-		
-		cb->tracker_scrape_response(tracker_req()
-			, complete, incomplete, downloaded, -1);
 
 		close();
 		return true;
@@ -639,13 +766,16 @@ namespace libtorrent
 		const bool stats = req.send_stats;
 		session_settings const& settings = m_ses.settings();
 
+		mutex::scoped_lock l(m_cache_mutex);
 		std::map<address, connection_cache_entry>::iterator i
 			= m_connection_cache.find(m_target.address());
 		// this isn't really supposed to happen
 		TORRENT_ASSERT(i != m_connection_cache.end());
 		if (i == m_connection_cache.end()) return;
+		boost::int64_t connection_id = i->second.connection_id;
+		l.unlock();
 
-		detail::write_int64(i->second.connection_id, out); // connection_id
+		detail::write_int64(connection_id, out); // connection_id
 		detail::write_int32(action_announce, out); // action (announce)
 		detail::write_int32(m_transaction_id, out); // transaction_id
 		std::copy(req.info_hash.begin(), req.info_hash.end(), out); // info_hash
@@ -38,6 +38,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/broadcast_socket.hpp" // for is_teredo
 #include "libtorrent/random.hpp"
 
+#include <boost/bind.hpp>
+
 // #define TORRENT_DEBUG_MTU 1135
 
 namespace libtorrent
@@ -47,6 +49,9 @@ namespace libtorrent
 		, incoming_utp_callback_t cb)
 		: m_sock(s)
 		, m_cb(cb)
+		, m_timers(100, 1024)
+		, m_pacing_timer(new utp_pacing_timer(s.get_io_service(), this))
+		, m_pacing_deadline(max_time())
 		, m_last_socket(0)
 		, m_new_connection(-1)
 		, m_sett(sett)
@@ -59,10 +64,14 @@ namespace libtorrent
 
 	utp_socket_manager::~utp_socket_manager()
 	{
-		for (socket_map_t::iterator i = m_utp_sockets.begin()
-			, end(m_utp_sockets.end()); i != end; ++i)
+		m_pacing_timer->manager = 0;
+		error_code ec;
+		m_pacing_timer->timer.cancel(ec);
+
+		for (int i = 0; i < m_utp_sockets.capacity(); ++i)
 		{
-			delete_utp_impl(i->second);
+			utp_socket_impl* s = m_utp_sockets.at(i);
+			if (s) delete_utp_impl(s);
 		}
 	}
 
@@ -86,11 +95,17 @@ namespace libtorrent
 		s.payload_pkts_out = m_counters[payload_pkts_out];
 		s.invalid_pkts_in = m_counters[invalid_pkts_in];
 		s.redundant_pkts_in = m_counters[redundant_pkts_in];
+		s.paced_packets = m_counters[paced_packets];
+		s.packet_pool_hits = m_packet_pool.hits();
+		s.packet_pool_misses = m_packet_pool.misses();
+		s.packets_in_use = m_packet_pool.in_use();
+		s.packets_high_water = m_packet_pool.high_water();
 
-		for (socket_map_t::const_iterator i = m_utp_sockets.begin()
-			, end(m_utp_sockets.end()); i != end; ++i)
+		for (int i = 0; i < m_utp_sockets.capacity(); ++i)
 		{
-			int state = utp_socket_state(i->second);
+			utp_socket_impl* sock = m_utp_sockets.at(i);
+			if (sock == 0) continue;
+			int state = utp_socket_state(sock);
 			switch (state)
 			{
 				case 0: ++s.num_idle; break;
@@ -105,18 +120,24 @@ namespace libtorrent
 
 	void utp_socket_manager::tick(ptime now)
 	{
-		for (socket_map_t::iterator i = m_utp_sockets.begin()
-			, end(m_utp_sockets.end()); i != end;)
+		// only the sockets whose timers expired need to be ticked. This
+		// is what keeps the cost of a tick independent of the number of
+		// idle sockets
+		m_expired_timers.clear();
+		m_timers.expire(now, m_expired_timers);
+
+		for (std::vector<timer_wheel_entry*>::iterator i = m_expired_timers.begin()
+			, end(m_expired_timers.end()); i != end; ++i)
 		{
-			if (should_delete(i->second))
+			utp_socket_impl* s = static_cast<utp_socket_impl*>((*i)->userdata);
+			if (should_delete(s))
 			{
-				delete_utp_impl(i->second);
-				if (m_last_socket == i->second) m_last_socket = 0;
-				m_utp_sockets.erase(i++);
+				m_utp_sockets.erase(utp_remote_endpoint(s), utp_receive_id(s), s);
+				if (m_last_socket == s) m_last_socket = 0;
+				delete_utp_impl(s);
 				continue;
 			}
-			tick_utp_impl(i->second, now);
-			++i;
+			tick_utp_impl(s, now);
 		}
 	}
 
@@ -214,7 +235,11 @@ namespace libtorrent
 		if (flags & utp_socket_manager::dont_fragment)
 			m_sock.set_option(libtorrent::dont_fragment(true), tmp);
 #endif
-		m_sock.send(ep, p, len, ec);
+		// MTU probes are not deferred by a corked socket. The dont-fragment
+		// option only applies while it's set, and the probe needs to learn
+		// about message_size errors right away
+		m_sock.send(ep, p, len, ec
+			, (flags & dont_fragment) ? udp_socket::dont_cork : 0);
 #ifdef TORRENT_HAS_DONT_FRAGMENT
 		if (flags & utp_socket_manager::dont_fragment)
 			m_sock.set_option(libtorrent::dont_fragment(false), tmp);
@@ -309,14 +334,12 @@ namespace libtorrent
 			return utp_incoming_packet(m_last_socket, p, size, ep, receive_time);
 		}
 
-		std::pair<socket_map_t::iterator, socket_map_t::iterator> r =
-			m_utp_sockets.equal_range(id);
-
-		for (; r.first != r.second; ++r.first)
+		utp_socket_impl* s = m_utp_sockets.find(ep, id);
+		if (s)
 		{
-			if (!utp_match(r.first->second, ep, id)) continue;
-			bool ret = utp_incoming_packet(r.first->second, p, size, ep, receive_time);
-			if (ret) m_last_socket = r.first->second;
+			TORRENT_ASSERT(utp_match(s, ep, id));
+			bool ret = utp_incoming_packet(s, p, size, ep, receive_time);
+			if (ret) m_last_socket = s;
 			return ret;
 		}
 
@@ -419,13 +442,61 @@ namespace libtorrent
 		m_drained_event.push_back(s);
 	}
 
-	void utp_socket_manager::remove_socket(boost::uint16_t id)
+	void utp_socket_manager::pace(utp_socket_impl* s, ptime when)
+	{
+		TORRENT_ASSERT(std::find(m_paced_sockets.begin(), m_paced_sockets.end(), s)
+			== m_paced_sockets.end());
+		m_paced_sockets.push_back(s);
+
+		if (when >= m_pacing_deadline) return;
+		m_pacing_deadline = when;
+		error_code ec;
+		m_pacing_timer->timer.expires_at(when, ec);
+		m_pacing_timer->timer.async_wait(boost::bind(&utp_socket_manager::on_pacing_timer
+			, m_pacing_timer, _1));
+	}
+
+	void utp_socket_manager::cancel_pacing(utp_socket_impl* s)
+	{
+		std::vector<utp_socket_impl*>::iterator i = std::find(
+			m_paced_sockets.begin(), m_paced_sockets.end(), s);
+		TORRENT_ASSERT(i != m_paced_sockets.end());
+		if (i != m_paced_sockets.end()) m_paced_sockets.erase(i);
+	}
+
+	void utp_socket_manager::on_pacing_timer(boost::intrusive_ptr<utp_pacing_timer> t
+		, error_code const& ec)
+	{
+		// operation_aborted means the timer was moved to an earlier time,
+		// or the manager is gone
+		if (ec || t->manager == 0) return;
+		t->manager->wake_paced_sockets();
+	}
+
+	void utp_socket_manager::wake_paced_sockets()
+	{
+		m_pacing_deadline = max_time();
+
+		// all paced sockets get a chance to send. The ones that still
+		// have to wait will subscribe again, with a later deadline
+		std::vector<utp_socket_impl*> paced;
+		m_paced_sockets.swap(paced);
+		m_sock.cork();
+		for (std::vector<utp_socket_impl*>::iterator i = paced.begin()
+			, end(paced.end()); i != end; ++i)
+		{
+			utp_paced(*i);
+		}
+		m_sock.uncork();
+	}
+
+	void utp_socket_manager::rekey_socket(utp_socket_impl* s, udp::endpoint const& old_ep)
 	{
-		socket_map_t::iterator i = m_utp_sockets.find(id);
-		if (i == m_utp_sockets.end()) return;
-		delete_utp_impl(i->second);
-		if (m_last_socket == i->second) m_last_socket = 0;
-		m_utp_sockets.erase(i);
+		boost::uint16_t id = utp_receive_id(s);
+		bool found = m_utp_sockets.erase(old_ep, id, s);
+		TORRENT_ASSERT(found);
+		(void)found;
+		m_utp_sockets.insert(utp_remote_endpoint(s), id, s);
 	}
 	
 	void utp_socket_manager::set_sock_buf(int size)
@@ -472,7 +543,7 @@ namespace libtorrent
 			recv_id = send_id - 1;
 		}
 		utp_socket_impl* impl = construct_utp_impl(recv_id, send_id, str, this);
-		m_utp_sockets.insert(std::make_pair(recv_id, impl));
+		m_utp_sockets.insert(utp_remote_endpoint(impl), recv_id, impl);
 		return impl;
 	}
 }
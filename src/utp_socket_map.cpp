@@ -0,0 +1,141 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/utp_socket_map.hpp"
+#include "libtorrent/assert.hpp"
+
+namespace libtorrent
+{
+	utp_socket_map::utp_socket_map()
+		: m_slots(16)
+		, m_size(0)
+	{}
+
+	boost::uint32_t utp_socket_map::hash(udp::endpoint const& ep, boost::uint16_t id)
+	{
+		boost::uint32_t h = id;
+		h = h * 0x9e3779b1 ^ ep.port();
+		// hash the raw socket address, to avoid constructing
+		// an address object for every incoming packet
+#if TORRENT_USE_IPV6
+		if (ep.protocol() == udp::v6())
+		{
+			boost::uint32_t const* a = reinterpret_cast<boost::uint32_t const*>(
+				&reinterpret_cast<sockaddr_in6 const*>(ep.data())->sin6_addr);
+			for (int i = 0; i < 4; ++i)
+				h = h * 0x9e3779b1 ^ a[i];
+		}
+		else
+#endif
+		{
+			h = h * 0x9e3779b1 ^ boost::uint32_t(
+				reinterpret_cast<sockaddr_in const*>(ep.data())->sin_addr.s_addr);
+		}
+		// mix the high bits into the low bits, which are
+		// the ones used to pick the slot
+		h ^= h >> 16;
+		h *= 0x85ebca6b;
+		h ^= h >> 13;
+		return h;
+	}
+
+	utp_socket_impl* utp_socket_map::find(udp::endpoint const& ep, boost::uint16_t id) const
+	{
+		int const mask = m_slots.size() - 1;
+		for (int i = hash(ep, id) & mask;; i = (i + 1) & mask)
+		{
+			slot const& s = m_slots[i];
+			if (s.sock == 0) return 0;
+			if (s.id == id && s.ep == ep) return s.sock;
+		}
+	}
+
+	void utp_socket_map::insert(udp::endpoint const& ep, boost::uint16_t id, utp_socket_impl* s)
+	{
+		TORRENT_ASSERT(s);
+		// keep the load factor at or below 1/2
+		if ((m_size + 1) * 2 > int(m_slots.size())) grow();
+
+		int const mask = m_slots.size() - 1;
+		int i = hash(ep, id) & mask;
+		while (m_slots[i].sock) i = (i + 1) & mask;
+		m_slots[i].ep = ep;
+		m_slots[i].id = id;
+		m_slots[i].sock = s;
+		++m_size;
+	}
+
+	bool utp_socket_map::erase(udp::endpoint const& ep, boost::uint16_t id, utp_socket_impl* s)
+	{
+		int const mask = m_slots.size() - 1;
+		int i = hash(ep, id) & mask;
+		for (;; i = (i + 1) & mask)
+		{
+			if (m_slots[i].sock == 0) return false;
+			if (m_slots[i].sock == s) break;
+		}
+		TORRENT_ASSERT(m_slots[i].id == id && m_slots[i].ep == ep);
+
+		// shift the following entries in the probe sequence back into
+		// the hole, so that lookups never have to skip deleted slots
+		int hole = i;
+		for (int j = (i + 1) & mask; m_slots[j].sock; j = (j + 1) & mask)
+		{
+			int home = hash(m_slots[j].ep, m_slots[j].id) & mask;
+			// can the entry at j be moved to the hole? Only if its home
+			// slot is not in the (cyclic) range (hole, j]
+			bool const in_range = hole <= j
+				? (home > hole && home <= j)
+				: (home > hole || home <= j);
+			if (in_range) continue;
+			m_slots[hole] = m_slots[j];
+			hole = j;
+		}
+		m_slots[hole] = slot();
+		--m_size;
+		return true;
+	}
+
+	void utp_socket_map::grow()
+	{
+		std::vector<slot> old;
+		old.swap(m_slots);
+		m_slots.resize(old.size() * 2);
+		m_size = 0;
+		for (std::vector<slot>::iterator i = old.begin(), end(old.end()); i != end; ++i)
+		{
+			if (i->sock == 0) continue;
+			insert(i->ep, i->id, i->sock);
+		}
+	}
+}
+
@@ -34,6 +34,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/utp_stream.hpp"
 #include "libtorrent/sliding_average.hpp"
 #include "libtorrent/utp_socket_manager.hpp"
+#include "libtorrent/packet_pool.hpp"
+#include "libtorrent/timer_wheel.hpp"
 #include "libtorrent/alloca.hpp"
 #include "libtorrent/timestamp_history.hpp"
 #include "libtorrent/error.hpp"
@@ -135,44 +137,6 @@ TORRENT_EXTRA_EXPORT bool compare_less_wrap(boost::uint32_t lhs, boost::uint32_t
 	return dist_up < dist_down;
 }
 
-// used for out-of-order incoming packets
-// as well as sent packets that are waiting to be ACKed
-struct packet
-{
-	// the last time this packet was sent
-	ptime send_time;
-
-	// the number of bytes actually allocated in 'buf'
-	boost::uint16_t allocated;
-
-	// the size of the buffer 'buf' points to
-	boost::uint16_t size;
-
-	// this is the offset to the payload inside the buffer
-	// this is also used as a cursor to describe where the
-	// next payload that hasn't been consumed yet starts
-	boost::uint16_t header_size;
-	
-	// the number of times this packet has been sent
-	boost::uint8_t num_transmissions:6;
-
-	// true if we need to send this packet again. All
-	// outstanding packets are marked as needing to be
-	// resent on timeouts
-	bool need_resend:1;
-
-	// this is set to true for packets that were
-	// sent with the DF bit set (Don't Fragment)
-	bool mtu_probe:1;
-
-#ifdef TORRENT_DEBUG
-	int num_fast_resend;
-#endif
-
-	// the actual packet buffer
-	boost::uint8_t buf[];
-};
-
 // since the uTP socket state may be needed after the
 // utp_stream is closed, it's kept in a separate struct
 // whose lifetime is not tied to the lifetime of utp_stream
@@ -233,7 +197,10 @@ struct utp_socket_impl
 		, m_connect_handler(0)
 		, m_remote_address()
 		, m_timeout(time_now_hires() + milliseconds(m_sm->connect_timeout()))
+		, m_timer(this)
+		, m_rack_send_time(min_time())
 		, m_last_history_step(time_now_hires())
+		, m_pacer(time_now_hires())
 		, m_cwnd(TORRENT_ETHERNET_MTU << 16)
 		, m_buffered_incoming_bytes(0)
 		, m_reply_micro(0)
@@ -274,16 +241,21 @@ struct utp_socket_impl
 		, m_deferred_ack(false)
 		, m_subscribe_drained(false)
 		, m_stalled(false)
+		, m_paced(false)
 	{
 		TORRENT_ASSERT(m_userdata);
 		for (int i = 0; i != num_delay_hist; ++i)
 			m_delay_sample_hist[i] = UINT_MAX;
+		m_sm->schedule_timer(&m_timer, m_timeout);
 	}
 
 	~utp_socket_impl();
 
 	void tick(ptime const& now);
+	void schedule_tick(ptime const& now);
+	void set_timeout(ptime const& t);
 	void init_mtu(int link_mtu, int utp_mtu);
+	void set_remote_endpoint(udp::endpoint const& ep);
 	bool incoming_packet(boost::uint8_t const* buf, int size
 		, udp::endpoint const& ep, ptime receive_time);
 	void writable();
@@ -331,6 +303,10 @@ struct utp_socket_impl
 		utp_header const* ph, boost::uint8_t const* ptr, int payload_size, ptime now);
 	void update_mtu_limits();
 	void experienced_loss(int seq_nr);
+	void detect_lost_packets();
+	boost::int64_t pacing_rate() const;
+	bool pacing_allows(int bytes);
+	void use_pacing_tokens(int bytes);
 
 	void check_receive_buffers() const;
 
@@ -423,10 +399,23 @@ struct utp_socket_impl
 	// it can also happen if the other end sends an advertized window
 	// size less than one MSS.
 	ptime m_timeout;
+
+	// our entry in the socket manager's timer wheel. It's scheduled
+	// to expire no later than m_timeout. When it expires, tick() is
+	// called
+	timer_wheel_entry m_timer;
+
+	// the send time of the most recently sent packet that has been
+	// ACKed. Any packet still in flight that was sent sufficiently long
+	// before this is considered lost (RACK)
+	ptime m_rack_send_time;
 	
 	// the last time we stepped the timestamp history
 	ptime m_last_history_step;
 
+	// spreads the packets we send out over the round-trip time
+	utp_pacer m_pacer;
+
 	// the max number of bytes in-flight. This is a fixed point
 	// value, to get the true number of bytes, shift right 16 bits
 	// the value is always >= 0, but the calculations performed on
@@ -637,6 +626,10 @@ struct utp_socket_impl
 	// of sockets in the utp_socket_manager to be notified of
 	// the socket being writable again
 	bool m_stalled:1;
+
+	// this is true while the socket is waiting for the pacing
+	// timer in the utp socket manager, to send more packets
+	bool m_paced:1;
 };
 
 #if defined TORRENT_VERBOSE_LOGGING || defined TORRENT_LOGGING || defined TORRENT_ERROR_LOGGING
@@ -668,6 +661,7 @@ bool should_delete(utp_socket_impl* s)
 void tick_utp_impl(utp_socket_impl* s, ptime const& now)
 {
 	s->tick(now);
+	s->schedule_tick(now);
 }
 
 void utp_init_mtu(utp_socket_impl* s, int link_mtu, int utp_mtu)
@@ -705,6 +699,13 @@ void utp_writable(utp_socket_impl* s)
 	s->writable();
 }
 
+void utp_paced(utp_socket_impl* s)
+{
+	TORRENT_ASSERT(s->m_paced);
+	s->m_paced = false;
+	s->writable();
+}
+
 void utp_send_ack(utp_socket_impl* s)
 {
 	TORRENT_ASSERT(s->m_deferred_ack);
@@ -1008,7 +1009,7 @@ size_t utp_stream::read_some(bool clear_buffers)
 		// Consumed entire packet
 		if (p->header_size == p->size)
 		{
-			free(p);
+			m_impl->m_sm->release_packet(p);
 			++pop_packets;
 			*i = 0;
 			++i;
@@ -1072,8 +1073,7 @@ void utp_stream::do_connect(tcp::endpoint const& ep, utp_stream::connect_handler
 	m_impl->m_sm->mtu_for_dest(ep.address(), link_mtu, utp_mtu);
 	m_impl->init_mtu(link_mtu, utp_mtu);
 	TORRENT_ASSERT(m_impl->m_connect_handler == 0);
-	m_impl->m_remote_address = ep.address();
-	m_impl->m_port = ep.port();
+	m_impl->set_remote_endpoint(udp::endpoint(ep.address(), ep.port()));
 	m_impl->m_connect_handler = handler;
 
 	error_code ec;
@@ -1094,29 +1094,32 @@ utp_socket_impl::~utp_socket_impl()
 
 	UTP_LOGV("%8p: destroying utp socket state\n", this);
 
+	m_sm->cancel_timer(&m_timer);
+	if (m_paced) m_sm->cancel_pacing(this);
+
 	// free any buffers we're holding
 	for (boost::uint16_t i = m_inbuf.cursor(), end((m_inbuf.cursor()
 		+ m_inbuf.capacity()) & ACK_MASK);
 		i != end; i = (i + 1) & ACK_MASK)
 	{
-		void* p = m_inbuf.remove(i);
-		free(p);
+		packet* p = (packet*)m_inbuf.remove(i);
+		m_sm->release_packet(p);
 	}
 	for (boost::uint16_t i = m_outbuf.cursor(), end((m_outbuf.cursor()
 		+ m_outbuf.capacity()) & ACK_MASK);
 		i != end; i = (i + 1) & ACK_MASK)
 	{
-		void* p = m_outbuf.remove(i);
-		free(p);
+		packet* p = (packet*)m_outbuf.remove(i);
+		m_sm->release_packet(p);
 	}
 
 	for (std::vector<packet*>::iterator i = m_receive_buffer.begin()
 		, end = m_receive_buffer.end(); i != end; ++i)
 	{
-		free(*i);
+		m_sm->release_packet(*i);
 	}
 
-	free(m_nagle_packet);
+	m_sm->release_packet(m_nagle_packet);
 	m_nagle_packet = NULL;
 }
 
@@ -1221,6 +1224,10 @@ void utp_socket_impl::detach()
 
 	UTP_LOGV("%8p: detach()\n", this);
 	m_attached = false;
+
+	// make sure the socket manager gets a chance to
+	// delete this socket on the next tick
+	m_sm->schedule_timer(&m_timer, min_time());
 }
 
 void utp_socket_impl::send_syn()
@@ -1233,7 +1240,7 @@ void utp_socket_impl::send_syn()
 	m_ack_nr = 0;
 	m_fast_resend_seq_nr = m_seq_nr;
 
-	packet* p = (packet*)malloc(sizeof(packet) + sizeof(utp_header));
+	packet* p = m_sm->acquire_packet(sizeof(utp_header));
 	p->size = sizeof(utp_header);
 	p->header_size = sizeof(utp_header);
 	p->num_transmissions = 0;
@@ -1281,7 +1288,7 @@ void utp_socket_impl::send_syn()
 	}
 	else if (ec)
 	{
-		free(p);
+		m_sm->release_packet(p);
 		m_error = ec;
 		m_state = UTP_STATE_ERROR_WAIT;
 		test_socket_state();
@@ -1398,50 +1405,47 @@ void utp_socket_impl::parse_sack(boost::uint16_t packet_ack, boost::uint8_t cons
 	// the sequence number of the last ACKed packet
 	int last_ack = packet_ack;
 
-	// for each byte
-	for (boost::uint8_t const* end = ptr + size; ptr != end; ++ptr)
+	// for each byte. Only the set bits are visited, and bits past the
+	// last packet we've sent are masked off, since there's nothing for
+	// them to acknowledge
+	for (boost::uint8_t const* end = ptr + size; ptr != end
+		&& compare_less_wrap(ack_nr, m_seq_nr, ACK_MASK); ++ptr)
 	{
-		unsigned char bitfield = unsigned(*ptr);
-		unsigned char mask = 1;
-		// for each bit
-		for (int i = 0; i < 8; ++i)
+		int const left = (m_seq_nr - ack_nr) & ACK_MASK;
+		unsigned int bitfield = *ptr;
+		if (left < 8) bitfield &= (1 << left) - 1;
+
+		while (bitfield)
 		{
-			if (mask & bitfield)
-			{
-				last_ack = ack_nr;
-				if (m_fast_resend_seq_nr == ack_nr)
-					m_fast_resend_seq_nr = (m_fast_resend_seq_nr + 1) & ACK_MASK;
-
-				if (compare_less_wrap(m_fast_resend_seq_nr, ack_nr, ACK_MASK)) ++dups;
-				// this bit was set, ack_nr was received
-				packet* p = (packet*)m_outbuf.remove(ack_nr);
-				if (p)
-				{
-					*acked_bytes += p->size - p->header_size;
-					// each ACKed packet counts as a duplicate ack
-					UTP_LOGV("%8p: duplicate_acks:%u fast_resend_seq_nr:%u\n"
-						, this, m_duplicate_acks, m_fast_resend_seq_nr);
-					ack_packet(p, now, min_rtt, ack_nr);
-				}
-				else
-				{
-					// this packet might have been acked by a previous
-					// selective ack
-					maybe_inc_acked_seq_nr();
-				}
-			}
+			int i = 0;
+			while ((bitfield & (1 << i)) == 0) ++i;
+			bitfield &= bitfield - 1;
+
+			// this bit was set, seq_nr was received
+			int const seq_nr = (ack_nr + i) & ACK_MASK;
+			last_ack = seq_nr;
+			if (m_fast_resend_seq_nr == seq_nr)
+				m_fast_resend_seq_nr = (m_fast_resend_seq_nr + 1) & ACK_MASK;
 
-			mask <<= 1;
-			ack_nr = (ack_nr + 1) & ACK_MASK;
+			if (compare_less_wrap(m_fast_resend_seq_nr, seq_nr, ACK_MASK)) ++dups;
 
-			// we haven't sent packets past this point.
-			// if there are any more bits set, we have to
-			// ignore them anyway
-			if (ack_nr == m_seq_nr) break;
+			// if the packet isn't in the send buffer, it was
+			// acked by a previous selective ack
+			packet* p = (packet*)m_outbuf.remove(seq_nr);
+			if (!p) continue;
+
+			*acked_bytes += p->size - p->header_size;
+			// each ACKed packet counts as a duplicate ack
+			UTP_LOGV("%8p: duplicate_acks:%u fast_resend_seq_nr:%u\n"
+				, this, m_duplicate_acks, m_fast_resend_seq_nr);
+			ack_packet(p, now, min_rtt, seq_nr);
 		}
-		if (ack_nr == m_seq_nr) break;
+
+		ack_nr = (ack_nr + 8) & ACK_MASK;
 	}
 
+	maybe_inc_acked_seq_nr();
+
 	TORRENT_ASSERT(m_outbuf.at((m_acked_seq_nr + 1) & ACK_MASK) || ((m_seq_nr - m_acked_seq_nr) & ACK_MASK) <= 1);
 
 	// we received more than dup_ack_limit ACKs in this SACK message.
@@ -1564,27 +1568,30 @@ void utp_socket_impl::remove_sack_header(packet* p)
 	p->size -= sack_size + 2;
 }
 
-struct holder
+// returns the packet to the pool when it goes out of
+// scope, unless release() was called
+struct packet_holder
 {
-	holder(char* buf = NULL): m_buf(buf) {}
-	~holder() { free(m_buf); }
+	packet_holder(utp_socket_manager* sm): m_sm(sm), m_packet(NULL) {}
+	~packet_holder() { m_sm->release_packet(m_packet); }
 
-	void reset(char* buf)
+	void reset(packet* p)
 	{
-		free(m_buf);
-		m_buf = buf;
+		m_sm->release_packet(m_packet);
+		m_packet = p;
 	}
 
-	char* release()
+	packet* release()
 	{
-		char* ret = m_buf;
-		m_buf = NULL;
+		packet* ret = m_packet;
+		m_packet = NULL;
 		return ret;
 	}
 
 private:
 
-	char* m_buf;
+	utp_socket_manager* m_sm;
+	packet* m_packet;
 };
 
 // sends a packet, pulls data from the write buffer (if there's any)
@@ -1675,6 +1682,17 @@ bool utp_socket_impl::send_pkt(int flags)
 		}
 	}
 
+	// spread the packets out over the round-trip time, rather than
+	// sending the whole congestion window in one burst. The tokens are
+	// only used up once we know Nagle doesn't hold the packet back
+	bool paced = payload_size > 0 && (flags & pkt_fin) == 0;
+	if (paced && !pacing_allows(header_size + payload_size))
+	{
+		paced = false;
+		payload_size = 0;
+		if (!force) return false;
+	}
+
 	// if we don't have any data to send, or can't send any data
 	// and we don't have any data to force, don't send a packet
 	if (payload_size == 0 && !force && !m_nagle_packet)
@@ -1703,7 +1721,7 @@ bool utp_socket_impl::send_pkt(int flags)
 
 	// used to free the packet buffer in case we exit the
 	// function early
-	holder buf_holder;
+	packet_holder buf_holder(m_sm);
 
 	// payload size being zero means we're just sending
 	// an force. We should not pick up the nagle packet
@@ -1713,9 +1731,8 @@ bool utp_socket_impl::send_pkt(int flags)
 		// need to keep the packet around (in the outbuf)
 		if (payload_size) 
 		{
-			p = (packet*)malloc(sizeof(packet) + m_mtu);
-			p->allocated = m_mtu;
-			buf_holder.reset((char*)p);
+			p = m_sm->acquire_packet(m_mtu);
+			buf_holder.reset(p);
 
 			m_sm->inc_stats_counter(utp_socket_manager::payload_pkts_out);
 		}
@@ -1840,6 +1857,8 @@ bool utp_socket_impl::send_pkt(int flags)
 		return false;
 	}
 
+	if (paced) use_pacing_tokens(p->size);
+
 	// MTU DISCOVERY
 	if (m_mtu_seq == 0
 		&& p->size > m_mtu_floor
@@ -1965,7 +1984,7 @@ bool utp_socket_impl::send_pkt(int flags)
 		{
 			TORRENT_ASSERT(((utp_header*)old->buf)->seq_nr == m_seq_nr);
 			if (!old->need_resend) m_bytes_in_flight -= old->size - old->header_size;
-			free(old);
+			m_sm->release_packet(old);
 		}
 		TORRENT_ASSERT(h->seq_nr == m_seq_nr);
 		m_seq_nr = (m_seq_nr + 1) & ACK_MASK;
@@ -2151,6 +2170,115 @@ void utp_socket_impl::experienced_loss(int seq_nr)
 	m_sm->inc_stats_counter(utp_socket_manager::packet_loss);
 }
 
+// the rate is a bit higher than cwnd / rtt, to let the window
+// grow. In slow-start it has to be able to double every RTT
+boost::int64_t utp_pacer::rate(int cwnd, int rtt, bool slow_start)
+{
+	// without an RTT estimate, we don't know what rate to pace at
+	if (rtt <= 0 || cwnd <= 0) return 0;
+	return boost::int64_t(cwnd) * (slow_start ? 2000 : 1250) / rtt;
+}
+
+int utp_pacer::wait(int bytes, boost::int64_t rate, int mtu, ptime now)
+{
+	if (rate <= 0) return 0;
+
+	// allow bursts of two packets, or 2 milliseconds worth of
+	// data at high rates, to not need a timer for every packet
+	boost::int64_t const burst = (std::max)(boost::int64_t(mtu) * 2, rate / 500);
+
+	boost::int64_t const elapsed = (std::min)(total_microseconds(now - m_last_update)
+		, boost::int64_t(1000000));
+	if (elapsed > 0)
+	{
+		m_last_update = now;
+		m_tokens = (std::min)(burst, m_tokens + rate * elapsed / 1000000);
+	}
+
+	if (m_tokens >= bytes) return 0;
+	return int((bytes - m_tokens) * 1000000 / rate + 1);
+}
+
+// returns the pacing rate in bytes per second, or 0 if packets aren't
+// paced
+boost::int64_t utp_socket_impl::pacing_rate() const
+{
+	if (!m_sm->pacing()) return 0;
+	return utp_pacer::rate(int(m_cwnd >> 16), m_rtt.mean(), m_slow_start);
+}
+
+// returns true if a packet of the specified size may be sent now. If
+// not, the socket is woken up by the socket manager once enough tokens
+// have accumulated. The tokens are taken by use_pacing_tokens() when
+// the packet is actually sent
+bool utp_socket_impl::pacing_allows(int bytes)
+{
+	boost::int64_t const rate = pacing_rate();
+	if (rate == 0) return true;
+
+	ptime const now = time_now_hires();
+	int const wait = m_pacer.wait(bytes, rate, m_mtu, now);
+	if (wait == 0) return true;
+
+	if (!m_paced)
+	{
+		UTP_LOGV("%8p: pacing, waiting %d us\n", this, wait);
+		m_sm->inc_stats_counter(utp_socket_manager::paced_packets);
+		m_paced = true;
+		m_sm->pace(this, now + microsec(wait));
+	}
+	return false;
+}
+
+void utp_socket_impl::use_pacing_tokens(int bytes)
+{
+	if (pacing_rate() == 0) return;
+	m_pacer.use(bytes);
+}
+
+// RACK style loss detection. A packet is considered lost once a
+// packet sent after it (by more than a reordering window) has been
+// acked. Unlike counting duplicate ACKs, this also detects loss of
+// re-sent packets and loss at the tail of a burst
+void utp_socket_impl::detect_lost_packets()
+{
+	INVARIANT_CHECK;
+
+	if (m_rack_send_time == min_time()) return;
+
+	// allow for some reordering, a quarter of the round-trip time
+	time_duration const reorder_window = microsec(m_rtt.mean() * 1000 / 4);
+	ptime const lost_before = m_rack_send_time - reorder_window;
+
+	int num_resent = 0;
+	for (int i = (m_acked_seq_nr + 1) & ACK_MASK; i != m_seq_nr; i = (i + 1) & ACK_MASK)
+	{
+		packet* p = (packet*)m_outbuf.at(i);
+		if (!p || p->need_resend || p->num_transmissions == 0) continue;
+
+		if (p->send_time >= lost_before)
+		{
+			// packets are sent in sequence number order. Any packet past
+			// one that was only sent once was sent later than it, and
+			// can't be lost either. Re-sent packets have a later
+			// send time than their sequence number suggests
+			if (p->num_transmissions == 1) break;
+			continue;
+		}
+
+		// the timeout will take care of giving up on this packet
+		if (p->num_transmissions >= m_sm->num_resends()) continue;
+
+		UTP_LOGV("%8p: Packet %d lost (RACK).\n", this, i);
+		experienced_loss(i);
+		if (m_fast_resend_seq_nr == i)
+			m_fast_resend_seq_nr = (m_fast_resend_seq_nr + 1) & ACK_MASK;
+		if (!resend_packet(p, true)) break;
+		m_duplicate_acks = 0;
+		if (++num_resent >= sack_resend_limit) break;
+	}
+}
+
 void utp_socket_impl::maybe_inc_acked_seq_nr()
 {
 	INVARIANT_CHECK;
@@ -2226,7 +2354,15 @@ void utp_socket_impl::ack_packet(packet* p, ptime const& receive_time
 
 	m_rtt.add_sample(rtt / 1000);
 	if (rtt < min_rtt) min_rtt = rtt;
-	free(p);
+
+	// if a re-sent packet is ACKed sooner than could be expected, the
+	// ACK is most likely for the original transmission. Then we don't
+	// know when the packet that was received was sent
+	if (p->send_time > m_rack_send_time
+		&& (p->num_transmissions <= 1 || int(rtt / 1000) >= m_rtt.mean() / 2))
+		m_rack_send_time = p->send_time;
+
+	m_sm->release_packet(p);
 }
 
 void utp_socket_impl::incoming(boost::uint8_t const* buf, int size, packet* p, ptime now)
@@ -2262,7 +2398,7 @@ void utp_socket_impl::incoming(boost::uint8_t const* buf, int size, packet* p, p
 		if (size == 0)
 		{
 			TORRENT_ASSERT(p == 0 || p->header_size == p->size);
-			free(p);
+			m_sm->release_packet(p);
 			return;
 		}
 	}
@@ -2272,7 +2408,7 @@ void utp_socket_impl::incoming(boost::uint8_t const* buf, int size, packet* p, p
 	if (!p)
 	{
 		TORRENT_ASSERT(buf);
-		p = (packet*)malloc(sizeof(packet) + size);
+		p = m_sm->acquire_packet(size);
 		p->size = size;
 		p->header_size = 0;
 		memcpy(p->buf, buf, size);
@@ -2400,7 +2536,7 @@ bool utp_socket_impl::consume_incoming_data(
 		}
 
 		// we don't need to save the packet header, just the payload
-		packet* p = (packet*)malloc(sizeof(packet) + payload_size);
+		packet* p = m_sm->acquire_packet(payload_size);
 		p->size = payload_size;
 		p->header_size = 0;
 		p->num_transmissions = 0;
@@ -2449,6 +2585,17 @@ bool utp_socket_impl::test_socket_state()
 	return false;
 }
 
+void utp_socket_impl::set_remote_endpoint(udp::endpoint const& ep)
+{
+	udp::endpoint old_ep(m_remote_address, m_port);
+	if (old_ep == ep) return;
+	m_remote_address = ep.address();
+	m_port = ep.port();
+	// the socket manager looks sockets up by remote endpoint,
+	// it needs to move this socket to its new key
+	m_sm->rekey_socket(this, old_ep);
+}
+
 void utp_socket_impl::init_mtu(int link_mtu, int utp_mtu)
 {
 	INVARIANT_CHECK;
@@ -2526,10 +2673,7 @@ bool utp_socket_impl::incoming_packet(boost::uint8_t const* buf, int size
 	}
 
 	if (m_state == UTP_STATE_NONE && ph->get_type() == ST_SYN)
-	{
-		m_remote_address = ep.address();
-		m_port = ep.port();
-	}
+		set_remote_endpoint(ep);
 
 	if (m_state != UTP_STATE_NONE && ph->get_type() == ST_SYN)
 	{
@@ -2671,7 +2815,7 @@ bool utp_socket_impl::incoming_packet(boost::uint8_t const* buf, int size
 
 	// this is a valid incoming packet, update the timeout timer
 	m_num_timeouts = 0;
-	m_timeout = receive_time + milliseconds(packet_timeout());
+	set_timeout(receive_time + milliseconds(packet_timeout()));
 	UTP_LOGV("%8p: updating timeout to: now + %d\n"
 		, this, packet_timeout());
 
@@ -2778,6 +2922,12 @@ bool utp_socket_impl::incoming_packet(boost::uint8_t const* buf, int size
 	// state, in which case we shouldn't continue
 	if (m_state == UTP_STATE_ERROR_WAIT || m_state == UTP_STATE_DELETE) return true;
 
+	if (acked_bytes > 0 && m_state != UTP_STATE_NONE)
+	{
+		detect_lost_packets();
+		if (m_state == UTP_STATE_ERROR_WAIT || m_state == UTP_STATE_DELETE) return true;
+	}
+
 	if (m_duplicate_acks >= dup_ack_limit
 		&& ((m_acked_seq_nr + 1) & ACK_MASK) == m_fast_resend_seq_nr)
 	{
@@ -2865,8 +3015,7 @@ bool utp_socket_impl::incoming_packet(boost::uint8_t const* buf, int size
 				// we accept are SYN packets.
 				m_state = UTP_STATE_CONNECTED;
 
-				m_remote_address = ep.address();
-				m_port = ep.port();
+				set_remote_endpoint(ep);
 
 				error_code ec;
 				m_local_address = m_sm->local_endpoint(m_remote_address, ec).address();
@@ -3290,6 +3439,28 @@ int utp_socket_impl::packet_timeout() const
 	return timeout;
 }
 
+void utp_socket_impl::set_timeout(ptime const& t)
+{
+	m_timeout = t;
+
+	// if the timer is already set to expire before the new timeout,
+	// leave it. When it expires, tick() will see that we haven't
+	// timed out yet, and schedule it again. This keeps the common case
+	// of pushing the timeout forward on every incoming packet cheap
+	if (m_timer.scheduled() && m_timer.expires <= t) return;
+	m_sm->schedule_timer(&m_timer, t);
+}
+
+void utp_socket_impl::schedule_tick(ptime const& now)
+{
+	// a detached socket is ticked every time, until the
+	// socket manager finds that it can be deleted
+	if (!m_attached || m_timeout <= now)
+		m_sm->schedule_timer(&m_timer, now);
+	else
+		m_sm->schedule_timer(&m_timer, m_timeout);
+}
+
 void utp_socket_impl::tick(ptime const& now)
 {
 	INVARIANT_CHECK;
@@ -3352,7 +3523,7 @@ void utp_socket_impl::tick(ptime const& now)
 
 		TORRENT_ASSERT(m_cwnd >= 0);
 
-		m_timeout = now + milliseconds(packet_timeout());
+		set_timeout(now + milliseconds(packet_timeout()));
 	
 		UTP_LOGV("%8p: timeout resetting cwnd:%d\n"
 			, this, int(m_cwnd >> 16));
@@ -60,8 +60,9 @@ namespace libtorrent
 		, boost::weak_ptr<torrent> t
 		, boost::shared_ptr<socket_type> s
 		, tcp::endpoint const& remote
-		, web_seed_entry& web)
-		: peer_connection(ses, t, s, remote, &web.peer_info)
+		, web_seed_entry& web
+		, policy::peer* peerinfo)
+		: peer_connection(ses, t, s, remote, peerinfo)
 		, m_parser(http_parser::dont_parse_chunks)
 		, m_external_auth(web.auth)
 		, m_extra_headers(web.extra_headers)
@@ -65,8 +65,9 @@ namespace libtorrent
 		, boost::weak_ptr<torrent> t
 		, boost::shared_ptr<socket_type> s
 		, tcp::endpoint const& remote
-		, web_seed_entry& web)
-		: web_connection_base(ses, t, s, remote, web)
+		, web_seed_entry& web
+		, policy::peer* peerinfo)
+		: web_connection_base(ses, t, s, remote, web, peerinfo)
 		, m_url(web.url)
 		, m_web(web)
 		, m_received_body(0)
@@ -75,6 +76,7 @@ namespace libtorrent
 		, m_chunk_pos(0)
 		, m_partial_chunk_header(0)
 		, m_num_responses(0)
+		, m_outstanding_requests(0)
 	{
 		INVARIANT_CHECK;
 
@@ -183,9 +185,6 @@ namespace libtorrent
 		}
 
 		torrent_info const& info = t->torrent_file();
-		
-		std::string request;
-		request.reserve(400);
 
 		int size = r.length;
 		const int block_size = t->block_size();
@@ -201,25 +200,10 @@ namespace libtorrent
 			size -= pr.length;
 		}
 
-		proxy_settings const& ps = m_ses.proxy();
-		bool using_proxy = (ps.type == proxy_settings::http
-			|| ps.type == proxy_settings::http_pw) && !m_ssl;
-
 		if (single_file_request)
 		{
-			request += "GET ";
-			// do not encode single file paths, they are 
-			// assumed to be encoded in the torrent file
-			request += using_proxy ? m_url : m_path;
-			request += " HTTP/1.1\r\n";
-			add_headers(request, ps, using_proxy);
-			request += "\r\nRange: bytes=";
-			request += to_string(size_type(r.piece) * info.piece_length() + r.start).elems;
-			request += "-";
-			request += to_string(size_type(r.piece) * info.piece_length() + r.start + r.length - 1).elems;
-			request += "\r\n\r\n";
-			m_first_request = false;
-			m_file_requests.push_back(0);
+			queue_request(0, size_type(r.piece) * info.piece_length() + r.start
+				, r.length);
 		}
 		else
 		{
@@ -235,49 +219,107 @@ namespace libtorrent
 					m_file_requests.push_back(f.file_index);
 					continue;
 				}
+				TORRENT_ASSERT(f.file_index >= 0);
+				queue_request(f.file_index, f.offset, f.size);
+			}
+		}
 
-				request += "GET ";
-				if (using_proxy)
-				{
-					// m_url is already a properly escaped URL
-					// with the correct slashes. Don't encode it again
-					request += m_url;
-					std::string path = info.orig_files().file_path(f.file_index);
-#ifdef TORRENT_WINDOWS
-					convert_path_to_posix(path);
-#endif
-					request += escape_path(path.c_str(), path.length());
-				}
-				else
-				{
-					// m_path is already a properly escaped URL
-					// with the correct slashes. Don't encode it again
-					request += m_path;
+		send_pending_requests();
+	}
+
+	void web_peer_connection::queue_request(int file_index, size_type start
+		, size_type length)
+	{
+		// the block requests are issued in order, so a request for the
+		// continuation of a file that's still waiting in the queue can be
+		// merged into it. That saves a round-trip and a response header.
+		// m_file_requests.back() is different if a pad file was queued
+		// in between
+		if (!m_pending_requests.empty())
+		{
+			pending_request& last = m_pending_requests.back();
+			if (last.file_index == file_index
+				&& last.start + last.length == start
+				&& m_file_requests.back() == file_index)
+			{
+				last.length += length;
+				return;
+			}
+		}
+
+		pending_request req;
+		req.file_index = file_index;
+		req.start = start;
+		req.length = length;
+		m_pending_requests.push_back(req);
+		m_file_requests.push_back(file_index);
+	}
+
+	bool web_peer_connection::send_pending_requests()
+	{
+		if (m_pending_requests.empty()) return false;
+
+		boost::shared_ptr<torrent> t = associated_torrent().lock();
+		TORRENT_ASSERT(t);
+		torrent_info const& info = t->torrent_file();
+		bool single_file_request = info.num_files() == 1;
+
+		// if the server closes the connection after each response, any
+		// request beyond the first one would be lost
+		int pipeline_size = m_web.supports_keepalive
+			? (std::max)(m_ses.settings().urlseed_pipeline_size, 1) : 1;
+
+		proxy_settings const& ps = m_ses.proxy();
+		bool using_proxy = (ps.type == proxy_settings::http
+			|| ps.type == proxy_settings::http_pw) && !m_ssl;
+
+		std::string request;
+		request.reserve(400);
+
+		while (!m_pending_requests.empty()
+			&& m_outstanding_requests < pipeline_size)
+		{
+			pending_request const& r = m_pending_requests.front();
 
-					std::string path = info.orig_files().file_path(f.file_index);
+			request += "GET ";
+			if (single_file_request)
+			{
+				// do not encode single file paths, they are 
+				// assumed to be encoded in the torrent file
+				request += using_proxy ? m_url : m_path;
+			}
+			else
+			{
+				// m_url and m_path are already properly escaped URLs
+				// with the correct slashes. Don't encode them again
+				request += using_proxy ? m_url : m_path;
+				std::string path = info.orig_files().file_path(r.file_index);
 #ifdef TORRENT_WINDOWS
-					convert_path_to_posix(path);
+				convert_path_to_posix(path);
 #endif
-					request += escape_path(path.c_str(), path.length());
-				}
-				request += " HTTP/1.1\r\n";
-				add_headers(request, ps, using_proxy);
-				request += "\r\nRange: bytes=";
-				request += to_string(f.offset).elems;
-				request += "-";
-				request += to_string(f.offset + f.size - 1).elems;
-				request += "\r\n\r\n";
-				m_first_request = false;
-				TORRENT_ASSERT(f.file_index >= 0);
-				m_file_requests.push_back(f.file_index);
+				request += escape_path(path.c_str(), path.length());
 			}
+			request += " HTTP/1.1\r\n";
+			add_headers(request, ps, using_proxy);
+			request += "\r\nRange: bytes=";
+			request += to_string(r.start).elems;
+			request += "-";
+			request += to_string(r.start + r.length - 1).elems;
+			request += "\r\n\r\n";
+			m_first_request = false;
+
+			m_pending_requests.pop_front();
+			++m_outstanding_requests;
 		}
 
+		if (request.empty()) return false;
+
 #ifdef TORRENT_VERBOSE_LOGGING
 		peer_log("==> %s", request.c_str());
 #endif
 
 		send_buffer(request.c_str(), request.size(), message_type_request);
+		return true;
 	}
 
 	// --------------------------
@@ -493,10 +535,14 @@ namespace libtorrent
 					// TODO: 3 just make this peer not have the pieces
 					// associated with the file we just requested. Only
 					// when it doesn't have any of the file do the following
-					int retry_time = atoi(m_parser.header("retry-after").c_str());
+					int retry_time = atoi(m_parser.header_value(http_parser::retry_after_header).begin);
 					if (retry_time <= 0) retry_time = m_ses.settings().urlseed_wait_retry;
 					// temporarily unavailable, retry later
 					t->retry_web_seed(this, retry_time);
+					// the server may be rejecting us for opening too
+					// many connections
+					if (m_parser.status_code() == 429 || m_parser.status_code() == 503)
+						t->throttle_web_seed(this);
 					std::string error_msg = to_string(m_parser.status_code()).elems
 						+ (" " + m_parser.message());
 					if (m_ses.m_alerts.should_post<url_seed_alert>())
@@ -575,13 +621,13 @@ namespace libtorrent
 					return;
 				}
 
-				std::string const& server_version = m_parser.header("server");
-				if (!server_version.empty())
+				buffer::const_interval server_version = m_parser.header_value(http_parser::server_header);
+				if (server_version.left() > 0)
 				{
 					m_server_string = "URL seed @ ";
 					m_server_string += m_host;
 					m_server_string += " (";
-					m_server_string += server_version;
+					m_server_string.append(server_version.begin, server_version.end);
 					m_server_string += ")";
 				}
 
@@ -884,6 +930,12 @@ namespace libtorrent
 				}
 				recv_buffer = receive_buffer();
 				m_file_requests.pop_front();
+				TORRENT_ASSERT(m_outstanding_requests > 0);
+				--m_outstanding_requests;
+				// there's room in the pipeline for another request, unless
+				// the server is about to close the connection
+				if (!m_parser.connection_close() && send_pending_requests())
+					setup_send();
 				m_parser.reset();
 				m_body_start = 0;
 				m_received_body = 0;
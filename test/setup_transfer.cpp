@@ -784,6 +784,10 @@ int start_web_server(bool ssl, bool chunked_encoding)
 	std::srand(seed);
 	int port = 5000 + (rand() % 55000);
 
+	// the web server writes its request counters to this file
+	error_code ec;
+	remove("web_server_requests", ec);
+
 	char buf[200];
 	snprintf(buf, sizeof(buf), "python ../web_server.py %d %d %d"
 		, port, chunked_encoding , ssl);
@@ -0,0 +1,160 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/session.hpp"
+#include "libtorrent/session_settings.hpp"
+#include "libtorrent/create_torrent.hpp"
+#include "libtorrent/alert_types.hpp"
+#include "libtorrent/bencode.hpp"
+#include "libtorrent/file.hpp"
+#include "libtorrent/time.hpp"
+#include "test.hpp"
+#include "setup_transfer.hpp"
+
+using namespace libtorrent;
+
+const int num_torrents = 500;
+
+// generates num_torrents unique .torrent files in the add_torrents
+// directory and returns their file:// URLs
+std::vector<std::string> generate_torrents()
+{
+	error_code ec;
+	create_directory("add_torrents", ec);
+	std::string dir = complete("add_torrents");
+
+	std::vector<std::string> ret;
+	std::vector<char> piece(16 * 1024, 'A');
+	sha1_hash ph = hasher(&piece[0], piece.size()).final();
+	for (int i = 0; i < num_torrents; ++i)
+	{
+		char name[100];
+		snprintf(name, sizeof(name), "temporary_%d", i);
+		file_storage fs;
+		fs.add_file(name, 16 * 1024 * 20);
+		libtorrent::create_torrent t(fs, 16 * 1024);
+		t.add_tracker("http://non-existent-name.com/announce");
+		for (int j = 0; j < t.num_pieces(); ++j)
+			t.set_hash(j, ph);
+
+		std::vector<char> buf;
+		bencode(std::back_inserter(buf), t.generate());
+		snprintf(name, sizeof(name), "%d.torrent", i);
+		std::string path = combine_path(dir, name);
+		save_file(path.c_str(), &buf[0], buf.size());
+		ret.push_back("file://" + path);
+	}
+	return ret;
+}
+
+// adds all the torrents (plus one that does not exist on disk) to a new
+// session with the specified number of parser threads, and reports the
+// time it took until every torrent was added
+void test_add_torrents(std::vector<std::string> const& urls, int threads)
+{
+	session ses(fingerprint("LT", 0, 1, 0, 0), std::make_pair(48130, 48140), "0.0.0.0", 0);
+	ses.set_alert_mask(alert::status_notification | alert::error_notification);
+	session_settings sett;
+	sett.add_torrent_threads = threads;
+	sett.alert_queue_size = num_torrents * 10;
+	ses.set_settings(sett);
+
+	std::vector<add_torrent_params> params;
+	for (int i = 0; i < int(urls.size()); ++i)
+	{
+		add_torrent_params p;
+		p.flags &= ~add_torrent_params::flag_auto_managed;
+		p.flags |= add_torrent_params::flag_paused;
+		p.save_path = ".";
+		p.url = urls[i];
+		params.push_back(p);
+		// put a missing file in the middle of the batch
+		if (i == num_torrents / 2)
+		{
+			p.url = "file://non-existent.torrent";
+			params.push_back(p);
+		}
+	}
+
+	ptime start = time_now_hires();
+	ses.async_add_torrents(params);
+
+	std::vector<torrent_handle> handles;
+	int num_errors = 0;
+	int num_alerts = 0;
+	ptime deadline = time_now() + seconds(60);
+	while (num_alerts < int(params.size()) && time_now() < deadline)
+	{
+		ses.wait_for_alert(seconds(1));
+		std::deque<alert*> alerts;
+		ses.pop_alerts(&alerts);
+		for (std::deque<alert*>::iterator i = alerts.begin()
+			, end(alerts.end()); i != end; ++i)
+		{
+			add_torrent_alert* a = alert_cast<add_torrent_alert>(*i);
+			if (a)
+			{
+				++num_alerts;
+				if (a->error) ++num_errors;
+				else handles.push_back(a->handle);
+			}
+			delete *i;
+		}
+	}
+	int ms = total_milliseconds(time_now_hires() - start);
+
+	fprintf(stderr, "added %d torrents with %d parser threads in %d ms\n"
+		, int(handles.size()), threads, ms);
+
+	TEST_EQUAL(num_alerts, int(params.size()));
+	TEST_EQUAL(num_errors, 1);
+	TEST_EQUAL(int(handles.size()), num_torrents);
+	TEST_EQUAL(int(ses.get_torrents().size()), num_torrents);
+
+	// the torrents are queued in the order they were passed in
+	for (int i = 0; i < int(handles.size()); ++i)
+		TEST_EQUAL(handles[i].status(0).queue_position, i);
+}
+
+int test_main()
+{
+	std::vector<std::string> urls = generate_torrents();
+
+	test_add_torrents(urls, 0);
+	test_add_torrents(urls, 1);
+	test_add_torrents(urls, 4);
+
+	error_code ec;
+	remove_all("add_torrents", ec);
+	return 0;
+}
+
@@ -31,30 +31,166 @@ POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "libtorrent/lazy_entry.hpp"
+#include "libtorrent/entry.hpp"
+#include "libtorrent/bencode.hpp"
 #include <boost/lexical_cast.hpp>
 #include <iostream>
+#include <cstdio>
 
 #include "test.hpp"
 #include "libtorrent/time.hpp"
 
 using namespace libtorrent;
 
+// a DHT get_peers response with 50 peers
+std::vector<char> dht_response()
+{
+	entry e;
+	e["y"] = "r";
+	e["t"] = "aa";
+	e["v"] = "LT01";
+	entry& r = e["r"];
+	r["id"] = std::string(20, 'a');
+	r["token"] = std::string(8, 'b');
+	entry::list_type& values = r["values"].list();
+	for (int i = 0; i < 50; ++i)
+		values.push_back(entry(std::string(6, char(i))));
+	std::vector<char> ret;
+	bencode(std::back_inserter(ret), e);
+	return ret;
+}
+
+// the shape of a .torrent file with a lot of files
+std::vector<char> torrent_file(int num_files)
+{
+	entry e;
+	e["announce"] = "http://tracker.example.com/announce";
+	entry& info = e["info"];
+	info["name"] = "test";
+	info["piece length"] = 16 * 1024 * 1024;
+	info["pieces"] = std::string(20 * 500, 'p');
+	entry::list_type& files = info["files"].list();
+	for (int i = 0; i < num_files; ++i)
+	{
+		entry f;
+		f["length"] = 1234567 + i;
+		entry::list_type& path = f["path"].list();
+		path.push_back(entry("directory"));
+		path.push_back(entry("file-" + boost::lexical_cast<std::string>(i)));
+		files.push_back(f);
+	}
+	std::vector<char> ret;
+	bencode(std::back_inserter(ret), e);
+	return ret;
+}
+
+// returns nanoseconds per decode
+template <class F>
+double run(std::vector<char> const& buf, int rounds, F f)
+{
+	ptime start(time_now_hires());
+	for (int i = 0; i < rounds; ++i) f(buf);
+	ptime stop(time_now_hires());
+	return double(total_microseconds(stop - start)) * 1000. / rounds;
+}
+
+struct decode_tree
+{
+	void operator()(std::vector<char> const& buf) const
+	{
+		lazy_entry e;
+		error_code ec;
+		int ret = lazy_bdecode(&buf[0], &buf[0] + buf.size(), e, ec);
+		TEST_CHECK(ret == 0);
+	}
+};
+
+struct decode_arena
+{
+	decode_arena(lazy_bdecode_arena& a): arena(a) {}
+	lazy_bdecode_arena& arena;
+	void operator()(std::vector<char> const& buf) const
+	{
+		lazy_entry e;
+		error_code ec;
+		int ret = lazy_bdecode(&buf[0], &buf[0] + buf.size(), e, arena, ec);
+		TEST_CHECK(ret == 0);
+	}
+};
+
+struct decode_entry
+{
+	void operator()(std::vector<char> const& buf) const
+	{
+		entry e = bdecode(buf.begin(), buf.end());
+		TEST_CHECK(e.type() == entry::dictionary_t);
+	}
+};
+
+void bench(char const* name, std::vector<char> const& buf, int rounds)
+{
+	lazy_bdecode_arena arena;
+	double tree = run(buf, rounds, decode_tree());
+	double reused = run(buf, rounds, decode_arena(arena));
+	double ent = run(buf, rounds, decode_entry());
+	std::printf("%-16s %8d bytes: lazy_bdecode %10.0f ns  arena %10.0f ns  bdecode (entry) %10.0f ns\n"
+		, name, int(buf.size()), tree, reused, ent);
+}
+
 int test_main()
 {
 	using namespace libtorrent;
 
-	ptime start(time_now());
-
-	for (int i = 0; i < 100000; ++i)
 	{
 		char b[] = "d1:ai12453e1:b3:aaa1:c3:bbbe";
-		lazy_entry e;
+		std::vector<char> buf(b, b + sizeof(b) - 1);
+		bench("small dict", buf, 1000000);
+	}
+
+	bench("DHT response", dht_response(), 200000);
+	bench("torrent file", torrent_file(20000), 20);
+
+	// dictionary lookups, linear scan against the hash index
+	{
+		entry e;
+		for (int i = 0; i < 1000; ++i)
+			e["key-" + boost::lexical_cast<std::string>(i)] = i;
+		std::vector<char> buf;
+		bencode(std::back_inserter(buf), e);
+
+		lazy_bdecode_arena linear;
+		lazy_bdecode_arena indexed;
+		indexed.index_threshold = 32;
+
+		lazy_entry l;
+		lazy_entry h;
 		error_code ec;
-		lazy_bdecode(b, b + sizeof(b)-1, e, ec);
+		TEST_CHECK(lazy_bdecode(&buf[0], &buf[0] + buf.size(), l, linear, ec) == 0);
+		TEST_CHECK(lazy_bdecode(&buf[0], &buf[0] + buf.size(), h, indexed, ec) == 0);
+
+		std::vector<std::string> keys;
+		for (int i = 0; i < 1000; ++i)
+			keys.push_back("key-" + boost::lexical_cast<std::string>((i * 7919) % 1000));
+
+		boost::int64_t sum_linear = 0;
+		ptime start(time_now_hires());
+		for (int r = 0; r < 100; ++r)
+			for (int i = 0; i < 1000; ++i)
+				sum_linear += l.dict_find_int_value(keys[i].c_str());
+		ptime mid(time_now_hires());
+		boost::int64_t sum_indexed = 0;
+		for (int r = 0; r < 100; ++r)
+			for (int i = 0; i < 1000; ++i)
+				sum_indexed += h.dict_find_int_value(keys[i].c_str());
+		ptime stop(time_now_hires());
+
+		TEST_EQUAL(sum_linear, sum_indexed);
+		TEST_EQUAL(sum_linear, 100 * 999 * 1000 / 2);
+		// 100000 lookups each
+		std::printf("dict_find in a 1000 key dict: linear %.0f ns  indexed %.0f ns\n"
+			, double(total_microseconds(mid - start)) / 100
+			, double(total_microseconds(stop - mid)) / 100);
 	}
-	ptime stop(time_now());
 
-	std::cout << "done in " << total_milliseconds(stop - start) / 100. << " seconds per million message" << std::endl;
 	return 0;
 }
-
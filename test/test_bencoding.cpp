@@ -31,6 +31,7 @@ POSSIBILITY OF SUCH DAMAGE.
 */
 
 #include "libtorrent/bencode.hpp"
+#include "libtorrent/bencode_writer.hpp"
 #include "libtorrent/lazy_entry.hpp"
 #include <boost/lexical_cast.hpp>
 #include <iostream>
@@ -104,6 +105,87 @@ int test_main()
 		TEST_CHECK(decode(encode(e)) == e);
 	}
 
+	// ** bencode_writer **
+	{
+		entry e(entry::dictionary_t);
+		e["cow"] = entry("moo");
+		e["list"].list().push_back(entry(-3));
+		e["list"].list().push_back(entry("eggs"));
+		e["nodes"] = entry("abcdef");
+		e["spam"] = entry(1234567890123LL);
+
+		std::vector<char> buf;
+		bencode_writer w(buf);
+		w.begin_dict();
+		w.key("cow");
+		w.string("moo");
+		w.key("list");
+		w.begin_list();
+		w.integer(-3);
+		w.string(std::string("eggs"));
+		w.end();
+		w.key("nodes");
+		w.string_prefix(6);
+		w.raw("abc", 3);
+		w.raw("def", 3);
+		w.key("spam");
+		w.integer(1234567890123LL);
+		w.end();
+		TEST_EQUAL(std::string(buf.begin(), buf.end()), encode(e));
+	}
+
+	{
+		std::vector<char> buf;
+		bencode_writer w(buf);
+		char* p = w.reserve_string(4);
+		std::memcpy(p, "spam", 4);
+		w.reserve_string(0);
+		w.value(entry("eggs"));
+		TEST_EQUAL(std::string(buf.begin(), buf.end()), "4:spam0:4:eggs");
+	}
+
+	// ** bencode_dict_merge **
+	{
+		entry extra(entry::dictionary_t);
+		extra["a"] = entry(1);
+		extra["c"] = entry(3);
+		extra["z"] = entry("zz");
+
+		// the caller's values are kept for keys in both
+		std::vector<char> buf;
+		bencode_writer w(buf);
+		w.begin_dict();
+		bencode_dict_merge d(w, extra, false);
+		if (d.key("b")) w.integer(2);
+		TEST_CHECK(d.key("c"));
+		w.string("mine");
+		d.finish();
+		w.end();
+		TEST_EQUAL(std::string(buf.begin(), buf.end())
+			, "d1:ai1e1:bi2e1:c4:mine1:z2:zze");
+
+		// the entry's values are kept for keys in both
+		buf.clear();
+		w.begin_dict();
+		bencode_dict_merge d2(w, extra, true);
+		if (d2.key("b")) w.integer(2);
+		TEST_CHECK(!d2.key("c"));
+		d2.finish();
+		w.end();
+		TEST_EQUAL(std::string(buf.begin(), buf.end())
+			, "d1:ai1e1:bi2e1:ci3e1:z2:zze");
+
+		// an entry that isn't a dictionary adds nothing
+		buf.clear();
+		w.begin_dict();
+		bencode_dict_merge d3(w, entry(), true);
+		TEST_CHECK(d3.key("b"));
+		w.integer(2);
+		d3.finish();
+		w.end();
+		TEST_EQUAL(std::string(buf.begin(), buf.end()), "d1:bi2ee");
+	}
+
 	{
 		char b[] = "i12453e";
 		lazy_entry e;
@@ -479,6 +561,70 @@ int test_main()
 		TEST_EQUAL(ps.len, 0);
 	}
 
+	// test decoding into a reused arena
+	{
+		lazy_bdecode_arena arena;
+		error_code ec;
+
+		char b1[] = "d1:ad1:bli1ei2eee1:c3:fooe";
+		lazy_entry e;
+		int ret = lazy_bdecode(b1, b1 + sizeof(b1)-1, e, arena, ec);
+		TEST_EQUAL(ret, 0);
+		printf("%s\n", print_entry(e).c_str());
+		lazy_entry const* l = e.dict_find("a");
+		TEST_CHECK(l && l->type() == lazy_entry::dict_t);
+		l = l->dict_find_list("b");
+		TEST_CHECK(l && l->list_size() == 2);
+		TEST_EQUAL(l->list_int_value_at(1), 2);
+		TEST_EQUAL(l->data_section().second, 8);
+		TEST_EQUAL(e.dict_find_string_value("c"), "foo");
+		TEST_EQUAL(e.data_section().second, int(sizeof(b1)-1));
+
+		// a larger message grows the arena, the smaller one after it
+		// reuses it
+		char b2[] = "l1:a1:b1:c1:d1:e1:f1:g1:h1:i1:jd1:xi1eee";
+		ret = lazy_bdecode(b2, b2 + sizeof(b2)-1, e, arena, ec);
+		TEST_EQUAL(ret, 0);
+		TEST_EQUAL(e.list_size(), 11);
+		TEST_EQUAL(e.list_string_value_at(9), "j");
+		TEST_EQUAL(e.list_at(10)->dict_find_int_value("x"), 1);
+
+		ret = lazy_bdecode(b1, b1 + sizeof(b1)-1, e, arena, ec);
+		TEST_EQUAL(ret, 0);
+		TEST_EQUAL(e.dict_find_string_value("c"), "foo");
+
+		// errors leave the entry empty
+		char b3[] = "d1:ai1e1:b";
+		ret = lazy_bdecode(b3, b3 + sizeof(b3)-1, e, arena, ec);
+		TEST_CHECK(ret != 0);
+		TEST_EQUAL(e.type(), lazy_entry::none_t);
+	}
+
+	// test dictionaries with a hash index
+	{
+		lazy_bdecode_arena arena;
+		arena.index_threshold = 3;
+		error_code ec;
+
+		// the first "a" wins, like with the linear scan
+		char b[] = "d1:ai1e2:bbi2e1:ai3e0:i4e1:cd1:xi5eee";
+		lazy_entry e;
+		int ret = lazy_bdecode(b, b + sizeof(b)-1, e, arena, ec);
+		TEST_EQUAL(ret, 0);
+		TEST_EQUAL(e.dict_size(), 5);
+		TEST_EQUAL(e.dict_find_int_value("a"), 1);
+		TEST_EQUAL(e.dict_find_int_value("bb"), 2);
+		TEST_EQUAL(e.dict_find_int_value(""), 4);
+		TEST_CHECK(e.dict_find("b") == 0);
+		TEST_CHECK(e.dict_find("bbb") == 0);
+		// the nested dict is below the threshold
+		lazy_entry const* c = e.dict_find_dict("c");
+		TEST_CHECK(c);
+		TEST_EQUAL(c->dict_find_int_value("x"), 5);
+		TEST_EQUAL(e.dict_at(2).first, "a");
+		TEST_EQUAL(e.dict_at(2).second->int_value(), 3);
+	}
+
 	{
 		unsigned char buf[] = { 0x44	, 0x91	, 0x3a };
 		entry ent = bdecode(buf, buf + sizeof(buf));
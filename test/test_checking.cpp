@@ -195,8 +195,64 @@ void test_checking(bool read_only_files, bool corrupt_files = false)
 		, ec.value(), ec.message().c_str());
 }
 
+void record_piece(int piece, std::vector<int>* pieces)
+{
+	pieces->push_back(piece);
+}
+
+void test_parallel_hashing()
+{
+	using namespace libtorrent;
+
+	fprintf(stderr, "==== TEST PARALLEL HASHING =====\n");
+
+	error_code ec;
+	remove_all("tmp1_hashing", ec);
+	create_directory("tmp1_hashing", ec);
+	create_directory(combine_path("tmp1_hashing", "test_torrent_dir"), ec);
+	std::srand(10);
+	create_random_files(combine_path("tmp1_hashing", "test_torrent_dir"), file_sizes, num_files);
+
+	file_storage fs;
+	add_files(fs, combine_path("tmp1_hashing", "test_torrent_dir"));
+
+	// the result must not depend on the number of hashing threads
+	sha1_hash info_hash;
+	for (int threads = 1; threads <= 8; threads *= 2)
+	{
+		libtorrent::create_torrent t(fs, 0x4000, -1
+			, libtorrent::create_torrent::calculate_file_hashes);
+		std::vector<int> pieces;
+		set_piece_hashes(t, "tmp1_hashing"
+			, boost::bind(&record_piece, _1, &pieces), ec, threads);
+		TEST_CHECK(!ec);
+
+		// progress is reported in order, once per piece
+		TEST_EQUAL(int(pieces.size()), t.num_pieces());
+		for (int i = 0; i < int(pieces.size()); ++i)
+			TEST_EQUAL(pieces[i], i);
+
+		std::vector<char> buf;
+		bencode(std::back_inserter(buf), t.generate());
+		torrent_info ti(&buf[0], buf.size(), ec);
+		TEST_CHECK(!ec);
+		if (threads == 1) info_hash = ti.info_hash();
+		TEST_CHECK(ti.info_hash() == info_hash);
+	}
+
+	// a missing file fails with an error
+	remove(combine_path(combine_path("tmp1_hashing", "test_torrent_dir"), "test_dir3/test17"), ec);
+	TEST_CHECK(!ec);
+	libtorrent::create_torrent t(fs, 0x4000);
+	set_piece_hashes(t, "tmp1_hashing", detail::nop, ec, 4);
+	TEST_CHECK(ec);
+
+	remove_all("tmp1_hashing", ec);
+}
+
 int test_main()
 {
+	test_parallel_hashing();
 	test_checking(false);
 	test_checking(true);
 	test_checking(true, true);
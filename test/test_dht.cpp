@@ -97,6 +97,12 @@ struct mock_socket : udp_socket_interface
 		g_sent_packets.push_back(std::make_pair(ep, msg));
 		return true;
 	}
+
+	bool send_packet(char const* buf, int size, udp::endpoint const& ep, int flags)
+	{
+		g_sent_packets.push_back(std::make_pair(ep, bdecode(buf, buf + size)));
+		return true;
+	}
 };
 
 address rand_v4()
@@ -438,6 +444,37 @@ bool get_item_cb(dht::item& i)
 	return false;
 }
 
+// an outstanding request whose send time can be moved back, to
+// trigger timeouts without waiting
+struct timeout_observer : observer
+{
+	timeout_observer(boost::intrusive_ptr<traversal_algorithm> const& a
+		, udp::endpoint const& ep, node_id const& id)
+		: observer(a, ep, id) {}
+	virtual void reply(msg const&) { flags |= flag_done; }
+	void age(time_duration d) { m_sent -= d; }
+};
+
+// a traversal that doesn't send anything itself. The test sends the
+// requests of its observers through the rpc_manager
+struct timeout_algorithm : traversal_algorithm
+{
+	timeout_algorithm(node_impl& node) : traversal_algorithm(node, node_id::min()) {}
+
+	boost::intrusive_ptr<timeout_observer> add_observer(udp::endpoint const& ep)
+	{
+		void* ptr = allocate_observer();
+		boost::intrusive_ptr<timeout_observer> o(new (ptr) timeout_observer(this, ep, node_id::min()));
+#if TORRENT_USE_ASSERTS
+		o->m_in_constructor = false;
+#endif
+		o->flags |= observer::flag_queried | observer::flag_no_id;
+		m_results.push_back(o);
+		++m_invoke_count;
+		return o;
+	}
+};
+
 // TODO: 3 test obfuscated_get_peers
 int test_main()
 {
@@ -621,6 +658,22 @@ int test_main()
 		fprintf(stderr, "   invalid get_peers response: %s\n", error_string);
 	}
 
+	// ====== per-torrent peer limit ======
+
+	// lowering max_peers takes effect on the next announce, which evicts
+	// the oldest peers to make room
+	sett.max_peers = 20;
+	source = udp::endpoint(rand_v4(), 6000);
+	send_dht_request(node, "get_peers", source, &response, "10", "01010101010101010101");
+	ret = dht::verify_message(&response, peer1_desc, parsed, 4, error_string, sizeof(error_string));
+	TEST_CHECK(ret);
+	if (ret) token = parsed[2]->string_value();
+	response.clear();
+	send_dht_request(node, "announce_peer", source, &response, "10", "01010101010101010101"
+		, "test", token, 8080);
+	TEST_EQUAL(node.num_peers(), 20);
+	sett.max_peers = 500;
+
 	// ====== test node ID enforcement ======
 
 	// enable node_id enforcement
@@ -667,6 +720,16 @@ int test_main()
 			&& parsed[1]->list_at(1)->type() == lazy_entry::string_t)
 		{
 			TEST_CHECK(parsed[1]->list_at(1)->string_value() == "invalid node ID");
+			// the error tells the node what its external address is, so
+			// it can pick a valid node ID
+			lazy_entry const* ip = response.dict_find_string("ip");
+			TEST_CHECK(ip != 0);
+			if (ip)
+			{
+				char const* ptr = ip->string_ptr();
+				TEST_CHECK(ip->string_length() == 6
+					&& libtorrent::detail::read_v4_endpoint<udp::endpoint>(ptr) == source);
+			}
 		}
 		else
 		{
@@ -1844,6 +1907,172 @@ int test_main()
 
 	} while (false);
 
+	// rpc_manager timeouts
+
+	do
+	{
+		dht::node_impl node(&ad, &s, sett, node_id::min(), ext, 0);
+		boost::intrusive_ptr<timeout_algorithm> algo(new timeout_algorithm(node));
+		int const branch_factor = algo->branch_factor();
+
+		udp::endpoint eps[3] =
+			{ udp::endpoint(address_v4::from_string("4.4.4.4"), 1234)
+			, udp::endpoint(address_v4::from_string("5.5.5.5"), 1235)
+			, udp::endpoint(address_v4::from_string("6.6.6.6"), 1236) };
+		boost::intrusive_ptr<timeout_observer> o[3];
+		for (int i = 0; i < 3; ++i)
+		{
+			o[i] = algo->add_observer(eps[i]);
+			entry e;
+			e["q"] = "ping";
+			TEST_CHECK(node.m_rpc.invoke(e, eps[i], o[i]));
+		}
+		TEST_EQUAL(g_sent_packets.size(), 3);
+		TEST_EQUAL(node.m_rpc.num_transactions(), 3);
+		g_sent_packets.clear();
+
+		// nothing has timed out yet
+		time_duration next = node.m_rpc.tick();
+		TEST_EQUAL(total_seconds(next), 1);
+		TEST_EQUAL(algo->branch_factor(), branch_factor);
+
+		// the first two requests reach the short timeout. They stay
+		// outstanding, but open up a slot each in the traversal. The
+		// requests must stay in the order they were sent
+		o[0]->age(seconds(2));
+		o[1]->age(seconds(2));
+		o[2]->age(milliseconds(500));
+		node.m_rpc.tick();
+		TEST_CHECK(o[0]->flags & observer::flag_short_timeout);
+		TEST_CHECK(o[1]->flags & observer::flag_short_timeout);
+		TEST_CHECK((o[2]->flags & observer::flag_short_timeout) == 0);
+		TEST_EQUAL(algo->branch_factor(), branch_factor + 2);
+		TEST_EQUAL(node.m_rpc.num_transactions(), 3);
+
+		// a request is only considered for the short timeout once, even if
+		// its observer would accept another one
+		o[0]->flags &= ~observer::flag_short_timeout;
+		node.m_rpc.tick();
+		TEST_CHECK((o[0]->flags & observer::flag_short_timeout) == 0);
+		TEST_EQUAL(algo->branch_factor(), branch_factor + 2);
+
+		// an ICMP port unreachable fails the request to that endpoint only
+		node.m_rpc.unreachable(eps[2]);
+		TEST_CHECK(o[2]->flags & observer::flag_failed);
+		TEST_CHECK(o[2]->flags & observer::flag_done);
+		TEST_CHECK((o[1]->flags & observer::flag_done) == 0);
+		TEST_EQUAL(node.m_rpc.num_transactions(), 2);
+
+		// unreachable for an endpoint with no outstanding request is ignored
+		node.m_rpc.unreachable(udp::endpoint(address_v4::from_string("4.4.4.4"), 4321));
+		TEST_EQUAL(node.m_rpc.num_transactions(), 2);
+
+		// the first request times out completely. The second one has 13
+		// seconds left
+		o[0]->age(seconds(14));
+		next = node.m_rpc.tick();
+		TEST_CHECK(o[0]->flags & observer::flag_failed);
+		TEST_CHECK(o[0]->flags & observer::flag_done);
+		TEST_CHECK((o[1]->flags & observer::flag_done) == 0);
+		TEST_EQUAL(node.m_rpc.num_transactions(), 1);
+		TEST_EQUAL(total_seconds(next), 13);
+
+	} while (false);
+
+	// multiple node instances
+
+	do
+	{
+		dht::node_impl node(&ad, &s, sett, node_id::min(), ext, 0);
+		std::vector<boost::shared_ptr<node_impl> > extra;
+
+		lazy_entry msg_ent;
+		entry e;
+		e["y"] = "r";
+		e["t"] = "\0\0";
+		lazy_from_entry(e, msg_ent);
+		udp::endpoint eps[3] =
+			{ udp::endpoint(address_v4::from_string("4.4.4.4"), 1234)
+			, udp::endpoint(address_v4::from_string("5.5.5.5"), 1235)
+			, udp::endpoint(address_v4::from_string("6.6.6.6"), 1236) };
+
+		// with a single node, everything goes to it
+		TEST_CHECK(&node_for(msg(msg_ent, eps[0]), node, extra) == &node);
+
+		extra.push_back(boost::shared_ptr<node_impl>(new node_impl(
+			&ad, &s, sett, (node_id::max)(), ext, 0)));
+		node_impl& node2 = *extra.back();
+
+		// each node sends a request of its own
+		boost::intrusive_ptr<timeout_algorithm> algo(new timeout_algorithm(node));
+		boost::intrusive_ptr<timeout_algorithm> algo2(new timeout_algorithm(node2));
+		e = entry();
+		e["q"] = "ping";
+		TEST_CHECK(node.m_rpc.invoke(e, eps[0], algo->add_observer(eps[0])));
+		e = entry();
+		e["q"] = "ping";
+		TEST_CHECK(node2.m_rpc.invoke(e, eps[1], algo2->add_observer(eps[1])));
+		TEST_EQUAL(g_sent_packets.size(), 2);
+		if (g_sent_packets.size() != 2) break;
+		std::string tid[2] =
+			{ g_sent_packets.front().second["t"].string()
+			, g_sent_packets.back().second["t"].string() };
+		g_sent_packets.clear();
+
+		// replies go to the node with the matching transaction
+		e = entry();
+		e["y"] = "r";
+		e["t"] = tid[0];
+		lazy_from_entry(e, msg_ent);
+		TEST_CHECK(node.m_rpc.is_outstanding(msg(msg_ent, eps[0])));
+		TEST_CHECK(!node2.m_rpc.is_outstanding(msg(msg_ent, eps[0])));
+		TEST_CHECK(&node_for(msg(msg_ent, eps[0]), node, extra) == &node);
+
+		e["t"] = tid[1];
+		lazy_from_entry(e, msg_ent);
+		TEST_CHECK(!node.m_rpc.is_outstanding(msg(msg_ent, eps[1])));
+		TEST_CHECK(node2.m_rpc.is_outstanding(msg(msg_ent, eps[1])));
+		TEST_CHECK(&node_for(msg(msg_ent, eps[1]), node, extra) == &node2);
+
+		// a reply nobody is waiting for goes to the primary node
+		TEST_CHECK(!node2.m_rpc.is_outstanding(msg(msg_ent, eps[2])));
+		TEST_CHECK(&node_for(msg(msg_ent, eps[2]), node, extra) == &node);
+
+		// queries go to the node closest to the target
+		e = entry();
+		e["y"] = "q";
+		e["t"] = "10";
+		e["q"] = "get_peers";
+		e["a"]["info_hash"] = (node_id::max)().to_string();
+		lazy_from_entry(e, msg_ent);
+		TEST_CHECK(&node_for(msg(msg_ent, eps[2]), node, extra) == &node2);
+
+		e["a"]["info_hash"] = to_hash("0101010101010101010101010101010101010101").to_string();
+		lazy_from_entry(e, msg_ent);
+		TEST_CHECK(&node_for(msg(msg_ent, eps[2]), node, extra) == &node);
+
+		// the IDs of the extra nodes survive a save and restore
+		entry state(entry::dictionary_t);
+		TEST_EQUAL(extract_extra_node_id(&state, 0), node_id::min());
+		save_extra_node_ids(state, extra);
+		char buf[100];
+		int len = bencode(buf, state);
+		entry restored = bdecode(buf, buf + len);
+		TEST_EQUAL(extract_extra_node_id(&restored, 0), node2.nid());
+		TEST_EQUAL(extract_extra_node_id(&restored, 1), node_id::min());
+		restored["extra-node-ids"].list().front() = "abc";
+		TEST_EQUAL(extract_extra_node_id(&restored, 0), node_id::min());
+		TEST_EQUAL(extract_extra_node_id(0, 0), node_id::min());
+
+		// the session status has one entry per node
+		session_status st;
+		node.status(st);
+		add_extra_node_status(st, extra);
+		TEST_EQUAL(st.dht_instances.size(), 2);
+		add_extra_node_status(st, std::vector<boost::shared_ptr<node_impl> >());
+		TEST_CHECK(st.dht_instances.empty());
+	} while (false);
+
 	// test vector 1
 
 	// test content
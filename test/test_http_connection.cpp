@@ -57,8 +57,9 @@ void print_http_header(http_parser const& p)
 {
 	std::cerr << time_now_string() << " < " << p.status_code() << " " << p.message() << std::endl;
 
+	std::multimap<std::string, std::string> const headers = p.headers();
 	for (std::multimap<std::string, std::string>::const_iterator i
-		= p.headers().begin(), end(p.headers().end()); i != end; ++i)
+		= headers.begin(), end(headers.end()); i != end; ++i)
 	{
 		std::cerr << time_now_string() << " < " << i->first << ": " << i->second << std::endl;
 	}
@@ -137,6 +138,50 @@ void run_test(std::string const& url, int size, int status, int connected
 	TEST_CHECK(http_status == status || status == -1);
 }
 
+// sends two requests on the same keep-alive connection, and makes sure the
+// second one doesn't connect again
+void run_keepalive_test(int port)
+{
+	reset_globals();
+
+	char url[256];
+	snprintf(url, sizeof(url), "http://127.0.0.1:%d/test_file", port);
+	std::cerr << " ===== TESTING KEEP-ALIVE: " << url << " =====" << std::endl;
+
+	boost::shared_ptr<http_connection> h(new http_connection(ios, cq
+		, &::http_handler, true, 1024*1024, &::http_connect_handler));
+	h->keep_alive(true);
+	h->get(url, seconds(1));
+	ios.reset();
+	error_code e;
+	ios.run(e);
+
+	TEST_EQUAL(handler_called, 1);
+	TEST_EQUAL(http_status, 200);
+	TEST_EQUAL(data_size, 3216);
+	TEST_CHECK(h->can_reuse());
+	tcp::endpoint local_ep = h->socket().local_endpoint(e);
+
+	http_status = 0;
+	data_size = 0;
+	h->get(url, seconds(1));
+	ios.reset();
+	ios.run(e);
+
+	TEST_EQUAL(handler_called, 2);
+	TEST_EQUAL(http_status, 200);
+	TEST_EQUAL(data_size, 3216);
+	// the connect handler is called for the reused connection too, but
+	// it's the same socket
+	TEST_EQUAL(connect_handler_called, 2);
+	TEST_CHECK(h->socket().local_endpoint(e) == local_ep);
+
+	// the test web server serves one connection at a time
+	h->close();
+	ios.reset();
+	ios.run(e);
+}
+
 void run_suite(std::string const& protocol, proxy_settings ps, int port)
 {
 	if (ps.type != proxy_settings::none)
@@ -212,6 +257,7 @@ int test_main()
 		ps.type = (proxy_settings::proxy_type)i;
 		run_suite("http", ps, port);
 	}
+	run_keepalive_test(port);
 	stop_web_server();
 
 #ifdef TORRENT_USE_OPENSSL
@@ -228,6 +274,7 @@ int test_main()
 	port = start_web_server(false, true);
 	ps.type = proxy_settings::none;
 	run_suite("http", ps, port);
+	run_keepalive_test(port);
 
 	stop_web_server();
 	std::remove("test_file");
@@ -312,10 +312,65 @@ int test_main()
 		TEST_EQUAL(chunk_size, 0);
 		TEST_EQUAL(header_size, sizeof(chunk_header2) - 1);
 
-		TEST_EQUAL(parser.headers().find("test1")->second, "foo");
-		TEST_EQUAL(parser.headers().find("test2")->second, "bar");
+		TEST_EQUAL(parser.header("test1"), "foo");
+		TEST_EQUAL(parser.header("test2"), "bar");
 	}
 
+	{
+		// incomplete tail headers are not added to the parser
+		parser.reset();
+		char const chunk_header3[] =
+			"0\r\n"
+			"test3: foo\r\n"
+			"test4: bar\r\n"
+			"\r\n";
+		size_type chunk_size;
+		int header_size;
+		bool ret = parser.parse_chunk_header(buffer::const_interval(chunk_header3
+			, chunk_header3 + sizeof(chunk_header3) - 3), &chunk_size, &header_size);
+		TEST_EQUAL(ret, false);
+		TEST_EQUAL(parser.header("test3"), "");
+		TEST_EQUAL(parser.headers().size(), 0);
+		ret = parser.parse_chunk_header(buffer::const_interval(chunk_header3
+			, chunk_header3 + sizeof(chunk_header3) - 1), &chunk_size, &header_size);
+		TEST_EQUAL(ret, true);
+		TEST_EQUAL(parser.header("test3"), "foo");
+		TEST_EQUAL(parser.header("test4"), "bar");
+		TEST_EQUAL(parser.headers().size(), 2);
+	}
+
+	parser.reset();
+
+	// known headers are looked up without copying, and the first one
+	// wins when a header is repeated
+	char const* known_headers_response =
+		"HTTP/1.1 302 Found\r\n"
+		"LOCATION: http://example.com/a\r\n"
+		"Location: http://example.com/b\r\n"
+		"Retry-After: 10\r\n"
+		"X-Custom:  value\r\n"
+		"Content-Length: 0\r\n"
+		"\r\n";
+
+	received = feed_bytes(parser, known_headers_response);
+
+	TEST_CHECK(received == make_tuple(0, int(strlen(known_headers_response)), false));
+	TEST_EQUAL(parser.status_code(), 302);
+	TEST_EQUAL(parser.message(), "Found");
+	TEST_EQUAL(parser.protocol(), "HTTP/1.1");
+	buffer::const_interval location = parser.header_value(http_parser::location_header);
+	TEST_EQUAL(std::string(location.begin, location.end), "http://example.com/a");
+	// the value is null terminated
+	TEST_EQUAL(*location.end, 0);
+	TEST_EQUAL(parser.header("location"), "http://example.com/a");
+	TEST_EQUAL(atoi(parser.header_value(http_parser::retry_after_header).begin), 10);
+	TEST_EQUAL(parser.header("x-custom"), "value");
+	TEST_EQUAL(parser.header_value(http_parser::server_header).left(), 0);
+	TEST_EQUAL(*parser.header_value(http_parser::server_header).begin, 0);
+	TEST_EQUAL(parser.header_value("x-missing").left(), 0);
+	TEST_EQUAL(parser.headers().count("location"), 2);
+	TEST_EQUAL(parser.headers().size(), 5);
+
 	// test url parsing
 
 	error_code ec;
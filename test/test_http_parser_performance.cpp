@@ -0,0 +1,136 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/http_parser.hpp"
+#include "libtorrent/time.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <cstring>
+
+#include "test.hpp"
+
+using namespace libtorrent;
+
+// a response to a range request, the way web seeds answer every
+// block request
+char const web_seed_response[] =
+	"HTTP/1.1 206 Partial Content\r\n"
+	"Date: Fri, 02 Jan 1970 08:10:38 GMT\r\n"
+	"Server: Apache/2.2.22 (Ubuntu)\r\n"
+	"Last-Modified: Thu, 01 Jan 1970 12:00:00 GMT\r\n"
+	"ETag: \"2e0c1f-4000000-4c1a0a8b2e1c0\"\r\n"
+	"Accept-Ranges: bytes\r\n"
+	"Content-Length: 16\r\n"
+	"Content-Range: bytes 16384-16399/67108864\r\n"
+	"Keep-Alive: timeout=5, max=100\r\n"
+	"Connection: Keep-Alive\r\n"
+	"Content-Type: application/octet-stream\r\n"
+	"\r\n"
+	"0123456789abcdef";
+
+char const chunked_response[] =
+	"HTTP/1.1 200 OK\r\n"
+	"Server: tracker\r\n"
+	"Content-Type: text/plain\r\n"
+	"Transfer-Encoding: chunked\r\n"
+	"\r\n"
+	"4\r\n"
+	"test\r\n"
+	"10\r\n"
+	"0123456789abcdef\r\n"
+	"0\r\n"
+	"X-Tail: foobar\r\n"
+	"\r\n";
+
+// parses the response num_responses times, the way a connection reuses
+// its parser, and returns the number of nanoseconds per response
+int parse(http_parser& p, char const* response, int size, int num_responses
+	, int step, bool lookups)
+{
+	int checksum = 0;
+	ptime start(time_now_hires());
+	for (int i = 0; i < num_responses; ++i)
+	{
+		p.reset();
+		bool error = false;
+		buffer::const_interval recv_buf(response, response);
+		while (recv_buf.end < response + size)
+		{
+			recv_buf.end = (std::min)(recv_buf.end + step, response + size);
+			p.incoming(recv_buf, error);
+		}
+		TEST_CHECK(!error);
+		TEST_CHECK(p.finished());
+		if (lookups)
+		{
+			checksum += p.status_code();
+			checksum += p.header("server").size();
+			checksum += atoi(p.header("retry-after").c_str());
+			checksum += p.header("location").size();
+		}
+	}
+	ptime stop(time_now_hires());
+	if (lookups) TEST_CHECK(checksum > 0);
+	return int(total_microseconds(stop - start) * 1000 / num_responses);
+}
+
+int test_main()
+{
+	int const num_responses = 200000;
+	http_parser p;
+
+	std::cout << "web seed response, in one piece: "
+		<< parse(p, web_seed_response, sizeof(web_seed_response) - 1
+			, num_responses, sizeof(web_seed_response), false)
+		<< " ns per response" << std::endl;
+	TEST_EQUAL(p.content_range().first, 16384);
+	TEST_EQUAL(p.content_range().second, 16399);
+
+	std::cout << "web seed response, with header lookups: "
+		<< parse(p, web_seed_response, sizeof(web_seed_response) - 1
+			, num_responses, sizeof(web_seed_response), true)
+		<< " ns per response" << std::endl;
+
+	std::cout << "web seed response, 100 bytes at a time: "
+		<< parse(p, web_seed_response, sizeof(web_seed_response) - 1
+			, num_responses, 100, false)
+		<< " ns per response" << std::endl;
+
+	std::cout << "chunked response, in one piece: "
+		<< parse(p, chunked_response, sizeof(chunked_response) - 1
+			, num_responses, sizeof(chunked_response), false)
+		<< " ns per response" << std::endl;
+	TEST_EQUAL(p.header("x-tail"), "foobar");
+	TEST_EQUAL(p.chunks().size(), 2);
+	return 0;
+}
+
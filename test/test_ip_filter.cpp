@@ -32,6 +32,8 @@ POSSIBILITY OF SUCH DAMAGE.
 
 #include "libtorrent/ip_filter.hpp"
 #include <boost/utility.hpp>
+#include <cstdlib>
+#include <algorithm>
 
 #include "test.hpp"
 #include "libtorrent/socket_io.hpp"
@@ -269,6 +271,75 @@ int test_main()
 	}	
 #endif
 
+	// **** test against a reference, with rules both pending and merged ****
+
+	{
+		// a filter over the 16 bit port range is small enough to keep
+		// the access of every single port in a plain array
+		std::vector<int> reference(65536, 0);
+		port_filter pf;
+		std::srand(10);
+		for (int i = 0; i < 2000; ++i)
+		{
+			int first = std::rand() % 65536;
+			int last = (std::min)(65535, first + std::rand() % 3000);
+			if (i % 50 == 0) last = 65535;
+			int flags = std::rand() % 3;
+			pf.add_rule(first, last, flags);
+			std::fill(reference.begin() + first, reference.begin() + last + 1, flags);
+
+			if (i % 97 != 0) continue;
+			for (int p = 0; p < 65536; p += 1 + std::rand() % 50)
+			{
+				if (pf.access(p) == reference[p]) continue;
+				TEST_ERROR("port filter doesn't match the reference");
+				i = 2000;
+				break;
+			}
+		}
+	}
+
+	// **** test batch access ****
+
+	{
+		ip_filter f;
+		f.add_rule(IP("1.0.0.0"), IP("1.255.255.255"), ip_filter::blocked);
+		f.add_rule(IP("10.0.0.0"), IP("10.0.0.255"), ip_filter::blocked);
+		f.add_rule(IP("10.0.0.128"), IP("10.0.0.130"), 0);
+#if TORRENT_USE_IPV6
+		f.add_rule(IP("2::"), IP("3::"), ip_filter::blocked);
+#endif
+
+		std::vector<address> addrs;
+		addrs.push_back(IP("0.255.255.255"));
+		addrs.push_back(IP("1.0.0.0"));
+		addrs.push_back(IP("1.2.3.4"));
+		addrs.push_back(IP("10.0.0.1"));
+		addrs.push_back(IP("10.0.0.129"));
+		addrs.push_back(IP("10.0.0.200"));
+		addrs.push_back(IP("11.0.0.0"));
+		// out of order
+		addrs.push_back(IP("1.0.0.1"));
+#if TORRENT_USE_IPV6
+		addrs.push_back(IP("2::1"));
+		addrs.push_back(IP("1::"));
+#endif
+
+		for (int committed = 0; committed < 2; ++committed)
+		{
+			if (committed) f.commit();
+			std::vector<int> flags;
+			f.access(addrs, flags);
+			TEST_EQUAL(flags.size(), addrs.size());
+			for (int i = 0; i < int(addrs.size()); ++i)
+				TEST_EQUAL(flags[i], f.access(addrs[i]));
+			TEST_EQUAL(flags[1], int(ip_filter::blocked));
+			TEST_EQUAL(flags[4], 0);
+			TEST_EQUAL(flags[5], int(ip_filter::blocked));
+			TEST_EQUAL(flags[6], 0);
+		}
+	}
+
 	port_filter pf;
 
 	// default contructed port filter should allow any port
@@ -0,0 +1,153 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/ip_filter.hpp"
+#include "libtorrent/time.hpp"
+#include <iostream>
+#include <cstdlib>
+#include <algorithm>
+
+#include "test.hpp"
+
+using namespace libtorrent;
+
+boost::uint32_t random_u32()
+{
+	return boost::uint32_t(std::rand()) << 16 ^ boost::uint32_t(std::rand());
+}
+
+struct rule_t
+{
+	boost::uint32_t first;
+	boost::uint32_t last;
+	bool operator<(rule_t const& r) const { return first < r.first; }
+};
+
+bool equal_ranges(std::vector<ip_range<address_v4> > const& lhs
+	, std::vector<ip_range<address_v4> > const& rhs)
+{
+	if (lhs.size() != rhs.size()) return false;
+	for (int i = 0; i < int(lhs.size()); ++i)
+	{
+		if (lhs[i].first != rhs[i].first
+			|| lhs[i].last != rhs[i].last
+			|| lhs[i].flags != rhs[i].flags) return false;
+	}
+	return true;
+}
+
+// loads the rules into a filter, the way a block list is loaded, and
+// returns the number of milliseconds it took
+int load(ip_filter& f, std::vector<rule_t> const& rules)
+{
+	ptime start(time_now_hires());
+	for (std::vector<rule_t>::const_iterator i = rules.begin()
+		, end(rules.end()); i != end; ++i)
+	{
+		f.add_rule(address_v4(i->first), address_v4(i->last), ip_filter::blocked);
+	}
+	f.commit();
+	return int(total_milliseconds(time_now_hires() - start));
+}
+
+int test_main()
+{
+	// a block list of the size of the popular ones. Most of its ranges
+	// are small, and some overlap
+	std::vector<rule_t> rules;
+	int const num_rules = 500000;
+	for (int i = 0; i < num_rules; ++i)
+	{
+		rule_t r;
+		r.first = random_u32();
+		r.last = r.first + (std::min)(boost::uint32_t(std::rand() % 4096)
+			, 0xffffffff - r.first);
+		rules.push_back(r);
+	}
+
+	ip_filter random_order;
+	int ms = load(random_order, rules);
+	std::cout << "load " << num_rules << " rules in random order: " << ms << " ms" << std::endl;
+
+	std::sort(rules.begin(), rules.end());
+	ip_filter sorted_order;
+	ms = load(sorted_order, rules);
+	std::cout << "load " << num_rules << " rules in address order: " << ms << " ms" << std::endl;
+
+	std::vector<ip_range<address_v4> > ranges;
+#if TORRENT_USE_IPV6
+	ranges = boost::get<0>(sorted_order.export_filter());
+	TEST_CHECK(equal_ranges(ranges, boost::get<0>(random_order.export_filter())));
+#else
+	ranges = sorted_order.export_filter();
+	TEST_CHECK(equal_ranges(ranges, random_order.export_filter()));
+#endif
+	std::cout << "the filter has " << ranges.size() << " ranges" << std::endl;
+
+	// the session makes a copy of the filter it's given
+	ptime start(time_now_hires());
+	ip_filter copy(sorted_order);
+	std::cout << "copy: " << total_milliseconds(time_now_hires() - start)
+		<< " ms" << std::endl;
+
+	std::vector<address> addrs;
+	int const num_lookups = 1000000;
+	for (int i = 0; i < num_lookups; ++i)
+		addrs.push_back(address_v4(random_u32()));
+
+	start = time_now_hires();
+	int blocked = 0;
+	for (std::vector<address>::const_iterator i = addrs.begin()
+		, end(addrs.end()); i != end; ++i)
+		blocked += sorted_order.access(*i);
+	ptime stop(time_now_hires());
+	std::cout << "access: " << total_microseconds(stop - start) * 1000 / num_lookups
+		<< " ns per lookup" << std::endl;
+
+	// the batch access is meant for looking up a torrent's peer list,
+	// which is sorted by address
+	std::sort(addrs.begin(), addrs.end());
+	std::vector<int> flags;
+	start = time_now_hires();
+	sorted_order.access(addrs, flags);
+	stop = time_now_hires();
+	std::cout << "batch access (sorted): " << total_microseconds(stop - start) * 1000 / num_lookups
+		<< " ns per lookup" << std::endl;
+
+	int batch_blocked = 0;
+	for (std::vector<int>::const_iterator i = flags.begin()
+		, end(flags.end()); i != end; ++i)
+		batch_blocked += *i;
+	TEST_EQUAL(batch_blocked, blocked);
+	return 0;
+}
+
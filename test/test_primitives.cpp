@@ -48,6 +48,11 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/aux_/session_impl.hpp"
 #include "libtorrent/ip_voter.hpp"
 #include "libtorrent/socket_io.hpp"
+#include "libtorrent/performance_counters.hpp"
+#include "libtorrent/session_stats.hpp"
+#include "libtorrent/latency_histogram.hpp"
+#include "libtorrent/packet_pool.hpp"
+#include "libtorrent/timer_wheel.hpp"
 #include <boost/bind.hpp>
 #include <iostream>
 #include <set>
@@ -359,6 +364,163 @@ int test_main()
 	h2 = to_hash("0123456789abcdef11232456789abcdef0123456");
 	TEST_CHECK(common_bits(&h1[0], &h2[0], 20) == 16 * 4 + 3);
 
+	// test performance counters
+	counters cnt;
+	TEST_EQUAL(cnt[counters::on_read_counter], 0);
+	cnt.inc_stats_counter(counters::on_read_counter);
+	cnt.inc_stats_counter(counters::on_read_counter, 10);
+	TEST_EQUAL(cnt[counters::on_read_counter], 11);
+	cnt.set_value(counters::num_peers_connected, 1337);
+	TEST_EQUAL(cnt[counters::num_peers_connected], 1337);
+	counters cnt2 = cnt;
+	TEST_EQUAL(cnt2[counters::on_read_counter], 11);
+
+	// every counter, gauge and histogram has exactly one metric, with a
+	// unique name
+	std::vector<stats_metric> metrics = session_stats_metrics();
+	TEST_EQUAL(int(metrics.size())
+		, int(counters::num_counters) + int(counters::num_histograms));
+	std::set<int> indices;
+	std::set<int> histogram_indices;
+	std::set<std::string> names;
+	for (int i = 0; i < int(metrics.size()); ++i)
+	{
+		names.insert(metrics[i].name);
+		TEST_EQUAL(find_metric_idx(metrics[i].name), metrics[i].value_index);
+		if (metrics[i].type == stats_metric::type_histogram)
+		{
+			histogram_indices.insert(metrics[i].value_index);
+			continue;
+		}
+		indices.insert(metrics[i].value_index);
+		bool const is_gauge = metrics[i].value_index >= counters::num_stats_counters;
+		TEST_CHECK((metrics[i].type == stats_metric::type_gauge) == is_gauge);
+	}
+	TEST_EQUAL(int(indices.size()), int(counters::num_counters));
+	TEST_EQUAL(int(histogram_indices.size()), int(counters::num_histograms));
+	TEST_EQUAL(int(names.size()), int(metrics.size()));
+	TEST_EQUAL(find_metric_idx("does-not-exist"), -1);
+
+	// test latency histogram buckets
+	for (int i = 0; i < latency_histogram::num_buckets; ++i)
+	{
+		boost::int64_t lower = latency_histogram::bucket_lower_bound(i);
+		TEST_EQUAL(latency_histogram::bucket_for(lower), i);
+		if (i > 0) TEST_EQUAL(latency_histogram::bucket_for(lower - 1), i - 1);
+	}
+	TEST_EQUAL(latency_histogram::bucket_for(-1), 0);
+	TEST_EQUAL(latency_histogram::bucket_for(1000000000)
+		, int(latency_histogram::num_buckets) - 1);
+
+	// 90 samples at 10 us and 10 samples at 5 ms
+	latency_histogram h;
+	for (int i = 0; i < 90; ++i) h.add_sample(10);
+	for (int i = 0; i < 10; ++i) h.add_sample(5000);
+	boost::uint64_t buckets[latency_histogram::num_buckets];
+	h.snapshot(buckets);
+	TEST_EQUAL(latency_histogram::num_samples(buckets), 100);
+	boost::int64_t p50 = latency_histogram::percentile(buckets, 50);
+	TEST_CHECK(p50 >= 10 && p50 < 10 * 5 / 4);
+	boost::int64_t p99 = latency_histogram::percentile(buckets, 99);
+	TEST_CHECK(p99 >= 5000 && p99 < 5000 * 5 / 4);
+	h.clear();
+	h.snapshot(buckets);
+	TEST_EQUAL(latency_histogram::num_samples(buckets), 0);
+	TEST_EQUAL(latency_histogram::percentile(buckets, 50), 0);
+
+	cnt.add_latency_sample(counters::tick_total_time, milliseconds(2));
+	cnt.histogram(counters::tick_total_time).snapshot(buckets);
+	TEST_EQUAL(latency_histogram::num_samples(buckets), 1);
+	TEST_EQUAL(buckets[latency_histogram::bucket_for(2000)], 1);
+
+	// test packet pool
+	{
+		packet_pool pool;
+		packet* p1 = pool.acquire(20);
+		packet* p2 = pool.acquire(1400);
+		packet* p3 = pool.acquire(9000);
+		TEST_EQUAL(p1->allocated, 20);
+		TEST_EQUAL(p2->allocated, 1400);
+		TEST_EQUAL(p3->allocated, 9000);
+		TEST_EQUAL(pool.in_use(), 3);
+		TEST_EQUAL(pool.misses(), 3);
+		TEST_EQUAL(pool.hits(), 0);
+
+		pool.release(p1);
+		pool.release(p2);
+		pool.release(p3);
+		pool.release(NULL);
+		TEST_EQUAL(pool.in_use(), 0);
+		TEST_EQUAL(pool.high_water(), 3);
+		// packets too big for the MTU size class are not kept
+		TEST_EQUAL(pool.num_free(), 2);
+
+		// a smaller MTU-sized packet reuses the buffer
+		packet* p4 = pool.acquire(576);
+		TEST_CHECK(p4 == p2);
+		TEST_EQUAL(p4->allocated, 576);
+		packet* p5 = pool.acquire(0);
+		TEST_CHECK(p5 == p1);
+		TEST_EQUAL(pool.hits(), 2);
+		TEST_EQUAL(pool.num_free(), 0);
+		pool.release(p4);
+		pool.release(p5);
+		TEST_EQUAL(pool.high_water(), 3);
+	}
+
+	// test timer wheel
+	{
+		timer_wheel w(100, 16);
+		ptime now = time_now_hires();
+		timer_wheel_entry e1((void*)1);
+		timer_wheel_entry e2((void*)2);
+		timer_wheel_entry e3((void*)3);
+		std::vector<timer_wheel_entry*> expired;
+
+		w.schedule(&e1, now + milliseconds(250));
+		w.schedule(&e2, now + milliseconds(550));
+		// further into the future than the wheel spans
+		w.schedule(&e3, now + seconds(60));
+		TEST_EQUAL(w.size(), 3);
+		TEST_CHECK(e1.scheduled());
+
+		w.expire(now + milliseconds(50), expired);
+		TEST_EQUAL(expired.size(), 0);
+
+		w.expire(now + milliseconds(400), expired);
+		TEST_EQUAL(expired.size(), 1);
+		TEST_CHECK(expired[0] == &e1);
+		TEST_CHECK(!e1.scheduled());
+		TEST_EQUAL(w.size(), 2);
+
+		// moving a timer
+		w.schedule(&e2, now + milliseconds(1000));
+		expired.clear();
+		w.expire(now + milliseconds(700), expired);
+		TEST_EQUAL(expired.size(), 0);
+
+		// a timer in the past expires on the next granularity step
+		w.schedule(&e1, now);
+		w.expire(now + milliseconds(750), expired);
+		TEST_EQUAL(expired.size(), 0);
+		w.expire(now + milliseconds(850), expired);
+		TEST_EQUAL(expired.size(), 1);
+		TEST_CHECK(expired[0] == &e1);
+
+		w.cancel(&e2);
+		TEST_CHECK(!e2.scheduled());
+		TEST_EQUAL(w.size(), 1);
+
+		// the timer that was too far out expires early, once
+		// the wheel has made a full revolution
+		expired.clear();
+		w.expire(now + milliseconds(2500), expired);
+		TEST_EQUAL(expired.size(), 1);
+		TEST_CHECK(expired[0] == &e3);
+		TEST_CHECK(e3.expires == now + seconds(60));
+		TEST_EQUAL(w.size(), 0);
+	}
+
 	return 0;
 }
 
@@ -0,0 +1,214 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+
+#include "test.hpp"
+#include "libtorrent/resolver.hpp"
+#include "libtorrent/io_service.hpp"
+#include "libtorrent/error_code.hpp"
+
+#include <boost/bind.hpp>
+#include <string>
+#include <vector>
+
+using namespace libtorrent;
+
+namespace
+{
+	// doesn't talk to DNS. Lookups are recorded and completed by the test
+	struct stub_resolver : resolver
+	{
+		stub_resolver(io_service& ios) : resolver(ios) {}
+
+		std::vector<std::string> queries;
+
+		void complete(std::string const& host, error_code const& ec
+			, std::vector<address> const& addresses)
+		{ on_lookup(host, ec, addresses); }
+
+	protected:
+		virtual void start_lookup(std::string const& host)
+		{ queries.push_back(host); }
+		virtual void cancel_lookups() {}
+	};
+
+	int num_callbacks = 0;
+	error_code last_error;
+	std::vector<address> last_addresses;
+
+	void on_resolve(error_code const& ec, std::vector<address> const& addresses)
+	{
+		++num_callbacks;
+		last_error = ec;
+		last_addresses = addresses;
+	}
+
+	void reset()
+	{
+		num_callbacks = 0;
+		last_error.clear();
+		last_addresses.clear();
+	}
+
+	void run(io_service& ios)
+	{
+		ios.reset();
+		ios.poll();
+	}
+}
+
+int test_main()
+{
+	io_service ios;
+	error_code ec;
+	std::vector<address> addresses;
+	addresses.push_back(address::from_string("10.0.0.1", ec));
+	addresses.push_back(address::from_string("10.0.0.2", ec));
+
+	// IP addresses are not looked up
+	{
+		stub_resolver r(ios);
+		reset();
+		r.async_resolve("10.1.2.3", &on_resolve);
+		TEST_EQUAL(num_callbacks, 0);
+		run(ios);
+		TEST_EQUAL(num_callbacks, 1);
+		TEST_CHECK(!last_error);
+		TEST_EQUAL(last_addresses.size(), 1);
+		TEST_CHECK(last_addresses[0] == address::from_string("10.1.2.3", ec));
+		TEST_CHECK(r.queries.empty());
+		TEST_EQUAL(r.lookups(), 0);
+	}
+
+	// concurrent lookups of the same name share one query, and the result
+	// is served from the cache afterwards
+	{
+		stub_resolver r(ios);
+		reset();
+		r.async_resolve("tracker.test", &on_resolve);
+		r.async_resolve("tracker.test", &on_resolve);
+		r.async_resolve("other.test", &on_resolve);
+		TEST_EQUAL(r.queries.size(), 2);
+		TEST_EQUAL(r.lookups(), 2);
+		TEST_EQUAL(r.shared_lookups(), 1);
+
+		r.complete("tracker.test", error_code(), addresses);
+		TEST_EQUAL(num_callbacks, 2);
+		TEST_CHECK(!last_error);
+		TEST_CHECK(last_addresses == addresses);
+		TEST_EQUAL(r.cache_size(), 1);
+
+		reset();
+		r.async_resolve("tracker.test", &on_resolve);
+		run(ios);
+		TEST_EQUAL(num_callbacks, 1);
+		TEST_CHECK(last_addresses == addresses);
+		TEST_EQUAL(r.queries.size(), 2);
+		TEST_EQUAL(r.cache_hits(), 1);
+	}
+
+	// failed lookups are cached too
+	{
+		stub_resolver r(ios);
+		reset();
+		r.async_resolve("missing.test", &on_resolve);
+		r.complete("missing.test", error_code(asio::error::host_not_found)
+			, std::vector<address>());
+		TEST_EQUAL(num_callbacks, 1);
+		TEST_CHECK(last_error == error_code(asio::error::host_not_found));
+
+		reset();
+		r.async_resolve("missing.test", &on_resolve);
+		run(ios);
+		TEST_EQUAL(num_callbacks, 1);
+		TEST_CHECK(last_error == error_code(asio::error::host_not_found));
+		TEST_CHECK(last_addresses.empty());
+		TEST_EQUAL(r.queries.size(), 1);
+		TEST_EQUAL(r.cache_hits(), 1);
+	}
+
+	// a timeout of 0 disables the cache, and aborted lookups are never
+	// cached
+	{
+		stub_resolver r(ios);
+		r.set_cache_timeout(0);
+		r.set_negative_cache_timeout(0);
+		reset();
+		r.async_resolve("tracker.test", &on_resolve);
+		r.complete("tracker.test", error_code(), addresses);
+		r.async_resolve("missing.test", &on_resolve);
+		r.complete("missing.test", error_code(asio::error::host_not_found)
+			, std::vector<address>());
+		TEST_EQUAL(num_callbacks, 2);
+		TEST_EQUAL(r.cache_size(), 0);
+
+		r.set_cache_timeout(1200);
+		r.set_negative_cache_timeout(60);
+		r.async_resolve("tracker.test", &on_resolve);
+		r.complete("tracker.test", error_code(asio::error::operation_aborted)
+			, std::vector<address>());
+		TEST_EQUAL(r.cache_size(), 0);
+		TEST_EQUAL(r.queries.size(), 3);
+	}
+
+	// abort() fails outstanding lookups and clears the cache
+	{
+		stub_resolver r(ios);
+		reset();
+		r.async_resolve("tracker.test", &on_resolve);
+		r.complete("tracker.test", error_code(), addresses);
+		r.async_resolve("other.test", &on_resolve);
+		TEST_EQUAL(r.cache_size(), 1);
+
+		reset();
+		r.abort();
+		TEST_EQUAL(r.cache_size(), 0);
+		run(ios);
+		TEST_EQUAL(num_callbacks, 1);
+		TEST_CHECK(last_error == error_code(asio::error::operation_aborted));
+
+		// a late result for the aborted lookup is ignored
+		r.complete("other.test", error_code(), addresses);
+		TEST_EQUAL(num_callbacks, 1);
+
+		// names are looked up again after abort()
+		reset();
+		r.async_resolve("tracker.test", &on_resolve);
+		TEST_EQUAL(r.queries.size(), 3);
+		r.complete("tracker.test", error_code(), addresses);
+		TEST_EQUAL(num_callbacks, 1);
+		TEST_CHECK(last_addresses == addresses);
+	}
+
+	return 0;
+}
+
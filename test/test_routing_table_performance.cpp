@@ -0,0 +1,116 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/kademlia/routing_table.hpp"
+#include "libtorrent/kademlia/node_id.hpp"
+#include "libtorrent/session_settings.hpp"
+#include "libtorrent/time.hpp"
+#include <iostream>
+#include <cstdlib>
+
+#include "test.hpp"
+
+using namespace libtorrent;
+using namespace libtorrent::dht;
+
+node_id random_id()
+{
+	node_id ret;
+	for (int i = 0; i < 20; ++i) ret[i] = std::rand() & 0xff;
+	return ret;
+}
+
+address_v4 random_v4()
+{
+	return address_v4((std::rand() << 16 | std::rand()) & 0xffffffff);
+}
+
+int test_main()
+{
+	using namespace libtorrent;
+
+	dht_settings s;
+	node_id our_id = random_id();
+	// a bucket size of 8 saturates at around a thousand nodes. Use
+	// larger buckets to get a table of the size a busy node would have
+	routing_table table(our_id, 64, s);
+
+	// keep feeding the table with nodes until it holds 5000 of them,
+	// live and replacements combined. Most random IDs land in the far
+	// away buckets, so spread them out across the ID space by sharing
+	// a random length prefix with our own ID
+	int total = 0;
+	for (int i = 0; total < 5000 && i < 1000000; ++i)
+	{
+		node_id id = random_id();
+		int const shared_bits = std::rand() % 32;
+		for (int b = 0; b < shared_bits; ++b)
+		{
+			boost::uint8_t const mask = 0x80 >> (b & 7);
+			id[b / 8] = (id[b / 8] & ~mask) | (our_id[b / 8] & mask);
+		}
+		table.node_seen(id, udp::endpoint(random_v4(), 1 + std::rand() % 65534), 10);
+		if ((i & 0xff) == 0)
+			total = table.size().get<0>() + table.size().get<1>();
+	}
+	total = table.size().get<0>() + table.size().get<1>();
+	std::cout << "routing table: " << table.size().get<0>() << " live nodes, "
+		<< table.size().get<1>() << " replacements, "
+		<< table.num_active_buckets() << " buckets" << std::endl;
+	TEST_CHECK(total >= 5000);
+
+	std::vector<node_id> targets;
+	for (int i = 0; i < 1000; ++i) targets.push_back(random_id());
+
+	std::vector<node_entry> l;
+	int const rounds = 200;
+	ptime start(time_now_hires());
+	size_type found = 0;
+	for (int r = 0; r < rounds; ++r)
+	{
+		for (std::vector<node_id>::iterator i = targets.begin()
+			, end(targets.end()); i != end; ++i)
+		{
+			table.find_node(*i, l, 0, 8);
+			found += l.size();
+		}
+	}
+	ptime stop(time_now_hires());
+
+	int const lookups = rounds * int(targets.size());
+	TEST_EQUAL(found, size_type(lookups) * 8);
+
+	std::cout << "find_node: " << total_microseconds(stop - start) * 1000 / lookups
+		<< " ns per lookup (" << lookups << " lookups)" << std::endl;
+	return 0;
+}
+
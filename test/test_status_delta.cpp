@@ -0,0 +1,244 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "test.hpp"
+#include "libtorrent/status_delta.hpp"
+#include "libtorrent/torrent_handle.hpp"
+#include "libtorrent/time.hpp"
+
+#include <vector>
+#include <cstdio>
+#include <algorithm>
+
+using namespace libtorrent;
+
+// compares all fields that are carried by torrent_status_delta
+void compare_status(torrent_status const& lhs, torrent_status const& rhs)
+{
+	TEST_EQUAL(lhs.state, rhs.state);
+	TEST_EQUAL(lhs.paused, rhs.paused);
+	TEST_EQUAL(lhs.auto_managed, rhs.auto_managed);
+	TEST_EQUAL(lhs.queue_position, rhs.queue_position);
+	TEST_EQUAL(lhs.progress, rhs.progress);
+	TEST_EQUAL(lhs.progress_ppm, rhs.progress_ppm);
+	TEST_EQUAL(lhs.total_done, rhs.total_done);
+	TEST_EQUAL(lhs.download_rate, rhs.download_rate);
+	TEST_EQUAL(lhs.upload_rate, rhs.upload_rate);
+	TEST_EQUAL(lhs.total_download, rhs.total_download);
+	TEST_EQUAL(lhs.all_time_upload, rhs.all_time_upload);
+	TEST_EQUAL(lhs.num_peers, rhs.num_peers);
+	TEST_EQUAL(lhs.distributed_copies, rhs.distributed_copies);
+	TEST_EQUAL(lhs.current_tracker, rhs.current_tracker);
+	TEST_CHECK(lhs.next_announce == rhs.next_announce);
+	TEST_EQUAL(lhs.added_time, rhs.added_time);
+	TEST_EQUAL(lhs.active_time, rhs.active_time);
+	TEST_EQUAL(lhs.error, rhs.error);
+	TEST_EQUAL(lhs.name, rhs.name);
+	TEST_EQUAL(lhs.save_path, rhs.save_path);
+	TEST_CHECK(lhs.info_hash == rhs.info_hash);
+	TEST_EQUAL(lhs.pieces.size(), rhs.pieces.size());
+	for (int i = 0; i < (std::min)(lhs.pieces.size(), rhs.pieces.size()); ++i)
+		TEST_EQUAL(lhs.pieces.get_bit(i), rhs.pieces.get_bit(i));
+}
+
+torrent_status make_status(int i)
+{
+	torrent_status st;
+	char name[100];
+	snprintf(name, sizeof(name), "torrent-%d", i);
+	st.name = name;
+	st.save_path = "/var/lib/downloads/complete";
+	st.current_tracker = "http://tracker.example.com:6969/announce";
+	st.info_hash[0] = i & 0xff;
+	st.info_hash[1] = (i >> 8) & 0xff;
+	st.state = torrent_status::downloading;
+	st.queue_position = i;
+	st.added_time = 1390000000 + i;
+	st.next_announce = boost::posix_time::seconds(1800);
+	st.announce_interval = boost::posix_time::seconds(1800);
+	st.pieces.resize(1000, false);
+	st.total_wanted = 1000 * 0x40000;
+	st.has_metadata = true;
+	return st;
+}
+
+// simulates one second passing for a torrent. Every torrent ticks its
+// timers, one in ten is transferring data
+void tick(torrent_status& st, int i, int round)
+{
+	++st.active_time;
+	st.next_announce -= boost::posix_time::seconds(1);
+	if ((i + round) % 10 != 0) return;
+
+	st.download_rate = 1000 * (round + 1);
+	st.download_payload_rate = 900 * (round + 1);
+	st.total_download += st.download_rate;
+	st.total_payload_download += st.download_payload_rate;
+	st.total_done += 0x40000;
+	st.total_wanted_done += 0x40000;
+	st.progress_ppm = st.total_wanted_done * 1000000 / st.total_wanted;
+	st.progress = st.progress_ppm / 1000000.f;
+	st.pieces.set_bit(round % st.pieces.size());
+	st.num_pieces = st.pieces.count();
+	++st.num_peers;
+}
+
+int full_status_size(torrent_status const& st)
+{
+	return int(sizeof(st) + st.name.size() + st.save_path.size()
+		+ st.current_tracker.size() + st.error.size()
+		+ (st.pieces.size() + 7) / 8 + (st.verified_pieces.size() + 7) / 8);
+}
+
+int test_main()
+{
+	// the first delta contains everything, applying it to a default
+	// constructed status reproduces the original
+	{
+		status_snapshot snap;
+		torrent_status st = make_status(1);
+		st.error = "disk full";
+		torrent_status_delta d;
+		TEST_CHECK(snap.update(st, d));
+		TEST_EQUAL(d.fields, torrent_status_delta::all_fields);
+
+		torrent_status copy;
+		d.apply(copy);
+		compare_status(copy, st);
+
+		// nothing changed
+		TEST_CHECK(!snap.update(st, d));
+		TEST_EQUAL(d.fields, 0);
+		TEST_CHECK(d.data.empty());
+
+		// only the rate group changed
+		st.upload_rate = 1337;
+		TEST_CHECK(snap.update(st, d));
+		TEST_EQUAL(d.fields, torrent_status_delta::rate_fields);
+		d.apply(copy);
+		compare_status(copy, st);
+
+		// a string and a bitfield
+		st.error.clear();
+		st.pieces.set_bit(10);
+		TEST_CHECK(snap.update(st, d));
+		TEST_EQUAL(d.fields, boost::uint32_t(torrent_status_delta::error_fields
+			| torrent_status_delta::piece_fields));
+		d.apply(copy);
+		compare_status(copy, st);
+
+		snap.clear();
+		TEST_CHECK(snap.update(st, d));
+		TEST_EQUAL(d.fields, torrent_status_delta::all_fields);
+	}
+
+	// benchmark. Compare the bytes and CPU of copying full torrent_status
+	// objects for every torrent, to generating and applying deltas
+	const int num_torrents = 40000;
+	const int num_rounds = 10;
+
+	std::vector<torrent_status> source;
+	source.reserve(num_torrents);
+	for (int i = 0; i < num_torrents; ++i)
+		source.push_back(make_status(i));
+
+	std::vector<torrent_status> client(source.size());
+	std::vector<status_snapshot> snapshots(source.size());
+	std::vector<torrent_status_delta> deltas;
+
+	// initial round, populate the client side
+	for (int i = 0; i < num_torrents; ++i)
+	{
+		torrent_status_delta d;
+		snapshots[i].update(source[i], d);
+		d.apply(client[i]);
+	}
+
+	boost::int64_t full_bytes = 0;
+	boost::int64_t delta_bytes = 0;
+	time_duration full_time = seconds(0);
+	time_duration encode_time = seconds(0);
+	time_duration apply_time = seconds(0);
+
+	for (int round = 0; round < num_rounds; ++round)
+	{
+		for (int i = 0; i < num_torrents; ++i)
+			tick(source[i], i, round);
+
+		ptime start = time_now_hires();
+		std::vector<torrent_status> full(source);
+		full_time += time_now_hires() - start;
+		for (int i = 0; i < num_torrents; ++i)
+			full_bytes += full_status_size(full[i]);
+
+		start = time_now_hires();
+		deltas.clear();
+		for (int i = 0; i < num_torrents; ++i)
+		{
+			deltas.push_back(torrent_status_delta());
+			if (!snapshots[i].update(source[i], deltas.back()))
+				deltas.pop_back();
+		}
+		encode_time += time_now_hires() - start;
+
+		// every torrent ticks its timers, so there's one delta per torrent
+		// and the index maps the delta to the client's status. A real client
+		// would look it up by the delta's handle
+		TEST_EQUAL(int(deltas.size()), num_torrents);
+		start = time_now_hires();
+		for (int i = 0; i < int(deltas.size()); ++i)
+			deltas[i].apply(client[i]);
+		apply_time += time_now_hires() - start;
+
+		for (std::vector<torrent_status_delta>::iterator i = deltas.begin()
+			, end(deltas.end()); i != end; ++i)
+			delta_bytes += i->size();
+	}
+
+	for (int i = 0; i < num_torrents; i += 97)
+		compare_status(client[i], source[i]);
+
+	fprintf(stderr, "%d torrents, per update round:\n"
+		"  full status: %d kB %d ms\n"
+		"  delta:       %d kB encode: %d ms apply: %d ms\n"
+		, num_torrents
+		, int(full_bytes / num_rounds / 1000)
+		, int(total_milliseconds(full_time) / num_rounds)
+		, int(delta_bytes / num_rounds / 1000)
+		, int(total_milliseconds(encode_time) / num_rounds)
+		, int(total_milliseconds(apply_time) / num_rounds));
+
+	TEST_CHECK(delta_bytes < full_bytes);
+
+	return 0;
+}
+
@@ -42,7 +42,8 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "setup_transfer.hpp"
 #include <iostream>
 
-void test_swarm(bool super_seeding = false, bool strict = false, bool seed_mode = false, bool time_critical = false)
+void test_swarm(bool super_seeding = false, bool strict = false, bool seed_mode = false, bool time_critical = false
+	, int network_threads = 0)
 {
 	using namespace libtorrent;
 
@@ -72,6 +73,7 @@ void test_swarm(bool super_seeding = false, bool strict = false, bool seed_mode
 	settings.allow_multiple_connections_per_ip = true;
 	settings.ignore_limits_on_local_network = false;
 	settings.strict_super_seeding = strict;
+	settings.network_threads = network_threads;
 
 	settings.upload_rate_limit = rate_limit;
 	ses1.set_settings(settings);
@@ -225,6 +227,9 @@ int test_main()
 	// with strict super seeding
 	test_swarm(true, true);
 
+	// with peer socket writes issued by the network thread pool
+	test_swarm(false, false, false, false, 2);
+
 	return 0;
 }
 
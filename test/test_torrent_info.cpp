@@ -95,6 +95,75 @@ int test_main()
 		fprintf(stderr, "%s == %s\n", p.c_str(), filenames[i]);
 		TEST_CHECK(p == filenames[i]);
 	}
-	
+
+	// web seed connections
+
+	web_seed_entry web("http://127.0.0.1/", web_seed_entry::url_seed);
+	TEST_EQUAL(web.connection_limit, 1);
+
+	// every connection gets its own peer entry. Free ones are reused
+	peer_connection* const c1 = reinterpret_cast<peer_connection*>(1);
+	peer_connection* const c2 = reinterpret_cast<peer_connection*>(2);
+	peer_connection* const c3 = reinterpret_cast<peer_connection*>(3);
+	policy::ipv4_peer& p1 = web.unused_peer();
+	TEST_CHECK(&p1 == &web.peer_info);
+	p1.connection = c1;
+	policy::ipv4_peer& p2 = web.unused_peer();
+	TEST_CHECK(&p2 != &p1);
+	TEST_CHECK(p2.web_seed);
+	p2.connection = c2;
+	policy::ipv4_peer& p3 = web.unused_peer();
+	TEST_CHECK(&p3 != &p1 && &p3 != &p2);
+	p3.connection = c3;
+	TEST_EQUAL(web.extra_peers.size(), 2);
+	p2.connection = 0;
+	TEST_CHECK(&web.unused_peer() == &p2);
+	TEST_EQUAL(web.extra_peers.size(), 2);
+
+	// the limit is only raised once all allowed connections are open, and
+	// the rate went up by at least 10%
+	ptime now = time_now();
+	TEST_CHECK(!web.update_connection_limit(0, 1000, 4, now));
+	TEST_CHECK(web.update_connection_limit(1, 1000, 4, now));
+	TEST_EQUAL(web.connection_limit, 2);
+	TEST_CHECK(!web.update_connection_limit(1, 5000, 4, now + seconds(10)));
+	// not before 10 seconds have passed
+	TEST_CHECK(!web.update_connection_limit(2, 5000, 4, now + seconds(5)));
+	TEST_CHECK(web.update_connection_limit(2, 2000, 4, now + seconds(10)));
+	TEST_EQUAL(web.connection_limit, 3);
+	// another connection didn't help
+	TEST_CHECK(!web.update_connection_limit(3, 2100, 4, now + seconds(20)));
+	TEST_EQUAL(web.connection_limit, 3);
+	// so it's not tried again for a minute
+	TEST_CHECK(!web.update_connection_limit(3, 3000, 4, now + seconds(30)));
+	TEST_EQUAL(web.connection_limit, 3);
+	TEST_CHECK(web.update_connection_limit(3, 2100, 4, now + seconds(80)));
+	TEST_EQUAL(web.connection_limit, 4);
+	// never above urlseed_max_connections
+	TEST_CHECK(!web.update_connection_limit(4, 9000, 4, now + seconds(90)));
+	TEST_EQUAL(web.connection_limit, 4);
+	TEST_CHECK(!web.update_connection_limit(4, 9000, 2, now + seconds(100)));
+	TEST_EQUAL(web.connection_limit, 2);
+
+	// a 429 or 503 halves the limit, and holds it for a while
+	web.connection_limit = 4;
+	web.last_rate = 9000;
+	web.throttle(now + seconds(170));
+	TEST_EQUAL(web.connection_limit, 2);
+	TEST_CHECK(!web.update_connection_limit(2, 90000, 4, now + seconds(160)));
+	TEST_EQUAL(web.connection_limit, 2);
+	web.throttle(now + seconds(170));
+	TEST_EQUAL(web.connection_limit, 1);
+	web.throttle(now + seconds(170));
+	TEST_EQUAL(web.connection_limit, 1);
+	// with a single connection, the rate is well below what it was with
+	// four. The limit grows again as long as connections help
+	TEST_CHECK(web.update_connection_limit(1, 3000, 4, now + seconds(170)));
+	TEST_EQUAL(web.connection_limit, 2);
+	TEST_CHECK(web.update_connection_limit(2, 4000, 4, now + seconds(180)));
+	TEST_EQUAL(web.connection_limit, 3);
+	TEST_CHECK(!web.update_connection_limit(3, 4100, 4, now + seconds(190)));
+	TEST_EQUAL(web.connection_limit, 3);
+
 	return 0;
 }
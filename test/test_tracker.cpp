@@ -34,24 +34,222 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "setup_transfer.hpp"
 #include "udp_tracker.hpp"
 #include "libtorrent/alert.hpp"
+#include "libtorrent/alert_types.hpp"
 #include "libtorrent/session.hpp"
 #include "libtorrent/error_code.hpp"
 
 #include <fstream>
+#include <vector>
 
 using namespace libtorrent;
 
+// announces and scrapes num_torrents torrents to the UDP tracker and checks
+// that they share connect and scrape packets. This must run before anything
+// else talks to the tracker, since connection IDs are cached for a minute,
+// and a cached ID would mean no connect message is sent at all
+void test_udp_sharing(int udp_port, int alert_mask)
+{
+	session* s = new libtorrent::session(fingerprint("LT", 0, 1, 0, 0), std::make_pair(39875, 39900), "0.0.0.0", 0, alert_mask);
+
+	session_settings sett;
+	sett.half_open_limit = 1;
+	sett.announce_to_all_trackers = true;
+	sett.announce_to_all_tiers = true;
+	sett.tracker_completion_timeout = 30;
+	sett.tracker_receive_timeout = 10;
+	s->set_settings(sett);
+
+	int prev_udp_announces = num_udp_announces();
+	int prev_udp_connects = num_udp_connects();
+	int prev_udp_scrapes = num_udp_scrapes();
+	int prev_udp_scraped_hashes = num_udp_scraped_hashes();
+
+	char tracker_url[200];
+	snprintf(tracker_url, sizeof(tracker_url), "udp://127.0.0.1:%d/announce", udp_port);
+
+	add_torrent_params addp;
+	addp.flags &= ~add_torrent_params::flag_paused;
+	addp.flags &= ~add_torrent_params::flag_auto_managed;
+	addp.flags |= add_torrent_params::flag_seed_mode;
+
+	const int num_torrents = 20;
+	std::vector<torrent_handle> handles;
+	for (int i = 0; i < num_torrents; ++i)
+	{
+		// a different number of pieces gives every torrent its own info-hash
+		boost::intrusive_ptr<torrent_info> t = ::create_torrent(0, 16 * 1024, i + 1, false);
+		t->add_tracker(tracker_url, 0);
+		addp.ti = t;
+		addp.save_path = "tmp3_tracker";
+		handles.push_back(s->add_torrent(addp));
+	}
+
+	for (int i = 0; i < 50; ++i)
+	{
+		print_alerts(*s, "s");
+		if (num_udp_announces() == prev_udp_announces + num_torrents) break;
+		test_sleep(100);
+	}
+
+	TEST_EQUAL(num_udp_announces(), prev_udp_announces + num_torrents);
+	// announces can't share a packet, but they share the connection ID.
+	// The tracker hasn't been contacted before, so exactly one connect
+	// message is needed
+	fprintf(stderr, "announced %d torrents with %d connect messages\n"
+		, num_torrents, num_udp_connects() - prev_udp_connects);
+	TEST_EQUAL(num_udp_connects() - prev_udp_connects, 1);
+
+	for (std::vector<torrent_handle>::iterator i = handles.begin()
+		, end(handles.end()); i != end; ++i)
+		i->scrape_tracker();
+
+	for (int i = 0; i < 50; ++i)
+	{
+		print_alerts(*s, "s");
+		if (num_udp_scraped_hashes() == prev_udp_scraped_hashes + num_torrents) break;
+		test_sleep(100);
+	}
+
+	int scrape_packets = num_udp_scrapes() - prev_udp_scrapes;
+	fprintf(stderr, "scraped %d torrents with %d packets\n"
+		, num_udp_scraped_hashes() - prev_udp_scraped_hashes, scrape_packets);
+	TEST_EQUAL(num_udp_scraped_hashes(), prev_udp_scraped_hashes + num_torrents);
+	TEST_CHECK(scrape_packets < num_torrents);
+	// the connection ID from the announces is still valid
+	TEST_EQUAL(num_udp_connects() - prev_udp_connects, 1);
+
+	fprintf(stderr, "destructing session\n");
+	delete s;
+	fprintf(stderr, "done\n");
+}
+
+int tracker_replies = 0;
+
+bool on_tracker_alert(alert* a)
+{
+	if (alert_cast<tracker_reply_alert>(a)) ++tracker_replies;
+	return false;
+}
+
+// adds a torrent announcing to tracker_url and waits for the response
+void announce_and_wait(session& s, char const* tracker_url, int num_pieces)
+{
+	int prev_replies = tracker_replies;
+
+	add_torrent_params addp;
+	addp.flags &= ~add_torrent_params::flag_paused;
+	addp.flags &= ~add_torrent_params::flag_auto_managed;
+	addp.flags |= add_torrent_params::flag_seed_mode;
+	// a different number of pieces gives every torrent its own info-hash
+	addp.ti = ::create_torrent(0, 16 * 1024, num_pieces, false);
+	addp.ti->add_tracker(tracker_url, 0);
+	addp.save_path = "tmp4_tracker";
+	s.add_torrent(addp);
+
+	for (int i = 0; i < 50; ++i)
+	{
+		print_alerts(s, "s", false, false, false, &on_tracker_alert);
+		if (tracker_replies > prev_replies) break;
+		test_sleep(100);
+	}
+	TEST_EQUAL(tracker_replies, prev_replies + 1);
+}
+
+// announces to the HTTP tracker one torrent at a time, and checks that the
+// connections are kept alive and reused
+void test_http_keepalive(int http_port, int alert_mask)
+{
+	session* s = new libtorrent::session(fingerprint("LT", 0, 1, 0, 0), std::make_pair(39905, 39930), "0.0.0.0", 0, alert_mask);
+
+	session_settings sett;
+	sett.tracker_keepalive_connections = 1;
+	sett.tracker_keepalive_timeout = 2;
+	s->set_settings(sett);
+
+	char keepalive_url[200];
+	snprintf(keepalive_url, sizeof(keepalive_url), "http://127.0.0.1:%d/keepalive/announce", http_port);
+	char close_url[200];
+	snprintf(close_url, sizeof(close_url), "http://127.0.0.1:%d/announce", http_port);
+
+	// the first announce opens a connection, which is kept afterwards
+	announce_and_wait(*s, keepalive_url, 1);
+	session_status st = s->status();
+	TEST_EQUAL(st.total_tracker_connections, 1);
+	TEST_EQUAL(st.total_tracker_connection_reuses, 0);
+	TEST_EQUAL(st.num_idle_tracker_connections, 1);
+
+	// the next one reuses it
+	announce_and_wait(*s, keepalive_url, 2);
+	st = s->status();
+	TEST_EQUAL(st.total_tracker_connections, 1);
+	TEST_EQUAL(st.total_tracker_connection_reuses, 1);
+	TEST_EQUAL(st.num_idle_tracker_connections, 1);
+
+	// a tracker that closes the connection after its response (on the
+	// same host, so the idle connection is used) doesn't leave one behind
+	announce_and_wait(*s, close_url, 3);
+	st = s->status();
+	TEST_EQUAL(st.total_tracker_connection_reuses, 2);
+	TEST_EQUAL(st.num_idle_tracker_connections, 0);
+
+	// several announces at once need several connections. Only
+	// tracker_keepalive_connections of them are kept
+	int prev_connections = int(st.total_tracker_connections);
+	int prev_replies = tracker_replies;
+	add_torrent_params addp;
+	addp.flags &= ~add_torrent_params::flag_paused;
+	addp.flags &= ~add_torrent_params::flag_auto_managed;
+	addp.flags |= add_torrent_params::flag_seed_mode;
+	addp.save_path = "tmp4_tracker";
+	for (int i = 0; i < 3; ++i)
+	{
+		addp.ti = ::create_torrent(0, 16 * 1024, 4 + i, false);
+		addp.ti->add_tracker(keepalive_url, 0);
+		s->add_torrent(addp);
+	}
+	for (int i = 0; i < 50; ++i)
+	{
+		print_alerts(*s, "s", false, false, false, &on_tracker_alert);
+		if (tracker_replies == prev_replies + 3) break;
+		test_sleep(100);
+	}
+	TEST_EQUAL(tracker_replies, prev_replies + 3);
+	st = s->status();
+	fprintf(stderr, "3 concurrent announces opened %d connections\n"
+		, int(st.total_tracker_connections) - prev_connections);
+	TEST_CHECK(st.total_tracker_connections > prev_connections);
+	TEST_EQUAL(st.num_idle_tracker_connections, 1);
+
+	// once tracker_keepalive_timeout has passed, the idle connection is
+	// closed instead of reused
+	test_sleep(3000);
+	prev_connections = int(st.total_tracker_connections);
+	int prev_reuses = int(st.total_tracker_connection_reuses);
+	announce_and_wait(*s, keepalive_url, 7);
+	st = s->status();
+	TEST_EQUAL(st.total_tracker_connections, prev_connections + 1);
+	TEST_EQUAL(st.total_tracker_connection_reuses, prev_reuses);
+	TEST_EQUAL(st.num_idle_tracker_connections, 1);
+
+	fprintf(stderr, "destructing session\n");
+	delete s;
+	fprintf(stderr, "done\n");
+}
+
 int test_main()
 {
 	int http_port = start_web_server();
 	int udp_port = start_udp_tracker();
 
-	int prev_udp_announces = num_udp_announces();
-
 	int const alert_mask = alert::all_categories
 		& ~alert::progress_notification
 		& ~alert::stats_notification;
 
+	test_udp_sharing(udp_port, alert_mask);
+	test_http_keepalive(http_port, alert_mask);
+
+	int prev_udp_announces = num_udp_announces();
+
 	session* s = new libtorrent::session(fingerprint("LT", 0, 1, 0, 0), std::make_pair(48875, 49800), "0.0.0.0", 0, alert_mask);
 
 	session_settings sett;
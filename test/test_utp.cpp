@@ -38,6 +38,7 @@ POSSIBILITY OF SUCH DAMAGE.
 #include "libtorrent/thread.hpp"
 #include "libtorrent/time.hpp"
 #include "libtorrent/file.hpp"
+#include "libtorrent/utp_stream.hpp"
 #include <boost/tuple/tuple.hpp>
 #include <boost/bind.hpp>
 
@@ -138,10 +139,66 @@ void test_transfer()
 	p2 = ses2.abort();
 }
 
+void test_pacing()
+{
+	// without an RTT estimate, packets aren't paced
+	TEST_EQUAL(utp_pacer::rate(100000, 0, false), 0);
+	TEST_EQUAL(utp_pacer::rate(100000, 100, false), 1250000);
+	TEST_EQUAL(utp_pacer::rate(100000, 100, true), 2000000);
+
+	ptime const start = time_now_hires();
+	utp_pacer p(start);
+
+	// a rate of 0 means no pacing
+	TEST_EQUAL(p.wait(1000, 0, 1000, start), 0);
+
+	// the bucket starts out empty
+	boost::int64_t const rate = 1250000;
+	TEST_CHECK(p.wait(1000, rate, 1000, start) > 0);
+
+	// and holds at most 2 milliseconds worth of data (2500 bytes)
+	ptime now = start + milliseconds(10);
+	TEST_EQUAL(p.wait(1000, rate, 1000, now), 0);
+	p.use(1000);
+	TEST_EQUAL(p.wait(1000, rate, 1000, now), 0);
+	p.use(1000);
+	int w = p.wait(1000, rate, 1000, now);
+	TEST_CHECK(w > 0);
+
+	// send 20 packets as soon as we're allowed to. After the first burst
+	// they're spaced out at the pacing rate
+	now += microsec(w);
+	ptime const first = now;
+	for (int i = 0; i < 20; ++i)
+	{
+		w = p.wait(1000, rate, 1000, now);
+		if (w > 0)
+		{
+			// each packet is allowed after one packet's worth of time
+			TEST_CHECK(w <= 1000000 * 1000 / rate + 1);
+			now += microsec(w);
+			TEST_EQUAL(p.wait(1000, rate, 1000, now), 0);
+		}
+		p.use(1000);
+	}
+	// the first one is sent right away, the other 19 are sent 800
+	// microseconds apart
+	int const elapsed = total_microseconds(now - first);
+	fprintf(stderr, "paced 20 packets in %d us\n", elapsed);
+	TEST_CHECK(elapsed >= 19 * 790 && elapsed <= 19 * 810);
+
+	// a packet that grew while Nagle held it back has to be paid back
+	// before the next one is sent
+	p.use(5000);
+	w = p.wait(1000, rate, 1000, now);
+	TEST_CHECK(w >= 1000000 * 6000 / rate);
+}
+
 int test_main()
 {
 	using namespace libtorrent;
 
+	test_pacing();
 	test_transfer();
 	
 	error_code ec;
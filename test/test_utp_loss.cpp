@@ -0,0 +1,232 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "libtorrent/session.hpp"
+#include "libtorrent/session_settings.hpp"
+#include "libtorrent/alert_types.hpp"
+#include "libtorrent/thread.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/file.hpp"
+#include "libtorrent/socket.hpp"
+#include "libtorrent/io_service.hpp"
+#include <boost/tuple/tuple.hpp>
+#include <boost/bind.hpp>
+
+#include "test.hpp"
+#include "setup_transfer.hpp"
+#include <fstream>
+
+using namespace libtorrent;
+using boost::tuples::ignore;
+
+// measures uTP goodput over a lossy link. The downloader connects to the
+// seed through a UDP relay, which forwards packets in both directions and
+// drops a fraction of them
+
+namespace
+{
+	struct udp_relay
+	{
+		udp_relay(io_service& ios, int target_port, int loss_permille)
+			: forwarded(0)
+			, dropped(0)
+			, m_sock(ios)
+			, m_target(address_v4::loopback(), target_port)
+			, m_loss(loss_permille)
+			, m_rand(0x1234567)
+		{
+			error_code ec;
+			m_sock.open(udp::v4(), ec);
+			m_sock.bind(udp::endpoint(address_v4::loopback(), 0), ec);
+			TEST_CHECK(!ec);
+			start();
+		}
+
+		int port() const
+		{
+			error_code ec;
+			return m_sock.local_endpoint(ec).port();
+		}
+
+		void close()
+		{
+			error_code ec;
+			m_sock.close(ec);
+		}
+
+		int forwarded;
+		int dropped;
+
+	private:
+
+		bool drop()
+		{
+			// a deterministic sequence, to make runs comparable
+			m_rand = m_rand * 1103515245 + 12345;
+			return int((m_rand >> 16) % 1000) < m_loss;
+		}
+
+		void start()
+		{
+			m_sock.async_receive_from(asio::buffer(m_buf, sizeof(m_buf)), m_from
+				, boost::bind(&udp_relay::on_receive, this, _1, _2));
+		}
+
+		void on_receive(error_code const& ec, std::size_t bytes)
+		{
+			if (ec == asio::error::operation_aborted) return;
+			if (!ec)
+			{
+				udp::endpoint to;
+				if (m_from == m_target) to = m_client;
+				else
+				{
+					m_client = m_from;
+					to = m_target;
+				}
+
+				if (to.port() != 0)
+				{
+					if (drop())
+					{
+						++dropped;
+					}
+					else
+					{
+						error_code err;
+						m_sock.send_to(asio::buffer(m_buf, bytes), to, 0, err);
+						++forwarded;
+					}
+				}
+			}
+			start();
+		}
+
+		udp::socket m_sock;
+		udp::endpoint m_target;
+		udp::endpoint m_client;
+		udp::endpoint m_from;
+		int m_loss;
+		boost::uint32_t m_rand;
+		char m_buf[2000];
+	};
+}
+
+void test_transfer(int loss_permille, bool pacing = true)
+{
+	// in case the previous run was terminated
+	error_code ec;
+	remove_all("./tmp1_utp_loss", ec);
+	remove_all("./tmp2_utp_loss", ec);
+
+	session_proxy p1;
+	session_proxy p2;
+
+	session ses1(fingerprint("LT", 0, 1, 0, 0), std::make_pair(48875, 49930), "0.0.0.0", 0);
+	session ses2(fingerprint("LT", 0, 1, 0, 0), std::make_pair(49875, 50930), "0.0.0.0", 0);
+
+	session_settings sett;
+	sett.enable_outgoing_tcp = false;
+	sett.enable_incoming_tcp = false;
+	sett.utp_dynamic_sock_buf = true;
+	sett.utp_pacing = pacing;
+	ses1.set_settings(sett);
+	ses2.set_settings(sett);
+
+#ifndef TORRENT_DISABLE_ENCRYPTION
+	pe_settings pes;
+	pes.out_enc_policy = pe_settings::disabled;
+	pes.in_enc_policy = pe_settings::disabled;
+	ses1.set_pe_settings(pes);
+	ses2.set_pe_settings(pes);
+#endif
+
+	io_service ios;
+	udp_relay relay(ios, ses1.listen_port(), loss_permille);
+	thread relay_thread(boost::bind(&io_service::run, &ios));
+
+	torrent_handle tor1;
+	torrent_handle tor2;
+
+	create_directory("./tmp1_utp_loss", ec);
+	std::ofstream file("./tmp1_utp_loss/temporary");
+	boost::intrusive_ptr<torrent_info> t = ::create_torrent(&file, 16 * 1024, 256, false);
+	file.close();
+
+	boost::tie(tor1, tor2, ignore) = setup_transfer(&ses1, &ses2, 0
+		, true, false, false, "_utp_loss", 16 * 1024, &t);
+
+	tor2.connect_peer(tcp::endpoint(address_v4::loopback(), relay.port()));
+
+	ptime start = time_now_hires();
+	ptime deadline = start + seconds(120);
+	while (time_now_hires() < deadline)
+	{
+		print_alerts(ses1, "ses1", true, true, true);
+		print_alerts(ses2, "ses2", true, true, true);
+
+		test_sleep(100);
+		if (tor2.status().is_finished) break;
+	}
+
+	int ms = total_milliseconds(time_now_hires() - start);
+	TEST_CHECK(tor2.status().is_finished);
+
+	fprintf(stderr, "loss: %.1f%% pacing: %s time: %d ms goodput: %.2f MB/s "
+		"(forwarded: %d dropped: %d)\n"
+		, loss_permille / 10.f, pacing ? "on" : "off", ms, t->total_size() / 1000.f / (std::max)(ms, 1)
+		, relay.forwarded, relay.dropped);
+
+	// this allows shutting down the sessions in parallel
+	p1 = ses1.abort();
+	p2 = ses2.abort();
+
+	ios.post(boost::bind(&udp_relay::close, &relay));
+	relay_thread.join();
+}
+
+int test_main()
+{
+	using namespace libtorrent;
+
+	test_transfer(0);
+	test_transfer(10);
+	test_transfer(50);
+	test_transfer(50, false);
+
+	error_code ec;
+	remove_all("./tmp1_utp_loss", ec);
+	remove_all("./tmp2_utp_loss", ec);
+
+	return 0;
+}
+
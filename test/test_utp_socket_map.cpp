@@ -0,0 +1,204 @@
+/*
+
+Copyright (c) 2014, Arvid Norberg
+All rights reserved.
+
+Redistribution and use in source and binary forms, with or without
+modification, are permitted provided that the following conditions
+are met:
+
+    * Redistributions of source code must retain the above copyright
+      notice, this list of conditions and the following disclaimer.
+    * Redistributions in binary form must reproduce the above copyright
+      notice, this list of conditions and the following disclaimer in
+      the documentation and/or other materials provided with the distribution.
+    * Neither the name of the author nor the names of its
+      contributors may be used to endorse or promote products derived
+      from this software without specific prior written permission.
+
+THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS BE
+LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE
+POSSIBILITY OF SUCH DAMAGE.
+
+*/
+
+#include "test.hpp"
+#include "libtorrent/utp_socket_map.hpp"
+#include "libtorrent/time.hpp"
+#include "libtorrent/socket_io.hpp" // for print_endpoint
+
+#include <map>
+#include <vector>
+
+using namespace libtorrent;
+
+namespace
+{
+	// the map never dereferences the socket pointers, so
+	// any unique value will do
+	utp_socket_impl* fake_socket(int i)
+	{
+		return reinterpret_cast<utp_socket_impl*>(boost::uintptr_t(i + 1) * 16);
+	}
+
+	udp::endpoint peer_ep(int i)
+	{
+		return udp::endpoint(address_v4(0x0a000000 + (i >> 4)), 6881 + (i & 15));
+	}
+
+	// this is how the socket manager used to look up sockets. The
+	// connection ID is picked randomly by the peer, and the endpoint
+	// is compared once the ID matches
+	struct baseline_entry
+	{
+		udp::endpoint ep;
+		utp_socket_impl* sock;
+	};
+	typedef std::multimap<boost::uint16_t, baseline_entry> baseline_map;
+
+	utp_socket_impl* baseline_find(baseline_map const& m
+		, udp::endpoint const& ep, boost::uint16_t id)
+	{
+		std::pair<baseline_map::const_iterator, baseline_map::const_iterator> r
+			= m.equal_range(id);
+		for (; r.first != r.second; ++r.first)
+			if (r.first->second.ep == ep) return r.first->second.sock;
+		return 0;
+	}
+
+	// feeds packets round-robin to num_sockets sockets and
+	// prints the average cost of a lookup in both maps
+	void bench_demux(int num_sockets)
+	{
+		utp_socket_map m;
+		baseline_map b;
+		std::vector<udp::endpoint> eps;
+		std::vector<boost::uint16_t> ids;
+		for (int i = 0; i < num_sockets; ++i)
+		{
+			udp::endpoint ep = peer_ep(i);
+			boost::uint16_t id = boost::uint16_t(i * 40503);
+			baseline_entry e = { ep, fake_socket(i) };
+			m.insert(ep, id, fake_socket(i));
+			b.insert(std::make_pair(id, e));
+			eps.push_back(ep);
+			ids.push_back(id);
+		}
+
+		const int rounds = 2000000 / num_sockets;
+		int failed = 0;
+
+		ptime start = time_now_hires();
+		for (int r = 0; r < rounds; ++r)
+			for (int i = 0; i < num_sockets; ++i)
+				if (m.find(eps[i], ids[i]) != fake_socket(i)) ++failed;
+		boost::int64_t hash_ns = total_microseconds(time_now_hires() - start) * 1000;
+
+		start = time_now_hires();
+		for (int r = 0; r < rounds; ++r)
+			for (int i = 0; i < num_sockets; ++i)
+				if (baseline_find(b, eps[i], ids[i]) != fake_socket(i)) ++failed;
+		boost::int64_t base_ns = total_microseconds(time_now_hires() - start) * 1000;
+
+		TEST_EQUAL(failed, 0);
+
+		boost::int64_t lookups = boost::int64_t(rounds) * num_sockets;
+		fprintf(stderr, "demux %5d sockets: hash table: %3d ns/packet  multimap: %3d ns/packet\n"
+			, num_sockets, int(hash_ns / lookups), int(base_ns / lookups));
+	}
+}
+
+int test_main()
+{
+	{
+		utp_socket_map m;
+		TEST_EQUAL(m.size(), 0);
+		TEST_CHECK(m.empty());
+		TEST_CHECK(m.find(peer_ep(0), 10) == 0);
+
+		m.insert(peer_ep(0), 10, fake_socket(0));
+		m.insert(peer_ep(1), 10, fake_socket(1));
+		m.insert(peer_ep(0), 11, fake_socket(2));
+		TEST_EQUAL(m.size(), 3);
+
+		// the same connection ID from different endpoints must
+		// map to different sockets, and vice versa
+		TEST_CHECK(m.find(peer_ep(0), 10) == fake_socket(0));
+		TEST_CHECK(m.find(peer_ep(1), 10) == fake_socket(1));
+		TEST_CHECK(m.find(peer_ep(0), 11) == fake_socket(2));
+		TEST_CHECK(m.find(peer_ep(1), 11) == 0);
+
+		// erasing requires the right socket
+		TEST_CHECK(!m.erase(peer_ep(0), 10, fake_socket(1)));
+		TEST_CHECK(m.erase(peer_ep(0), 10, fake_socket(0)));
+		TEST_CHECK(!m.erase(peer_ep(0), 10, fake_socket(0)));
+		TEST_EQUAL(m.size(), 2);
+		TEST_CHECK(m.find(peer_ep(0), 10) == 0);
+		TEST_CHECK(m.find(peer_ep(1), 10) == fake_socket(1));
+	}
+
+	{
+		// sockets that don't have a remote endpoint yet share
+		// the unspecified endpoint and may share IDs too
+		utp_socket_map m;
+		m.insert(udp::endpoint(), 5, fake_socket(0));
+		m.insert(udp::endpoint(), 5, fake_socket(1));
+		TEST_EQUAL(m.size(), 2);
+		TEST_CHECK(m.find(udp::endpoint(), 5) == fake_socket(0));
+
+		// rekey the first one, the way the socket manager does
+		// when the remote endpoint becomes known
+		TEST_CHECK(m.erase(udp::endpoint(), 5, fake_socket(0)));
+		m.insert(peer_ep(3), 5, fake_socket(0));
+		TEST_CHECK(m.find(udp::endpoint(), 5) == fake_socket(1));
+		TEST_CHECK(m.find(peer_ep(3), 5) == fake_socket(0));
+	}
+
+	{
+		// grow the table and erase in an order that exercises
+		// probe sequences wrapping around and being shifted back
+		utp_socket_map m;
+		const int num = 5000;
+		for (int i = 0; i < num; ++i)
+			m.insert(peer_ep(i), boost::uint16_t(i & 7), fake_socket(i));
+		TEST_EQUAL(m.size(), num);
+		TEST_CHECK(m.capacity() >= num * 2);
+
+		int failed = 0;
+		for (int i = 0; i < num; ++i)
+			if (m.find(peer_ep(i), boost::uint16_t(i & 7)) != fake_socket(i)) ++failed;
+		TEST_EQUAL(failed, 0);
+
+		for (int i = 0; i < num; i += 3)
+			TEST_CHECK(m.erase(peer_ep(i), boost::uint16_t(i & 7), fake_socket(i)));
+
+		failed = 0;
+		int count = 0;
+		for (int i = 0; i < num; ++i)
+		{
+			utp_socket_impl* s = m.find(peer_ep(i), boost::uint16_t(i & 7));
+			if (s != (i % 3 == 0 ? 0 : fake_socket(i))) ++failed;
+		}
+		for (int i = 0; i < m.capacity(); ++i)
+			if (m.at(i)) ++count;
+		TEST_EQUAL(failed, 0);
+		TEST_EQUAL(count, m.size());
+		TEST_EQUAL(m.size(), num - (num + 2) / 3);
+	}
+
+	bench_demux(10);
+	bench_demux(100);
+	bench_demux(1000);
+	bench_demux(10000);
+
+	return 0;
+}
+
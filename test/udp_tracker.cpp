@@ -56,6 +56,9 @@ struct udp_tracker
 
 	boost::asio::io_service m_ios;
 	boost::detail::atomic_count m_udp_announces;
+	boost::detail::atomic_count m_udp_connects;
+	boost::detail::atomic_count m_udp_scrapes;
+	boost::detail::atomic_count m_udp_scraped_hashes;
 	udp::socket m_socket;
 	int m_port;
 
@@ -88,6 +91,7 @@ struct udp_tracker
 		{
 			case 0: // connect
 
+				++m_udp_connects;
 				fprintf(stderr, "%s: UDP connect from %s\n", time_now_string(), print_endpoint(*from).c_str());
 				ptr = buffer;
 				detail::write_uint32(0, ptr); // action = connect
@@ -111,10 +115,27 @@ struct udp_tracker
 				m_socket.send_to(asio::buffer(buffer, 20), *from, 0, e);
 				if (e) fprintf(stderr, "%s: send_to failed. ERROR: %s\n", time_now_string(), e.message().c_str());
 				break;
-			case 2:
-				// ignore scrapes
-				fprintf(stderr, "%s: UDP scrape\n", time_now_string());
+			case 2: // scrape
+			{
+				// the request has one 20 byte info-hash after the header for
+				// every torrent, the response has 12 bytes for each of them
+				int num_hashes = (int(bytes_transferred) - 16) / 20;
+				++m_udp_scrapes;
+				for (int i = 0; i < num_hashes; ++i) ++m_udp_scraped_hashes;
+				fprintf(stderr, "%s: UDP scrape [%d info-hashes]\n", time_now_string(), num_hashes);
+				ptr = buffer;
+				detail::write_uint32(2, ptr); // action = scrape
+				detail::write_uint32(transaction_id, ptr); // transaction_id
+				for (int i = 0; i < num_hashes; ++i)
+				{
+					detail::write_uint32(1, ptr); // complete
+					detail::write_uint32(0, ptr); // downloaded
+					detail::write_uint32(1, ptr); // incomplete
+				}
+				m_socket.send_to(asio::buffer(buffer, 8 + 12 * num_hashes), *from, 0, e);
+				if (e) fprintf(stderr, "%s: send_to failed. ERROR: %s\n", time_now_string(), e.message().c_str());
 				break;
+			}
 			default:
 				fprintf(stderr, "%s: UDP unknown message: %d\n", time_now_string(), action);
 				break;
@@ -127,6 +148,9 @@ struct udp_tracker
 
 	udp_tracker()
 		: m_udp_announces(0)
+		, m_udp_connects(0)
+		, m_udp_scrapes(0)
+		, m_udp_scraped_hashes(0)
 		, m_socket(m_ios)
 		, m_port(0)
 	{
@@ -166,6 +190,9 @@ struct udp_tracker
 	int port() const { return m_port; }
 
 	int num_hits() const { return m_udp_announces; }
+	int num_connects() const { return m_udp_connects; }
+	int num_scrapes() const { return m_udp_scrapes; }
+	int num_scraped_hashes() const { return m_udp_scraped_hashes; }
 
 	static void incoming_packet(error_code const& ec, size_t bytes_transferred, size_t *ret, error_code* error, bool* done)
 	{
@@ -213,6 +240,24 @@ int num_udp_announces()
 	return 0;
 }
 
+int num_udp_connects()
+{
+	if (g_udp_tracker) return g_udp_tracker->num_connects();
+	return 0;
+}
+
+int num_udp_scrapes()
+{
+	if (g_udp_tracker) return g_udp_tracker->num_scrapes();
+	return 0;
+}
+
+int num_udp_scraped_hashes()
+{
+	if (g_udp_tracker) return g_udp_tracker->num_scraped_hashes();
+	return 0;
+}
+
 void stop_udp_tracker()
 {
 	fprintf(stderr, "%s: stop_udp_tracker()\n", time_now_string());
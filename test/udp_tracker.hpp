@@ -38,5 +38,13 @@ int EXPORT start_udp_tracker();
 // the number of udp tracker announces received
 int EXPORT num_udp_announces();
 
+// the number of udp tracker connect messages received
+int EXPORT num_udp_connects();
+
+// the number of udp tracker scrape packets received, and the total
+// number of info-hashes in them
+int EXPORT num_udp_scrapes();
+int EXPORT num_udp_scraped_hashes();
+
 void EXPORT stop_udp_tracker();
 
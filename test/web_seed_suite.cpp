@@ -73,6 +73,28 @@ static sha1_hash file_hash(std::string const& name)
 	return h.final();
 }
 
+// returns the number of requests and connections the web server has
+// served so far, the most connections it had open at the same time and
+// the most requests that were outstanding on one connection
+static boost::tuple<int, int, int, int> web_server_requests()
+{
+	std::vector<char> buf;
+	error_code ec;
+	load_file("web_server_requests", buf, ec);
+	int requests = 0;
+	int connections = 0;
+	int max_open_connections = 0;
+	int max_outstanding = 0;
+	if (!buf.empty())
+	{
+		buf.push_back('\0');
+		sscanf(&buf[0], "%d %d %d %d", &requests, &connections
+			, &max_open_connections, &max_outstanding);
+	}
+	return boost::make_tuple(requests, connections, max_open_connections
+		, max_outstanding);
+}
+
 static char const* proxy_name[] = {"", "_socks4", "_socks5", "_socks5_pw", "_http", "_http_pw", "_i2p"};
 
 // proxy: 0=none, 1=socks4, 2=socks5, 3=socks5_pw 4=http 5=http_pw
@@ -143,6 +165,11 @@ static void test_transfer(session& ses, boost::intrusive_ptr<torrent_info> torre
 
 	peer_disconnects = 0;
 
+	int requests_before;
+	int connections_before;
+	boost::tie(requests_before, connections_before, boost::tuples::ignore
+		, boost::tuples::ignore) = web_server_requests();
+
 	for (int i = 0; i < 40; ++i)
 	{
 		torrent_status s = th.status();
@@ -176,6 +203,34 @@ static void test_transfer(session& ses, boost::intrusive_ptr<torrent_info> torre
 		test_sleep(100);
 	}
 
+	int requests;
+	int connections;
+	int max_open_connections;
+	int max_outstanding;
+	boost::tie(requests, connections, max_open_connections, max_outstanding)
+		= web_server_requests();
+	requests -= requests_before;
+	connections -= connections_before;
+	fprintf(stderr, "web server: %d requests on %d connections, at most %d at a time"
+		", at most %d outstanding on one connection\n"
+		, requests, connections, max_open_connections, max_outstanding);
+
+	// the number of connections to a web seed may grow, but never beyond
+	// urlseed_max_connections
+	if (proxy == 0)
+		TEST_CHECK(max_open_connections <= ses.settings().urlseed_max_connections);
+
+	if (url_seed && proxy == 0)
+	{
+		// requests for adjacent ranges of a file are merged while they
+		// wait for room in the pipeline, so a single file is downloaded
+		// in fewer requests than it has pieces
+		if (!test_ban && fs.num_files() == 1)
+			TEST_CHECK(requests < torrent_file->num_pieces());
+
+		TEST_CHECK(max_outstanding <= ses.settings().urlseed_pipeline_size);
+	}
+
 	// for test_ban tests, make sure we removed
 	// the url seed (i.e. banned it)
 	TEST_CHECK(!test_ban || (th.url_seeds().empty() && th.http_seeds().empty()));
@@ -229,6 +284,41 @@ static void test_transfer(session& ses, boost::intrusive_ptr<torrent_info> torre
 	remove_all(save_path, ec);
 }
 
+// creates a single file torrent with a url seed, whose file is in the
+// "single" directory under save_path
+static boost::intrusive_ptr<torrent_info> single_file_torrent(std::string const& save_path
+	, char const* protocol, int port)
+{
+	std::string dir = combine_path(save_path, "single");
+	error_code ec;
+	create_directory(dir, ec);
+	static const int file_sizes[] = { 64 * 0x4000 };
+	create_random_files(dir, file_sizes, 1);
+	// create_random_files() puts the file in a sub directory
+	dir = combine_path(dir, "test_dir0");
+
+	file_storage fs;
+	add_files(fs, combine_path(dir, "test0"));
+	libtorrent::create_torrent t(fs, 0x4000);
+
+	char url[512];
+	snprintf(url, sizeof(url), "%s://127.0.0.1:%d/%s/", protocol, port, dir.c_str());
+	t.add_url_seed(url);
+
+	set_piece_hashes(t, dir, ec);
+	if (ec)
+	{
+		fprintf(stderr, "error creating hashes for test torrent: %s\n"
+			, ec.message().c_str());
+		TEST_CHECK(false);
+		return boost::intrusive_ptr<torrent_info>();
+	}
+
+	std::vector<char> buf;
+	bencode(std::back_inserter(buf), t.generate());
+	return boost::intrusive_ptr<torrent_info>(new torrent_info(&buf[0], buf.size(), ec));
+}
+
 // proxy: 0=none, 1=socks4, 2=socks5, 3=socks5_pw 4=http 5=http_pw
 // protocol: "http" or "https"
 // test_url_seed determines whether to use url-seed or http-seed
@@ -350,6 +440,7 @@ int EXPORT run_http_suite(int proxy, char const* protocol, bool test_url_seed, b
 		session ses(fingerprint("  ", 0,0,0,0), 0);
 		session_settings settings;
 		settings.max_queued_disk_bytes = 256 * 1024;
+		settings.urlseed_max_connections = 2;
 		ses.set_settings(settings);
 		ses.set_alert_mask(~(alert::progress_notification | alert::stats_notification));
 		error_code ec;
@@ -363,6 +454,14 @@ int EXPORT run_http_suite(int proxy, char const* protocol, bool test_url_seed, b
 			torrent_file->rename_file(0, combine_path(save_path, combine_path("torrent_dir", "renamed_test1")));
 			test_transfer(ses, torrent_file, 0, port, protocol, test_url_seed, chunked_encoding, test_ban);
 		}
+
+		if (test_url_seed && !test_ban)
+		{
+			boost::intrusive_ptr<torrent_info> single_file
+				= single_file_torrent(save_path, protocol, port);
+			if (single_file)
+				test_transfer(ses, single_file, 0, port, protocol, true, chunked_encoding, false);
+		}
 	}
 
 	stop_web_server();
@@ -1,5 +1,8 @@
 import BaseHTTPServer
 import SimpleHTTPServer
+import SocketServer
+import threading
+import socket
 import sys
 import os
 import ssl
@@ -7,6 +10,19 @@ import gzip
 
 chunked_encoding = False
 
+# the number of GET requests and connections served so far, the most
+# connections that were open at the same time and the most requests that
+# were outstanding on a single connection. They're written to the file
+# "web_server_requests" after every request, for the tests to check how
+# requests are pipelined and merged, and how many connections are opened
+# to a web seed
+num_requests = 0
+num_connections = 0
+open_connections = 0
+max_open_connections = 0
+max_outstanding_requests = 0
+stats_lock = threading.Lock()
+
 try:
 	fin = open('test_file', 'rb')
 	f = gzip.open('test_file.gz', 'wb')
@@ -16,8 +32,11 @@ try:
 except:
 	pass
 
-class http_server_with_timeout(BaseHTTPServer.HTTPServer):
+# every connection is served by its own thread, so that a client can
+# have several of them open at once
+class http_server_with_timeout(SocketServer.ThreadingMixIn, BaseHTTPServer.HTTPServer):
 	allow_reuse_address = True
+	daemon_threads = True
 	timeout = 190
 
 	def handle_timeout(self):
@@ -25,7 +44,55 @@ class http_server_with_timeout(BaseHTTPServer.HTTPServer):
 
 class http_handler(SimpleHTTPServer.SimpleHTTPRequestHandler):
 
+	# read requests unbuffered, so that the ones pipelined behind the
+	# current one are left in the socket, where they can be counted
+	rbufsize = 0
+
+	# returns the number of requests the client has sent on this
+	# connection that haven't been read yet
+	def pipelined_requests(s):
+		try:
+			data = s.connection.recv(65536, socket.MSG_PEEK | socket.MSG_DONTWAIT)
+		except:
+			# nothing to read, or an SSL socket which can't peek
+			return 0
+		return data.count('\r\nGET ') + data.startswith('GET ')
+
+	def setup(s):
+		global num_connections, open_connections, max_open_connections
+		stats_lock.acquire()
+		num_connections += 1
+		open_connections += 1
+		max_open_connections = max(max_open_connections, open_connections)
+		stats_lock.release()
+		SimpleHTTPServer.SimpleHTTPRequestHandler.setup(s)
+
+	def finish(s):
+		global open_connections
+		try:
+			SimpleHTTPServer.SimpleHTTPRequestHandler.finish(s)
+		finally:
+			stats_lock.acquire()
+			open_connections -= 1
+			stats_lock.release()
+
 	def do_GET(s):
+		global num_requests, max_outstanding_requests
+		outstanding = 1 + s.pipelined_requests()
+		stats_lock.acquire()
+		num_requests += 1
+		max_outstanding_requests = max(max_outstanding_requests, outstanding)
+		try:
+			f = open('web_server_requests', 'w')
+			f.write('%d %d %d %d\n' % (num_requests, num_connections
+				, max_open_connections, max_outstanding_requests))
+			f.close()
+		except:
+			pass
+		stats_lock.release()
+		s.serve_GET()
+
+	def serve_GET(s):
 
 		#print s.requestline
 		global chunked_encoding
@@ -52,11 +119,14 @@ class http_handler(SimpleHTTPServer.SimpleHTTPRequestHandler):
 			s.send_header("Location", "../test_file")
 			s.send_header("Connection", "close")
 			s.end_headers()
-		elif s.path.startswith('/announce'):
+		elif s.path.startswith('/announce') or s.path.startswith('/keepalive/announce'):
 			s.send_response(200)
 			response = 'd8:intervali1800e8:completei1e10:incompletei1e5:peers0:e'
 			s.send_header("Content-Length", "%d" % len(response))
-			s.send_header("Connection", "close")
+			# /keepalive/announce leaves the connection open for the next
+			# request
+			if s.path.startswith('/announce'):
+				s.send_header("Connection", "close")
 			s.end_headers()
 			s.wfile.write(response)
 		elif os.path.split(s.path)[1].startswith('seed?'):
@@ -0,0 +1,65 @@
+#! /usr/bin/env python
+# Copyright Arvid Norberg 2014. Use, modification and distribution is
+# subject to the Boost Software License, Version 1.0. (See accompanying
+# file LICENSE_1_0.txt or copy at http://www.boost.org/LICENSE_1_0.txt)
+
+# parses the latency histogram logs written by libtorrent built with
+# TORRENT_STATS (session_stats/<pid>.<seq>.latency.log) and prints the
+# percentiles of each histogram. The histograms in the log are cumulative.
+# If two log files are given, the histograms of the first are subtracted
+# from the second, to get the distribution for the time in between.
+
+import sys
+
+if len(sys.argv) < 2:
+	print('usage: parse_latency_log.py [earlier-log] latency-log')
+	sys.exit(1)
+
+percentiles = [50, 90, 99, 99.9, 100]
+
+def parse(filename):
+	bounds = []
+	histograms = []
+	for l in open(filename, 'r'):
+		name, values = l.split(':', 1)
+		values = [int(v) for v in values.split()]
+		if name == 'buckets': bounds = values
+		else: histograms.append((name, values))
+	return bounds, histograms
+
+bounds, histograms = parse(sys.argv[-1])
+
+if len(sys.argv) > 2:
+	earlier = dict(parse(sys.argv[1])[1])
+	for name, values in histograms:
+		if not name in earlier: continue
+		for i in range(len(values)):
+			values[i] -= earlier[name][i]
+
+# returns the upper bound (in microseconds) of the bucket the percentile
+# falls into. This mirrors latency_histogram::percentile()
+def percentile(values, p):
+	total = sum(values)
+	if total == 0: return 0
+	limit = min(max(int(total * p / 100.0 + 0.5), 1), total)
+	acc = 0
+	for i in range(len(values) - 1):
+		acc += values[i]
+		if acc >= limit: return bounds[i + 1] - 1
+	return bounds[-1]
+
+def format_us(us):
+	if us >= 1000000: return '%.1f s' % (us / 1000000.0)
+	if us >= 1000: return '%.1f ms' % (us / 1000.0)
+	return '%d us' % us
+
+sys.stdout.write('%-36s %10s' % ('histogram', 'samples'))
+for p in percentiles: sys.stdout.write(' %10s' % ('p%s' % p))
+sys.stdout.write('\n')
+
+for name, values in histograms:
+	sys.stdout.write('%-36s %10d' % (name, sum(values)))
+	for p in percentiles:
+		sys.stdout.write(' %10s' % format_us(percentile(values, p)))
+	sys.stdout.write('\n')
+